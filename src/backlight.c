@@ -0,0 +1,648 @@
+/*
+ * Copyright 2026 The Ayatana Indicators project
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "backlight.h"
+
+#include <glib-unix.h>
+#include <gio/gio.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h> /* atoi() */
+#include <string.h>
+#include <unistd.h>
+
+#define DEFAULT_SYSFS_ROOT "/sys"
+
+#define LOGIND_BUSNAME "org.freedesktop.login1"
+#define LOGIND_SESSION_PATH "/org/freedesktop/login1/session/auto"
+#define LOGIND_SESSION_IFACE "org.freedesktop.login1.Session"
+
+enum
+{
+  PROP_0,
+  PROP_SYSFS_ROOT,
+  PROP_BRIGHTNESS,
+  LAST_PROP
+};
+
+static GParamSpec* properties[LAST_PROP];
+
+typedef struct
+{
+  gchar * sysfs_root;
+
+  /* the device we picked, e.g. "intel_backlight" */
+  gchar * name;
+  int max_brightness;
+  int brightness;
+
+  /* kept open so that each change is a single pwrite() */
+  int brightness_fd;
+
+  /* kept open so that we can poll() it for sysfs_notify() */
+  int actual_brightness_fd;
+  guint actual_brightness_tag;
+  GFileMonitor * actual_brightness_monitor;
+
+  /* used iff we can't write to brightness_fd */
+  gboolean use_logind;
+  GDBusConnection * system_bus;
+}
+IndicatorPowerBacklightPrivate;
+
+typedef IndicatorPowerBacklightPrivate priv_t;
+
+G_DEFINE_TYPE_WITH_PRIVATE(IndicatorPowerBacklight,
+                           indicator_power_backlight,
+                           G_TYPE_OBJECT)
+
+#define get_priv(o) ((priv_t*)indicator_power_backlight_get_instance_private(o))
+
+/***
+****  sysfs helpers
+***/
+
+static gboolean
+read_int_file(const char * filename, int * setme)
+{
+  gchar * contents = NULL;
+  gboolean success = FALSE;
+
+  if (g_file_get_contents(filename, &contents, NULL, NULL))
+    {
+      *setme = atoi(contents);
+      success = TRUE;
+    }
+
+  g_free(contents);
+  return success;
+}
+
+static gboolean
+read_int_fd(int fd, int * setme)
+{
+  char buf[32];
+  ssize_t n;
+
+  /* sysfs attributes must be re-read from the start */
+  n = pread(fd, buf, sizeof(buf)-1, 0);
+  if (n <= 0)
+    return FALSE;
+
+  buf[n] = '\0';
+  *setme = atoi(buf);
+  return TRUE;
+}
+
+/* Like logind and gnome-settings-daemon, prefer firmware interfaces
+   over platform ones, and platform ones over raw driver interfaces. */
+static int
+get_type_rank(const char * device_dir)
+{
+  gchar * filename;
+  gchar * type = NULL;
+  int rank = 0;
+
+  filename = g_build_filename(device_dir, "type", NULL);
+  if (g_file_get_contents(filename, &type, NULL, NULL))
+    {
+      g_strstrip(type);
+
+      if (!g_strcmp0(type, "firmware"))
+        rank = 3;
+      else if (!g_strcmp0(type, "platform"))
+        rank = 2;
+      else if (!g_strcmp0(type, "raw"))
+        rank = 1;
+    }
+
+  g_free(type);
+  g_free(filename);
+  return rank;
+}
+
+static gchar *
+find_backlight_device(const char * sysfs_root)
+{
+  gchar * class_dir;
+  GDir * dir;
+  gchar * best_name = NULL;
+  int best_rank = -1;
+
+  class_dir = g_build_filename(sysfs_root, "class", "backlight", NULL);
+  dir = g_dir_open(class_dir, 0, NULL);
+
+  if (dir != NULL)
+    {
+      const gchar * name;
+
+      while ((name = g_dir_read_name(dir)))
+        {
+          gchar * device_dir = g_build_filename(class_dir, name, NULL);
+          const int rank = get_type_rank(device_dir);
+
+          /* break ties by name so that the choice is stable */
+          if ((rank > best_rank) || ((rank == best_rank) && (g_strcmp0(name, best_name) < 0)))
+            {
+              g_free(best_name);
+              best_name = g_strdup(name);
+              best_rank = rank;
+            }
+
+          g_free(device_dir);
+        }
+
+      g_dir_close(dir);
+    }
+
+  g_free(class_dir);
+  return best_name;
+}
+
+/***
+****  Watching for external changes
+***/
+
+static void
+refresh_brightness(IndicatorPowerBacklight * self)
+{
+  priv_t * p = get_priv(self);
+  int brightness;
+
+  if ((p->actual_brightness_fd != -1) &&
+      read_int_fd(p->actual_brightness_fd, &brightness) &&
+      (p->brightness != brightness))
+    {
+      p->brightness = brightness;
+      g_object_notify_by_pspec(G_OBJECT(self), properties[PROP_BRIGHTNESS]);
+    }
+}
+
+/* the kernel wakes pollers with POLLPRI when actual_brightness changes */
+static gboolean
+on_actual_brightness_pri(gint         fd        G_GNUC_UNUSED,
+                         GIOCondition condition,
+                         gpointer     gself)
+{
+  if (condition & G_IO_PRI)
+    {
+      refresh_brightness(INDICATOR_POWER_BACKLIGHT(gself));
+      return G_SOURCE_CONTINUE;
+    }
+
+  get_priv(INDICATOR_POWER_BACKLIGHT(gself))->actual_brightness_tag = 0;
+  return G_SOURCE_REMOVE;
+}
+
+/* ...and a file monitor covers anything that doesn't use sysfs_notify(),
+   such as a test's fake sysfs tree */
+static void
+on_actual_brightness_file_changed(GFileMonitor      * monitor    G_GNUC_UNUSED,
+                                  GFile             * file       G_GNUC_UNUSED,
+                                  GFile             * other_file G_GNUC_UNUSED,
+                                  GFileMonitorEvent   event_type,
+                                  gpointer            gself)
+{
+  if ((event_type == G_FILE_MONITOR_EVENT_CHANGED) ||
+      (event_type == G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT))
+    refresh_brightness(INDICATOR_POWER_BACKLIGHT(gself));
+}
+
+/***
+****  Setup
+***/
+
+static void
+open_device(IndicatorPowerBacklight * self)
+{
+  priv_t * p = get_priv(self);
+  gchar * device_dir;
+  gchar * filename;
+  GFile * file;
+
+  p->name = find_backlight_device(p->sysfs_root);
+  if (p->name == NULL)
+    {
+      g_debug("No backlight devices in %s", p->sysfs_root);
+      return;
+    }
+
+  device_dir = g_build_filename(p->sysfs_root, "class", "backlight", p->name, NULL);
+
+  /* max_brightness never changes, so only read it once */
+  filename = g_build_filename(device_dir, "max_brightness", NULL);
+  if (!read_int_file(filename, &p->max_brightness) || (p->max_brightness <= 0))
+    {
+      g_warning("Unable to read '%s'", filename);
+      g_clear_pointer(&p->name, g_free);
+    }
+  g_free(filename);
+
+  if (p->name != NULL)
+    {
+      filename = g_build_filename(device_dir, "brightness", NULL);
+      p->brightness_fd = open(filename, O_WRONLY|O_CLOEXEC);
+      if (p->brightness_fd == -1)
+        {
+          const int err = errno;
+
+          if ((err == EACCES) || (err == EPERM) || (err == EROFS))
+            {
+              g_debug("Can't write to '%s'; using logind instead", filename);
+              p->use_logind = TRUE;
+            }
+          else
+            {
+              g_warning("Unable to open '%s': %s", filename, g_strerror(err));
+              g_clear_pointer(&p->name, g_free);
+            }
+        }
+      g_free(filename);
+    }
+
+  if (p->name != NULL)
+    {
+      filename = g_build_filename(device_dir, "actual_brightness", NULL);
+      p->actual_brightness_fd = open(filename, O_RDONLY|O_CLOEXEC);
+      if (p->actual_brightness_fd != -1)
+        {
+          read_int_fd(p->actual_brightness_fd, &p->brightness);
+          p->actual_brightness_tag = g_unix_fd_add(p->actual_brightness_fd,
+                                                   G_IO_PRI|G_IO_ERR,
+                                                   on_actual_brightness_pri,
+                                                   self);
+        }
+      else
+        {
+          g_warning("Unable to open '%s': %s", filename, g_strerror(errno));
+        }
+
+      file = g_file_new_for_path(filename);
+      p->actual_brightness_monitor = g_file_monitor_file(file, G_FILE_MONITOR_NONE, NULL, NULL);
+      if (p->actual_brightness_monitor != NULL)
+        g_signal_connect(p->actual_brightness_monitor, "changed",
+                         G_CALLBACK(on_actual_brightness_file_changed), self);
+      g_object_unref(file);
+      g_free(filename);
+
+      g_debug("Using backlight '%s': brightness %d of %d%s",
+              p->name, p->brightness, p->max_brightness,
+              p->use_logind ? " (via logind)" : "");
+    }
+
+  g_free(device_dir);
+}
+
+/***
+****  GObject virtual functions
+***/
+
+static void
+my_get_property(GObject     * o,
+                guint         property_id,
+                GValue      * value,
+                GParamSpec  * pspec)
+{
+  priv_t * p = get_priv(INDICATOR_POWER_BACKLIGHT(o));
+
+  switch (property_id)
+    {
+      case PROP_SYSFS_ROOT:
+        g_value_set_string(value, p->sysfs_root);
+        break;
+
+      case PROP_BRIGHTNESS:
+        g_value_set_int(value, p->brightness);
+        break;
+
+      default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID(o, property_id, pspec);
+    }
+}
+
+static void
+my_set_property(GObject       * o,
+                guint           property_id,
+                const GValue  * value,
+                GParamSpec    * pspec)
+{
+  priv_t * p = get_priv(INDICATOR_POWER_BACKLIGHT(o));
+
+  switch (property_id)
+    {
+      case PROP_SYSFS_ROOT:
+        g_free(p->sysfs_root);
+        p->sysfs_root = g_value_dup_string(value);
+        break;
+
+      default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID(o, property_id, pspec);
+    }
+}
+
+static void
+my_constructed(GObject * o)
+{
+  priv_t * p = get_priv(INDICATOR_POWER_BACKLIGHT(o));
+
+  if (p->sysfs_root == NULL)
+    p->sysfs_root = g_strdup(DEFAULT_SYSFS_ROOT);
+
+  open_device(INDICATOR_POWER_BACKLIGHT(o));
+
+  G_OBJECT_CLASS(indicator_power_backlight_parent_class)->constructed(o);
+}
+
+static void
+my_dispose(GObject * o)
+{
+  priv_t * p = get_priv(INDICATOR_POWER_BACKLIGHT(o));
+
+  if (p->actual_brightness_tag != 0)
+    {
+      g_source_remove(p->actual_brightness_tag);
+      p->actual_brightness_tag = 0;
+    }
+
+  if (p->actual_brightness_monitor != NULL)
+    {
+      g_signal_handlers_disconnect_by_data(p->actual_brightness_monitor, o);
+      g_file_monitor_cancel(p->actual_brightness_monitor);
+      g_clear_object(&p->actual_brightness_monitor);
+    }
+
+  g_clear_object(&p->system_bus);
+
+  G_OBJECT_CLASS(indicator_power_backlight_parent_class)->dispose(o);
+}
+
+static void
+my_finalize(GObject * o)
+{
+  priv_t * p = get_priv(INDICATOR_POWER_BACKLIGHT(o));
+
+  if (p->brightness_fd != -1)
+    close(p->brightness_fd);
+
+  if (p->actual_brightness_fd != -1)
+    close(p->actual_brightness_fd);
+
+  g_free(p->name);
+  g_free(p->sysfs_root);
+
+  G_OBJECT_CLASS(indicator_power_backlight_parent_class)->finalize(o);
+}
+
+/***
+****  DBus Chatter: org.freedesktop.login1.Session
+****
+****  Used to set the brightness when we lack write permission
+****  to the sysfs attribute, e.g. when udev hasn't granted it.
+***/
+
+static void
+on_logind_set_brightness_result(GObject      * system_bus,
+                                GAsyncResult * res,
+                                gpointer       gtask)
+{
+  GTask * task = G_TASK(gtask);
+  GError * error = NULL;
+  GVariant * v;
+
+  v = g_dbus_connection_call_finish(G_DBUS_CONNECTION(system_bus), res, &error);
+  if (v != NULL)
+    {
+      IndicatorPowerBacklight * self = g_task_get_source_object(task);
+      get_priv(self)->brightness = GPOINTER_TO_INT(g_task_get_task_data(task));
+      g_task_return_boolean(task, TRUE);
+      g_variant_unref(v);
+    }
+  else
+    {
+      g_task_return_error(task, error);
+    }
+
+  g_object_unref(task);
+}
+
+static void
+call_logind_set_brightness(GTask * task)
+{
+  priv_t * p = get_priv(INDICATOR_POWER_BACKLIGHT(g_task_get_source_object(task)));
+
+  g_dbus_connection_call(p->system_bus,
+                         LOGIND_BUSNAME,
+                         LOGIND_SESSION_PATH,
+                         LOGIND_SESSION_IFACE,
+                         "SetBrightness",
+                         g_variant_new("(ssu)",
+                                       "backlight",
+                                       p->name,
+                                       (guint32)GPOINTER_TO_INT(g_task_get_task_data(task))),
+                         NULL,
+                         G_DBUS_CALL_FLAGS_NONE,
+                         -1,
+                         g_task_get_cancellable(task),
+                         on_logind_set_brightness_result,
+                         task);
+}
+
+static void
+on_system_bus_ready(GObject      * source_object G_GNUC_UNUSED,
+                    GAsyncResult * res,
+                    gpointer       gtask)
+{
+  GTask * task = G_TASK(gtask);
+  GError * error = NULL;
+  GDBusConnection * system_bus;
+
+  system_bus = g_bus_get_finish(res, &error);
+  if (system_bus != NULL)
+    {
+      priv_t * p = get_priv(INDICATOR_POWER_BACKLIGHT(g_task_get_source_object(task)));
+
+      if (p->system_bus == NULL)
+        p->system_bus = g_object_ref(system_bus);
+
+      call_logind_set_brightness(task);
+      g_object_unref(system_bus);
+    }
+  else
+    {
+      g_task_return_error(task, error);
+      g_object_unref(task);
+    }
+}
+
+/***
+****  Instantiation
+***/
+
+static void
+indicator_power_backlight_init(IndicatorPowerBacklight * self)
+{
+  priv_t * p = get_priv(self);
+
+  p->brightness_fd = -1;
+  p->actual_brightness_fd = -1;
+}
+
+static void
+indicator_power_backlight_class_init(IndicatorPowerBacklightClass * klass)
+{
+  GObjectClass * object_class = G_OBJECT_CLASS(klass);
+
+  object_class->constructed = my_constructed;
+  object_class->dispose = my_dispose;
+  object_class->finalize = my_finalize;
+  object_class->get_property = my_get_property;
+  object_class->set_property = my_set_property;
+
+  properties[PROP_0] = NULL;
+
+  properties[PROP_SYSFS_ROOT] = g_param_spec_string(
+    INDICATOR_POWER_BACKLIGHT_PROP_SYSFS_ROOT,
+    "Sysfs Root",
+    "Where sysfs is mounted",
+    DEFAULT_SYSFS_ROOT,
+    G_PARAM_READWRITE|G_PARAM_CONSTRUCT_ONLY|G_PARAM_STATIC_STRINGS);
+
+  properties[PROP_BRIGHTNESS] = g_param_spec_int(
+    INDICATOR_POWER_BACKLIGHT_PROP_BRIGHTNESS,
+    "Brightness",
+    "The backlight's brightness, from 0 to max-brightness",
+    0, G_MAXINT, 0,
+    G_PARAM_READABLE|G_PARAM_STATIC_STRINGS);
+
+  g_object_class_install_properties(object_class, LAST_PROP, properties);
+}
+
+/***
+****  Public API
+***/
+
+/**
+ * @sysfs_root: where sysfs is mounted, or NULL for "/sys"
+ */
+IndicatorPowerBacklight *
+indicator_power_backlight_new(const char * sysfs_root)
+{
+  gpointer o = g_object_new(INDICATOR_TYPE_POWER_BACKLIGHT,
+                            INDICATOR_POWER_BACKLIGHT_PROP_SYSFS_ROOT, sysfs_root,
+                            NULL);
+
+  return INDICATOR_POWER_BACKLIGHT(o);
+}
+
+gboolean
+indicator_power_backlight_is_available(IndicatorPowerBacklight * self)
+{
+  g_return_val_if_fail(INDICATOR_IS_POWER_BACKLIGHT(self), FALSE);
+
+  return get_priv(self)->name != NULL;
+}
+
+const char *
+indicator_power_backlight_get_name(IndicatorPowerBacklight * self)
+{
+  g_return_val_if_fail(INDICATOR_IS_POWER_BACKLIGHT(self), NULL);
+
+  return get_priv(self)->name;
+}
+
+int
+indicator_power_backlight_get_max_brightness(IndicatorPowerBacklight * self)
+{
+  g_return_val_if_fail(INDICATOR_IS_POWER_BACKLIGHT(self), 0);
+
+  return get_priv(self)->max_brightness;
+}
+
+int
+indicator_power_backlight_get_brightness(IndicatorPowerBacklight * self)
+{
+  g_return_val_if_fail(INDICATOR_IS_POWER_BACKLIGHT(self), 0);
+
+  return get_priv(self)->brightness;
+}
+
+/**
+ * Set the backlight's brightness.
+ *
+ * Since the caller already knows about this change,
+ * "notify::brightness" is only emitted for external changes.
+ */
+void
+indicator_power_backlight_set_brightness(IndicatorPowerBacklight * self,
+                                         int                       brightness,
+                                         GCancellable            * cancellable,
+                                         GAsyncReadyCallback       callback,
+                                         gpointer                  user_data)
+{
+  priv_t * p;
+  GTask * task;
+
+  g_return_if_fail(INDICATOR_IS_POWER_BACKLIGHT(self));
+
+  p = get_priv(self);
+  task = g_task_new(self, cancellable, callback, user_data);
+  brightness = CLAMP(brightness, 0, p->max_brightness);
+
+  if (p->name == NULL)
+    {
+      g_task_return_new_error(task, G_IO_ERROR, G_IO_ERROR_NOT_FOUND,
+                              "No backlight device in %s", p->sysfs_root);
+      g_object_unref(task);
+    }
+  else if (!p->use_logind)
+    {
+      char buf[16];
+      const int len = g_snprintf(buf, sizeof(buf), "%d\n", brightness);
+
+      if (pwrite(p->brightness_fd, buf, len, 0) == len)
+        {
+          p->brightness = brightness;
+          g_task_return_boolean(task, TRUE);
+        }
+      else
+        {
+          const int err = errno;
+          g_task_return_new_error(task, G_IO_ERROR, g_io_error_from_errno(err),
+                                  "Unable to set '%s' brightness: %s", p->name, g_strerror(err));
+        }
+      g_object_unref(task);
+    }
+  else
+    {
+      g_task_set_task_data(task, GINT_TO_POINTER(brightness), NULL);
+
+      if (p->system_bus != NULL)
+        call_logind_set_brightness(task);
+      else
+        g_bus_get(G_BUS_TYPE_SYSTEM, cancellable, on_system_bus_ready, task);
+    }
+}
+
+gboolean
+indicator_power_backlight_set_brightness_finish(IndicatorPowerBacklight  * self,
+                                                GAsyncResult             * res,
+                                                GError                  ** error)
+{
+  g_return_val_if_fail(g_task_is_valid(res, self), FALSE);
+
+  return g_task_propagate_boolean(G_TASK(res), error);
+}
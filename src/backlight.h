@@ -0,0 +1,83 @@
+/*
+ * Copyright 2026 The Ayatana Indicators project
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef INDICATOR_POWER_BACKLIGHT__H
+#define INDICATOR_POWER_BACKLIGHT__H
+
+#include <glib.h>
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+/* standard GObject macros */
+#define INDICATOR_POWER_BACKLIGHT(o)            (G_TYPE_CHECK_INSTANCE_CAST ((o), INDICATOR_TYPE_POWER_BACKLIGHT, IndicatorPowerBacklight))
+#define INDICATOR_TYPE_POWER_BACKLIGHT          (indicator_power_backlight_get_type())
+#define INDICATOR_IS_POWER_BACKLIGHT(o)         (G_TYPE_CHECK_INSTANCE_TYPE ((o), INDICATOR_TYPE_POWER_BACKLIGHT))
+
+typedef struct _IndicatorPowerBacklight         IndicatorPowerBacklight;
+typedef struct _IndicatorPowerBacklightClass    IndicatorPowerBacklightClass;
+
+/* property keys */
+#define INDICATOR_POWER_BACKLIGHT_PROP_SYSFS_ROOT  "sysfs-root"
+#define INDICATOR_POWER_BACKLIGHT_PROP_BRIGHTNESS  "brightness"
+
+/**
+ * A backlight device in /sys/class/backlight.
+ *
+ * Writes go straight to the device's brightness attribute,
+ * or through logind's SetBrightness if we can't open it for writing.
+ * External changes are picked up from actual_brightness.
+ */
+struct _IndicatorPowerBacklight
+{
+  /*< private >*/
+  GObject parent;
+};
+
+struct _IndicatorPowerBacklightClass
+{
+  GObjectClass parent_class;
+};
+
+/***
+****
+***/
+
+GType indicator_power_backlight_get_type(void);
+
+IndicatorPowerBacklight * indicator_power_backlight_new(const char * sysfs_root);
+
+gboolean indicator_power_backlight_is_available(IndicatorPowerBacklight * self);
+
+const char * indicator_power_backlight_get_name(IndicatorPowerBacklight * self);
+
+int indicator_power_backlight_get_max_brightness(IndicatorPowerBacklight * self);
+
+int indicator_power_backlight_get_brightness(IndicatorPowerBacklight * self);
+
+void indicator_power_backlight_set_brightness(IndicatorPowerBacklight * self,
+                                              int                       brightness,
+                                              GCancellable            * cancellable,
+                                              GAsyncReadyCallback       callback,
+                                              gpointer                  user_data);
+
+gboolean indicator_power_backlight_set_brightness_finish(IndicatorPowerBacklight  * self,
+                                                         GAsyncResult             * res,
+                                                         GError                  ** error);
+
+G_END_DECLS
+
+#endif /* INDICATOR_POWER_BACKLIGHT__H */
@@ -0,0 +1,372 @@
+/*
+ * Copyright 2026 The Ayatana Indicators project
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "battery-watches.h"
+
+#include <string.h> /* memmove(), strcmp() */
+
+/***
+****  Names
+***/
+
+static const gchar * const property_names[INDICATOR_POWER_WATCH_N_PROPERTIES] =
+{
+  "Percentage",
+  "TimeRemaining",
+  "State"
+};
+
+static const gchar * const comparison_names[INDICATOR_POWER_WATCH_N_COMPARISONS] =
+{
+  "below",
+  "above",
+  "equals"
+};
+
+gboolean
+indicator_power_watch_property_from_string (const gchar                 * str,
+                                            IndicatorPowerWatchProperty * setme)
+{
+  guint i;
+
+  for (i=0; i<G_N_ELEMENTS(property_names); i++)
+    {
+      if (!g_strcmp0 (str, property_names[i]))
+        {
+          *setme = (IndicatorPowerWatchProperty) i;
+          return TRUE;
+        }
+    }
+
+  return FALSE;
+}
+
+gboolean
+indicator_power_watch_comparison_from_string (const gchar                   * str,
+                                              IndicatorPowerWatchComparison * setme)
+{
+  guint i;
+
+  for (i=0; i<G_N_ELEMENTS(comparison_names); i++)
+    {
+      if (!g_strcmp0 (str, comparison_names[i]))
+        {
+          *setme = (IndicatorPowerWatchComparison) i;
+          return TRUE;
+        }
+    }
+
+  return FALSE;
+}
+
+/***
+****  Watches
+***/
+
+typedef struct
+{
+  guint32 id;
+  gchar * owner;
+  IndicatorPowerWatchProperty property;
+  IndicatorPowerWatchComparison comparison;
+  gdouble threshold;
+}
+Watch;
+
+struct _IndicatorPowerWatchList
+{
+  /* Watch*, sorted by threshold */
+  GPtrArray * sorted[INDICATOR_POWER_WATCH_N_PROPERTIES][INDICATOR_POWER_WATCH_N_COMPARISONS];
+
+  GHashTable * by_id;    /* GUINT_TO_POINTER(id) -> Watch*, owns the watches */
+  GHashTable * n_owned;  /* owner -> GUINT_TO_POINTER(count) */
+
+  guint32 next_id;
+};
+
+static void
+watch_free (gpointer gwatch)
+{
+  Watch * watch = gwatch;
+
+  g_free (watch->owner);
+  g_free (watch);
+}
+
+/* index of the first watch whose threshold is >= threshold,
+   or > threshold if inclusive is FALSE */
+static guint
+lower_bound (GPtrArray * watches, gdouble threshold, gboolean inclusive)
+{
+  guint lo = 0;
+  guint hi = watches->len;
+
+  while (lo < hi)
+    {
+      const guint mid = lo + (hi - lo) / 2;
+      const Watch * watch = g_ptr_array_index (watches, mid);
+
+      if ((watch->threshold < threshold) || (!inclusive && (watch->threshold == threshold)))
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+
+  return lo;
+}
+
+IndicatorPowerWatchList *
+indicator_power_watch_list_new (void)
+{
+  IndicatorPowerWatchList * list;
+  guint i, j;
+
+  list = g_new0 (IndicatorPowerWatchList, 1);
+
+  for (i=0; i<INDICATOR_POWER_WATCH_N_PROPERTIES; i++)
+    for (j=0; j<INDICATOR_POWER_WATCH_N_COMPARISONS; j++)
+      list->sorted[i][j] = g_ptr_array_new ();
+
+  list->by_id = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, watch_free);
+  list->n_owned = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  list->next_id = 1;
+
+  return list;
+}
+
+void
+indicator_power_watch_list_free (IndicatorPowerWatchList * list)
+{
+  guint i, j;
+
+  g_return_if_fail (list != NULL);
+
+  for (i=0; i<INDICATOR_POWER_WATCH_N_PROPERTIES; i++)
+    for (j=0; j<INDICATOR_POWER_WATCH_N_COMPARISONS; j++)
+      g_ptr_array_unref (list->sorted[i][j]);
+
+  g_hash_table_destroy (list->by_id);
+  g_hash_table_destroy (list->n_owned);
+  g_free (list);
+}
+
+static void
+adjust_owned (IndicatorPowerWatchList * list, const gchar * owner, gint delta)
+{
+  const guint n = GPOINTER_TO_UINT (g_hash_table_lookup (list->n_owned, owner)) + delta;
+
+  if (n > 0)
+    g_hash_table_insert (list->n_owned, g_strdup (owner), GUINT_TO_POINTER (n));
+  else
+    g_hash_table_remove (list->n_owned, owner);
+}
+
+/**
+ * Add a watch for @owner.
+ *
+ * Return value: the new watch's id, which is never 0.
+ */
+guint32
+indicator_power_watch_list_add (IndicatorPowerWatchList       * list,
+                                const gchar                   * owner,
+                                IndicatorPowerWatchProperty     property,
+                                IndicatorPowerWatchComparison   comparison,
+                                gdouble                         threshold)
+{
+  GPtrArray * watches;
+  Watch * watch;
+  guint pos;
+
+  g_return_val_if_fail (list != NULL, 0);
+  g_return_val_if_fail (owner != NULL, 0);
+  g_return_val_if_fail (property < INDICATOR_POWER_WATCH_N_PROPERTIES, 0);
+  g_return_val_if_fail (comparison < INDICATOR_POWER_WATCH_N_COMPARISONS, 0);
+
+  watch = g_new0 (Watch, 1);
+  watch->owner = g_strdup (owner);
+  watch->property = property;
+  watch->comparison = comparison;
+  watch->threshold = threshold;
+
+  do
+    watch->id = list->next_id++;
+  while ((watch->id == 0) || g_hash_table_contains (list->by_id, GUINT_TO_POINTER (watch->id)));
+
+  /* insert after any watches with the same threshold */
+  watches = list->sorted[property][comparison];
+  pos = lower_bound (watches, threshold, FALSE);
+  g_ptr_array_add (watches, NULL);
+  memmove (&watches->pdata[pos+1],
+           &watches->pdata[pos],
+           (watches->len - 1 - pos) * sizeof (gpointer));
+  watches->pdata[pos] = watch;
+
+  g_hash_table_insert (list->by_id, GUINT_TO_POINTER (watch->id), watch);
+  adjust_owned (list, owner, +1);
+
+  return watch->id;
+}
+
+static void
+unlink_watch (IndicatorPowerWatchList * list, Watch * watch)
+{
+  GPtrArray * watches = list->sorted[watch->property][watch->comparison];
+  guint i;
+
+  for (i=lower_bound (watches, watch->threshold, TRUE); i<watches->len; i++)
+    {
+      if (g_ptr_array_index (watches, i) == watch)
+        {
+          g_ptr_array_remove_index (watches, i);
+          break;
+        }
+    }
+
+  adjust_owned (list, watch->owner, -1);
+}
+
+/**
+ * Remove watch @id, but only if @owner added it.
+ */
+gboolean
+indicator_power_watch_list_remove (IndicatorPowerWatchList * list,
+                                   const gchar             * owner,
+                                   guint32                   id)
+{
+  Watch * watch;
+
+  g_return_val_if_fail (list != NULL, FALSE);
+
+  watch = g_hash_table_lookup (list->by_id, GUINT_TO_POINTER (id));
+  if ((watch == NULL) || g_strcmp0 (watch->owner, owner))
+    return FALSE;
+
+  unlink_watch (list, watch);
+  g_hash_table_remove (list->by_id, GUINT_TO_POINTER (id));
+  return TRUE;
+}
+
+/**
+ * Remove all of @owner's watches, e.g. when it leaves the bus.
+ *
+ * Return value: the number of watches removed.
+ */
+guint
+indicator_power_watch_list_remove_owner (IndicatorPowerWatchList * list,
+                                         const gchar             * owner)
+{
+  GHashTableIter iter;
+  gpointer value;
+  guint n = 0;
+
+  g_return_val_if_fail (list != NULL, 0);
+
+  if (!g_hash_table_contains (list->n_owned, owner))
+    return 0;
+
+  g_hash_table_iter_init (&iter, list->by_id);
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    {
+      Watch * watch = value;
+
+      if (!strcmp (watch->owner, owner))
+        {
+          unlink_watch (list, watch);
+          g_hash_table_iter_remove (&iter);
+          ++n;
+        }
+    }
+
+  return n;
+}
+
+guint
+indicator_power_watch_list_count_owner (const IndicatorPowerWatchList * list,
+                                        const gchar                   * owner)
+{
+  g_return_val_if_fail (list != NULL, 0);
+
+  return GPOINTER_TO_UINT (g_hash_table_lookup (list->n_owned, owner));
+}
+
+/**
+ * Call @func for each watch that fires when the watched values
+ * change from @old_values to @new_values.
+ *
+ * Both arrays are indexed by IndicatorPowerWatchProperty.
+ * A BELOW watch fires when the value goes from at-or-above its threshold
+ * to under it; ABOVE is the reverse; and an EQUALS watch fires when the
+ * value changes to its threshold. @func must not change @list.
+ */
+void
+indicator_power_watch_list_evaluate (IndicatorPowerWatchList * list,
+                                     const gdouble           * old_values,
+                                     const gdouble           * new_values,
+                                     IndicatorPowerWatchFunc   func,
+                                     gpointer                  user_data)
+{
+  guint property;
+
+  g_return_if_fail (list != NULL);
+  g_return_if_fail (func != NULL);
+
+  for (property=0; property<INDICATOR_POWER_WATCH_N_PROPERTIES; property++)
+    {
+      const gdouble old_value = old_values[property];
+      const gdouble new_value = new_values[property];
+      GPtrArray * watches;
+      guint i;
+
+      if (old_value == new_value)
+        continue;
+
+      /* thresholds in (new, old] */
+      if (new_value < old_value)
+        {
+          watches = list->sorted[property][INDICATOR_POWER_WATCH_BELOW];
+          for (i=lower_bound (watches, new_value, FALSE); i<watches->len; i++)
+            {
+              const Watch * watch = g_ptr_array_index (watches, i);
+              if (watch->threshold > old_value)
+                break;
+              func (watch->owner, watch->id, new_value, user_data);
+            }
+        }
+
+      /* thresholds in [old, new) */
+      if (new_value > old_value)
+        {
+          watches = list->sorted[property][INDICATOR_POWER_WATCH_ABOVE];
+          for (i=lower_bound (watches, old_value, TRUE); i<watches->len; i++)
+            {
+              const Watch * watch = g_ptr_array_index (watches, i);
+              if (watch->threshold >= new_value)
+                break;
+              func (watch->owner, watch->id, new_value, user_data);
+            }
+        }
+
+      /* thresholds == new */
+      watches = list->sorted[property][INDICATOR_POWER_WATCH_EQUALS];
+      for (i=lower_bound (watches, new_value, TRUE); i<watches->len; i++)
+        {
+          const Watch * watch = g_ptr_array_index (watches, i);
+          if (watch->threshold != new_value)
+            break;
+          func (watch->owner, watch->id, new_value, user_data);
+        }
+    }
+}
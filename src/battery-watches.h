@@ -0,0 +1,90 @@
+/*
+ * Copyright 2026 The Ayatana Indicators project
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __INDICATOR_POWER_BATTERY_WATCHES__H__
+#define __INDICATOR_POWER_BATTERY_WATCHES__H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef enum
+{
+  INDICATOR_POWER_WATCH_PERCENTAGE,
+  INDICATOR_POWER_WATCH_TIME_REMAINING,
+  INDICATOR_POWER_WATCH_STATE,
+  INDICATOR_POWER_WATCH_N_PROPERTIES
+}
+IndicatorPowerWatchProperty;
+
+typedef enum
+{
+  INDICATOR_POWER_WATCH_BELOW,  /* fires when the value drops below the threshold */
+  INDICATOR_POWER_WATCH_ABOVE,  /* fires when the value rises above the threshold */
+  INDICATOR_POWER_WATCH_EQUALS, /* fires when the value becomes the threshold */
+  INDICATOR_POWER_WATCH_N_COMPARISONS
+}
+IndicatorPowerWatchComparison;
+
+gboolean indicator_power_watch_property_from_string   (const gchar                 * str,
+                                                       IndicatorPowerWatchProperty * setme);
+
+gboolean indicator_power_watch_comparison_from_string (const gchar                   * str,
+                                                       IndicatorPowerWatchComparison * setme);
+
+/**
+ * Threshold watches registered by D-Bus clients.
+ *
+ * Each (property, comparison) pair keeps its watches sorted by threshold,
+ * so finding the ones a change crosses is a binary search rather than a
+ * walk over every client's watches.
+ */
+typedef struct _IndicatorPowerWatchList IndicatorPowerWatchList;
+
+typedef void (*IndicatorPowerWatchFunc) (const gchar * owner,
+                                         guint32       id,
+                                         gdouble       value,
+                                         gpointer      user_data);
+
+IndicatorPowerWatchList * indicator_power_watch_list_new          (void);
+
+void                      indicator_power_watch_list_free         (IndicatorPowerWatchList * list);
+
+guint32                   indicator_power_watch_list_add          (IndicatorPowerWatchList       * list,
+                                                                   const gchar                   * owner,
+                                                                   IndicatorPowerWatchProperty     property,
+                                                                   IndicatorPowerWatchComparison   comparison,
+                                                                   gdouble                         threshold);
+
+gboolean                  indicator_power_watch_list_remove       (IndicatorPowerWatchList * list,
+                                                                   const gchar             * owner,
+                                                                   guint32                   id);
+
+guint                     indicator_power_watch_list_remove_owner (IndicatorPowerWatchList * list,
+                                                                   const gchar             * owner);
+
+guint                     indicator_power_watch_list_count_owner  (const IndicatorPowerWatchList * list,
+                                                                   const gchar                   * owner);
+
+void                      indicator_power_watch_list_evaluate     (IndicatorPowerWatchList * list,
+                                                                   const gdouble           * old_values,
+                                                                   const gdouble           * new_values,
+                                                                   IndicatorPowerWatchFunc   func,
+                                                                   gpointer                  user_data);
+
+G_END_DECLS
+
+#endif /* __INDICATOR_POWER_BATTERY_WATCHES__H__ */
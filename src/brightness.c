@@ -19,6 +19,7 @@
  *   Robert Tari <robert@tari.in>
  */
 
+#include "backlight.h"
 #include "brightness.h"
 #include "dbus-repowerd.h"
 
@@ -30,6 +31,15 @@
 #define KEY_BRIGHTNESS "brightness"
 #define KEY_NEED_DEFAULT "brightness-needs-hardware-default"
 
+/* Don't send setUserBrightness more often than the display can show it.
+   16 msec is one frame at 60 Hz, the usual panel refresh rate. On a
+   faster panel a drag just skips some in-between values, which the
+   eye can't tell apart from a smooth change */
+#define FRAME_INTERVAL_MSEC 16
+
+/* Wait for the slider to stop moving before applying GSettings changes */
+#define SETTLE_INTERVAL_MSEC 500
+
 enum
 {
   PROP_0,
@@ -51,8 +61,27 @@ typedef struct
   DbusRepowerd * powerd_proxy;
   char * powerd_name_owner;
 
+  /* used when repowerd isn't running */
+  IndicatorPowerBacklight * backlight;
+
   double percentage;
 
+  /* setUserBrightness pipeline: at most one call in flight,
+     and only the most recent request is kept while we wait */
+  gboolean call_in_flight;
+  gboolean have_pending;
+  int pending_brightness;
+  guint frame_tag;
+
+  /* p->settings is in delay-apply mode: changes are kept in memory
+     and only written to dconf when the slider settles */
+  int settings_brightness;
+  guint settle_tag;
+
+  /* writes KEY_AUTO right away, without applying p->settings'
+     staged brightness along with it */
+  GSettings * auto_settings;
+
   /* powerd brightness params */
   gint powerd_dim;
   gint powerd_min;
@@ -119,8 +148,8 @@ my_set_property(GObject       * o,
         break;
 
       case PROP_AUTO:
-        if (p->settings != NULL)
-          g_settings_set_boolean (p->settings, KEY_AUTO, g_value_get_boolean(value));
+        if (p->auto_settings != NULL)
+          g_settings_set_boolean (p->auto_settings, KEY_AUTO, g_value_get_boolean(value));
         break;
 
       default:
@@ -146,7 +175,34 @@ my_dispose(GObject * o)
       g_clear_object(&p->powerd_proxy);
     }
 
+  if (p->frame_tag != 0)
+    {
+      g_source_remove(p->frame_tag);
+      p->frame_tag = 0;
+    }
+
+  if (p->settle_tag != 0)
+    {
+      g_source_remove(p->settle_tag);
+      p->settle_tag = 0;
+    }
+
+  /* don't lose changes that are waiting for the slider to settle */
+  if (p->settings != NULL)
+    {
+      g_signal_handlers_disconnect_by_data(p->settings, o);
+      if (g_settings_get_has_unapplied(p->settings))
+        g_settings_apply(p->settings);
+    }
+
+  if (p->backlight != NULL)
+    {
+      g_signal_handlers_disconnect_by_data(p->backlight, o);
+      g_clear_object(&p->backlight);
+    }
+
   g_clear_object(&p->settings);
+  g_clear_object(&p->auto_settings);
   g_clear_object(&p->system_bus);
   g_clear_pointer(&p->powerd_name_owner, g_free);
 
@@ -157,6 +213,18 @@ my_dispose(GObject * o)
 ****  Percentage <-> Brightness Int conversion helpers
 ***/
 
+/* If repowerd isn't running, drive the sysfs backlight directly */
+static gboolean
+use_backlight(const priv_t * p)
+{
+  return (p->powerd_name_owner == NULL) &&
+         (p->backlight != NULL) &&
+         indicator_power_backlight_is_available(p->backlight);
+}
+
+/* Don't let the slider turn the panel all the way off */
+#define BACKLIGHT_MIN 1
+
 static gdouble
 brightness_to_percentage(IndicatorPowerBrightness * self, int brightness)
 {
@@ -170,6 +238,12 @@ brightness_to_percentage(IndicatorPowerBrightness * self, int brightness)
       const int hi = p->powerd_max;
       percentage = (brightness-lo) / (double)(hi-lo);
     }
+  else if (use_backlight(p))
+    {
+      const int lo = BACKLIGHT_MIN;
+      const int hi = indicator_power_backlight_get_max_brightness(p->backlight);
+      percentage = hi > lo ? CLAMP((brightness-lo) / (double)(hi-lo), 0.0, 1.0) : 1.0;
+    }
   else
     {
       percentage = 0;
@@ -191,6 +265,12 @@ percentage_to_brightness(IndicatorPowerBrightness * self, double percentage)
       const int hi = p->powerd_max;
       brightness = (int)(lo + (percentage*(hi-lo)));
     }
+  else if (use_backlight(p))
+    {
+      const int lo = BACKLIGHT_MIN;
+      const int hi = indicator_power_backlight_get_max_brightness(p->backlight);
+      brightness = (int)(lo + (percentage*(hi-lo)) + 0.5);
+    }
   else
     {
       brightness = 0;
@@ -208,6 +288,8 @@ percentage_to_brightness(IndicatorPowerBrightness * self, double percentage)
 
 static void set_brightness_global(IndicatorPowerBrightness*, int);
 static void set_brightness_local(IndicatorPowerBrightness*, int);
+static void flush_pending_brightness(IndicatorPowerBrightness*);
+static void on_backlight_set_brightness_result(GObject*, GAsyncResult*, gpointer);
 
 static void
 on_powerd_brightness_params_ready(GObject      * oproxy,
@@ -250,6 +332,7 @@ on_powerd_brightness_params_ready(GObject      * oproxy,
               g_debug("%s is true, so initializing brightness to powerd default '%d'", KEY_NEED_DEFAULT, p->powerd_default_value);
               set_brightness_global(self, p->powerd_default_value);
               g_settings_set_boolean(p->settings, KEY_NEED_DEFAULT, FALSE);
+              g_settings_apply(p->settings);
             }
           else
             {
@@ -292,7 +375,15 @@ on_powerd_name_owner_changed(GDBusProxy * powerd_proxy,
 
       g_free(p->powerd_name_owner);
       p->powerd_name_owner = owner;
-  }
+
+      /* repowerd went away, so start following the backlight */
+      if (use_backlight(p))
+        set_brightness_local(gself, indicator_power_backlight_get_brightness(p->backlight));
+    }
+  else
+    {
+      g_free(owner);
+    }
 }
 
 static void
@@ -322,6 +413,7 @@ on_powerd_proxy_ready(GObject      * source_object G_GNUC_UNUSED,
       /* keep a handle to the system bus */
       g_clear_object(&p->system_bus);
       p->system_bus = g_object_ref(g_dbus_proxy_get_connection(G_DBUS_PROXY(powerd_proxy)));
+      flush_pending_brightness(INDICATOR_POWER_BRIGHTNESS(gself));
 
       /* keep the proxy and listen to owner changes */
       p->powerd_proxy = powerd_proxy;
@@ -347,26 +439,36 @@ on_powerd_proxy_ready(GObject      * source_object G_GNUC_UNUSED,
  */
 
 /* setUserBrightness doesn't return anything,
-   so this function is just to check for bus error messages */
+   so this function is just to check for bus error messages
+   and to send the next pending value, if any */
 static void
 on_set_uscreen_user_brightness_result(GObject      * system_bus,
                                       GAsyncResult * res,
-                                      gpointer       gself        G_GNUC_UNUSED)
+                                      gpointer       gself)
 {
   GError * error;
   GVariant * v;
 
   error = NULL;
   v = g_dbus_connection_call_finish(G_DBUS_CONNECTION(system_bus), res, &error);
+  g_clear_pointer(&v, g_variant_unref);
+
   if (error != NULL)
     {
-      if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+      const gboolean cancelled = g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED);
+
+      if (!cancelled)
         g_warning("Unable to call uscreen.setBrightness: %s", error->message);
 
       g_error_free(error);
+
+      /* if we were cancelled, gself may already be disposed */
+      if (cancelled)
+        return;
     }
 
-  g_clear_pointer(&v, g_variant_unref);
+  get_priv(INDICATOR_POWER_BRIGHTNESS(gself))->call_in_flight = FALSE;
+  flush_pending_brightness(INDICATOR_POWER_BRIGHTNESS(gself));
 }
 
 static void
@@ -375,6 +477,8 @@ set_uscreen_user_brightness(IndicatorPowerBrightness * self,
 {
   priv_t * p = get_priv(self);
 
+  p->call_in_flight = TRUE;
+
   g_dbus_connection_call(p->system_bus,
                          "com.canonical.Unity.Screen",
                          "/com/canonical/Unity/Screen",
@@ -389,6 +493,93 @@ set_uscreen_user_brightness(IndicatorPowerBrightness * self,
                          self);
 }
 
+static gboolean
+on_frame_timer(gpointer gself)
+{
+  IndicatorPowerBrightness * self = INDICATOR_POWER_BRIGHTNESS(gself);
+
+  get_priv(self)->frame_tag = 0;
+  flush_pending_brightness(self);
+
+  return G_SOURCE_REMOVE;
+}
+
+/**
+ * Send the most recent pending value, if there is one and if
+ * we're allowed to: a slider drag can produce far more requests
+ * than the screen can show, so we wait for the previous call to
+ * return and for the next display frame before sending another.
+ */
+static void
+flush_pending_brightness(IndicatorPowerBrightness * self)
+{
+  priv_t * p = get_priv(self);
+
+  if (!p->have_pending || p->call_in_flight || p->frame_tag != 0)
+    return;
+
+  if (use_backlight(p))
+    {
+      p->call_in_flight = TRUE;
+      indicator_power_backlight_set_brightness(p->backlight,
+                                               p->pending_brightness,
+                                               p->cancellable,
+                                               on_backlight_set_brightness_result,
+                                               self);
+    }
+  else if (p->system_bus != NULL)
+    {
+      set_uscreen_user_brightness(self, p->pending_brightness);
+    }
+  else /* no connection to the system bus yet, so nowhere to send it */
+    {
+      return;
+    }
+
+  p->have_pending = FALSE;
+  p->frame_tag = g_timeout_add(FRAME_INTERVAL_MSEC, on_frame_timer, self);
+}
+
+/**
+ * sysfs backlight
+ *
+ * Used when repowerd isn't running, e.g. outside of Lomiri
+ */
+
+static void
+on_backlight_brightness_changed(IndicatorPowerBacklight * backlight,
+                                GParamSpec              * pspec      G_GNUC_UNUSED,
+                                gpointer                  gself)
+{
+  if (use_backlight(get_priv(INDICATOR_POWER_BRIGHTNESS(gself))))
+    set_brightness_local(gself, indicator_power_backlight_get_brightness(backlight));
+}
+
+static void
+on_backlight_set_brightness_result(GObject      * backlight,
+                                   GAsyncResult * res,
+                                   gpointer       gself)
+{
+  GError * error = NULL;
+
+  if (!indicator_power_backlight_set_brightness_finish(INDICATOR_POWER_BACKLIGHT(backlight), res, &error))
+    {
+      const gboolean cancelled = g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED);
+
+      if (!cancelled)
+        g_warning("Unable to set backlight brightness: %s", error->message);
+
+      g_error_free(error);
+
+      /* if we were cancelled, gself may already be disposed */
+      if (cancelled)
+        return;
+    }
+
+  get_priv(INDICATOR_POWER_BRIGHTNESS(gself))->call_in_flight = FALSE;
+  flush_pending_brightness(INDICATOR_POWER_BRIGHTNESS(gself));
+}
+
 /***
 ****
 ***/
@@ -406,8 +597,33 @@ on_brightness_changed_in_schema(GSettings * settings,
                                 gchar     * key,
                                 gpointer    gself)
 {
-  set_brightness_local(INDICATOR_POWER_BRIGHTNESS(gself),
-                       g_settings_get_int(settings, key));
+  priv_t * p = get_priv(INDICATOR_POWER_BRIGHTNESS(gself));
+  const int brightness = g_settings_get_int(settings, key);
+
+  /* the key is in repowerd's units, which mean nothing to the
+     sysfs backlight; it reports its own changes */
+  if (use_backlight(p))
+    return;
+
+  /* ignore the echo of our own writes; we've already handled them */
+  if (brightness == p->settings_brightness)
+    return;
+
+  p->settings_brightness = brightness;
+  set_brightness_local(INDICATOR_POWER_BRIGHTNESS(gself), brightness);
+}
+
+static gboolean
+on_settle_timer(gpointer gself)
+{
+  priv_t * p = get_priv(INDICATOR_POWER_BRIGHTNESS(gself));
+
+  p->settle_tag = 0;
+
+  if ((p->settings != NULL) && g_settings_get_has_unapplied(p->settings))
+    g_settings_apply(p->settings);
+
+  return G_SOURCE_REMOVE;
 }
 
 static void
@@ -415,12 +631,27 @@ set_brightness_global(IndicatorPowerBrightness * self, int brightness)
 {
   priv_t * p = get_priv(self);
 
-  set_uscreen_user_brightness(self, brightness);
+  /* latest value wins */
+  p->pending_brightness = brightness;
+  p->have_pending = TRUE;
+  flush_pending_brightness(self);
 
-  if (p->settings != NULL)
-    g_settings_set_int(p->settings, KEY_BRIGHTNESS, brightness);
-  else
-    set_brightness_local(self, brightness);
+  /* update our state now instead of waiting for the schema */
+  set_brightness_local(self, brightness);
+
+  /* stage the change in memory, and (re)start the settle timer
+     so that it's written to dconf once the slider stops moving.
+     The key is shared with repowerd and holds its units, so a raw
+     sysfs value from backlight mode must not be written there */
+  if ((p->settings != NULL) && !use_backlight(p) && (p->settings_brightness != brightness))
+    {
+      p->settings_brightness = brightness;
+      g_settings_set_int(p->settings, KEY_BRIGHTNESS, brightness);
+
+      if (p->settle_tag != 0)
+        g_source_remove(p->settle_tag);
+      p->settle_tag = g_timeout_add(SETTLE_INTERVAL_MSEC, on_settle_timer, self);
+    }
 }
 
 static void
@@ -455,6 +686,9 @@ indicator_power_brightness_init(IndicatorPowerBrightness * self)
       if (g_settings_schema_has_key(schema, KEY_BRIGHTNESS))
         {
           p->settings = g_settings_new(SCHEMA_NAME);
+          g_settings_delay(p->settings);
+          p->auto_settings = g_settings_new(SCHEMA_NAME);
+          p->settings_brightness = g_settings_get_int(p->settings, KEY_BRIGHTNESS);
           g_signal_connect(p->settings, "changed::" KEY_BRIGHTNESS,
                            G_CALLBACK(on_brightness_changed_in_schema), self);
           g_signal_connect_swapped(p->settings, "changed::" KEY_AUTO,
@@ -463,6 +697,14 @@ indicator_power_brightness_init(IndicatorPowerBrightness * self)
       g_settings_schema_unref(schema);
     }
 
+  p->backlight = indicator_power_backlight_new(NULL);
+  if (indicator_power_backlight_is_available(p->backlight))
+    {
+      p->percentage = brightness_to_percentage(self, indicator_power_backlight_get_brightness(p->backlight));
+      g_signal_connect(p->backlight, "notify::" INDICATOR_POWER_BACKLIGHT_PROP_BRIGHTNESS,
+                       G_CALLBACK(on_backlight_brightness_changed), self);
+    }
+
   dbus_repowerd_proxy_new_for_bus (G_BUS_TYPE_SYSTEM,
                                  G_DBUS_PROXY_FLAGS_GET_INVALIDATED_PROPERTIES,
                                  "com.lomiri.Repowerd",
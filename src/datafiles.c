@@ -50,8 +50,8 @@ test_directory_for_file(const char* dir, DatafileType type, const char* basename
   return NULL;
 }
 
-gchar*
-datafile_find(DatafileType type, const char * basename)
+static gchar*
+datafile_find_uncached(DatafileType type, const char * basename)
 {
   gchar * filename;
   const gchar * user_data_dir;
@@ -69,3 +69,352 @@ datafile_find(DatafileType type, const char * basename)
 
   return NULL;
 }
+
+/***
+****  The index
+****
+****  Maps "prefix/basename" to the first matching file in the XDG
+****  data dirs. It's built in a worker thread, thrown away whenever
+****  a file monitor sees a change in one of the candidate directories,
+****  and a lookup's result is re-checked in the background after use
+****  in case the monitors missed something (e.g. on network mounts).
+****
+****  Only candidate directories that exist are monitored: GLib polls
+****  missing paths for as long as they're watched. Instead, a lookup
+****  that misses rescans in the background, at most once a minute,
+****  which also picks up directories created since the last scan.
+****
+****  Everything here except build_index_thread_func() is main-thread only.
+***/
+
+static const DatafileType all_types[] = { DATAFILE_TYPE_SOUND };
+
+/* how long to wait between rescans after lookups miss */
+#define MISS_RESCAN_INTERVAL_USEC (60 * G_USEC_PER_SEC)
+
+static GHashTable * index_table = NULL;
+static gboolean index_building = FALSE;
+static gboolean index_stale = FALSE;
+static gboolean revalidating = FALSE;
+static GHashTable * index_monitors = NULL; /* dirname -> GFileMonitor */
+static gint64 last_miss_rescan = 0;
+
+typedef struct
+{
+  GHashTable * table;
+  GPtrArray * existing_dirs; /* the candidate dirs that were there */
+}
+IndexScan;
+
+static void build_index(void);
+static void on_candidate_dir_changed(GFileMonitor*, GFile*, GFile*, GFileMonitorEvent, gpointer);
+
+static void
+index_scan_free(gpointer gscan)
+{
+  IndexScan * scan = gscan;
+
+  g_hash_table_unref(scan->table);
+  g_ptr_array_unref(scan->existing_dirs);
+  g_free(scan);
+}
+
+static gchar*
+get_index_key(DatafileType type, const char * basename)
+{
+  return g_build_filename(get_directory_prefix_for_type(type), basename, NULL);
+}
+
+/* the data dirs to search, in order of precedence */
+static GPtrArray*
+get_candidate_dirs(void)
+{
+  GPtrArray * dirs = g_ptr_array_new_with_free_func(g_free);
+  const gchar * const * system_data_dirs;
+  gsize i, j;
+
+  for (j=0; j<G_N_ELEMENTS(all_types); ++j)
+    g_ptr_array_add(dirs, g_build_filename(g_get_user_data_dir(),
+                                           GETTEXT_PACKAGE,
+                                           get_directory_prefix_for_type(all_types[j]),
+                                           NULL));
+
+  system_data_dirs = g_get_system_data_dirs();
+  for (i=0; system_data_dirs && system_data_dirs[i]; ++i)
+    for (j=0; j<G_N_ELEMENTS(all_types); ++j)
+      g_ptr_array_add(dirs, g_build_filename(system_data_dirs[i],
+                                             GETTEXT_PACKAGE,
+                                             get_directory_prefix_for_type(all_types[j]),
+                                             NULL));
+
+  return dirs;
+}
+
+static void
+build_index_thread_func(GTask        * task,
+                        gpointer       source_object G_GNUC_UNUSED,
+                        gpointer       task_data,
+                        GCancellable * cancellable   G_GNUC_UNUSED)
+{
+  GPtrArray * dirs = task_data;
+  IndexScan * scan;
+  GHashTable * table;
+  guint i;
+
+  scan = g_new0(IndexScan, 1);
+  scan->table = table = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+  scan->existing_dirs = g_ptr_array_new_with_free_func(g_free);
+
+  for (i=0; i<dirs->len; ++i)
+    {
+      const gchar * dirname = g_ptr_array_index(dirs, i);
+      gchar * prefix = g_path_get_basename(dirname);
+      GDir * dir;
+
+      if ((dir = g_dir_open(dirname, 0, NULL)))
+        {
+          const gchar * name;
+
+          while ((name = g_dir_read_name(dir)))
+            {
+              gchar * key = g_build_filename(prefix, name, NULL);
+
+              /* earlier dirs take precedence */
+              if (!g_hash_table_contains(table, key))
+                g_hash_table_insert(table, key, g_build_filename(dirname, name, NULL));
+              else
+                g_free(key);
+            }
+
+          g_dir_close(dir);
+          g_ptr_array_add(scan->existing_dirs, g_strdup(dirname));
+        }
+
+      g_free(prefix);
+    }
+
+  g_task_return_pointer(task, scan, index_scan_free);
+}
+
+/* watch the candidate dirs that exist, and only those */
+static void
+update_monitors(GPtrArray * existing_dirs)
+{
+  GHashTable * wanted = g_hash_table_new(g_str_hash, g_str_equal);
+  GHashTableIter iter;
+  gpointer key;
+  guint i;
+
+  for (i=0; i<existing_dirs->len; ++i)
+    g_hash_table_add(wanted, g_ptr_array_index(existing_dirs, i));
+
+  g_hash_table_iter_init(&iter, index_monitors);
+  while (g_hash_table_iter_next(&iter, &key, NULL))
+    if (!g_hash_table_contains(wanted, key))
+      g_hash_table_iter_remove(&iter);
+
+  for (i=0; i<existing_dirs->len; ++i)
+    {
+      const gchar * dirname = g_ptr_array_index(existing_dirs, i);
+      GFile * dir;
+      GFileMonitor * monitor;
+
+      if (g_hash_table_contains(index_monitors, dirname))
+        continue;
+
+      dir = g_file_new_for_path(dirname);
+      monitor = g_file_monitor_directory(dir, G_FILE_MONITOR_NONE, NULL, NULL);
+      if (monitor != NULL)
+        {
+          g_signal_connect(monitor, "changed", G_CALLBACK(on_candidate_dir_changed), NULL);
+          g_hash_table_insert(index_monitors, g_strdup(dirname), monitor);
+        }
+      g_object_unref(dir);
+    }
+
+  g_hash_table_destroy(wanted);
+}
+
+static void
+on_index_built(GObject      * source_object G_GNUC_UNUSED,
+               GAsyncResult * res,
+               gpointer       unused        G_GNUC_UNUSED)
+{
+  IndexScan * scan = g_task_propagate_pointer(G_TASK(res), NULL);
+
+  index_building = FALSE;
+  update_monitors(scan->existing_dirs);
+
+  if (index_stale)
+    {
+      /* something changed while we were scanning */
+      build_index();
+    }
+  else
+    {
+      g_debug("datafile index built with %u entries", g_hash_table_size(scan->table));
+      g_clear_pointer(&index_table, g_hash_table_unref);
+      index_table = g_hash_table_ref(scan->table);
+    }
+
+  index_scan_free(scan);
+}
+
+static void
+build_index(void)
+{
+  GTask * task;
+
+  index_stale = FALSE;
+
+  if (index_building)
+    return;
+
+  index_building = TRUE;
+  task = g_task_new(NULL, NULL, on_index_built, NULL);
+  g_task_set_task_data(task, get_candidate_dirs(), (GDestroyNotify)g_ptr_array_unref);
+  g_task_run_in_thread(task, build_index_thread_func);
+  g_object_unref(task);
+}
+
+static void
+invalidate_index(void)
+{
+  g_clear_pointer(&index_table, g_hash_table_unref);
+
+  if (index_building)
+    index_stale = TRUE;
+  else
+    build_index();
+}
+
+static void
+on_candidate_dir_changed(GFileMonitor      * monitor    G_GNUC_UNUSED,
+                         GFile             * file       G_GNUC_UNUSED,
+                         GFile             * other_file G_GNUC_UNUSED,
+                         GFileMonitorEvent   event_type,
+                         gpointer            unused     G_GNUC_UNUSED)
+{
+  switch (event_type)
+    {
+      case G_FILE_MONITOR_EVENT_CREATED:
+      case G_FILE_MONITOR_EVENT_DELETED:
+      case G_FILE_MONITOR_EVENT_MOVED:
+      case G_FILE_MONITOR_EVENT_UNMOUNTED:
+        invalidate_index();
+        break;
+
+      default:
+        break;
+    }
+}
+
+static void
+on_revalidated(GObject      * file,
+               GAsyncResult * res,
+               gpointer       unused G_GNUC_UNUSED)
+{
+  GFileInfo * info;
+
+  revalidating = FALSE;
+
+  info = g_file_query_info_finish(G_FILE(file), res, NULL);
+  if (info != NULL)
+    {
+      g_object_unref(info);
+    }
+  else
+    {
+      gchar * path = g_file_get_path(G_FILE(file));
+      g_debug("\"%s\" is gone; rebuilding the datafile index", path);
+      g_free(path);
+      invalidate_index();
+    }
+}
+
+static void
+revalidate_soon(const gchar * filename)
+{
+  GFile * file;
+
+  if (revalidating)
+    return;
+
+  revalidating = TRUE;
+  file = g_file_new_for_path(filename);
+  g_file_query_info_async(file,
+                          G_FILE_ATTRIBUTE_STANDARD_TYPE,
+                          G_FILE_QUERY_INFO_NONE,
+                          G_PRIORITY_LOW,
+                          NULL,
+                          on_revalidated,
+                          NULL);
+  g_object_unref(file);
+}
+
+/***
+****  Public API
+***/
+
+/**
+ * Start building the datafile index in the background.
+ *
+ * Until it's ready, datafile_find() searches the data dirs directly.
+ */
+void
+datafile_index_init(void)
+{
+  if (index_monitors != NULL)
+    return;
+
+  /* the first scan tells us which dirs to monitor */
+  index_monitors = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_object_unref);
+  build_index();
+}
+
+gchar*
+datafile_find(DatafileType type, const char * basename)
+{
+  gchar * key;
+  const gchar * filename;
+  gboolean found;
+
+  /* no index yet, so do it the slow way */
+  if (index_table == NULL)
+    return datafile_find_uncached(type, basename);
+
+  key = get_index_key(type, basename);
+  found = g_hash_table_lookup_extended(index_table, key, NULL, (gpointer*)&filename);
+  g_free(key);
+
+  if (!found)
+    {
+      /* maybe it's in a dir that didn't exist when we last looked */
+      const gint64 now = g_get_monotonic_time();
+
+      if (!index_building &&
+          ((last_miss_rescan == 0) || (now - last_miss_rescan >= MISS_RESCAN_INTERVAL_USEC)))
+        {
+          last_miss_rescan = now;
+          build_index();
+        }
+
+      return NULL;
+    }
+
+  revalidate_soon(filename);
+  return g_strdup(filename);
+}
+
+/* for tests */
+gboolean
+datafile_index_is_ready(void)
+{
+  return (index_table != NULL) && !index_building;
+}
+
+guint
+datafile_index_get_n_monitored_dirs(void)
+{
+  return index_monitors ? g_hash_table_size(index_monitors) : 0;
+}
@@ -30,8 +30,15 @@ typedef enum
 }
 DatafileType;
 
+void datafile_index_init(void);
+
 gchar* datafile_find(DatafileType type, const char * basename);
 
+/* for tests */
+gboolean datafile_index_is_ready(void);
+
+guint datafile_index_get_n_monitored_dirs(void);
+
 G_END_DECLS
 
 #endif /* __INDICATOR_POWER_DATAFILES_H__ */
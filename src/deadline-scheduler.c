@@ -0,0 +1,201 @@
+/*
+ * Copyright 2026 The Ayatana Indicators project
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "deadline-scheduler.h"
+
+/* g_timeout_add_seconds() may fire a little before the second is up */
+#define DUE_SLACK_USEC (G_USEC_PER_SEC / 2)
+
+typedef struct
+{
+  gint64 when; /* g_get_monotonic_time() */
+  guint tags;
+}
+Deadline;
+
+struct _IndicatorPowerDeadlineScheduler
+{
+  IndicatorPowerDeadlineFunc func;
+  gpointer user_data;
+
+  GArray * deadlines; /* Deadline, sorted by 'when' */
+  guint timeout_tag;
+  gint64 timeout_when;
+};
+
+static void reschedule (IndicatorPowerDeadlineScheduler * scheduler);
+
+IndicatorPowerDeadlineScheduler *
+indicator_power_deadline_scheduler_new (IndicatorPowerDeadlineFunc func,
+                                        gpointer                   user_data)
+{
+  IndicatorPowerDeadlineScheduler * scheduler;
+
+  g_return_val_if_fail (func != NULL, NULL);
+
+  scheduler = g_new0 (IndicatorPowerDeadlineScheduler, 1);
+  scheduler->func = func;
+  scheduler->user_data = user_data;
+  scheduler->deadlines = g_array_new (FALSE, FALSE, sizeof (Deadline));
+
+  return scheduler;
+}
+
+void
+indicator_power_deadline_scheduler_free (IndicatorPowerDeadlineScheduler * scheduler)
+{
+  g_return_if_fail (scheduler != NULL);
+
+  if (scheduler->timeout_tag != 0)
+    g_source_remove (scheduler->timeout_tag);
+
+  g_array_free (scheduler->deadlines, TRUE);
+  g_free (scheduler);
+}
+
+static gboolean
+on_timeout (gpointer gscheduler)
+{
+  IndicatorPowerDeadlineScheduler * scheduler = gscheduler;
+  const gint64 now = g_get_monotonic_time ();
+  guint tags = 0;
+  guint n = 0;
+
+  scheduler->timeout_tag = 0;
+
+  while (n < scheduler->deadlines->len)
+    {
+      const Deadline * deadline = &g_array_index (scheduler->deadlines, Deadline, n);
+
+      if (deadline->when > now + DUE_SLACK_USEC)
+        break;
+
+      tags |= deadline->tags;
+      ++n;
+    }
+
+  g_array_remove_range (scheduler->deadlines, 0, n);
+  reschedule (scheduler);
+
+  /* the callback may add new deadlines, so call it last */
+  if (tags != 0)
+    scheduler->func (tags, scheduler->user_data);
+
+  return G_SOURCE_REMOVE;
+}
+
+/* make sure the timeout is set for the earliest deadline */
+static void
+reschedule (IndicatorPowerDeadlineScheduler * scheduler)
+{
+  gint64 when;
+  gint64 now;
+
+  if (scheduler->deadlines->len == 0)
+    {
+      if (scheduler->timeout_tag != 0)
+        {
+          g_source_remove (scheduler->timeout_tag);
+          scheduler->timeout_tag = 0;
+        }
+      return;
+    }
+
+  when = g_array_index (scheduler->deadlines, Deadline, 0).when;
+  if ((scheduler->timeout_tag != 0) && (scheduler->timeout_when == when))
+    return;
+
+  if (scheduler->timeout_tag != 0)
+    g_source_remove (scheduler->timeout_tag);
+
+  now = g_get_monotonic_time ();
+  scheduler->timeout_when = when;
+  scheduler->timeout_tag = g_timeout_add_seconds (when > now ? (guint)((when - now + G_USEC_PER_SEC - 1) / G_USEC_PER_SEC) : 0,
+                                                  on_timeout,
+                                                  scheduler);
+}
+
+/**
+ * Ask for the callback to be called with @tags in @seconds.
+ *
+ * Deadlines that land in the same second are merged.
+ */
+void
+indicator_power_deadline_scheduler_add (IndicatorPowerDeadlineScheduler * scheduler,
+                                        guint                             seconds,
+                                        guint                             tags)
+{
+  Deadline deadline;
+  guint i;
+
+  g_return_if_fail (scheduler != NULL);
+  g_return_if_fail (tags != 0);
+
+  deadline.when = g_get_monotonic_time () + seconds * (gint64)G_USEC_PER_SEC;
+  deadline.tags = tags;
+
+  for (i=0; i<scheduler->deadlines->len; i++)
+    {
+      Deadline * existing = &g_array_index (scheduler->deadlines, Deadline, i);
+
+      if (existing->when / G_USEC_PER_SEC == deadline.when / G_USEC_PER_SEC)
+        {
+          existing->tags |= tags;
+          return;
+        }
+
+      if (existing->when > deadline.when)
+        break;
+    }
+
+  g_array_insert_val (scheduler->deadlines, i, deadline);
+  reschedule (scheduler);
+}
+
+/**
+ * Drop @tags from all pending deadlines,
+ * e.g. because those sections were just rebuilt.
+ */
+void
+indicator_power_deadline_scheduler_cancel (IndicatorPowerDeadlineScheduler * scheduler,
+                                           guint                             tags)
+{
+  guint i;
+
+  g_return_if_fail (scheduler != NULL);
+
+  for (i=0; i<scheduler->deadlines->len; )
+    {
+      Deadline * deadline = &g_array_index (scheduler->deadlines, Deadline, i);
+
+      deadline->tags &= ~tags;
+
+      if (deadline->tags == 0)
+        g_array_remove_index (scheduler->deadlines, i);
+      else
+        ++i;
+    }
+
+  reschedule (scheduler);
+}
+
+guint
+indicator_power_deadline_scheduler_get_n_pending (const IndicatorPowerDeadlineScheduler * scheduler)
+{
+  g_return_val_if_fail (scheduler != NULL, 0);
+
+  return scheduler->deadlines->len;
+}
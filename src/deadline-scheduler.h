@@ -0,0 +1,53 @@
+/*
+ * Copyright 2026 The Ayatana Indicators project
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __INDICATOR_POWER_DEADLINE_SCHEDULER__H__
+#define __INDICATOR_POWER_DEADLINE_SCHEDULER__H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * Coalesces "redraw this in N seconds" requests onto one timeout.
+ *
+ * Each deadline carries a bitmask of tags, e.g. menu sections. When the
+ * earliest deadline is reached, the callback is invoked once with the
+ * tags of every deadline that has come due, and the timeout is rescheduled
+ * for the next one. Only one GSource is ever pending.
+ */
+typedef struct _IndicatorPowerDeadlineScheduler IndicatorPowerDeadlineScheduler;
+
+typedef void (*IndicatorPowerDeadlineFunc) (guint    tags,
+                                            gpointer user_data);
+
+IndicatorPowerDeadlineScheduler * indicator_power_deadline_scheduler_new    (IndicatorPowerDeadlineFunc func,
+                                                                             gpointer                   user_data);
+
+void                              indicator_power_deadline_scheduler_free   (IndicatorPowerDeadlineScheduler * scheduler);
+
+void                              indicator_power_deadline_scheduler_add    (IndicatorPowerDeadlineScheduler * scheduler,
+                                                                             guint                             seconds,
+                                                                             guint                             tags);
+
+void                              indicator_power_deadline_scheduler_cancel (IndicatorPowerDeadlineScheduler * scheduler,
+                                                                             guint                             tags);
+
+guint                             indicator_power_deadline_scheduler_get_n_pending (const IndicatorPowerDeadlineScheduler * scheduler);
+
+G_END_DECLS
+
+#endif /* __INDICATOR_POWER_DEADLINE_SCHEDULER__H__ */
@@ -0,0 +1,823 @@
+/*
+ * Copyright 2026 The Ayatana Indicators project
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "dbus-hub.h"
+#include "device-provider.h"
+#include "device-provider-hub.h"
+
+#include <gio/gio.h>
+#include <glib/gstdio.h>
+
+#include <errno.h>
+#include <fcntl.h>    /* O_CREAT */
+#include <grp.h>      /* getgrouplist() */
+#include <pwd.h>      /* getpwuid_r() */
+#include <string.h>   /* strchr() */
+#include <sys/file.h> /* flock() */
+#include <sys/stat.h> /* fchmod() */
+#include <unistd.h>   /* close() */
+
+#define HUB_PATH "/org/ayatana/indicator/power/Hub"
+#define HUB_SOCKET_BASENAME "ayatana-indicator-power.hub"
+
+/* After losing the hub, each client waits a random time in this range
+   before trying to take over, so that they don't all rush it at once */
+#define RETRY_MIN_MSEC 20
+#define RETRY_MAX_MSEC 250
+
+/* If we still can't reach the hub after this many tries,
+   stop waiting for it and read the devices ourselves */
+#define MAX_CONNECT_ATTEMPTS 20
+
+/***
+****  private struct
+***/
+
+typedef struct
+{
+  gchar * address;
+  IndicatorPowerDeviceHubAccess access;
+  IndicatorPowerDeviceProviderFactory create_provider;
+  GCancellable * cancellable;
+
+  /* what we hand out, in either role. When we take over as the hub,
+     we keep the last one we were sent until our own provider has news */
+  IndicatorPowerDeviceSnapshot * snapshot;
+
+  /* serving: the real provider, and one connection per client */
+  int lock_fd;
+  GDBusServer * server;
+  GDBusAuthObserver * observer;
+  gid_t group; /* with HUB_GROUP access: the socket's group */
+  IndicatorPowerDeviceProvider * provider;
+  DbusHub * skeleton;
+  GSList * clients;
+
+  /* client: our connection to the hub */
+  GDBusConnection * connection;
+  DbusHub * proxy;
+  guint retry_tag;
+  guint failed_connects;
+}
+IndicatorPowerDeviceProviderHubPrivate;
+
+typedef IndicatorPowerDeviceProviderHubPrivate priv_t;
+
+/***
+****  GObject boilerplate
+***/
+
+static void indicator_power_device_provider_interface_init (
+                                IndicatorPowerDeviceProviderInterface * iface);
+
+G_DEFINE_TYPE_WITH_CODE (
+  IndicatorPowerDeviceProviderHub,
+  indicator_power_device_provider_hub,
+  G_TYPE_OBJECT,
+  G_ADD_PRIVATE (IndicatorPowerDeviceProviderHub)
+  G_IMPLEMENT_INTERFACE (INDICATOR_TYPE_POWER_DEVICE_PROVIDER,
+                         indicator_power_device_provider_interface_init))
+
+#define get_priv(o) ((priv_t*)indicator_power_device_provider_hub_get_instance_private(o))
+
+static void start (IndicatorPowerDeviceProviderHub * self);
+
+static void
+set_snapshot (IndicatorPowerDeviceProviderHub * self,
+              IndicatorPowerDeviceSnapshot    * snapshot)
+{
+  priv_t * p = get_priv(self);
+
+  g_clear_pointer (&p->snapshot, indicator_power_device_snapshot_unref);
+  p->snapshot = snapshot;
+
+  indicator_power_device_provider_emit_devices_changed (INDICATOR_POWER_DEVICE_PROVIDER (self));
+}
+
+/***
+****  Serving
+***/
+
+/* the socket file in @address, or NULL if it doesn't use one */
+static gchar *
+get_socket_path (const gchar * address)
+{
+  static const gchar prefix[] = "unix:path=";
+
+  if (!g_str_has_prefix (address, prefix) || strchr (address, ',') || strchr (address, ';'))
+    return NULL;
+
+  return g_uri_unescape_string (address + sizeof(prefix) - 1, NULL);
+}
+
+/* the socket file and its lock; other users need to be able to take over */
+static mode_t
+get_file_mode (priv_t * p)
+{
+  return p->access == INDICATOR_POWER_DEVICE_HUB_GROUP ? 0660 : 0600;
+}
+
+typedef enum
+{
+  LOCK_TAKEN,
+  LOCK_BUSY,   /* another instance is the hub */
+  LOCK_FAILED
+}
+LockResult;
+
+/* With a socket file, whoever holds its lock is the hub. The lock goes
+   away with its process, so this also tells us whether a leftover
+   socket file is stale. */
+static LockResult
+take_lock (priv_t * p, const gchar * socket_path)
+{
+  gchar * lock_path = g_strconcat (socket_path, ".lock", NULL);
+  LockResult ret = LOCK_TAKEN;
+  int fd;
+
+  fd = g_open (lock_path, O_RDWR | O_CREAT | O_CLOEXEC, get_file_mode (p));
+  if (fd == -1)
+    {
+      g_warning ("Unable to open '%s': %s", lock_path, g_strerror (errno));
+      ret = LOCK_FAILED;
+    }
+  else if (flock (fd, LOCK_EX | LOCK_NB) == -1)
+    {
+      const int err = errno;
+
+      if (err == EWOULDBLOCK)
+        ret = LOCK_BUSY;
+      else
+        {
+          g_warning ("Unable to lock '%s': %s", lock_path, g_strerror (err));
+          ret = LOCK_FAILED;
+        }
+
+      close (fd);
+      fd = -1;
+    }
+  else
+    {
+      /* don't leave it to our umask; this fails harmlessly if
+         someone else created it, since they've already done this */
+      fchmod (fd, get_file_mode (p));
+    }
+
+  g_free (lock_path);
+  p->lock_fd = fd;
+  return ret;
+}
+
+static void
+release_lock (priv_t * p)
+{
+  if (p->lock_fd != -1)
+    {
+      close (p->lock_fd);
+      p->lock_fd = -1;
+    }
+}
+
+static gboolean
+is_user_in_group (uid_t uid, gid_t gid)
+{
+  struct passwd pwd;
+  struct passwd * found = NULL;
+  gchar buf[4096];
+  gid_t * groups;
+  int n_groups = 64;
+  gboolean ret = FALSE;
+
+  if ((getpwuid_r (uid, &pwd, buf, sizeof(buf), &found) != 0) || (found == NULL))
+    return FALSE;
+
+  if (pwd.pw_gid == gid)
+    return TRUE;
+
+  groups = g_new (gid_t, n_groups);
+  if (getgrouplist (pwd.pw_name, pwd.pw_gid, groups, &n_groups) == -1)
+    {
+      /* n_groups is now the number needed */
+      groups = g_renew (gid_t, groups, n_groups);
+      if (getgrouplist (pwd.pw_name, pwd.pw_gid, groups, &n_groups) == -1)
+        n_groups = 0;
+    }
+
+  while (!ret && (n_groups > 0))
+    ret = groups[--n_groups] == gid;
+
+  g_free (groups);
+  return ret;
+}
+
+/* only mechanisms that tell us who the peer is */
+static gboolean
+on_allow_mechanism (GDBusAuthObserver * observer G_GNUC_UNUSED,
+                    const gchar       * mechanism,
+                    gpointer            gself    G_GNUC_UNUSED)
+{
+  return !g_strcmp0 (mechanism, "EXTERNAL");
+}
+
+static gboolean
+on_authorize_peer (GDBusAuthObserver * observer    G_GNUC_UNUSED,
+                   GIOStream         * stream      G_GNUC_UNUSED,
+                   GCredentials      * credentials,
+                   gpointer            gself)
+{
+  priv_t * p = get_priv(INDICATOR_POWER_DEVICE_PROVIDER_HUB (gself));
+  uid_t uid;
+
+  if (credentials == NULL)
+    return FALSE;
+
+  uid = g_credentials_get_unix_user (credentials, NULL);
+  if (uid == (uid_t)-1)
+    return FALSE;
+
+  if (uid == getuid ())
+    return TRUE;
+
+  if ((p->access == INDICATOR_POWER_DEVICE_HUB_GROUP) && is_user_in_group (uid, p->group))
+    return TRUE;
+
+  g_debug ("refusing a device hub client with uid %u", (guint) uid);
+  return FALSE;
+}
+
+static void
+publish (IndicatorPowerDeviceProviderHub * self)
+{
+  priv_t * p = get_priv(self);
+
+  dbus_hub_set_devices (p->skeleton, indicator_power_device_snapshot_serialize (p->snapshot));
+}
+
+static void
+on_provider_devices_changed (IndicatorPowerDeviceProviderHub * self)
+{
+  priv_t * p = get_priv(self);
+
+  set_snapshot (self, indicator_power_device_provider_get_snapshot (p->provider));
+
+  if (p->skeleton != NULL)
+    publish (self);
+}
+
+static void
+forget_client (IndicatorPowerDeviceProviderHub * self,
+               GDBusConnection                 * connection)
+{
+  priv_t * p = get_priv(self);
+
+  g_signal_handlers_disconnect_by_data (connection, self);
+  g_dbus_interface_skeleton_unexport_from_connection (G_DBUS_INTERFACE_SKELETON (p->skeleton), connection);
+  p->clients = g_slist_remove (p->clients, connection);
+  g_object_unref (connection);
+}
+
+static void
+on_client_closed (GDBusConnection * connection,
+                  gboolean          remote_peer_vanished G_GNUC_UNUSED,
+                  GError          * error                G_GNUC_UNUSED,
+                  gpointer          gself)
+{
+  forget_client (INDICATOR_POWER_DEVICE_PROVIDER_HUB (gself), connection);
+}
+
+static gboolean
+on_new_connection (GDBusServer     * server G_GNUC_UNUSED,
+                   GDBusConnection * connection,
+                   gpointer          gself)
+{
+  IndicatorPowerDeviceProviderHub * self = INDICATOR_POWER_DEVICE_PROVIDER_HUB (gself);
+  priv_t * p = get_priv(self);
+  GError * error = NULL;
+
+  if (!g_dbus_interface_skeleton_export (G_DBUS_INTERFACE_SKELETON (p->skeleton),
+                                         connection,
+                                         HUB_PATH,
+                                         &error))
+    {
+      g_warning ("Unable to export the device hub: %s", error->message);
+      g_error_free (error);
+      return FALSE;
+    }
+
+  p->clients = g_slist_prepend (p->clients, g_object_ref (connection));
+  g_signal_connect (connection, "closed", G_CALLBACK(on_client_closed), self);
+  return TRUE;
+}
+
+/* Read the devices ourselves, and serve them if we're the hub */
+static void
+use_provider (IndicatorPowerDeviceProviderHub * self)
+{
+  priv_t * p = get_priv(self);
+
+  p->provider = p->create_provider ();
+  g_signal_connect_swapped (p->provider, "devices-changed",
+                            G_CALLBACK(on_provider_devices_changed), self);
+
+  if (p->snapshot == NULL)
+    p->snapshot = indicator_power_device_provider_get_snapshot (p->provider);
+
+  if (p->skeleton != NULL)
+    publish (self);
+}
+
+static gboolean
+start_server (IndicatorPowerDeviceProviderHub * self,
+              const gchar                     * socket_path,
+              GError                         ** error)
+{
+  priv_t * p = get_priv(self);
+  GDBusServerFlags flags = G_DBUS_SERVER_FLAGS_NONE;
+  gchar * guid;
+
+#if GLIB_CHECK_VERSION(2,68,0)
+  if (p->access == INDICATOR_POWER_DEVICE_HUB_SAME_USER)
+    flags |= G_DBUS_SERVER_FLAGS_AUTHENTICATION_REQUIRE_SAME_USER;
+#endif
+
+  p->observer = g_dbus_auth_observer_new ();
+  g_signal_connect (p->observer, "allow-mechanism", G_CALLBACK(on_allow_mechanism), self);
+  g_signal_connect (p->observer, "authorize-authenticated-peer", G_CALLBACK(on_authorize_peer), self);
+
+  guid = g_dbus_generate_guid ();
+  p->server = g_dbus_server_new_sync (p->address,
+                                      flags,
+                                      guid,
+                                      p->observer,
+                                      p->cancellable,
+                                      error);
+  g_free (guid);
+
+  if (p->server == NULL)
+    {
+      g_clear_object (&p->observer);
+      return FALSE;
+    }
+
+  if (socket_path != NULL)
+    {
+      GStatBuf st;
+
+      /* the socket gets its group from its directory */
+      g_chmod (socket_path, get_file_mode (p));
+      if (g_stat (socket_path, &st) == 0)
+        p->group = st.st_gid;
+    }
+
+  g_debug ("serving the device hub at '%s'", p->address);
+
+  p->skeleton = dbus_hub_skeleton_new ();
+  g_signal_connect (p->server, "new-connection", G_CALLBACK(on_new_connection), self);
+  g_dbus_server_start (p->server);
+  return TRUE;
+}
+
+/* Returns FALSE if another instance is already the hub */
+static gboolean
+try_serve (IndicatorPowerDeviceProviderHub * self)
+{
+  priv_t * p = get_priv(self);
+  gchar * socket_path = get_socket_path (p->address);
+  gboolean can_serve = TRUE;
+  GError * error = NULL;
+
+  if (socket_path != NULL)
+    {
+      switch (take_lock (p, socket_path))
+        {
+          case LOCK_TAKEN:
+            g_unlink (socket_path);
+            break;
+
+          case LOCK_BUSY:
+            g_free (socket_path);
+            return FALSE;
+
+          case LOCK_FAILED:
+            /* if we can't share, at least keep working on our own */
+            can_serve = FALSE;
+            break;
+        }
+    }
+
+  if (can_serve && !start_server (self, socket_path, &error))
+    {
+      const gboolean taken = g_error_matches (error, G_IO_ERROR, G_IO_ERROR_ADDRESS_IN_USE);
+
+      release_lock (p);
+
+      if (!taken)
+        g_warning ("Unable to serve the device hub at '%s': %s", p->address, error->message);
+
+      g_error_free (error);
+
+      if (taken)
+        {
+          g_free (socket_path);
+          return FALSE;
+        }
+    }
+
+  g_free (socket_path);
+  use_provider (self);
+  return TRUE;
+}
+
+static void
+stop_serving (IndicatorPowerDeviceProviderHub * self)
+{
+  priv_t * p = get_priv(self);
+
+  if (p->server != NULL)
+    {
+      gchar * socket_path;
+
+      g_dbus_server_stop (p->server);
+      g_clear_object (&p->server);
+
+      while (p->clients != NULL)
+        {
+          GDBusConnection * connection = g_object_ref (p->clients->data);
+          forget_client (self, connection);
+          g_dbus_connection_close (connection, NULL, NULL, NULL);
+          g_object_unref (connection);
+        }
+
+      if ((socket_path = get_socket_path (p->address)))
+        {
+          g_unlink (socket_path);
+          g_free (socket_path);
+        }
+    }
+
+  g_clear_object (&p->skeleton);
+  g_clear_object (&p->observer);
+  release_lock (p);
+
+  if (p->provider != NULL)
+    {
+      g_signal_handlers_disconnect_by_data (p->provider, self);
+      g_clear_object (&p->provider);
+    }
+}
+
+/***
+****  Client
+***/
+
+static gboolean
+on_retry_timer (gpointer gself)
+{
+  IndicatorPowerDeviceProviderHub * self = INDICATOR_POWER_DEVICE_PROVIDER_HUB (gself);
+
+  get_priv(self)->retry_tag = 0;
+  start (self);
+  return G_SOURCE_REMOVE;
+}
+
+static void
+retry_soon (IndicatorPowerDeviceProviderHub * self)
+{
+  priv_t * p = get_priv(self);
+
+  if (p->retry_tag == 0)
+    p->retry_tag = g_timeout_add (g_random_int_range (RETRY_MIN_MSEC, RETRY_MAX_MSEC+1),
+                                  on_retry_timer,
+                                  self);
+}
+
+static void
+on_hub_devices_changed (IndicatorPowerDeviceProviderHub * self)
+{
+  priv_t * p = get_priv(self);
+  GVariant * devices = dbus_hub_get_devices (p->proxy);
+  IndicatorPowerDeviceSnapshot * snapshot;
+
+  if ((devices != NULL) && (snapshot = indicator_power_device_snapshot_deserialize (devices)))
+    set_snapshot (self, snapshot);
+}
+
+static void
+drop_hub (IndicatorPowerDeviceProviderHub * self)
+{
+  priv_t * p = get_priv(self);
+
+  if (p->proxy != NULL)
+    {
+      g_signal_handlers_disconnect_by_data (p->proxy, self);
+      g_clear_object (&p->proxy);
+    }
+
+  if (p->connection != NULL)
+    {
+      g_signal_handlers_disconnect_by_data (p->connection, self);
+      g_dbus_connection_close (p->connection, NULL, NULL, NULL);
+      g_clear_object (&p->connection);
+    }
+}
+
+/* keep showing the last devices we were sent; someone will take over soon */
+static void
+on_hub_closed (GDBusConnection * connection           G_GNUC_UNUSED,
+               gboolean          remote_peer_vanished G_GNUC_UNUSED,
+               GError          * error                G_GNUC_UNUSED,
+               gpointer          gself)
+{
+  IndicatorPowerDeviceProviderHub * self = INDICATOR_POWER_DEVICE_PROVIDER_HUB (gself);
+
+  g_debug ("lost the device hub");
+  drop_hub (self);
+  retry_soon (self);
+}
+
+static void
+on_proxy_ready (GObject      * source_object G_GNUC_UNUSED,
+                GAsyncResult * res,
+                gpointer       gself)
+{
+  GError * error = NULL;
+  DbusHub * proxy;
+
+  proxy = dbus_hub_proxy_new_finish (res, &error);
+  if (error != NULL)
+    {
+      if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        {
+          g_warning ("Unable to read the device hub: %s", error->message);
+          drop_hub (INDICATOR_POWER_DEVICE_PROVIDER_HUB (gself));
+          retry_soon (INDICATOR_POWER_DEVICE_PROVIDER_HUB (gself));
+        }
+
+      g_error_free (error);
+    }
+  else
+    {
+      IndicatorPowerDeviceProviderHub * self = INDICATOR_POWER_DEVICE_PROVIDER_HUB (gself);
+
+      get_priv(self)->proxy = proxy;
+      get_priv(self)->failed_connects = 0;
+      g_signal_connect_swapped (proxy, "notify::devices",
+                                G_CALLBACK(on_hub_devices_changed), self);
+      on_hub_devices_changed (self);
+    }
+}
+
+static void
+on_connection_ready (GObject      * source_object G_GNUC_UNUSED,
+                     GAsyncResult * res,
+                     gpointer       gself)
+{
+  GError * error = NULL;
+  GDBusConnection * connection;
+
+  connection = g_dbus_connection_new_for_address_finish (res, &error);
+  if (error != NULL)
+    {
+      /* the hub may be on its way out; try again, maybe as the hub */
+      if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        {
+          IndicatorPowerDeviceProviderHub * self = INDICATOR_POWER_DEVICE_PROVIDER_HUB (gself);
+          priv_t * p = get_priv(self);
+
+          if (++p->failed_connects < MAX_CONNECT_ATTEMPTS)
+            {
+              g_debug ("Unable to reach the device hub: %s", error->message);
+              retry_soon (self);
+            }
+          else
+            {
+              g_warning ("Unable to reach the device hub at '%s': %s. Reading the devices without it.",
+                         p->address, error->message);
+              use_provider (self);
+            }
+        }
+
+      g_error_free (error);
+    }
+  else
+    {
+      IndicatorPowerDeviceProviderHub * self = INDICATOR_POWER_DEVICE_PROVIDER_HUB (gself);
+      priv_t * p = get_priv(self);
+
+      p->connection = connection;
+      g_signal_connect (connection, "closed", G_CALLBACK(on_hub_closed), self);
+
+      dbus_hub_proxy_new (connection,
+                          G_DBUS_PROXY_FLAGS_NONE,
+                          NULL, /* peer-to-peer, so no bus name */
+                          HUB_PATH,
+                          p->cancellable,
+                          on_proxy_ready,
+                          self);
+    }
+}
+
+static void
+start (IndicatorPowerDeviceProviderHub * self)
+{
+  priv_t * p = get_priv(self);
+
+  if (!try_serve (self))
+    g_dbus_connection_new_for_address (p->address,
+                                       G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT,
+                                       NULL,
+                                       p->cancellable,
+                                       on_connection_ready,
+                                       self);
+}
+
+/***
+****  IndicatorPowerDeviceProvider virtual functions
+***/
+
+static IndicatorPowerDeviceSnapshot *
+my_get_snapshot (IndicatorPowerDeviceProvider * provider)
+{
+  priv_t * p = get_priv(INDICATOR_POWER_DEVICE_PROVIDER_HUB (provider));
+
+  if (p->snapshot == NULL)
+    p->snapshot = indicator_power_device_snapshot_new (0);
+
+  return indicator_power_device_snapshot_ref (p->snapshot);
+}
+
+/***
+****  GObject virtual functions
+***/
+
+static void
+my_dispose (GObject * o)
+{
+  IndicatorPowerDeviceProviderHub * self = INDICATOR_POWER_DEVICE_PROVIDER_HUB (o);
+  priv_t * p = get_priv(self);
+
+  if (p->cancellable != NULL)
+    {
+      g_cancellable_cancel (p->cancellable);
+      g_clear_object (&p->cancellable);
+    }
+
+  if (p->retry_tag != 0)
+    {
+      g_source_remove (p->retry_tag);
+      p->retry_tag = 0;
+    }
+
+  drop_hub (self);
+  stop_serving (self);
+  g_clear_pointer (&p->snapshot, indicator_power_device_snapshot_unref);
+
+  G_OBJECT_CLASS (indicator_power_device_provider_hub_parent_class)->dispose (o);
+}
+
+static void
+my_finalize (GObject * o)
+{
+  priv_t * p = get_priv(INDICATOR_POWER_DEVICE_PROVIDER_HUB (o));
+
+  g_free (p->address);
+
+  G_OBJECT_CLASS (indicator_power_device_provider_hub_parent_class)->finalize (o);
+}
+
+/***
+****  Instantiation
+***/
+
+static void
+indicator_power_device_provider_hub_class_init (IndicatorPowerDeviceProviderHubClass * klass)
+{
+  GObjectClass * object_class = G_OBJECT_CLASS (klass);
+
+  object_class->dispose = my_dispose;
+  object_class->finalize = my_finalize;
+}
+
+static void
+indicator_power_device_provider_interface_init (IndicatorPowerDeviceProviderInterface * iface)
+{
+  iface->get_snapshot = my_get_snapshot;
+}
+
+static void
+indicator_power_device_provider_hub_init (IndicatorPowerDeviceProviderHub * self)
+{
+  priv_t * p = get_priv(self);
+
+  p->cancellable = g_cancellable_new ();
+  p->lock_fd = -1;
+}
+
+/***
+****  Public API
+***/
+
+/**
+ * @address: the D-Bus server address the instances meet at
+ * @hub_access: who besides this user may use the hub
+ * @create_provider: creates the real provider if this instance
+ *                   becomes the hub, possibly later on
+ */
+IndicatorPowerDeviceProvider *
+indicator_power_device_provider_hub_new (const gchar                         * address,
+                                         IndicatorPowerDeviceHubAccess         hub_access,
+                                         IndicatorPowerDeviceProviderFactory   create_provider)
+{
+  IndicatorPowerDeviceProviderHub * self;
+  priv_t * p;
+
+  g_return_val_if_fail (address != NULL, NULL);
+  g_return_val_if_fail (create_provider != NULL, NULL);
+
+  self = g_object_new (INDICATOR_TYPE_POWER_DEVICE_PROVIDER_HUB, NULL);
+  p = get_priv(self);
+  p->address = g_strdup (address);
+  p->access = hub_access;
+  p->create_provider = create_provider;
+
+  if (hub_access == INDICATOR_POWER_DEVICE_HUB_GROUP)
+    {
+      gchar * socket_path = get_socket_path (address);
+
+      if (socket_path == NULL)
+        g_warning ("Device hub address '%s' has no socket file to share with a group; only this user can use it", address);
+
+      g_free (socket_path);
+    }
+
+  start (self);
+
+  return INDICATOR_POWER_DEVICE_PROVIDER (self);
+}
+
+/**
+ * Turn the device-hub setting into a D-Bus server address.
+ *
+ * "session" is a socket in $XDG_RUNTIME_DIR for this user only.
+ * Any other address is shared with the socket file's group.
+ *
+ * Return value: (transfer full): the address, or NULL if @setting
+ *               says not to share. Free with g_free().
+ */
+gchar *
+indicator_power_device_provider_hub_get_address (const gchar                   * setting,
+                                                 IndicatorPowerDeviceHubAccess * hub_access)
+{
+  gchar * path;
+  gchar * escaped;
+  gchar * address;
+
+  if ((setting == NULL) || (*setting == '\0'))
+    return NULL;
+
+  if (g_strcmp0 (setting, INDICATOR_POWER_DEVICE_HUB_SESSION))
+    {
+      *hub_access = INDICATOR_POWER_DEVICE_HUB_GROUP;
+      return g_strdup (setting);
+    }
+
+  *hub_access = INDICATOR_POWER_DEVICE_HUB_SAME_USER;
+
+  path = g_build_filename (g_get_user_runtime_dir (), HUB_SOCKET_BASENAME, NULL);
+  escaped = g_dbus_address_escape_value (path);
+  address = g_strdup_printf ("unix:path=%s", escaped);
+  g_free (escaped);
+  g_free (path);
+
+  return address;
+}
+
+gboolean
+indicator_power_device_provider_hub_is_serving (IndicatorPowerDeviceProviderHub * self)
+{
+  g_return_val_if_fail (INDICATOR_IS_POWER_DEVICE_PROVIDER_HUB (self), FALSE);
+
+  return get_priv(self)->server != NULL;
+}
+
+guint
+indicator_power_device_provider_hub_get_n_clients (IndicatorPowerDeviceProviderHub * self)
+{
+  g_return_val_if_fail (INDICATOR_IS_POWER_DEVICE_PROVIDER_HUB (self), 0);
+
+  return g_slist_length (get_priv(self)->clients);
+}
@@ -0,0 +1,99 @@
+/*
+ * Copyright 2026 The Ayatana Indicators project
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef __INDICATOR_POWER_DEVICE_PROVIDER_HUB__H__
+#define __INDICATOR_POWER_DEVICE_PROVIDER_HUB__H__
+
+#include <glib-object.h> /* parent class */
+
+#include "device-provider.h"
+
+G_BEGIN_DECLS
+
+#define INDICATOR_TYPE_POWER_DEVICE_PROVIDER_HUB \
+  (indicator_power_device_provider_hub_get_type())
+
+#define INDICATOR_POWER_DEVICE_PROVIDER_HUB(o) \
+  (G_TYPE_CHECK_INSTANCE_CAST ((o), \
+                               INDICATOR_TYPE_POWER_DEVICE_PROVIDER_HUB, \
+                               IndicatorPowerDeviceProviderHub))
+
+#define INDICATOR_IS_POWER_DEVICE_PROVIDER_HUB(o) \
+  (G_TYPE_CHECK_INSTANCE_TYPE ((o), \
+                               INDICATOR_TYPE_POWER_DEVICE_PROVIDER_HUB))
+
+/* the device-hub setting's shorthand for this user's sessions */
+#define INDICATOR_POWER_DEVICE_HUB_SESSION "session"
+
+/* who may connect to the hub, and take over from it */
+typedef enum
+{
+  /* only this user, e.g. for a socket in $XDG_RUNTIME_DIR */
+  INDICATOR_POWER_DEVICE_HUB_SAME_USER,
+
+  /* also members of the socket file's group, e.g. the greeter's user.
+     The socket and its lock are made group read/write, and they get
+     their group from a setgid directory. Needs a unix:path address. */
+  INDICATOR_POWER_DEVICE_HUB_GROUP
+}
+IndicatorPowerDeviceHubAccess;
+
+typedef struct _IndicatorPowerDeviceProviderHub
+                IndicatorPowerDeviceProviderHub;
+typedef struct _IndicatorPowerDeviceProviderHubClass
+                IndicatorPowerDeviceProviderHubClass;
+
+/**
+ * An IndicatorPowerDeviceProvider that shares one view of the devices
+ * between several service instances, e.g. one per session on a
+ * multi-seat machine.
+ *
+ * Whichever instance gets to the hub's address first becomes the hub:
+ * it reads the devices from a real provider and serves them to the others
+ * over a peer-to-peer D-Bus socket. The rest are clients that only pass
+ * along what the hub sends. If the hub goes away, a client takes its place.
+ * An instance that can't reach or become the hub reads the devices itself.
+ */
+struct _IndicatorPowerDeviceProviderHub
+{
+  GObject parent_instance;
+};
+
+struct _IndicatorPowerDeviceProviderHubClass
+{
+  GObjectClass parent_class;
+};
+
+/* creates the real provider, if and when this instance becomes the hub */
+typedef IndicatorPowerDeviceProvider * (*IndicatorPowerDeviceProviderFactory) (void);
+
+GType indicator_power_device_provider_hub_get_type (void);
+
+IndicatorPowerDeviceProvider * indicator_power_device_provider_hub_new        (const gchar                         * address,
+                                                                              IndicatorPowerDeviceHubAccess         hub_access,
+                                                                              IndicatorPowerDeviceProviderFactory   create_provider);
+
+gchar                        * indicator_power_device_provider_hub_get_address (const gchar                   * setting,
+                                                                              IndicatorPowerDeviceHubAccess * hub_access);
+
+gboolean                       indicator_power_device_provider_hub_is_serving  (IndicatorPowerDeviceProviderHub * self);
+
+guint                          indicator_power_device_provider_hub_get_n_clients (IndicatorPowerDeviceProviderHub * self);
+
+G_END_DECLS
+
+#endif /* __INDICATOR_POWER_DEVICE_PROVIDER_HUB__H__ */
@@ -21,6 +21,28 @@
 #include "device-provider.h"
 #include "device-provider-mock.h"
 
+#include <string.h> /* memcpy() */
+
+/* how often a playing profile moves its devices, in real time */
+#define PROFILE_TICK_MSEC 100
+
+struct _IndicatorPowerDeviceProviderMockPriv
+{
+  /* batching */
+  guint freeze_count;
+  gboolean changed_while_frozen;
+
+  /* the playing profile */
+  GList * profile_devices;
+  IndicatorPowerMockKeyframe * keyframes;
+  guint n_keyframes;
+  gdouble speed;
+  gint64 profile_start;
+  guint profile_tag;
+};
+
+typedef IndicatorPowerDeviceProviderMockPriv priv_t;
+
 /***
 ****  GObject boilerplate
 ***/
@@ -32,9 +54,107 @@ G_DEFINE_TYPE_WITH_CODE (
   IndicatorPowerDeviceProviderMock,
   indicator_power_device_provider_mock,
   G_TYPE_OBJECT,
+  G_ADD_PRIVATE (IndicatorPowerDeviceProviderMock)
   G_IMPLEMENT_INTERFACE (INDICATOR_TYPE_POWER_DEVICE_PROVIDER,
                          indicator_power_device_provider_interface_init))
 
+static void
+devices_changed (IndicatorPowerDeviceProviderMock * self)
+{
+  if (self->priv->freeze_count > 0)
+    self->priv->changed_while_frozen = TRUE;
+  else
+    indicator_power_device_provider_emit_devices_changed (INDICATOR_POWER_DEVICE_PROVIDER (self));
+}
+
+/***
+****  Profiles
+***/
+
+static gdouble
+interpolate (gdouble from, gdouble to, gdouble fraction)
+{
+  return from + (to - from) * fraction;
+}
+
+static void
+clear_profile (priv_t * p)
+{
+  g_list_free_full (p->profile_devices, g_object_unref);
+  p->profile_devices = NULL;
+  g_clear_pointer (&p->keyframes, g_free);
+  p->n_keyframes = 0;
+}
+
+/* move the devices to where the profile says they are now.
+   Returns FALSE once the profile is over. */
+static gboolean
+apply_profile (IndicatorPowerDeviceProviderMock * self)
+{
+  priv_t * p = self->priv;
+  const IndicatorPowerMockKeyframe * first = &p->keyframes[0];
+  const IndicatorPowerMockKeyframe * last = &p->keyframes[p->n_keyframes-1];
+  const gdouble elapsed = (g_get_monotonic_time () - p->profile_start) / (gdouble)G_USEC_PER_SEC * p->speed;
+  gboolean done = FALSE;
+  gdouble percentage;
+  gdouble time;
+  UpDeviceState state;
+  GList * l;
+
+  if (elapsed <= first->offset)
+    {
+      percentage = first->percentage;
+      state = first->state;
+      time = first->time;
+    }
+  else if (elapsed >= last->offset)
+    {
+      percentage = last->percentage;
+      state = last->state;
+      time = last->time;
+      done = TRUE;
+    }
+  else
+    {
+      const IndicatorPowerMockKeyframe * k = first;
+      gdouble fraction;
+
+      while (elapsed >= k[1].offset)
+        ++k;
+
+      fraction = (elapsed - k[0].offset) / (k[1].offset - k[0].offset);
+      percentage = interpolate (k[0].percentage, k[1].percentage, fraction);
+      time = interpolate (k[0].time, k[1].time, fraction);
+      state = k[0].state;
+    }
+
+  indicator_power_device_provider_mock_freeze (self);
+  for (l=p->profile_devices; l!=NULL; l=l->next)
+    g_object_set (l->data,
+                  INDICATOR_POWER_DEVICE_PERCENTAGE, percentage,
+                  INDICATOR_POWER_DEVICE_STATE, (gint)state,
+                  INDICATOR_POWER_DEVICE_TIME, (guint64)time,
+                  NULL);
+  indicator_power_device_provider_mock_thaw (self);
+
+  if (done)
+    clear_profile (p);
+
+  return !done;
+}
+
+static gboolean
+on_profile_tick (gpointer gself)
+{
+  IndicatorPowerDeviceProviderMock * self = INDICATOR_POWER_DEVICE_PROVIDER_MOCK (gself);
+
+  if (apply_profile (self))
+    return G_SOURCE_CONTINUE;
+
+  self->priv->profile_tag = 0;
+  return G_SOURCE_REMOVE;
+}
+
 /***
 ****  IndicatorPowerDeviceProvider virtual functions
 ***/
@@ -55,8 +175,14 @@ static void
 my_dispose (GObject * o)
 {
   IndicatorPowerDeviceProviderMock * self = INDICATOR_POWER_DEVICE_PROVIDER_MOCK(o);
+  GList * l;
+
+  indicator_power_device_provider_mock_stop_profile (self);
 
+  for (l=self->devices; l!=NULL; l=l->next)
+    g_signal_handlers_disconnect_by_data (l->data, self);
   g_list_free_full (self->devices, g_object_unref);
+  self->devices = NULL;
 
   G_OBJECT_CLASS (indicator_power_device_provider_mock_parent_class)->dispose (o);
 }
@@ -81,8 +207,9 @@ indicator_power_device_provider_interface_init (IndicatorPowerDeviceProviderInte
 }
 
 static void
-indicator_power_device_provider_mock_init (IndicatorPowerDeviceProviderMock * self G_GNUC_UNUSED)
+indicator_power_device_provider_mock_init (IndicatorPowerDeviceProviderMock * self)
 {
+  self->priv = indicator_power_device_provider_mock_get_instance_private (self);
 }
 
 /***
@@ -103,5 +230,120 @@ indicator_power_device_provider_add_device (IndicatorPowerDeviceProviderMock * p
 {
   provider->devices = g_list_append (provider->devices, g_object_ref(device));
 
-  g_signal_connect_swapped (device, "notify", G_CALLBACK(indicator_power_device_provider_emit_devices_changed), provider);
+  g_signal_connect_swapped (device, "notify", G_CALLBACK(devices_changed), provider);
+
+  devices_changed (provider);
+}
+
+void
+indicator_power_device_provider_remove_device (IndicatorPowerDeviceProviderMock * provider,
+                                               IndicatorPowerDevice             * device)
+{
+  priv_t * p = provider->priv;
+  GList * l;
+
+  if ((l = g_list_find (provider->devices, device)) == NULL)
+    return;
+
+  if ((l = g_list_find (p->profile_devices, device)))
+    {
+      p->profile_devices = g_list_delete_link (p->profile_devices, l);
+      g_object_unref (device);
+    }
+
+  g_signal_handlers_disconnect_by_data (device, provider);
+  provider->devices = g_list_remove (provider->devices, device);
+  g_object_unref (device);
+
+  devices_changed (provider);
+}
+
+/**
+ * Return value: (transfer none): the device at @object_path, or NULL
+ */
+IndicatorPowerDevice *
+indicator_power_device_provider_mock_get_device (IndicatorPowerDeviceProviderMock * provider,
+                                                 const gchar                      * object_path)
+{
+  GList * l;
+
+  for (l=provider->devices; l!=NULL; l=l->next)
+    if (!g_strcmp0 (indicator_power_device_get_object_path (l->data), object_path))
+      return l->data;
+
+  return NULL;
+}
+
+void
+indicator_power_device_provider_mock_freeze (IndicatorPowerDeviceProviderMock * provider)
+{
+  ++provider->priv->freeze_count;
+}
+
+void
+indicator_power_device_provider_mock_thaw (IndicatorPowerDeviceProviderMock * provider)
+{
+  priv_t * p = provider->priv;
+
+  g_return_if_fail (p->freeze_count > 0);
+
+  if ((--p->freeze_count == 0) && p->changed_while_frozen)
+    {
+      p->changed_while_frozen = FALSE;
+      devices_changed (provider);
+    }
+}
+
+/**
+ * Move @devices through @keyframes, @speed times faster than real time,
+ * replacing any profile that's already playing.
+ *
+ * @devices: the provider's devices to move, or NULL for all of them
+ * @keyframes: sorted by offset
+ */
+void
+indicator_power_device_provider_mock_play_profile (IndicatorPowerDeviceProviderMock * provider,
+                                                   GList                            * devices,
+                                                   const IndicatorPowerMockKeyframe * keyframes,
+                                                   guint                              n_keyframes,
+                                                   gdouble                            speed)
+{
+  priv_t * p = provider->priv;
+
+  g_return_if_fail (keyframes != NULL);
+  g_return_if_fail (n_keyframes > 0);
+  g_return_if_fail (speed > 0);
+
+  indicator_power_device_provider_mock_stop_profile (provider);
+
+  p->profile_devices = g_list_copy_deep (devices ? devices : provider->devices, (GCopyFunc)g_object_ref, NULL);
+  p->keyframes = g_new (IndicatorPowerMockKeyframe, n_keyframes);
+  memcpy (p->keyframes, keyframes, n_keyframes * sizeof(IndicatorPowerMockKeyframe));
+  p->n_keyframes = n_keyframes;
+  p->speed = speed;
+  p->profile_start = g_get_monotonic_time ();
+
+  /* start from the first keyframe right away */
+  if (apply_profile (provider))
+    p->profile_tag = g_timeout_add (PROFILE_TICK_MSEC, on_profile_tick, provider);
+}
+
+void
+indicator_power_device_provider_mock_stop_profile (IndicatorPowerDeviceProviderMock * provider)
+{
+  priv_t * p = provider->priv;
+
+  if (p->profile_tag != 0)
+    {
+      g_source_remove (p->profile_tag);
+      p->profile_tag = 0;
+    }
+
+  clear_profile (p);
+}
+
+gboolean
+indicator_power_device_provider_mock_is_playing (IndicatorPowerDeviceProviderMock * provider)
+{
+  return provider->priv->keyframes != NULL;
 }
@@ -60,6 +60,7 @@ struct _IndicatorPowerDeviceProviderMock
 
   /*< private >*/
   GList * devices;
+  IndicatorPowerDeviceProviderMockPriv * priv;
 };
 
 struct _IndicatorPowerDeviceProviderMockClass
@@ -74,6 +75,42 @@ IndicatorPowerDeviceProvider * indicator_power_device_provider_mock_new (void);
 void indicator_power_device_provider_add_device (IndicatorPowerDeviceProviderMock * provider,
                                                  IndicatorPowerDevice             * device);
 
+void indicator_power_device_provider_remove_device (IndicatorPowerDeviceProviderMock * provider,
+                                                    IndicatorPowerDevice             * device);
+
+IndicatorPowerDevice * indicator_power_device_provider_mock_get_device (IndicatorPowerDeviceProviderMock * provider,
+                                                                        const gchar                      * object_path);
+
+/**
+ * Batch changes: while frozen, adding, removing, or changing devices
+ * doesn't emit devices-changed. The last thaw emits it once if needed.
+ */
+void indicator_power_device_provider_mock_freeze (IndicatorPowerDeviceProviderMock * provider);
+
+void indicator_power_device_provider_mock_thaw   (IndicatorPowerDeviceProviderMock * provider);
+
+/**
+ * One point in a scripted charge/discharge profile.
+ */
+typedef struct
+{
+  guint64 offset;     /* seconds since the profile started */
+  gdouble percentage;
+  UpDeviceState state;
+  guint64 time;       /* seconds left */
+}
+IndicatorPowerMockKeyframe;
+
+void indicator_power_device_provider_mock_play_profile (IndicatorPowerDeviceProviderMock * provider,
+                                                        GList                            * devices,
+                                                        const IndicatorPowerMockKeyframe * keyframes,
+                                                        guint                              n_keyframes,
+                                                        gdouble                            speed);
+
+void indicator_power_device_provider_mock_stop_profile (IndicatorPowerDeviceProviderMock * provider);
+
+gboolean indicator_power_device_provider_mock_is_playing (IndicatorPowerDeviceProviderMock * provider);
+
 G_END_DECLS
 
 #endif /* __INDICATOR_POWER_DEVICE_PROVIDER_MOCK__H__ */
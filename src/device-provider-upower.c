@@ -22,6 +22,7 @@
 #include "device.h"
 #include "device-provider.h"
 #include "device-provider-upower.h"
+#include "device-snapshot.h"
 
 #define BUS_NAME "org.freedesktop.UPower"
 
@@ -30,27 +31,107 @@
 
 #define DISPLAY_DEVICE_PATH "/org/freedesktop/UPower/devices/DisplayDevice"
 
+#define LOGIND_BUS_NAME "org.freedesktop.login1"
+#define LOGIND_IFACE    "org.freedesktop.login1.Manager"
+#define LOGIND_PATH     "/org/freedesktop/login1"
+
+/***
+****  message filter state
+***/
+
+/**
+ * State for the message filter that runs in GDBus' worker thread.
+ *
+ * The worker thread owns 'ignored' outright.
+ * The main thread publishes a new ignore set by swapping it into
+ * 'pending_ignored', and the worker adopts it on its next message,
+ * so neither side ever waits on the other.
+ */
+typedef struct
+{
+  gint ref_count;
+
+  /* path --> IndicatorPowerUPowerFilterRule; worker thread only */
+  GHashTable * ignored;
+
+  /* a new ignore set waiting to be adopted by the worker thread */
+  gpointer pending_ignored;
+
+  /* how many messages each rule has dropped */
+  gint drops[INDICATOR_POWER_UPOWER_FILTER_N_RULES];
+}
+FilterState;
+
 /***
 ****  private struct
 ***/
 
+/**
+ * When the ingestion thread is enabled, everything that talks to UPower
+ * runs in that thread with its own GMainContext. It owns every field
+ * below except for 'snapshot', which belongs to the main thread.
+ * The two only meet at 'published', where the worker swaps in each new
+ * snapshot and then queues a single idle in the main context to take it.
+ */
 typedef struct
 {
   GDBusConnection * bus;
   GCancellable * cancellable;
 
-  /* dbus object path --> IndicatorPowerDevice */
+  /* the context that UPower is serviced in: NULL for the default one,
+     or the ingestion thread's own context */
+  GMainContext * context;
+  GMainContext * main_context;
+  GMainLoop * loop;
+  GThread * thread;
+
+  /* worker: idle that folds a burst of changes into one snapshot */
+  GSource * publish_source;
+
+  /* worker --> main: the newest unclaimed snapshot */
+  gpointer published;
+  gint main_idle_pending;
+
+  /* interned dbus object path --> IndicatorPowerDeviceRecord */
   GHashTable * devices;
 
-  /* a hashset of paths whose devices need to be refreshed */
+  /* the snapshot handed out by get_snapshot(), or NULL if stale */
+  IndicatorPowerDeviceSnapshot * snapshot;
+
+  /* a hashset of interned paths whose devices need to be refreshed */
   GHashTable * queued_paths;
 
   /* when this timer fires, the queued_paths will be refreshed */
-  guint queued_paths_timer;
+  GSource * queued_paths_timer;
+
+  /* calls from a full refresh that haven't answered yet: the first
+     EnumerateDevices() and OnBattery lookup and their GetAll()s, or
+     refreshing everything after a resume. devices-changed is held back
+     until they have, so that consumers see one complete update,
+     not a mix of old and new records */
+  guint initial_fetches;
+  gboolean fetching_initial;
+
+  /* UPower's OnBattery property */
+  gboolean on_battery;
 
   GSList* subscriptions;
 
+  /* interned dbus object path --> PropertiesChanged subscription id */
+  GHashTable * device_subscriptions;
+
+  gchar * name_owner;
+
+  /* path --> IndicatorPowerUPowerFilterRule; the master copy of the
+     ignore set that gets published to the message filter */
+  GHashTable * ignored_paths;
+
+  FilterState * filter_state;
+  guint filter_id;
+
   guint name_tag;
+
+  gboolean use_thread;
 }
 IndicatorPowerDeviceProviderUPowerPrivate;
 
@@ -63,6 +144,15 @@ typedef IndicatorPowerDeviceProviderUPowerPrivate priv_t;
 ****  GObject boilerplate
 ***/
 
+enum
+{
+  PROP_0,
+  PROP_INGESTION_THREAD,
+  LAST_PROP
+};
+
+static GParamSpec * properties[LAST_PROP];
+
 static void indicator_power_device_provider_interface_init (
                                 IndicatorPowerDeviceProviderInterface * iface);
 
@@ -74,20 +164,303 @@ G_DEFINE_TYPE_WITH_CODE (
   G_IMPLEMENT_INTERFACE (INDICATOR_TYPE_POWER_DEVICE_PROVIDER,
                          indicator_power_device_provider_interface_init))
 
+/***
+****  Object paths
+***/
+
+/* Object paths are interned the first time we see them, so that our
+   tables and the device records can use the pointer as the identity. */
+static const gchar *
+intern_path (const gchar * path)
+{
+  return g_intern_string (path);
+}
+
+/* returns the interned path, or NULL if we've never seen it before */
+static const gchar *
+lookup_path (const gchar * path)
+{
+  const GQuark q = g_quark_try_string (path);
+
+  return q ? g_quark_to_string (q) : NULL;
+}
+
+/***
+****  Message filter
+****
+****  Runs in GDBus' worker thread and drops the PropertiesChanged
+****  signals we'd ignore anyway, before they're queued to the main loop.
+***/
+
+/* atomically store newval in *slot, returning the previous value */
+static gpointer
+swap_pointer (gpointer * slot, gpointer newval)
+{
+  gpointer oldval;
+
+  do
+    oldval = g_atomic_pointer_get (slot);
+  while (!g_atomic_pointer_compare_and_exchange (slot, oldval, newval));
+
+  return oldval;
+}
+
+static FilterState *
+filter_state_ref (FilterState * state)
+{
+  g_atomic_int_inc (&state->ref_count);
+
+  return state;
+}
+
+static void
+filter_state_unref (gpointer gstate)
+{
+  FilterState * state = gstate;
+
+  if (g_atomic_int_dec_and_test (&state->ref_count))
+    {
+      g_hash_table_destroy (state->ignored);
+      g_clear_pointer (&state->pending_ignored, g_hash_table_destroy);
+      g_slice_free (FilterState, state);
+    }
+}
+
+static FilterState *
+filter_state_new (void)
+{
+  FilterState * state = g_slice_new0 (FilterState);
+
+  state->ref_count = 1;
+
+  state->ignored = g_hash_table_new (g_str_hash, g_str_equal);
+
+  return state;
+}
+
+static GDBusMessage *
+upower_message_filter (GDBusConnection * connection G_GNUC_UNUSED,
+                       GDBusMessage    * message,
+                       gboolean          incoming,
+                       gpointer          gstate)
+{
+  FilterState * state = gstate;
+  GHashTable * ignored;
+  const gchar * interface;
+  const gchar * member;
+  const gchar * path;
+  GVariant * body;
+  const gchar * iface_name;
+  gpointer rule;
+
+  if (!incoming || (g_dbus_message_get_message_type (message) != G_DBUS_MESSAGE_TYPE_SIGNAL))
+    return message;
+
+  /* adopt the newest ignore set, if the main thread has published one */
+  if ((ignored = swap_pointer (&state->pending_ignored, NULL)))
+    {
+      g_hash_table_destroy (state->ignored);
+      state->ignored = ignored;
+    }
+
+  interface = g_dbus_message_get_interface (message);
+  member = g_dbus_message_get_member (message);
+  path = g_dbus_message_get_path (message);
+  body = g_dbus_message_get_body (message);
+
+  /* we only care about device PropertiesChanged signals */
+  if (g_strcmp0 (member, "PropertiesChanged") ||
+      g_strcmp0 (interface, "org.freedesktop.DBus.Properties") ||
+      (path == NULL) ||
+      (body == NULL) ||
+      !g_variant_is_of_type (body, G_VARIANT_TYPE ("(sa{sv}as)")))
+    return message;
+
+  g_variant_get_child (body, 0, "&s", &iface_name);
+
+  /* Only the ignored devices' signals are dropped, since nothing else
+     in the process wants them either. Anything else may have other
+     subscribers on this shared connection, so duplicate values are
+     left to on_device_properties_changed() */
+  if (g_strcmp0 (iface_name, "org.freedesktop.UPower.Device") ||
+      !g_hash_table_lookup_extended (state->ignored, path, NULL, &rule))
+    return message;
+
+  g_atomic_int_inc (&state->drops[GPOINTER_TO_INT (rule)]);
+  g_object_unref (message);
+  return NULL;
+}
+
+/* hand a copy of the ignore set to the message filter */
+static void
+publish_ignored_paths (IndicatorPowerDeviceProviderUPower * self)
+{
+  priv_t * p = get_priv(self);
+  GHashTable * ignored;
+  GHashTableIter iter;
+  gpointer key;
+  gpointer value;
+
+  ignored = g_hash_table_new (g_str_hash, g_str_equal);
+  g_hash_table_iter_init (&iter, p->ignored_paths);
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    g_hash_table_insert (ignored, key, value);
+
+  /* if the worker never picked up the previous set, it's ours to free */
+  if ((ignored = swap_pointer (&p->filter_state->pending_ignored, ignored)))
+    g_hash_table_destroy (ignored);
+}
+
+static void
+ignore_path (IndicatorPowerDeviceProviderUPower * self,
+             const gchar                        * path,
+             IndicatorPowerUPowerFilterRule       rule)
+{
+  priv_t * p = get_priv(self);
+
+  /* the keys are interned, so the published copies can share them */
+  path = intern_path (path);
+
+  if (g_hash_table_contains (p->ignored_paths, path))
+    return;
+
+  g_hash_table_insert (p->ignored_paths, (gpointer) path, GINT_TO_POINTER (rule));
+
+  publish_ignored_paths (self);
+}
+
 /***
 ****  UPOWER DBUS
 ***/
 
+static void
+free_record (gpointer record)
+{
+  indicator_power_device_record_clear (record);
+  g_slice_free (IndicatorPowerDeviceRecord, record);
+}
+
 struct device_get_all_data
 {
-  char * path;
+  const char * path; /* interned */
   IndicatorPowerDeviceProviderUPower * self;
+  gboolean initial;
 };
 
+static IndicatorPowerDeviceSnapshot *
+create_snapshot (IndicatorPowerDeviceProviderUPower * self)
+{
+  priv_t * p = get_priv(self);
+  IndicatorPowerDeviceSnapshot * snapshot;
+  GHashTableIter iter;
+  gpointer grecord;
+  guint i = 0;
+
+  snapshot = indicator_power_device_snapshot_new (g_hash_table_size (p->devices));
+
+  g_hash_table_iter_init (&iter, p->devices);
+  while (g_hash_table_iter_next (&iter, NULL, &grecord))
+    {
+      const IndicatorPowerDeviceRecord * record = grecord;
+
+      indicator_power_device_record_set (&snapshot->records[i++],
+                                         record->object_path,
+                                         record->kind,
+                                         record->model,
+                                         record->percentage,
+                                         record->state,
+                                         record->time,
+                                         record->power_supply);
+    }
+
+  snapshot->on_battery = p->on_battery;
+
+  return snapshot;
+}
+
+/* main thread: claim the newest snapshot from the ingestion thread */
+static gboolean
+on_snapshot_published (gpointer gself)
+{
+  IndicatorPowerDeviceProviderUPower * self = INDICATOR_POWER_DEVICE_PROVIDER_UPOWER (gself);
+  priv_t * p = get_priv(self);
+  IndicatorPowerDeviceSnapshot * snapshot;
+
+  /* clear the flag first, so that anything published
+     after our swap will queue another idle */
+  g_atomic_int_set (&p->main_idle_pending, 0);
+
+  if ((snapshot = swap_pointer (&p->published, NULL)))
+    {
+      g_clear_pointer (&p->snapshot, indicator_power_device_snapshot_unref);
+      p->snapshot = snapshot;
+
+      indicator_power_device_provider_emit_devices_changed (INDICATOR_POWER_DEVICE_PROVIDER (self));
+    }
+
+  return G_SOURCE_REMOVE;
+}
+
+/* ingestion thread: hand a new snapshot over to the main thread */
+static gboolean
+publish_snapshot (gpointer gself)
+{
+  IndicatorPowerDeviceProviderUPower * self = INDICATOR_POWER_DEVICE_PROVIDER_UPOWER (gself);
+  priv_t * p = get_priv(self);
+  IndicatorPowerDeviceSnapshot * stale;
+
+  g_clear_pointer (&p->publish_source, g_source_unref);
+
+  /* if the main thread hasn't claimed the previous one, it's obsolete */
+  if ((stale = swap_pointer (&p->published, create_snapshot (self))))
+    indicator_power_device_snapshot_unref (stale);
+
+  if (g_atomic_int_compare_and_exchange (&p->main_idle_pending, 0, 1))
+    {
+      GSource * source = g_idle_source_new ();
+      g_source_set_callback (source, on_snapshot_published, g_object_ref (self), g_object_unref);
+      g_source_attach (source, p->main_context);
+      g_source_unref (source);
+    }
+
+  return G_SOURCE_REMOVE;
+}
+
 static void
 emit_devices_changed (IndicatorPowerDeviceProviderUPower * self)
 {
-  indicator_power_device_provider_emit_devices_changed (INDICATOR_POWER_DEVICE_PROVIDER (self));
+  priv_t * p = get_priv(self);
+
+  /* the last of the initial replies will emit it */
+  if (p->initial_fetches > 0)
+    return;
+
+  if (!p->use_thread)
+    {
+      g_clear_pointer (&p->snapshot, indicator_power_device_snapshot_unref);
+
+      indicator_power_device_provider_emit_devices_changed (INDICATOR_POWER_DEVICE_PROVIDER (self));
+    }
+  else if (p->publish_source == NULL)
+    {
+      /* fold a burst of changes into a single snapshot */
+      p->publish_source = g_idle_source_new ();
+      g_source_set_callback (p->publish_source, publish_snapshot, self, NULL);
+      g_source_attach (p->publish_source, p->context);
+    }
+}
+
+/* Returns TRUE if that was the last of the initial replies */
+static gboolean
+finish_initial_fetch (IndicatorPowerDeviceProviderUPower * self)
+{
+  priv_t * p = get_priv(self);
+
+  /* a late reply from before UPower went away */
+  if (p->initial_fetches == 0)
+    return FALSE;
+
+  return --p->initial_fetches == 0;
 }
 
 static void
@@ -101,28 +474,34 @@ on_get_all_response (GObject * o, GAsyncResult * res, gpointer gdata)
   response = g_dbus_connection_call_finish (G_DBUS_CONNECTION(o), res, &error);
   if (error != NULL)
     {
-      if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+      const gboolean cancelled = g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED);
+
+      if (!cancelled)
         g_warning ("Error getting properties for UPower device '%s': %s",
                    data->path, error->message);
 
+      /* a device that failed still counts as answered */
+      if (!cancelled && data->initial && finish_initial_fetch (data->self))
+        emit_devices_changed (data->self);
+
       g_error_free (error);
     }
   else
     {
       guint32 kind = 0;
-      gchar *model;
+      const gchar *model = NULL;
       guint32 state = 0;
       gdouble percentage = 0;
       gint64 time_to_empty = 0;
       gint64 time_to_full = 0;
       gint64 time;
       gboolean power_supply = FALSE;
-      IndicatorPowerDevice * device;
+      IndicatorPowerDeviceRecord * record;
       priv_t * p = get_priv(data->self);
       GVariant * dict = g_variant_get_child_value (response, 0);
 
       g_variant_lookup (dict, "Type", "u", &kind);
-      g_variant_lookup (dict, "Model", "s", &model);
+      g_variant_lookup (dict, "Model", "&s", &model);
       g_variant_lookup (dict, "State", "u", &state);
       g_variant_lookup (dict, "Percentage", "d", &percentage);
       g_variant_lookup (dict, "TimeToEmpty", "x", &time_to_empty);
@@ -130,40 +509,32 @@ on_get_all_response (GObject * o, GAsyncResult * res, gpointer gdata)
       g_variant_lookup (dict, "PowerSupply", "b", &power_supply);
       time = time_to_empty ? time_to_empty : time_to_full;
 
-      if ((device = g_hash_table_lookup (p->devices, data->path)))
+      if ((record = g_hash_table_lookup (p->devices, data->path)) == NULL)
         {
-          g_object_set (device, INDICATOR_POWER_DEVICE_KIND, (gint)kind,
-                                INDICATOR_POWER_DEVICE_MODEL, model,
-                                INDICATOR_POWER_DEVICE_STATE, (gint)state,
-                                INDICATOR_POWER_DEVICE_OBJECT_PATH, data->path,
-                                INDICATOR_POWER_DEVICE_PERCENTAGE, percentage,
-                                INDICATOR_POWER_DEVICE_TIME, time,
-                                INDICATOR_POWER_DEVICE_POWER_SUPPLY, power_supply,
-                                NULL);
-        }
-      else
-        {
-          device = indicator_power_device_new (data->path,
-                                               kind,
-                                               model,
-                                               percentage,
-                                               state,
-                                               (time_t)time,
-                                               power_supply);
+          record = g_slice_new0 (IndicatorPowerDeviceRecord);
 
           g_hash_table_insert (p->devices,
-                               g_strdup (data->path),
-                               g_object_ref (device));
-
-          g_object_unref (device);
+                               (gpointer) data->path,
+                               record);
         }
 
+      indicator_power_device_record_set (record,
+                                         data->path,
+                                         kind,
+                                         model,
+                                         percentage,
+                                         state,
+                                         (time_t)time,
+                                         power_supply);
+
+      if (data->initial)
+        finish_initial_fetch (data->self);
+
       emit_devices_changed (data->self);
       g_variant_unref (dict);
       g_variant_unref (response);
     }
 
-  g_free (data->path);
   g_slice_free (struct device_get_all_data, data);
 }
 
@@ -181,8 +552,12 @@ update_device_from_object_path (IndicatorPowerDeviceProviderUPower * self,
     return;
 
   data = g_slice_new (struct device_get_all_data);
-  data->path = g_strdup (path);
+  data->path = path;
   data->self = self;
+  data->initial = p->fetching_initial;
+
+  if (data->initial)
+    ++p->initial_fetches;
 
   g_dbus_connection_call(p->bus,
                          BUS_NAME,
@@ -226,10 +601,59 @@ on_queued_paths_timer(gpointer gself)
 
   /* cleanup */
   g_hash_table_remove_all (p->queued_paths);
-  p->queued_paths_timer = 0;
+  g_clear_pointer (&p->queued_paths_timer, g_source_unref);
   return G_SOURCE_REMOVE;
 }
 
+static void
+on_device_properties_changed(GDBusConnection * connection,
+                             const gchar     * sender_name,
+                             const gchar     * object_path,
+                             const gchar     * interface_name,
+                             const gchar     * signal_name,
+                             GVariant        * parameters,
+                             gpointer          gself);
+
+/* Listen for PropertiesChanged from this one device.
+   Matching on the path means the bus never wakes us up for
+   the devices we ignore, such as batt_therm or DisplayDevice. */
+static void
+watch_device (IndicatorPowerDeviceProviderUPower * self,
+              const gchar                        * path)
+{
+  priv_t * p = get_priv(self);
+  guint tag;
+
+  if ((p->bus == NULL) || g_hash_table_contains (p->device_subscriptions, path))
+    return;
+
+  tag = g_dbus_connection_signal_subscribe(p->bus,
+                                           p->name_owner,
+                                           "org.freedesktop.DBus.Properties",
+                                           "PropertiesChanged",
+                                           path,
+                                           "org.freedesktop.UPower.Device", /*arg0*/
+                                           G_DBUS_SIGNAL_FLAGS_NONE,
+                                           on_device_properties_changed,
+                                           self,
+                                           NULL);
+  g_hash_table_insert (p->device_subscriptions, (gpointer) path, GUINT_TO_POINTER(tag));
+}
+
+static void
+unwatch_device (IndicatorPowerDeviceProviderUPower * self,
+                const gchar                        * path)
+{
+  priv_t * p = get_priv(self);
+  gpointer tag;
+
+  if (g_hash_table_lookup_extended (p->device_subscriptions, path, NULL, &tag))
+    {
+      g_dbus_connection_signal_unsubscribe (p->bus, GPOINTER_TO_UINT(tag));
+      g_hash_table_remove (p->device_subscriptions, path);
+    }
+}
+
 /* add the path to our queued_paths hashset and ensure the timer's running */
 static void
 refresh_device_soon (IndicatorPowerDeviceProviderUPower * self,
@@ -237,13 +661,64 @@ refresh_device_soon (IndicatorPowerDeviceProviderUPower * self,
 {
   // Android: Ignore batt_therm devices since they give wrong values
   if (g_str_has_suffix(object_path, "batt_therm"))
+    {
+      ignore_path (self, object_path, INDICATOR_POWER_UPOWER_FILTER_BATT_THERM);
+      return;
+    }
+  if (!g_strcmp0(object_path, DISPLAY_DEVICE_PATH))
     return;
   priv_t * p = get_priv(self);
+  const gchar * path = intern_path (object_path);
+
+  watch_device (self, path);
+
+  g_hash_table_add (p->queued_paths, (gpointer) path);
+
+  if (p->queued_paths_timer == NULL)
+    {
+      p->queued_paths_timer = g_timeout_source_new (500);
+      g_source_set_callback (p->queued_paths_timer, on_queued_paths_timer, self, NULL);
+      g_source_attach (p->queued_paths_timer, p->context);
+    }
+}
+
+/* like on_queued_paths_timer(), but held back as one update */
+static gboolean
+on_refresh_all_idle (gpointer gself)
+{
+  priv_t * p = get_priv(INDICATOR_POWER_DEVICE_PROVIDER_UPOWER(gself));
+
+  p->fetching_initial = TRUE;
+  on_queued_paths_timer (gself);
+  p->fetching_initial = FALSE;
+
+  return G_SOURCE_REMOVE;
+}
+
+/* Queue every known device and refresh them all right away,
+   ahead of the usual coalescing and of anything else that's pending.
+   This is for when we know everything is stale, e.g. after a resume. */
+static void
+refresh_all_devices_now (IndicatorPowerDeviceProviderUPower * self)
+{
+  priv_t * p = get_priv(self);
+  GHashTableIter iter;
+  gpointer path;
 
-  g_hash_table_add (p->queued_paths, g_strdup (object_path));
+  g_hash_table_iter_init (&iter, p->devices);
+  while (g_hash_table_iter_next (&iter, &path, NULL))
+    g_hash_table_add (p->queued_paths, path);
 
-  if (p->queued_paths_timer == 0)
-    p->queued_paths_timer = g_timeout_add (500, on_queued_paths_timer, self);
+  if (p->queued_paths_timer != NULL)
+    {
+      g_source_destroy (p->queued_paths_timer);
+      g_source_unref (p->queued_paths_timer);
+    }
+
+  p->queued_paths_timer = g_idle_source_new ();
+  g_source_set_priority (p->queued_paths_timer, G_PRIORITY_HIGH);
+  g_source_set_callback (p->queued_paths_timer, on_refresh_all_idle, self, NULL);
+  g_source_attach (p->queued_paths_timer, p->context);
 }
 
 /***
@@ -263,7 +738,15 @@ on_enumerate_devices_response(GObject       * bus,
   if (v == NULL)
     {
       if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
-        g_warning ("Unable to enumerate UPower devices: %s", error->message);
+        {
+          IndicatorPowerDeviceProviderUPower * self = INDICATOR_POWER_DEVICE_PROVIDER_UPOWER(gself);
+
+          g_warning ("Unable to enumerate UPower devices: %s", error->message);
+
+          /* a failed enumeration still counts as answered */
+          if (finish_initial_fetch (self))
+            emit_devices_changed (self);
+        }
       g_error_free (error);
     }
   else if (g_variant_is_of_type(v, G_VARIANT_TYPE("(ao)")))
@@ -271,17 +754,34 @@ on_enumerate_devices_response(GObject       * bus,
       GVariant * ao;
       GVariantIter iter;
       const gchar * path;
+      IndicatorPowerDeviceProviderUPower * self = INDICATOR_POWER_DEVICE_PROVIDER_UPOWER(gself);
+      priv_t * p = get_priv(self);
 
       ao = g_variant_get_child_value(v, 0);
       g_variant_iter_init(&iter, ao);
       path = NULL;
-      while(g_variant_iter_loop(&iter, "o", &path)) {
-        // Android: Ignore batt_therm devices since they give wrong values
-        if (!g_str_has_suffix(path, "batt_therm"))
-          refresh_device_soon (gself, path);
-      }
+      while(g_variant_iter_loop(&iter, "o", &path))
+        refresh_device_soon (self, path);
 
       g_variant_unref(ao);
+
+      /* This is on the critical path to the first header, and it isn't
+         a burst of changes, so don't wait for the coalescing timer.
+         The GetAll() calls all go out at once and answer in parallel. */
+      if (p->queued_paths_timer != NULL)
+        {
+          g_source_destroy (p->queued_paths_timer);
+          g_clear_pointer (&p->queued_paths_timer, g_source_unref);
+        }
+
+      p->fetching_initial = TRUE;
+      on_queued_paths_timer (self);
+      p->fetching_initial = FALSE;
+
+      /* the enumeration was an initial fetch too; with
+         no devices at all, this may have been the last one */
+      if (finish_initial_fetch (self))
+        emit_devices_changed (self);
     }
 
   g_clear_pointer(&v, g_variant_unref);
@@ -296,18 +796,17 @@ on_device_properties_changed(GDBusConnection * connection     G_GNUC_UNUSED,
                              GVariant        * parameters,
                              gpointer          gself)
 {
-  // Android: Ignore batt_therm devices since they give wrong values
-  if (g_str_has_suffix(object_path, "batt_therm"))
-    return;
   IndicatorPowerDeviceProviderUPower* self;
   priv_t* p;
-  IndicatorPowerDevice* device;
+  const gchar* path;
+  IndicatorPowerDeviceRecord* record;
 
   self = INDICATOR_POWER_DEVICE_PROVIDER_UPOWER(gself);
   p = get_priv(self);
 
-  device = g_hash_table_lookup(p->devices, object_path);
-  if (device == NULL) /* unlikely, but let's handle it */
+  path = lookup_path(object_path);
+  record = path ? g_hash_table_lookup(p->devices, path) : NULL;
+  if (record == NULL) /* unlikely, but let's handle it */
     {
       refresh_device_soon (self, object_path);
     }
@@ -326,51 +825,58 @@ on_device_properties_changed(GDBusConnection * connection     G_GNUC_UNUSED,
           if (!g_strcmp0(key, "TimeToFull") || !g_strcmp0(key, "TimeToEmpty"))
             {
               const gint64 i = g_variant_get_int64(value);
-              if (i != 0)
+              if ((i != 0) && (record->time != (time_t)i))
                 {
-                  g_object_set(device,
-                               INDICATOR_POWER_DEVICE_TIME, (guint64)i,
-                               NULL);
+                  record->time = (time_t)i;
                   changed = TRUE;
                 }
             }
           else if (!g_strcmp0(key, "Percentage"))
             {
               const gdouble d = g_variant_get_double(value);
-              g_object_set(device,
-                           INDICATOR_POWER_DEVICE_PERCENTAGE, d,
-                           NULL);
-              changed = TRUE;
+              if (record->percentage != d)
+                {
+                  record->percentage = d;
+                  changed = TRUE;
+                }
             }
           else if (!g_strcmp0(key, "Type"))
             {
-              const guint32 u = g_variant_get_uint32(value);
-              g_object_set(device,
-                           INDICATOR_POWER_DEVICE_KIND, (gint)u,
-                           NULL);
-              changed = TRUE;
+              const UpDeviceKind kind = (UpDeviceKind)g_variant_get_uint32(value);
+              if (record->kind != kind)
+                {
+                  record->kind = kind;
+                  changed = TRUE;
+                }
             }
           else if (!g_strcmp0(key, "Model"))
             {
-              const gchar *s = g_variant_get_string(value, NULL);
-              g_object_set(device,
-                           INDICATOR_POWER_DEVICE_MODEL, s,
-                           NULL);
-              changed = TRUE;
+              if (g_strcmp0(record->model, g_variant_get_string(value, NULL)))
+                {
+                  g_free(record->model);
+                  record->model = g_variant_dup_string(value, NULL);
+                  changed = TRUE;
+                }
             }
           else if (!g_strcmp0(key, "State"))
             {
-              const guint32 u = g_variant_get_uint32(value);
-              g_object_set(device,
-                           INDICATOR_POWER_DEVICE_STATE, (gint)u,
-                           NULL);
-              changed = TRUE;
+              const UpDeviceState state = (UpDeviceState)g_variant_get_uint32(value);
+              if (record->state != state)
+                {
+                  record->state = state;
+                  changed = TRUE;
+                }
             }
+
+          g_free(key);
+          g_variant_unref(value);
         }
       g_variant_unref(dict);
 
       if (changed)
         emit_devices_changed(self);
+      else
+        g_atomic_int_inc(&p->filter_state->drops[INDICATOR_POWER_UPOWER_FILTER_DUPLICATE]);
     }
 }
 
@@ -414,9 +920,13 @@ on_upower_signal(GDBusConnection * connection     G_GNUC_UNUSED,
     }
   else if (!g_strcmp0(signal_name, "DeviceRemoved"))
     {
-      const char* device_path = get_path_from_nth_child(parameters, 0);
-      g_hash_table_remove(p->devices, device_path);
-      g_hash_table_remove(p->queued_paths, device_path);
+      const char* device_path = lookup_path(get_path_from_nth_child(parameters, 0));
+      if (device_path != NULL)
+        {
+          unwatch_device(self, device_path);
+          g_hash_table_remove(p->devices, device_path);
+          g_hash_table_remove(p->queued_paths, device_path);
+        }
       emit_devices_changed(self);
     }
   else if (!g_strcmp0(signal_name, "DeviceChanged")) /* UPower < 0.99 */
@@ -425,12 +935,105 @@ on_upower_signal(GDBusConnection * connection     G_GNUC_UNUSED,
     }
   else if (!g_strcmp0(signal_name, "Resuming")) /* UPower < 0.99 */
     {
-      GHashTableIter iter;
-      gpointer device_path = NULL;
-      g_debug("Resumed from hibernate/sleep; queueing all devices for a refresh");
-      g_hash_table_iter_init (&iter, p->devices);
-      while (g_hash_table_iter_next (&iter, &device_path, NULL))
-        refresh_device_soon (self, device_path);
+      g_debug("Resumed from hibernate/sleep; refreshing all devices");
+      refresh_all_devices_now (self);
+    }
+}
+
+/* UPower >= 0.99 has no Resuming signal, so ask logind instead */
+static void
+on_prepare_for_sleep(GDBusConnection * connection     G_GNUC_UNUSED,
+                     const gchar     * sender_name    G_GNUC_UNUSED,
+                     const gchar     * object_path    G_GNUC_UNUSED,
+                     const gchar     * interface_name G_GNUC_UNUSED,
+                     const gchar     * signal_name    G_GNUC_UNUSED,
+                     GVariant        * parameters,
+                     gpointer          gself)
+{
+  gboolean going_to_sleep = TRUE;
+
+  if ((parameters != NULL) && g_variant_is_of_type(parameters, G_VARIANT_TYPE("(b)")))
+    g_variant_get(parameters, "(b)", &going_to_sleep);
+
+  if (!going_to_sleep)
+    {
+      g_debug("logind says we've resumed; refreshing all devices");
+      refresh_all_devices_now (INDICATOR_POWER_DEVICE_PROVIDER_UPOWER(gself));
+    }
+}
+
+static void
+set_on_battery (IndicatorPowerDeviceProviderUPower * self,
+                gboolean                             on_battery)
+{
+  priv_t * p = get_priv(self);
+
+  if (!p->on_battery == !on_battery)
+    return;
+
+  p->on_battery = on_battery;
+  emit_devices_changed (self);
+}
+
+static void
+on_manager_properties_changed(GDBusConnection * connection     G_GNUC_UNUSED,
+                              const gchar     * sender_name    G_GNUC_UNUSED,
+                              const gchar     * object_path    G_GNUC_UNUSED,
+                              const gchar     * interface_name G_GNUC_UNUSED,
+                              const gchar     * signal_name    G_GNUC_UNUSED,
+                              GVariant        * parameters,
+                              gpointer          gself)
+{
+  GVariant * dict;
+  gboolean on_battery;
+
+  if ((parameters == NULL) || !g_variant_is_of_type(parameters, G_VARIANT_TYPE("(sa{sv}as)")))
+    return;
+
+  dict = g_variant_get_child_value(parameters, 1);
+  if (g_variant_lookup(dict, "OnBattery", "b", &on_battery))
+    set_on_battery (INDICATOR_POWER_DEVICE_PROVIDER_UPOWER(gself), on_battery);
+  g_variant_unref(dict);
+}
+
+static void
+on_get_on_battery_response(GObject       * bus,
+                           GAsyncResult  * res,
+                           gpointer        gself)
+{
+  GError* error;
+  GVariant* v;
+
+  error = NULL;
+  v = g_dbus_connection_call_finish(G_DBUS_CONNECTION(bus), res, &error);
+  if (v == NULL)
+    {
+      if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        {
+          IndicatorPowerDeviceProviderUPower * self = INDICATOR_POWER_DEVICE_PROVIDER_UPOWER(gself);
+
+          g_warning ("Unable to get UPower's OnBattery property: %s", error->message);
+
+          if (finish_initial_fetch (self))
+            emit_devices_changed (self);
+        }
+      g_error_free (error);
+    }
+  else
+    {
+      IndicatorPowerDeviceProviderUPower * self = INDICATOR_POWER_DEVICE_PROVIDER_UPOWER(gself);
+      priv_t * p = get_priv(self);
+      GVariant * value;
+
+      g_variant_get(v, "(v)", &value);
+      if (g_variant_is_of_type(value, G_VARIANT_TYPE_BOOLEAN))
+        p->on_battery = g_variant_get_boolean(value);
+      g_variant_unref(value);
+
+      if (finish_initial_fetch (self))
+        emit_devices_changed (self);
+
+      g_variant_unref(v);
     }
 }
 
@@ -448,6 +1051,7 @@ on_bus_name_appeared(GDBusConnection * bus,
   self = INDICATOR_POWER_DEVICE_PROVIDER_UPOWER(gself);
   p = get_priv(self);
   p->bus = G_DBUS_CONNECTION(g_object_ref(bus));
+  p->name_owner = g_strdup(name_owner);
 
   /* listen for signals from the boss */
   tag = g_dbus_connection_signal_subscribe(p->bus,
@@ -462,20 +1066,58 @@ on_bus_name_appeared(GDBusConnection * bus,
                                            NULL);
   p->subscriptions = g_slist_prepend(p->subscriptions, GUINT_TO_POINTER(tag));
 
-  /* listen for change events from the devices */
+  /* and for changes to its own properties, i.e. OnBattery */
   tag = g_dbus_connection_signal_subscribe(p->bus,
                                            name_owner,
                                            "org.freedesktop.DBus.Properties",
                                            "PropertiesChanged",
-                                           NULL /*object_path*/,
-                                           "org.freedesktop.UPower.Device", /*arg0*/
-                                           G_DBUS_SIGNAL_FLAGS_MATCH_ARG0_NAMESPACE,
-                                           on_device_properties_changed,
+                                           MGR_PATH,
+                                           MGR_IFACE /*arg0*/,
+                                           G_DBUS_SIGNAL_FLAGS_NONE,
+                                           on_manager_properties_changed,
+                                           self,
+                                           NULL);
+  p->subscriptions = g_slist_prepend(p->subscriptions, GUINT_TO_POINTER(tag));
+
+  /* refresh everything as soon as we wake up */
+  tag = g_dbus_connection_signal_subscribe(p->bus,
+                                           LOGIND_BUS_NAME,
+                                           LOGIND_IFACE,
+                                           "PrepareForSleep",
+                                           LOGIND_PATH,
+                                           NULL /*arg0*/,
+                                           G_DBUS_SIGNAL_FLAGS_NONE,
+                                           on_prepare_for_sleep,
                                            self,
                                            NULL);
   p->subscriptions = g_slist_prepend(p->subscriptions, GUINT_TO_POINTER(tag));
 
+  /* the devices' PropertiesChanged signals are subscribed to
+     one path at a time as we learn about them; see watch_device() */
+
+  /* drop ignored devices' signals before they reach the main loop */
+  p->filter_id = g_dbus_connection_add_filter(p->bus,
+                                              upower_message_filter,
+                                              filter_state_ref(p->filter_state),
+                                              filter_state_unref);
+
+  /* find out where our power's coming from */
+  ++p->initial_fetches;
+  g_dbus_connection_call(p->bus,
+                         BUS_NAME,
+                         MGR_PATH,
+                         "org.freedesktop.DBus.Properties",
+                         "Get",
+                         g_variant_new ("(ss)", MGR_IFACE, "OnBattery"),
+                         G_VARIANT_TYPE("(v)"),
+                         G_DBUS_CALL_FLAGS_NO_AUTO_START,
+                         -1, /* default timeout */
+                         p->cancellable,
+                         on_get_on_battery_response,
+                         self);
+
   /* rebuild our devices list */
+  ++p->initial_fetches;
   g_dbus_connection_call(p->bus,
                          BUS_NAME,
                          MGR_PATH,
@@ -498,26 +1140,52 @@ on_bus_name_vanished(GDBusConnection * connection G_GNUC_UNUSED,
   IndicatorPowerDeviceProviderUPower * self;
   priv_t * p;
   GSList * l;
+  GHashTableIter iter;
+  gpointer tag;
 
   self = INDICATOR_POWER_DEVICE_PROVIDER_UPOWER(gself);
   p = get_priv(self);
 
+  /* drop the replies still on their way from the old owner, so they
+     don't bring back its devices or count toward a new owner's
+     first enumeration. (When we're shutting down, there's nothing
+     left to replace it with.) */
+  if (p->cancellable != NULL)
+    {
+      g_cancellable_cancel(p->cancellable);
+      g_object_unref(p->cancellable);
+      p->cancellable = g_cancellable_new();
+    }
+
   /* clear the devices */
   g_hash_table_remove_all(p->devices);
   g_hash_table_remove_all(p->queued_paths);
-  if (p->queued_paths_timer != 0)
+  p->initial_fetches = 0;
+  p->on_battery = FALSE;
+  if (p->queued_paths_timer != NULL)
     {
-      g_source_remove(p->queued_paths_timer);
-      p->queued_paths_timer = 0;
+      g_source_destroy(p->queued_paths_timer);
+      g_clear_pointer(&p->queued_paths_timer, g_source_unref);
     }
   emit_devices_changed (self);
 
   /* clear the bus subscriptions */
+  if (p->filter_id != 0)
+    {
+      g_dbus_connection_remove_filter(p->bus, p->filter_id);
+      p->filter_id = 0;
+    }
   for (l=p->subscriptions; l!=NULL; l=l->next)
     g_dbus_connection_signal_unsubscribe(p->bus, GPOINTER_TO_UINT(l->data));
   g_slist_free(p->subscriptions);
   p->subscriptions = NULL;
 
+  g_hash_table_iter_init(&iter, p->device_subscriptions);
+  while (g_hash_table_iter_next(&iter, NULL, &tag))
+    g_dbus_connection_signal_unsubscribe(p->bus, GPOINTER_TO_UINT(tag));
+  g_hash_table_remove_all(p->device_subscriptions);
+  g_clear_pointer(&p->name_owner, g_free);
+
   /* clear the bus */
   g_clear_object(&p->bus);
 }
@@ -526,33 +1194,47 @@ on_bus_name_vanished(GDBusConnection * connection G_GNUC_UNUSED,
 ****  IndicatorPowerDeviceProvider virtual functions
 ***/
 
-static GList *
-my_get_devices(IndicatorPowerDeviceProvider * provider)
+static IndicatorPowerDeviceSnapshot *
+my_get_snapshot(IndicatorPowerDeviceProvider * provider)
 {
   IndicatorPowerDeviceProviderUPower * self;
   priv_t * p;
-  GList * devices;
 
   self = INDICATOR_POWER_DEVICE_PROVIDER_UPOWER(provider);
   p = get_priv(self);
 
-  devices = g_hash_table_get_values (p->devices);
-  g_list_foreach (devices, (GFunc)g_object_ref, NULL);
-  return devices;
+  /* build the snapshot lazily and share it until the next change.
+     With the ingestion thread, 'devices' isn't ours to read;
+     we only have what the thread has published so far. */
+  if (p->snapshot == NULL)
+    p->snapshot = p->use_thread ? indicator_power_device_snapshot_new (0)
+                                : create_snapshot (self);
+
+  return indicator_power_device_snapshot_ref (p->snapshot);
 }
 
 /***
-****  GObject virtual functions
+****  Watching UPower
 ***/
 
 static void
-my_dispose (GObject * o)
+start_watching (IndicatorPowerDeviceProviderUPower * self)
 {
-  IndicatorPowerDeviceProviderUPower * self;
-  priv_t * p;
+  priv_t * p = get_priv(self);
 
-  self = INDICATOR_POWER_DEVICE_PROVIDER_UPOWER(o);
-  p = get_priv(self);
+  p->name_tag = g_bus_watch_name(G_BUS_TYPE_SYSTEM,
+                                 BUS_NAME,
+                                 G_BUS_NAME_WATCHER_FLAGS_NONE,
+                                 on_bus_name_appeared,
+                                 on_bus_name_vanished,
+                                 self,
+                                 NULL);
+}
+
+static void
+stop_watching (IndicatorPowerDeviceProviderUPower * self)
+{
+  priv_t * p = get_priv(self);
 
   if (p->cancellable != NULL)
     {
@@ -561,11 +1243,11 @@ my_dispose (GObject * o)
       g_clear_object (&p->cancellable);
     }
 
-  if (p->queued_paths_timer != 0)
+  if (p->queued_paths_timer != NULL)
     {
-      g_source_remove (p->queued_paths_timer);
+      g_source_destroy (p->queued_paths_timer);
 
-      p->queued_paths_timer = 0;
+      g_clear_pointer (&p->queued_paths_timer, g_source_unref);
     }
 
   if (p->name_tag != 0)
@@ -576,6 +1258,148 @@ my_dispose (GObject * o)
       p->name_tag = 0;
     }
 
+  if (p->publish_source != NULL)
+    {
+      g_source_destroy (p->publish_source);
+
+      g_clear_pointer (&p->publish_source, g_source_unref);
+    }
+}
+
+static gboolean
+quit_ingestion_loop (gpointer gloop)
+{
+  g_main_loop_quit (gloop);
+  return G_SOURCE_REMOVE;
+}
+
+static gpointer
+ingestion_thread_func (gpointer gself)
+{
+  IndicatorPowerDeviceProviderUPower * self = INDICATOR_POWER_DEVICE_PROVIDER_UPOWER (gself);
+  priv_t * p = get_priv(self);
+
+  /* our bus subscriptions and calls will all dispatch in p->context */
+  g_main_context_push_thread_default (p->context);
+
+  start_watching (self);
+  g_main_loop_run (p->loop);
+  stop_watching (self);
+
+  /* let the cancelled calls finish up */
+  while (g_main_context_pending (p->context))
+    g_main_context_iteration (p->context, FALSE);
+
+  g_main_context_pop_thread_default (p->context);
+  return NULL;
+}
+
+/***
+****  GObject virtual functions
+***/
+
+static void
+my_get_property (GObject     * o,
+                 guint         property_id,
+                 GValue      * value,
+                 GParamSpec  * pspec)
+{
+  priv_t * p = get_priv(INDICATOR_POWER_DEVICE_PROVIDER_UPOWER(o));
+
+  switch (property_id)
+    {
+      case PROP_INGESTION_THREAD:
+        g_value_set_boolean (value, p->use_thread);
+        break;
+
+      default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID (o, property_id, pspec);
+    }
+}
+
+static void
+my_set_property (GObject       * o,
+                 guint           property_id,
+                 const GValue  * value,
+                 GParamSpec    * pspec)
+{
+  priv_t * p = get_priv(INDICATOR_POWER_DEVICE_PROVIDER_UPOWER(o));
+
+  switch (property_id)
+    {
+      case PROP_INGESTION_THREAD:
+        p->use_thread = g_value_get_boolean (value);
+        break;
+
+      default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID (o, property_id, pspec);
+    }
+}
+
+static void
+my_constructed (GObject * o)
+{
+  IndicatorPowerDeviceProviderUPower * self;
+  priv_t * p;
+
+  self = INDICATOR_POWER_DEVICE_PROVIDER_UPOWER(o);
+  p = get_priv(self);
+
+  if (p->use_thread)
+    {
+      p->context = g_main_context_new ();
+      p->loop = g_main_loop_new (p->context, FALSE);
+      p->thread = g_thread_new ("upower-ingestion", ingestion_thread_func, self);
+    }
+  else
+    {
+      start_watching (self);
+    }
+
+  G_OBJECT_CLASS (indicator_power_device_provider_upower_parent_class)->constructed (o);
+}
+
+static void
+my_dispose (GObject * o)
+{
+  IndicatorPowerDeviceProviderUPower * self;
+  priv_t * p;
+
+  self = INDICATOR_POWER_DEVICE_PROVIDER_UPOWER(o);
+  p = get_priv(self);
+
+  if (p->thread != NULL)
+    {
+      GSource * source;
+
+      /* Quit from inside the thread. Quitting from here would be lost
+         if the thread hasn't reached g_main_loop_run() yet, and
+         g_main_context_invoke() would run it here in that case too */
+      source = g_idle_source_new ();
+      g_source_set_priority (source, G_PRIORITY_HIGH);
+      g_source_set_callback (source, quit_ingestion_loop, p->loop, NULL);
+      g_source_attach (source, p->context);
+      g_source_unref (source);
+
+      g_thread_join (p->thread);
+
+      p->thread = NULL;
+    }
+  else
+    {
+      stop_watching (self);
+    }
+
+  if (p->filter_state != NULL)
+    {
+      g_debug("UPower provider dropped %u batt_therm, %u DisplayDevice, %u duplicate signals",
+              indicator_power_device_provider_upower_get_filter_drops(self, INDICATOR_POWER_UPOWER_FILTER_BATT_THERM),
+              indicator_power_device_provider_upower_get_filter_drops(self, INDICATOR_POWER_UPOWER_FILTER_DISPLAY_DEVICE),
+              indicator_power_device_provider_upower_get_filter_drops(self, INDICATOR_POWER_UPOWER_FILTER_DUPLICATE));
+
+      g_clear_pointer(&p->filter_state, filter_state_unref);
+    }
+
   G_OBJECT_CLASS (indicator_power_device_provider_upower_parent_class)->dispose(o);
 }
 
@@ -590,6 +1414,13 @@ my_finalize (GObject * o)
 
   g_hash_table_destroy (p->devices);
   g_hash_table_destroy (p->queued_paths);
+  g_hash_table_destroy (p->device_subscriptions);
+  g_hash_table_destroy (p->ignored_paths);
+  g_clear_pointer (&p->snapshot, indicator_power_device_snapshot_unref);
+  g_clear_pointer (&p->published, indicator_power_device_snapshot_unref);
+  g_clear_pointer (&p->loop, g_main_loop_unref);
+  g_clear_pointer (&p->context, g_main_context_unref);
+  g_clear_pointer (&p->main_context, g_main_context_unref);
 
   G_OBJECT_CLASS (indicator_power_device_provider_upower_parent_class)->finalize (o);
 }
@@ -605,12 +1436,24 @@ indicator_power_device_provider_upower_class_init (IndicatorPowerDeviceProviderU
 
   object_class->dispose = my_dispose;
   object_class->finalize = my_finalize;
+  object_class->constructed = my_constructed;
+  object_class->get_property = my_get_property;
+  object_class->set_property = my_set_property;
+
+  properties[PROP_INGESTION_THREAD] = g_param_spec_boolean (
+    INDICATOR_POWER_DEVICE_PROVIDER_UPOWER_INGESTION_THREAD,
+    "Ingestion thread",
+    "Whether to talk to UPower from a worker thread",
+    FALSE,
+    G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS);
+
+  g_object_class_install_properties (object_class, LAST_PROP, properties);
 }
 
 static void
 indicator_power_device_provider_interface_init (IndicatorPowerDeviceProviderInterface * iface)
 {
-  iface->get_devices = my_get_devices;
+  iface->get_snapshot = my_get_snapshot;
 }
 
 static void
@@ -620,23 +1463,25 @@ indicator_power_device_provider_upower_init (IndicatorPowerDeviceProviderUPower
 
   p->cancellable = g_cancellable_new();
 
-  p->devices = g_hash_table_new_full(g_str_hash,
-                                     g_str_equal,
-                                     g_free,
-                                     g_object_unref);
+  /* keys are interned paths, so compare them by pointer */
+  p->devices = g_hash_table_new_full(g_direct_hash,
+                                     g_direct_equal,
+                                     NULL,
+                                     free_record);
 
-  p->queued_paths = g_hash_table_new_full(g_str_hash,
-                                          g_str_equal,
-                                          g_free,
-                                          NULL);
+  p->queued_paths = g_hash_table_new(g_direct_hash,
+                                     g_direct_equal);
 
-  p->name_tag = g_bus_watch_name(G_BUS_TYPE_SYSTEM,
-                                 BUS_NAME,
-                                 G_BUS_NAME_WATCHER_FLAGS_NONE,
-                                 on_bus_name_appeared,
-                                 on_bus_name_vanished,
-                                 self,
-                                 NULL);
+  p->device_subscriptions = g_hash_table_new(g_direct_hash,
+                                             g_direct_equal);
+
+  p->ignored_paths = g_hash_table_new(g_direct_hash,
+                                      g_direct_equal);
+
+  p->filter_state = filter_state_new();
+  ignore_path(self, DISPLAY_DEVICE_PATH, INDICATOR_POWER_UPOWER_FILTER_DISPLAY_DEVICE);
+
+  p->main_context = g_main_context_ref_thread_default();
 }
 
 /***
@@ -650,3 +1495,37 @@ indicator_power_device_provider_upower_new(void)
 
   return INDICATOR_POWER_DEVICE_PROVIDER (o);
 }
+
+/**
+ * Like indicator_power_device_provider_upower_new(), but UPower's
+ * replies and signals are parsed in a worker thread, and the main
+ * thread only sees the finished snapshots.
+ */
+IndicatorPowerDeviceProvider *
+indicator_power_device_provider_upower_new_threaded(void)
+{
+  gpointer o = g_object_new (INDICATOR_TYPE_POWER_DEVICE_PROVIDER_UPOWER,
+                             INDICATOR_POWER_DEVICE_PROVIDER_UPOWER_INGESTION_THREAD, TRUE,
+                             NULL);
+
+  return INDICATOR_POWER_DEVICE_PROVIDER (o);
+}
+
+/**
+ * How many UPower signals have been dropped under @rule.
+ */
+guint
+indicator_power_device_provider_upower_get_filter_drops (IndicatorPowerDeviceProviderUPower * self,
+                                                         IndicatorPowerUPowerFilterRule       rule)
+{
+  priv_t * p;
+
+  g_return_val_if_fail (INDICATOR_IS_POWER_DEVICE_PROVIDER_UPOWER(self), 0);
+  g_return_val_if_fail (rule < INDICATOR_POWER_UPOWER_FILTER_N_RULES, 0);
+  p = get_priv(self);
+
+  if (p->filter_state == NULL)
+    return 0;
+
+  return (guint) g_atomic_int_get (&p->filter_state->drops[rule]);
+}
@@ -43,6 +43,9 @@ G_BEGIN_DECLS
   (G_TYPE_CHECK_INSTANCE_TYPE ((o), \
                                INDICATOR_TYPE_POWER_DEVICE_PROVIDER_UPOWER))
 
+/* Properties */
+#define INDICATOR_POWER_DEVICE_PROVIDER_UPOWER_INGESTION_THREAD "ingestion-thread"
+
 typedef struct _IndicatorPowerDeviceProviderUPower
                 IndicatorPowerDeviceProviderUPower;
 typedef struct _IndicatorPowerDeviceProviderUPowerClass
@@ -61,10 +64,32 @@ struct _IndicatorPowerDeviceProviderUPowerClass
   GObjectClass parent_class;
 };
 
+/**
+ * The rules by which the UPower provider drops PropertiesChanged signals.
+ *
+ * The ignored devices' signals are dropped by a message filter before
+ * they reach the main loop. Duplicates are skipped by the signal
+ * handler instead, since other users of the shared connection may
+ * still want them.
+ */
+typedef enum
+{
+  INDICATOR_POWER_UPOWER_FILTER_BATT_THERM,     /* Android thermal sensors */
+  INDICATOR_POWER_UPOWER_FILTER_DISPLAY_DEVICE, /* UPower's composite device */
+  INDICATOR_POWER_UPOWER_FILTER_DUPLICATE,      /* none of the values we use changed */
+  INDICATOR_POWER_UPOWER_FILTER_N_RULES
+}
+IndicatorPowerUPowerFilterRule;
+
 GType indicator_power_device_provider_upower_get_type (void);
 
 IndicatorPowerDeviceProvider * indicator_power_device_provider_upower_new (void);
 
+IndicatorPowerDeviceProvider * indicator_power_device_provider_upower_new_threaded (void);
+
+guint indicator_power_device_provider_upower_get_filter_drops (IndicatorPowerDeviceProviderUPower * self,
+                                                               IndicatorPowerUPowerFilterRule       rule);
+
 G_END_DECLS
 
 #endif /* __INDICATOR_POWER_DEVICE_PROVIDER_UPOWER__H__ */
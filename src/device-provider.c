@@ -69,13 +69,55 @@ indicator_power_device_provider_get_devices (IndicatorPowerDeviceProvider * self
   iface = INDICATOR_POWER_DEVICE_PROVIDER_GET_INTERFACE (self);
 
   if (iface->get_devices != NULL)
-    devices = iface->get_devices (self);
+    {
+      devices = iface->get_devices (self);
+    }
+  else if (iface->get_snapshot != NULL)
+    {
+      IndicatorPowerDeviceSnapshot * snapshot = iface->get_snapshot (self);
+      devices = indicator_power_device_snapshot_get_devices (snapshot);
+      indicator_power_device_snapshot_unref (snapshot);
+    }
   else
-    devices = NULL;
+    {
+      devices = NULL;
+    }
 
   return devices;
 }
 
+/**
+ * Get an immutable snapshot of the devices.
+ *
+ * Providers that don't implement get_snapshot() natively
+ * get one built from their get_devices() list.
+ *
+ * Return value: (transfer full): the current device snapshot.
+ *               Release with indicator_power_device_snapshot_unref().
+ */
+IndicatorPowerDeviceSnapshot *
+indicator_power_device_provider_get_snapshot (IndicatorPowerDeviceProvider * self)
+{
+  IndicatorPowerDeviceSnapshot * snapshot;
+  IndicatorPowerDeviceProviderInterface * iface;
+
+  g_return_val_if_fail (INDICATOR_IS_POWER_DEVICE_PROVIDER (self), NULL);
+  iface = INDICATOR_POWER_DEVICE_PROVIDER_GET_INTERFACE (self);
+
+  if (iface->get_snapshot != NULL)
+    {
+      snapshot = iface->get_snapshot (self);
+    }
+  else
+    {
+      GList * devices = indicator_power_device_provider_get_devices (self);
+      snapshot = indicator_power_device_snapshot_new_from_devices (devices);
+      g_list_free_full (devices, g_object_unref);
+    }
+
+  return snapshot;
+}
+
 /**
  * Emits the "devices-changed" signal.
  *
@@ -22,6 +22,8 @@
 
 #include <glib-object.h>
 
+#include "device-snapshot.h"
+
 G_BEGIN_DECLS
 
 #define INDICATOR_TYPE_POWER_DEVICE_PROVIDER \
@@ -63,6 +65,7 @@ struct _IndicatorPowerDeviceProviderInterface
 
   /* virtual functions */
   GList* (*get_devices) (IndicatorPowerDeviceProvider * self);
+  IndicatorPowerDeviceSnapshot* (*get_snapshot) (IndicatorPowerDeviceProvider * self);
 };
 
 GType indicator_power_device_provider_get_type (void);
@@ -73,6 +76,8 @@ GType indicator_power_device_provider_get_type (void);
 
 GList * indicator_power_device_provider_get_devices          (IndicatorPowerDeviceProvider * self);
 
+IndicatorPowerDeviceSnapshot * indicator_power_device_provider_get_snapshot (IndicatorPowerDeviceProvider * self);
+
 void    indicator_power_device_provider_emit_devices_changed (IndicatorPowerDeviceProvider * self);
 
 G_END_DECLS
@@ -0,0 +1,307 @@
+/*
+ * Copyright 2026 The Ayatana Indicators project
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "device.h"
+#include "device-snapshot.h"
+
+/***
+****  Snapshots
+***/
+
+/**
+ * Create a snapshot with room for @n_records zero-filled records.
+ *
+ * Return value: (transfer full): a new snapshot.
+ *               Release with indicator_power_device_snapshot_unref().
+ */
+IndicatorPowerDeviceSnapshot *
+indicator_power_device_snapshot_new (guint n_records)
+{
+  IndicatorPowerDeviceSnapshot * snapshot;
+
+  /* one allocation: the header, immediately followed by the records */
+  snapshot = g_malloc0 (sizeof (IndicatorPowerDeviceSnapshot) +
+                        n_records * sizeof (IndicatorPowerDeviceRecord));
+  snapshot->ref_count = 1;
+  snapshot->n_records = n_records;
+  snapshot->records = (IndicatorPowerDeviceRecord*) (snapshot + 1);
+
+  return snapshot;
+}
+
+/**
+ * Convenience wrapper to build a snapshot from a list of devices.
+ * The records are in the same order as @devices.
+ */
+IndicatorPowerDeviceSnapshot *
+indicator_power_device_snapshot_new_from_devices (GList * devices)
+{
+  IndicatorPowerDeviceSnapshot * snapshot;
+  GList * l;
+  guint i;
+
+  snapshot = indicator_power_device_snapshot_new (g_list_length (devices));
+
+  for (l=devices, i=0; l!=NULL; l=l->next, ++i)
+    indicator_power_device_record_from_device (&snapshot->records[i], l->data);
+
+  return snapshot;
+}
+
+IndicatorPowerDeviceSnapshot *
+indicator_power_device_snapshot_ref (IndicatorPowerDeviceSnapshot * snapshot)
+{
+  g_return_val_if_fail (snapshot != NULL, NULL);
+  g_return_val_if_fail (snapshot->ref_count > 0, NULL);
+
+  g_atomic_int_inc (&snapshot->ref_count);
+
+  return snapshot;
+}
+
+void
+indicator_power_device_snapshot_unref (IndicatorPowerDeviceSnapshot * snapshot)
+{
+  g_return_if_fail (snapshot != NULL);
+  g_return_if_fail (snapshot->ref_count > 0);
+
+  if (g_atomic_int_dec_and_test (&snapshot->ref_count))
+    {
+      guint i;
+
+      for (i=0; i<snapshot->n_records; i++)
+        indicator_power_device_record_clear (&snapshot->records[i]);
+
+      g_free (snapshot);
+    }
+}
+
+/**
+ * Get GObject wrappers for the records in a snapshot.
+ *
+ * This is for API compatibility with code that still wants
+ * IndicatorPowerDevices; the hot paths should read the records directly.
+ *
+ * Return value: (element-type IndicatorPowerDevice)
+ *               (transfer full):
+ *               list of devices
+ */
+GList *
+indicator_power_device_snapshot_get_devices (const IndicatorPowerDeviceSnapshot * snapshot)
+{
+  GList * devices = NULL;
+  guint i;
+
+  g_return_val_if_fail (snapshot != NULL, NULL);
+
+  for (i=snapshot->n_records; i>0; --i)
+    devices = g_list_prepend (devices, indicator_power_device_new_from_record (&snapshot->records[i-1]));
+
+  return devices;
+}
+
+/**
+ * Pack a snapshot into a GVariant of type
+ * INDICATOR_POWER_DEVICE_SNAPSHOT_VARIANT_TYPE, e.g. to send it over D-Bus.
+ * NULL strings are sent as empty ones.
+ *
+ * Return value: (transfer floating): the serialized snapshot.
+ */
+GVariant *
+indicator_power_device_snapshot_serialize (const IndicatorPowerDeviceSnapshot * snapshot)
+{
+  GVariantBuilder b;
+  guint i;
+
+  g_return_val_if_fail (snapshot != NULL, NULL);
+
+  g_variant_builder_init (&b, G_VARIANT_TYPE ("a(ssudxub)"));
+
+  for (i=0; i<snapshot->n_records; i++)
+    {
+      const IndicatorPowerDeviceRecord * record = &snapshot->records[i];
+
+      g_variant_builder_add (&b, "(ssudxub)",
+                             record->object_path ? record->object_path : "",
+                             record->model ? record->model : "",
+                             (guint32) record->kind,
+                             record->percentage,
+                             (gint64) record->time,
+                             (guint32) record->state,
+                             record->power_supply);
+    }
+
+  return g_variant_new ("(ba(ssudxub))", snapshot->on_battery, &b);
+}
+
+/**
+ * The reverse of indicator_power_device_snapshot_serialize().
+ *
+ * Return value: (transfer full): a new snapshot, or NULL if @variant
+ *               isn't of type INDICATOR_POWER_DEVICE_SNAPSHOT_VARIANT_TYPE.
+ *               Release with indicator_power_device_snapshot_unref().
+ */
+IndicatorPowerDeviceSnapshot *
+indicator_power_device_snapshot_deserialize (GVariant * variant)
+{
+  IndicatorPowerDeviceSnapshot * snapshot;
+  gboolean on_battery;
+  GVariant * records;
+  GVariantIter iter;
+  const gchar * object_path;
+  const gchar * model;
+  guint32 kind;
+  gdouble percentage;
+  gint64 time;
+  guint32 state;
+  gboolean power_supply;
+  guint i = 0;
+
+  g_return_val_if_fail (variant != NULL, NULL);
+
+  if (!g_variant_is_of_type (variant, G_VARIANT_TYPE (INDICATOR_POWER_DEVICE_SNAPSHOT_VARIANT_TYPE)))
+    return NULL;
+
+  g_variant_get (variant, "(b@a(ssudxub))", &on_battery, &records);
+  snapshot = indicator_power_device_snapshot_new (g_variant_iter_init (&iter, records));
+  snapshot->on_battery = on_battery;
+
+  while (g_variant_iter_next (&iter, "(&s&sudxub)", &object_path, &model, &kind,
+                              &percentage, &time, &state, &power_supply))
+    {
+      indicator_power_device_record_set (&snapshot->records[i++],
+                                         *object_path ? object_path : NULL,
+                                         (UpDeviceKind) kind,
+                                         *model ? model : NULL,
+                                         percentage,
+                                         (UpDeviceState) state,
+                                         (time_t) time,
+                                         power_supply);
+    }
+
+  g_variant_unref (records);
+  return snapshot;
+}
+
+/***
+****  Records
+***/
+
+void
+indicator_power_device_record_set (IndicatorPowerDeviceRecord * record,
+                                   const gchar                * object_path,
+                                   UpDeviceKind                 kind,
+                                   const gchar                * model,
+                                   gdouble                      percentage,
+                                   UpDeviceState                state,
+                                   time_t                       time,
+                                   gboolean                     power_supply)
+{
+  gchar * old_model;
+
+  g_return_if_fail (record != NULL);
+
+  /* dup before freeing, in case @model is the record's own */
+  old_model = record->model;
+  record->object_path = g_intern_string (object_path);
+  record->model = g_strdup (model);
+  g_free (old_model);
+  record->kind = kind;
+  record->percentage = percentage;
+  record->state = state;
+  record->time = time;
+  record->power_supply = power_supply;
+}
+
+void
+indicator_power_device_record_clear (IndicatorPowerDeviceRecord * record)
+{
+  g_return_if_fail (record != NULL);
+
+  g_clear_pointer (&record->model, g_free);
+}
+
+void
+indicator_power_device_record_from_device (IndicatorPowerDeviceRecord * record,
+                                           const IndicatorPowerDevice * device)
+{
+  g_return_if_fail (INDICATOR_IS_POWER_DEVICE (device));
+
+  indicator_power_device_record_set (record,
+                                     indicator_power_device_get_object_path (device),
+                                     indicator_power_device_get_kind (device),
+                                     indicator_power_device_get_model (device),
+                                     indicator_power_device_get_percentage (device),
+                                     indicator_power_device_get_state (device),
+                                     indicator_power_device_get_time (device),
+                                     indicator_power_device_get_power_supply (device));
+}
+
+IndicatorPowerDevice *
+indicator_power_device_new_from_record (const IndicatorPowerDeviceRecord * record)
+{
+  g_return_val_if_fail (record != NULL, NULL);
+
+  return indicator_power_device_new (record->object_path,
+                                     record->kind,
+                                     record->model,
+                                     record->percentage,
+                                     record->state,
+                                     record->time,
+                                     record->power_supply);
+}
+
+/**
+ * Update a device's properties from a record.
+ *
+ * Only the fields that differ are set, so listeners
+ * only get notify:: signals for real changes.
+ */
+void
+indicator_power_device_update_from_record (IndicatorPowerDevice             * device,
+                                           const IndicatorPowerDeviceRecord * record)
+{
+  GObject * o;
+
+  g_return_if_fail (INDICATOR_IS_POWER_DEVICE (device));
+  g_return_if_fail (record != NULL);
+
+  o = G_OBJECT (device);
+  g_object_freeze_notify (o);
+
+  if (indicator_power_device_get_kind (device) != record->kind)
+    g_object_set (o, INDICATOR_POWER_DEVICE_KIND, (gint)record->kind, NULL);
+
+  if (g_strcmp0 (indicator_power_device_get_model (device), record->model))
+    g_object_set (o, INDICATOR_POWER_DEVICE_MODEL, record->model, NULL);
+
+  if (indicator_power_device_get_state (device) != record->state)
+    g_object_set (o, INDICATOR_POWER_DEVICE_STATE, (gint)record->state, NULL);
+
+  if (g_strcmp0 (indicator_power_device_get_object_path (device), record->object_path))
+    g_object_set (o, INDICATOR_POWER_DEVICE_OBJECT_PATH, record->object_path, NULL);
+
+  if (indicator_power_device_get_percentage (device) != record->percentage)
+    g_object_set (o, INDICATOR_POWER_DEVICE_PERCENTAGE, record->percentage, NULL);
+
+  if (indicator_power_device_get_time (device) != record->time)
+    g_object_set (o, INDICATOR_POWER_DEVICE_TIME, (guint64)record->time, NULL);
+
+  if (indicator_power_device_get_power_supply (device) != record->power_supply)
+    g_object_set (o, INDICATOR_POWER_DEVICE_POWER_SUPPLY, record->power_supply, NULL);
+
+  g_object_thaw_notify (o);
+}
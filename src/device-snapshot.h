@@ -0,0 +1,108 @@
+/*
+ * Copyright 2026 The Ayatana Indicators project
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __INDICATOR_POWER_DEVICE_SNAPSHOT__H__
+#define __INDICATOR_POWER_DEVICE_SNAPSHOT__H__
+
+#include <glib.h>
+
+#include "device.h"
+
+G_BEGIN_DECLS
+
+/**
+ * A copy of an IndicatorPowerDevice's fields.
+ *
+ * The object path is interned with g_intern_string(), so two records
+ * refer to the same device iff their object_path pointers are equal.
+ * The model belongs to the record: set the fields with
+ * indicator_power_device_record_set() on a zero-filled record,
+ * and release it with indicator_power_device_record_clear().
+ */
+typedef struct
+{
+  const gchar   * object_path; /* NULL for synthesized devices */
+  gchar         * model;
+  gdouble         percentage;
+  time_t          time;
+  UpDeviceKind    kind;
+  UpDeviceState   state;
+  gboolean        power_supply;
+}
+IndicatorPowerDeviceRecord;
+
+/**
+ * An immutable, reference-counted array of device records.
+ *
+ * The records live in the same allocation as the snapshot itself.
+ * Providers fill in the records after indicator_power_device_snapshot_new()
+ * and must not change them once the snapshot has been handed out.
+ */
+typedef struct
+{
+  /*< private >*/
+  gint ref_count;
+
+  /*< public >*/
+  gboolean on_battery; /* UPower's OnBattery; FALSE if the provider can't tell */
+  guint n_records;
+  IndicatorPowerDeviceRecord * records;
+}
+IndicatorPowerDeviceSnapshot;
+
+IndicatorPowerDeviceSnapshot * indicator_power_device_snapshot_new               (guint n_records);
+
+IndicatorPowerDeviceSnapshot * indicator_power_device_snapshot_new_from_devices  (GList * devices);
+
+IndicatorPowerDeviceSnapshot * indicator_power_device_snapshot_ref               (IndicatorPowerDeviceSnapshot * snapshot);
+
+void                           indicator_power_device_snapshot_unref             (IndicatorPowerDeviceSnapshot * snapshot);
+
+GList                        * indicator_power_device_snapshot_get_devices       (const IndicatorPowerDeviceSnapshot * snapshot);
+
+/* (on_battery, a(object_path, model, kind, percentage, time, state, power_supply)) */
+#define INDICATOR_POWER_DEVICE_SNAPSHOT_VARIANT_TYPE "(ba(ssudxub))"
+
+GVariant                     * indicator_power_device_snapshot_serialize         (const IndicatorPowerDeviceSnapshot * snapshot);
+
+IndicatorPowerDeviceSnapshot * indicator_power_device_snapshot_deserialize       (GVariant * variant);
+
+/***
+****
+***/
+
+void                   indicator_power_device_record_set          (IndicatorPowerDeviceRecord * record,
+                                                                   const gchar                * object_path,
+                                                                   UpDeviceKind                 kind,
+                                                                   const gchar                * model,
+                                                                   gdouble                      percentage,
+                                                                   UpDeviceState                state,
+                                                                   time_t                       time,
+                                                                   gboolean                     power_supply);
+
+void                   indicator_power_device_record_clear        (IndicatorPowerDeviceRecord * record);
+
+void                   indicator_power_device_record_from_device  (IndicatorPowerDeviceRecord * record,
+                                                                   const IndicatorPowerDevice * device);
+
+IndicatorPowerDevice * indicator_power_device_new_from_record     (const IndicatorPowerDeviceRecord * record);
+
+void                   indicator_power_device_update_from_record  (IndicatorPowerDevice             * device,
+                                                                   const IndicatorPowerDeviceRecord * record);
+
+G_END_DECLS
+
+#endif /* __INDICATOR_POWER_DEVICE_SNAPSHOT__H__ */
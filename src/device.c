@@ -31,7 +31,40 @@ License along with this library. If not, see
 #include <glib/gi18n-lib.h>
 #include <gio/gio.h>
 
+#include <string.h> /* memcmp(), memset() */
+
 #include "device.h"
+#include "time-estimator.h"
+
+/* the strings that we render and cache */
+enum
+{
+  TEXT_READABLE,
+  TEXT_READABLE_MODEL,
+  TEXT_ACCESSIBLE,
+  TEXT_TITLE_PERCENT,      /* the title's index is TEXT_TITLE + want_time*2 + want_percent */
+  TEXT_TITLE_TIME,
+  TEXT_TITLE_TIME_PERCENT,
+  N_TEXTS
+};
+
+#define TEXT_TITLE (TEXT_TITLE_PERCENT - 1)
+
+#define TEXT_BIT(i) (1u << (i))
+#define TEXTS_ALL ((1u << N_TEXTS) - 1)
+#define TEXTS_MENUITEM (TEXT_BIT(TEXT_READABLE) | TEXT_BIT(TEXT_READABLE_MODEL) | TEXT_BIT(TEXT_ACCESSIBLE))
+#define TEXTS_WITH_TIME (TEXTS_MENUITEM | TEXT_BIT(TEXT_TITLE_TIME) | TEXT_BIT(TEXT_TITLE_TIME_PERCENT))
+#define TEXTS_WITH_PERCENT (TEXT_BIT(TEXT_TITLE_PERCENT) | TEXT_BIT(TEXT_TITLE_TIME_PERCENT))
+
+/* everything about the time remaining that the rendered text depends on */
+typedef struct
+{
+  gint64 minutes;          /* upower's time, as shown */
+  gboolean estimable;      /* whether upower's time is nonzero */
+  gint64 estimate_minutes; /* our own estimate, used while it's zero */
+  guint inestimable_phase; /* “estimating…”, “unknown”, or nothing */
+}
+TimeKey;
 
 struct _IndicatorPowerDevicePrivate
 {
@@ -46,7 +79,16 @@ struct _IndicatorPowerDevicePrivate
      the time-remaining field for this device, or 0 if not applicable.
      This is used when generating the time-remaining string. */
   GTimer * inestimable;
+
+  /* Our own guess at the time remaining, used while upower has none */
+  IndicatorPowerTimeEstimator estimator;
   gboolean power_supply;
+
+  /* Rendered strings, so that the header and each profile's menu
+     don't all redo them. texts_valid is a bitmask of TEXT_BIT()s. */
+  gchar * texts[N_TEXTS];
+  guint texts_valid;
+  TimeKey texts_time_key;
 };
 
 /* Properties */
@@ -65,6 +107,19 @@ enum {
 
 static GParamSpec * properties[N_PROPERTIES];
 
+/* drop the cached strings in @mask */
+static void
+invalidate_texts (IndicatorPowerDevicePrivate * p, guint mask)
+{
+  int i;
+
+  for (i=0; i<N_TEXTS; i++)
+    if (mask & TEXT_BIT(i))
+      g_clear_pointer (&p->texts[i], g_free);
+
+  p->texts_valid &= ~mask;
+}
+
 /* GObject stuff */
 static void indicator_power_device_class_init (IndicatorPowerDeviceClass *klass);
 static void indicator_power_device_init       (IndicatorPowerDevice *self);
@@ -172,6 +227,7 @@ indicator_power_device_finalize (GObject *object)
   IndicatorPowerDevicePrivate * priv = self->priv;
 
   g_clear_pointer (&priv->object_path, g_free);
+  invalidate_texts (priv, TEXTS_ALL);
 
   G_OBJECT_CLASS (indicator_power_device_parent_class)->finalize (object);
 }
@@ -231,15 +287,24 @@ set_property (GObject * o, guint prop_id, const GValue * value, GParamSpec * psp
   switch (prop_id)
     {
       case PROP_KIND:
+        if (p->kind != (UpDeviceKind) g_value_get_int (value))
+          invalidate_texts (p, TEXTS_MENUITEM);
         p->kind = (UpDeviceKind) g_value_get_int (value);
         break;
 
       case PROP_MODEL:
+        if (g_strcmp0 (p->model, g_value_get_string (value)))
+          invalidate_texts (p, TEXT_BIT(TEXT_READABLE_MODEL));
         g_free (p->model);
         p->model = g_value_dup_string (value);
         break;
 
       case PROP_STATE:
+        if (p->state != (UpDeviceState) g_value_get_int (value))
+          {
+            indicator_power_time_estimator_reset (&p->estimator);
+            invalidate_texts (p, TEXTS_WITH_TIME);
+          }
         p->state = (UpDeviceState) g_value_get_int (value);
         break;
 
@@ -249,10 +314,15 @@ set_property (GObject * o, guint prop_id, const GValue * value, GParamSpec * psp
         break;
 
       case PROP_PERCENTAGE:
+        if (p->percentage != g_value_get_double (value))
+          invalidate_texts (p, TEXTS_WITH_PERCENT);
         p->percentage = g_value_get_double (value);
+        if ((p->state == UP_DEVICE_STATE_CHARGING) || (p->state == UP_DEVICE_STATE_DISCHARGING))
+          indicator_power_time_estimator_add_sample (&p->estimator, g_get_monotonic_time (), p->percentage);
         break;
 
       case PROP_TIME:
+        /* the cached texts check this in get_time_key() */
         p->time = (time_t) g_value_get_uint64(value);
         break;
 
@@ -785,6 +855,8 @@ device_kind_to_localised_string (UpDeviceKind kind)
  * The '''brief time-remaining string''' for a component should be:
  *  * the time remaining for it to empty or fully charge,
  *    if estimable, in H:MM format; otherwise
+ *  * our own estimate of that, in the same format, once we've
+ *    watched the percentage change for long enough; otherwise
  *  * “estimating…” if the time remaining has been inestimable for
  *    less than 30 seconds; otherwise
  *  * “unknown” if the time remaining has been inestimable for
@@ -797,9 +869,14 @@ get_brief_time_remaining (const IndicatorPowerDevice * device)
   gchar * str = NULL;
   const IndicatorPowerDevicePrivate * p = device->priv;
 
-  if (p->time > 0)
+  time_t time = p->time;
+
+  if ((time == 0) && ((p->state == UP_DEVICE_STATE_CHARGING) || (p->state == UP_DEVICE_STATE_DISCHARGING)))
+    time = indicator_power_time_estimator_get_time (&p->estimator, p->state == UP_DEVICE_STATE_CHARGING);
+
+  if (time > 0)
     {
-      int minutes = p->time / 60;
+      int minutes = time / 60;
       const int hours = minutes / 60;
       minutes %= 60;
 
@@ -822,6 +899,35 @@ get_brief_time_remaining (const IndicatorPowerDevice * device)
   return str;
 }
 
+/**
+ * How many seconds until the brief time-remaining string changes by
+ * itself, e.g. from “estimating…” to “unknown”, or 0 if it won't.
+ */
+guint
+indicator_power_device_get_next_transition (const IndicatorPowerDevice * device)
+{
+  const IndicatorPowerDevicePrivate * p;
+  double elapsed;
+
+  /* LCOV_EXCL_START */
+  g_return_val_if_fail (INDICATOR_IS_POWER_DEVICE(device), 0);
+  /* LCOV_EXCL_STOP */
+
+  p = device->priv;
+
+  if ((p->time > 0) || (p->inestimable == NULL))
+    return 0;
+
+  /* round up so that we land just past the boundary */
+  elapsed = g_timer_elapsed (p->inestimable, NULL);
+  if (elapsed < 30)
+    return (guint)(30 - elapsed) + 1;
+  if (elapsed < 60)
+    return (guint)(60 - elapsed) + 1;
+
+  return 0;
+}
+
 /**
  * The '''expanded time-remaining string''' for a component should
  * be the same as the brief time-remaining string, except that if
@@ -1006,20 +1112,88 @@ get_menuitem_text (const IndicatorPowerDevice * device,
   return str;
 }
 
-char *
+/***
+****  Cached texts
+***/
+
+static void
+get_time_key (const IndicatorPowerDevice * device, TimeKey * key)
+{
+  const IndicatorPowerDevicePrivate * p = device->priv;
+
+  memset (key, 0, sizeof (TimeKey));
+
+  key->minutes = p->time / 60;
+  key->estimable = p->time > 0;
+
+  if (!key->estimable && ((p->state == UP_DEVICE_STATE_CHARGING) || (p->state == UP_DEVICE_STATE_DISCHARGING)))
+    key->estimate_minutes = indicator_power_time_estimator_get_time (&p->estimator, p->state == UP_DEVICE_STATE_CHARGING) / 60;
+
+  if (p->inestimable != NULL)
+    {
+      const double elapsed = g_timer_elapsed (p->inestimable, NULL);
+
+      key->inestimable_phase = elapsed < 30 ? 1 : elapsed < 60 ? 2 : 3;
+    }
+}
+
+/* Returns TRUE if texts[index] is up-to-date.
+   If the time key has changed, it drops every text that shows the time. */
+static gboolean
+lookup_text (const IndicatorPowerDevice * device, int index)
+{
+  IndicatorPowerDevicePrivate * p = device->priv;
+  TimeKey key;
+
+  get_time_key (device, &key);
+  if (memcmp (&key, &p->texts_time_key, sizeof (TimeKey)))
+    {
+      invalidate_texts (p, TEXTS_WITH_TIME);
+      p->texts_time_key = key;
+    }
+
+  return (p->texts_valid & TEXT_BIT(index)) != 0;
+}
+
+static const char *
+store_text (const IndicatorPowerDevice * device, int index, char * text)
+{
+  IndicatorPowerDevicePrivate * p = device->priv;
+
+  g_free (p->texts[index]);
+  p->texts[index] = text;
+  p->texts_valid |= TEXT_BIT(index);
+
+  return text;
+}
+
+/**
+ * The strings returned by the text and title getters are owned by the
+ * device and stay valid until the device changes or is next asked for text.
+ */
+
+const char *
 indicator_power_device_get_readable_text (const IndicatorPowerDevice * device, gboolean bModelName)
 {
+  const int index = bModelName ? TEXT_READABLE_MODEL : TEXT_READABLE;
+
   g_return_val_if_fail (INDICATOR_IS_POWER_DEVICE(device), NULL);
 
-  return get_menuitem_text (device, FALSE, bModelName);
+  if (lookup_text (device, index))
+    return device->priv->texts[index];
+
+  return store_text (device, index, get_menuitem_text (device, FALSE, bModelName));
 }
 
-char *
+const char *
 indicator_power_device_get_accessible_text (const IndicatorPowerDevice * device)
 {
   g_return_val_if_fail (INDICATOR_IS_POWER_DEVICE(device), NULL);
 
-  return get_menuitem_text (device, TRUE, FALSE);
+  if (lookup_text (device, TEXT_ACCESSIBLE))
+    return device->priv->texts[TEXT_ACCESSIBLE];
+
+  return store_text (device, TEXT_ACCESSIBLE, get_menuitem_text (device, TRUE, FALSE));
 }
 
 /**
@@ -1034,18 +1208,14 @@ indicator_power_device_get_accessible_text (const IndicatorPowerDevice * device)
  *
  * If both conditions are true, the time and percentage should be separated by a space.
  */
-char*
-indicator_power_device_get_readable_title (const IndicatorPowerDevice * device,
-                                           gboolean                     want_time,
-                                           gboolean                     want_percent)
+static char *
+create_readable_title (const IndicatorPowerDevice * device,
+                       gboolean                     want_time,
+                       gboolean                     want_percent)
 {
   char * str = NULL;
   char * time_str = NULL;
-  const IndicatorPowerDevicePrivate * p;
-
-  g_return_val_if_fail (INDICATOR_IS_POWER_DEVICE(device), NULL);
-
-  p = device->priv;
+  const IndicatorPowerDevicePrivate * p = device->priv;
 
   // if we can't provide time-remaining, turn off the time flag
   if (want_time && !time_is_relevant (device))
@@ -1110,11 +1280,30 @@ indicator_power_device_get_readable_title (const IndicatorPowerDevice * device,
   return str;
 }
 
+const char *
+indicator_power_device_get_readable_title (const IndicatorPowerDevice * device,
+                                           gboolean                     want_time,
+                                           gboolean                     want_percent)
+{
+  int index;
+
+  g_return_val_if_fail (INDICATOR_IS_POWER_DEVICE(device), NULL);
+
+  if (!want_time && !want_percent)
+    return NULL;
+
+  index = TEXT_TITLE + (want_time ? 2 : 0) + (want_percent ? 1 : 0);
+  if (lookup_text (device, index))
+    return device->priv->texts[index];
+
+  return store_text (device, index, create_readable_title (device, want_time, want_percent));
+}
+
 /**
  * Regardless, the accessible name for the whole menu title should be the same
  * as the accessible name for that thing’s component inside the menu itself.
  */
-char *
+const char *
 indicator_power_device_get_accessible_title (const IndicatorPowerDevice * device,
                                              gboolean                     want_time G_GNUC_UNUSED,
                                              gboolean                     want_percent G_GNUC_UNUSED)
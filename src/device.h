@@ -151,18 +151,20 @@ GStrv         indicator_power_device_get_icon_names        (const IndicatorPower
 GIcon       * indicator_power_device_get_gicon             (const IndicatorPowerDevice * device, gboolean panel, gboolean bShowCharge);
 
 
-char        * indicator_power_device_get_readable_text     (const IndicatorPowerDevice * device, gboolean bModelName);
+const char  * indicator_power_device_get_readable_text     (const IndicatorPowerDevice * device, gboolean bModelName);
 
-char        * indicator_power_device_get_accessible_text   (const IndicatorPowerDevice * device);
+const char  * indicator_power_device_get_accessible_text   (const IndicatorPowerDevice * device);
 
-char        * indicator_power_device_get_readable_title    (const IndicatorPowerDevice * device,
+const char  * indicator_power_device_get_readable_title    (const IndicatorPowerDevice * device,
                                                             gboolean                     want_time,
                                                             gboolean                     want_percent);
 
-char        * indicator_power_device_get_accessible_title  (const IndicatorPowerDevice * device,
+const char  * indicator_power_device_get_accessible_title  (const IndicatorPowerDevice * device,
                                                             gboolean                     want_time,
                                                             gboolean                     want_percent);
 
+guint         indicator_power_device_get_next_transition   (const IndicatorPowerDevice * device);
+
 
 G_END_DECLS
 
@@ -22,35 +22,44 @@
 #include "flashlight.h"
 
 #include <gio/gio.h>
+#include <glib-unix.h>
 #include <stdio.h>
+#include <string.h>
+#include <errno.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <sys/socket.h>
+#include <linux/filter.h>
+#include <linux/netlink.h>
 
 #define QCOM_ENABLE "255"
 #define QCOM_DISABLE "0"
 #define SIMPLE_ENABLE "1"
 #define SIMPLE_DISABLE "0"
 
+#define DEFAULT_SYSFS_ROOT "/sys"
+
 #ifdef ENABLE_LIBDEVICEINFO
 extern char* flashlight_path();
 extern char* flashlight_switch_path();
 #endif
 
+/* relative to the sysfs root */
 const size_t qcom_sysfs_size = 7;
-const char* const qcom_sysfs[] = {"/sys/class/leds/torch-light/brightness",
-                                  "/sys/class/leds/led:flash_torch/brightness",
-                                  "/sys/class/leds/flashlight/brightness",
-                                  "/sys/class/leds/torch-light0/brightness",
-                                  "/sys/class/leds/torch-light1/brightness",
-                                  "/sys/class/leds/led:torch_0/brightness",
-                                  "/sys/class/leds/led:torch_1/brightness"};
+const char* const qcom_sysfs[] = {"class/leds/torch-light/brightness",
+                                  "class/leds/led:flash_torch/brightness",
+                                  "class/leds/flashlight/brightness",
+                                  "class/leds/torch-light0/brightness",
+                                  "class/leds/torch-light1/brightness",
+                                  "class/leds/led:torch_0/brightness",
+                                  "class/leds/led:torch_1/brightness"};
 const size_t qcom_switch_size = 2;
-const char* const qcom_switch[] = {"/sys/class/leds/led:switch/brightness",
-                                   "/sys/class/leds/led:switch_0/brightness"};
+const char* const qcom_switch[] = {"class/leds/led:switch/brightness",
+                                   "class/leds/led:switch_0/brightness"};
 
 const size_t simple_sysfs_size = 2;
-const char* const simple_sysfs[] = {"/sys/class/flashlight_core/flashlight/flashlight_torch",
-                                    "/sys/class/leds/white:flash/brightness"};
+const char* const simple_sysfs[] = {"class/flashlight_core/flashlight/flashlight_torch",
+                                    "class/leds/white:flash/brightness"};
 
 char* flash_sysfs_path = NULL;
 char* qcom_switch_path = NULL;
@@ -58,16 +67,57 @@ char* qcom_switch_path = NULL;
 enum TorchType torch_type = SIMPLE;
 gboolean activated = 0;
 
-int
-set_sysfs_path()
+/* Discovery is cached until a "leds" uevent says the LEDs changed.
+   The chosen LEDs are kept open so that each toggle is one pwrite(). */
+static char* sysfs_root = NULL;
+static gboolean discovered = FALSE;
+static int flash_fd = -1;
+static int switch_fd = -1;
+static guint uevent_tag = 0;
+
+static void
+clear_sysfs_path()
+{
+  if (flash_fd != -1) {
+    close(flash_fd);
+    flash_fd = -1;
+  }
+  if (switch_fd != -1) {
+    close(switch_fd);
+    switch_fd = -1;
+  }
+  g_clear_pointer(&flash_sysfs_path, g_free);
+  g_clear_pointer(&qcom_switch_path, g_free);
+  torch_type = SIMPLE;
+  discovered = FALSE;
+}
+
+static char*
+find_sysfs_file(const char* const* candidates, size_t n_candidates)
+{
+  const char* root = sysfs_root ? sysfs_root : DEFAULT_SYSFS_ROOT;
+
+  for (size_t i = 0; i < n_candidates; i++) {
+    char* path = g_build_filename(root, candidates[i], NULL);
+    if (access(path, F_OK ) != -1)
+      return path;
+    g_free(path);
+  }
+  return NULL;
+}
+
+static int
+probe_sysfs_path()
 {
 # ifdef ENABLE_LIBDEVICEINFO
-  if (strcmp(flashlight_path(), "")) {
-    if (access(flashlight_path(), F_OK) != -1) {
-        flash_sysfs_path = flashlight_path();
-        if (strcmp(flashlight_switch_path(), "")) {
-          if (access(flashlight_switch_path(), F_OK) != -1) {
-              qcom_switch_path = flashlight_switch_path();
+  const char* di_path = flashlight_path();
+  if (strcmp(di_path, "")) {
+    if (access(di_path, F_OK) != -1) {
+        const char* di_switch_path = flashlight_switch_path();
+        flash_sysfs_path = g_strdup(di_path);
+        if (strcmp(di_switch_path, "")) {
+          if (access(di_switch_path, F_OK) != -1) {
+              qcom_switch_path = g_strdup(di_switch_path);
               torch_type = QCOM;
           }
         }
@@ -75,30 +125,200 @@ set_sysfs_path()
     }
   } else {
 # endif
-    for (size_t i = 0; i < qcom_sysfs_size; i++) {
-      if (access(qcom_sysfs[i], F_OK ) != -1){
-          flash_sysfs_path = (char*)qcom_sysfs[i];
-          torch_type = QCOM;
-          /* Qualcomm torch; determine switch file (if one is needed) */
-          for (size_t i = 0; i < qcom_switch_size; i++) {
-            if (access(qcom_switch[i], F_OK ) != -1)
-                qcom_switch_path = (char*)qcom_switch[i];
-          }
-          return 1;
-      }
-    }
-    for (size_t i = 0; i < simple_sysfs_size; i++) {
-      if (access(simple_sysfs[i], F_OK ) != -1){
-          flash_sysfs_path = (char*)simple_sysfs[i];
-          return 1;
-      }
+    if ((flash_sysfs_path = find_sysfs_file(qcom_sysfs, qcom_sysfs_size))) {
+      /* Qualcomm torch; determine switch file (if one is needed) */
+      torch_type = QCOM;
+      qcom_switch_path = find_sysfs_file(qcom_switch, qcom_switch_size);
+      return 1;
     }
+    if ((flash_sysfs_path = find_sysfs_file(simple_sysfs, simple_sysfs_size)))
+      return 1;
 # ifdef ENABLE_LIBDEVICEINFO
   }
 # endif
   return 0;
 }
 
+/***
+****  uevents
+***/
+
+/* Handle a kernel uevent read from the netlink socket.
+   The message is "ACTION@DEVPATH" followed by NUL-separated KEY=VALUE pairs. */
+static void
+handle_uevent_message(const char* buf, size_t len)
+{
+  const char* action = NULL;
+  const char* subsystem = NULL;
+  size_t i = 0;
+
+  while (i < len) {
+    const char* line = buf + i;
+    const size_t line_len = strnlen(line, len - i);
+    if (g_str_has_prefix(line, "ACTION="))
+      action = line + strlen("ACTION=");
+    else if (g_str_has_prefix(line, "SUBSYSTEM="))
+      subsystem = line + strlen("SUBSYSTEM=");
+    i += line_len + 1;
+  }
+
+  if (action != NULL && subsystem != NULL)
+    flashlight_handle_uevent(action, subsystem);
+}
+
+static gboolean
+on_uevent(gint fd, GIOCondition condition, gpointer data G_GNUC_UNUSED)
+{
+  char buf[4096];
+  ssize_t n;
+
+  if (condition & (G_IO_ERR | G_IO_HUP | G_IO_NVAL)) {
+    uevent_tag = 0;
+    close(fd);
+    return G_SOURCE_REMOVE;
+  }
+
+  for (;;) {
+    n = recv(fd, buf, sizeof(buf) - 1, 0);
+    if (n > 0) {
+      buf[n] = '\0';
+      handle_uevent_message(buf, n);
+    } else if (n == -1 && errno == ENOBUFS) {
+      /* the socket overflowed, so we may have missed a "leds" event */
+      g_debug("Lost some uevents; rediscovering the flashlight");
+      clear_sysfs_path();
+    } else if (n == -1 && errno == EINTR) {
+      continue;
+    } else {
+      break;
+    }
+  }
+
+  return G_SOURCE_CONTINUE;
+}
+
+/* How far into a message to look for the end of "ACTION@DEVPATH".
+   Each position costs four instructions; BPF_MAXINSNS is 4096. */
+#define UEVENT_FILTER_MAX_HEADER 512
+
+/* Build a socket filter that only passes "leds" uevents.
+
+   The kernel always sends "ACTION@DEVPATH\0ACTION=...\0DEVPATH=...\0"
+   followed by "SUBSYSTEM=...\0", so if the header's NUL is at offset n,
+   SUBSYSTEM= starts at 2n+17. Classic BPF has no loops, so the search
+   for that NUL is unrolled. Messages with a longer header are passed
+   through, and handle_uevent_message() checks them itself. */
+static struct sock_filter*
+create_uevent_filter(unsigned short* n_insns)
+{
+  const unsigned short n_tail = 12;
+  const unsigned short len = 4*UEVENT_FILTER_MAX_HEADER + 1 + n_tail;
+  struct sock_filter* insns = g_new0(struct sock_filter, len);
+  struct sock_filter* it = insns;
+  const unsigned short tail = len - n_tail;
+  unsigned short i;
+
+  for (i = 1; i <= UEVENT_FILTER_MAX_HEADER; i++) {
+    const unsigned short ja = (unsigned short)(it - insns) + 3;
+    *it++ = (struct sock_filter)BPF_STMT(BPF_LD|BPF_B|BPF_ABS, i);
+    *it++ = (struct sock_filter)BPF_JUMP(BPF_JMP|BPF_JEQ|BPF_K, 0, 0, 2);
+    *it++ = (struct sock_filter)BPF_STMT(BPF_LDX|BPF_IMM, 2*i + 17);
+    *it++ = (struct sock_filter)BPF_JUMP(BPF_JMP|BPF_JA, tail - (ja + 1), 0, 0);
+  }
+  *it++ = (struct sock_filter)BPF_STMT(BPF_RET|BPF_K, 0xffffffff);
+
+  /* match "SUBSYSTEM=leds\0" at X; loads are big-endian */
+  *it++ = (struct sock_filter)BPF_STMT(BPF_LD|BPF_W|BPF_IND, 0);
+  *it++ = (struct sock_filter)BPF_JUMP(BPF_JMP|BPF_JEQ|BPF_K, 0x53554253 /* SUBS */, 0, 9);
+  *it++ = (struct sock_filter)BPF_STMT(BPF_LD|BPF_W|BPF_IND, 4);
+  *it++ = (struct sock_filter)BPF_JUMP(BPF_JMP|BPF_JEQ|BPF_K, 0x59535445 /* YSTE */, 0, 7);
+  *it++ = (struct sock_filter)BPF_STMT(BPF_LD|BPF_W|BPF_IND, 8);
+  *it++ = (struct sock_filter)BPF_JUMP(BPF_JMP|BPF_JEQ|BPF_K, 0x4d3d6c65 /* M=le */, 0, 5);
+  *it++ = (struct sock_filter)BPF_STMT(BPF_LD|BPF_H|BPF_IND, 12);
+  *it++ = (struct sock_filter)BPF_JUMP(BPF_JMP|BPF_JEQ|BPF_K, 0x6473 /* ds */, 0, 3);
+  *it++ = (struct sock_filter)BPF_STMT(BPF_LD|BPF_B|BPF_IND, 14);
+  *it++ = (struct sock_filter)BPF_JUMP(BPF_JMP|BPF_JEQ|BPF_K, 0, 0, 1);
+  *it++ = (struct sock_filter)BPF_STMT(BPF_RET|BPF_K, 0xffffffff);
+  *it++ = (struct sock_filter)BPF_STMT(BPF_RET|BPF_K, 0);
+
+  g_assert(it - insns == len);
+  *n_insns = len;
+  return insns;
+}
+
+static void
+watch_uevents()
+{
+  struct sockaddr_nl addr;
+  struct sock_fprog filter;
+  int fd;
+
+  if (uevent_tag != 0)
+    return;
+
+  fd = socket(AF_NETLINK, SOCK_DGRAM|SOCK_CLOEXEC|SOCK_NONBLOCK, NETLINK_KOBJECT_UEVENT);
+  if (fd == -1) {
+    g_debug("Unable to watch for LED changes: %s", g_strerror(errno));
+    return;
+  }
+
+  /* don't wake up for every other device's uevents */
+  filter.filter = create_uevent_filter(&filter.len);
+  if (setsockopt(fd, SOL_SOCKET, SO_ATTACH_FILTER, &filter, sizeof(filter)) == -1)
+    g_debug("Unable to filter uevents: %s", g_strerror(errno));
+  g_free(filter.filter);
+
+  memset(&addr, 0, sizeof(addr));
+  addr.nl_family = AF_NETLINK;
+  addr.nl_groups = 1; /* kernel events */
+  if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) == -1) {
+    g_debug("Unable to watch for LED changes: %s", g_strerror(errno));
+    close(fd);
+    return;
+  }
+
+  uevent_tag = g_unix_fd_add(fd, G_IO_IN|G_IO_ERR|G_IO_HUP, on_uevent, NULL);
+}
+
+void
+flashlight_handle_uevent(const char* action, const char* subsystem)
+{
+  if (g_strcmp0(subsystem, "leds"))
+    return;
+
+  g_debug("LEDs changed (%s); rediscovering the flashlight", action);
+  clear_sysfs_path();
+}
+
+/***
+****
+***/
+
+int
+set_sysfs_path()
+{
+  if (discovered)
+    return flash_sysfs_path != NULL;
+
+  watch_uevents();
+
+  discovered = TRUE;
+  if (!probe_sysfs_path())
+    return 0;
+
+  flash_fd = open(flash_sysfs_path, O_WRONLY|O_CLOEXEC);
+  if (qcom_switch_path != NULL)
+    switch_fd = open(qcom_switch_path, O_WRONLY|O_CLOEXEC);
+  return 1;
+}
+
+static gboolean
+write_led(int fd, const char* value)
+{
+  const size_t len = strlen(value);
+  return pwrite(fd, value, len, 0) == (ssize_t)len;
+}
+
 gboolean
 flashlight_activated()
 {
@@ -108,27 +328,17 @@ flashlight_activated()
 int
 toggle_flashlight_action_qcom()
 {
-  FILE *fd1 = NULL, *fd2 = NULL;
-  int needs_enable;
-
-  fd1 = fopen(flash_sysfs_path, "w");
-  if (fd1 != NULL) {
-    needs_enable = access(qcom_switch_path, F_OK ) != -1;
-    if (needs_enable)
-      fd2 = fopen(qcom_switch_path, "w");
+  if (flash_fd != -1) {
     if (activated)
-      if (needs_enable && fd2 != NULL)
-        fprintf(fd2, "0");
+      if (switch_fd != -1)
+        write_led(switch_fd, "0");
       else
-        fprintf(fd1, QCOM_DISABLE);
+        write_led(flash_fd, QCOM_DISABLE);
     else {
-      fprintf(fd1, QCOM_ENABLE);
-      if (needs_enable && fd2 != NULL)
-        fprintf(fd2, "1");
+      write_led(flash_fd, QCOM_ENABLE);
+      if (switch_fd != -1)
+        write_led(switch_fd, "1");
     }
-    fclose(fd1);
-    if (fd2 !=NULL)
-      fclose(fd2);
     return 1;
   }
   return 0;
@@ -137,12 +347,8 @@ toggle_flashlight_action_qcom()
 int
 toggle_flashlight_action_simple()
 {
-  FILE *fd = NULL;
-
-  fd = fopen(flash_sysfs_path, "w");
-  if (fd != NULL) {
-    fprintf(fd, activated ? SIMPLE_DISABLE : SIMPLE_ENABLE);
-    fclose(fd);
+  if (flash_fd != -1) {
+    write_led(flash_fd, activated ? SIMPLE_DISABLE : SIMPLE_ENABLE);
     return 1;
   }
   return 0;
@@ -177,3 +383,12 @@ flashlight_supported()
 {
   return set_sysfs_path();
 }
+
+/* for tests: look for the LEDs somewhere other than /sys */
+void
+flashlight_set_sysfs_root(const char* root)
+{
+  g_free(sysfs_root);
+  sysfs_root = g_strdup(root);
+  clear_sysfs_path();
+}
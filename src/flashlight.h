@@ -41,6 +41,12 @@ flashlight_supported();
 gboolean
 flashlight_activated();
 
+void
+flashlight_handle_uevent(const char* action, const char* subsystem);
+
+void
+flashlight_set_sysfs_root(const char* root);
+
 enum
 TorchType { SIMPLE = 1, QCOM };
 
@@ -23,14 +23,73 @@
 #include <glib/gi18n.h>
 
 #include "device.h"
+#include "device-provider-hub.h"
+#include "device-provider-upower.h"
 #include "notifier.h"
 #include "service.h"
 #include "testing.h"
 
+#define SETTINGS_INGESTION_THREAD_S "upower-ingestion-thread"
+#define SETTINGS_DEVICE_HUB_S "device-hub"
+
 /***
-****
+****  Startup
 ***/
 
+/* Startup is a small dependency graph rather than a chain:
+ *
+ *   UPower:  system bus -> name appears -> EnumerateDevices -> GetAll x N
+ *            (or, with the device-hub setting, the hub instance's socket)
+ *   service: session bus -> export actions & menus -> own the bus name
+ *   header:  needs the service's exports and UPower's first full snapshot
+ *
+ * The two branches don't wait on each other, and the header is rebuilt
+ * as soon as the provider publishes, so what matters here is starting
+ * the slower UPower branch first: it's already on the system bus while
+ * the service is still building its menus. Everything else, such as
+ * brightness and notifications, starts when it's first needed. */
+
+static IndicatorPowerDeviceProvider *
+create_upower_provider (void)
+{
+  IndicatorPowerDeviceProvider * provider;
+  GSettings * settings;
+
+  settings = g_settings_new ("org.ayatana.indicator.power");
+  if (g_settings_get_boolean (settings, SETTINGS_INGESTION_THREAD_S))
+    provider = indicator_power_device_provider_upower_new_threaded();
+  else
+    provider = indicator_power_device_provider_upower_new();
+  g_object_unref (settings);
+
+  return provider;
+}
+
+/* UPower, either read directly or shared with other instances */
+static IndicatorPowerDeviceProvider *
+create_device_provider (void)
+{
+  IndicatorPowerDeviceProvider * provider;
+  GSettings * settings;
+  gchar * setting;
+  gchar * address;
+  IndicatorPowerDeviceHubAccess hub_access;
+
+  settings = g_settings_new ("org.ayatana.indicator.power");
+  setting = g_settings_get_string (settings, SETTINGS_DEVICE_HUB_S);
+  address = indicator_power_device_provider_hub_get_address (setting, &hub_access);
+
+  if (address != NULL)
+    provider = indicator_power_device_provider_hub_new (address, hub_access, create_upower_provider);
+  else
+    provider = create_upower_provider();
+
+  g_free (address);
+  g_free (setting);
+  g_object_unref (settings);
+  return provider;
+}
+
 static void
 on_name_lost (gpointer instance G_GNUC_UNUSED, gpointer loop)
 {
@@ -41,6 +100,7 @@ on_name_lost (gpointer instance G_GNUC_UNUSED, gpointer loop)
 int
 main (int argc G_GNUC_UNUSED, char ** argv G_GNUC_UNUSED)
 {
+  IndicatorPowerDeviceProvider * devices;
   IndicatorPowerNotifier * notifier;
   IndicatorPowerService * service;
   IndicatorPowerTesting * testing;
@@ -52,8 +112,9 @@ main (int argc G_GNUC_UNUSED, char ** argv G_GNUC_UNUSED)
   textdomain (GETTEXT_PACKAGE);
 
   /* run */
+  devices = create_device_provider();
   notifier = indicator_power_notifier_new();
-  service = indicator_power_service_new(NULL, notifier);
+  service = indicator_power_service_new(devices, notifier);
   testing = indicator_power_testing_new (service);
   loop = g_main_loop_new (NULL, FALSE);
   g_signal_connect (service, INDICATOR_POWER_SERVICE_SIGNAL_NAME_LOST,
@@ -65,5 +126,6 @@ main (int argc G_GNUC_UNUSED, char ** argv G_GNUC_UNUSED)
   g_clear_object (&testing);
   g_clear_object (&service);
   g_clear_object (&notifier);
+  g_clear_object (&devices);
   return 0;
 }
@@ -19,6 +19,7 @@
  *   Robert Tari <robert@tari.in>
  */
 
+#include "battery-watches.h"
 #include "datafiles.h"
 
 #ifdef LOMIRI_FEATURES_ENABLED
@@ -32,14 +33,24 @@
 #include "dbus-battery.h"
 #include "dbus-shared.h"
 #include "notifier.h"
+#include "power-level.h"
 #include "utils.h"
 
-#include <libnotify/notify.h>
-
 #include <glib/gi18n.h>
 
 #include <stdint.h> /* UINT32_MAX */
+#include <string.h> /* memcpy() */
+
+#define NOTIFY_BUSNAME "org.freedesktop.Notifications"
+#define NOTIFY_PATH "/org/freedesktop/Notifications"
+#define NOTIFY_IFACE "org.freedesktop.Notifications"
+
+#define BATTERY_IFACE "org.ayatana.indicator.power.Battery"
 
+/* keep one client from filling our memory with watches */
+#define MAX_WATCHES_PER_CLIENT 64
+
+/* these double as indices into power_levels[] */
 typedef enum
 {
   POWER_LEVEL_CRITICAL,
@@ -49,6 +60,16 @@ typedef enum
 }
 PowerLevel;
 
+/* the hysteresis keeps a percentage that wobbles around a threshold
+   from flipping PowerLevel and IsWarning back and forth. The bands are
+   a full 1% so that devices reporting whole percentages are covered */
+static const IndicatorPowerLevelSpec power_levels[] =
+{
+  {  2.0, 1.0 }, /* POWER_LEVEL_CRITICAL */
+  {  5.0, 1.0 }, /* POWER_LEVEL_VERY_LOW */
+  { 10.0, 1.0 }  /* POWER_LEVEL_LOW */
+};
+
 /**
 ***  GObject Properties
 **/
@@ -64,8 +85,6 @@ enum
 
 static GParamSpec * properties[LAST_PROP];
 
-static int instance_count = 0;
-
 /**
 ***
 **/
@@ -78,17 +97,50 @@ typedef struct
      See indicator_power_service_choose_primary_device() and
      bug #880881 */
   IndicatorPowerDevice * battery;
+  IndicatorPowerLevelEngine * levels;
   PowerLevel power_level;
   gboolean discharging;
 
-  NotifyNotification * notify_notification;
+  /* the notification we're showing, or 0 if none */
+  guint32 notification_id;
+
+  /* a Notify call that hasn't returned yet */
+  struct _NotifyRequest * pending_request;
 
   GDBusConnection * bus;
   DbusBattery * dbus_battery; /* org.ayatana.indicator.power.Battery skeleton */
 
-  gboolean caps_queried;
+  /* the values the skeleton will get on the next flush */
+  PowerLevel staged_power_level;
+  gboolean staged_is_warning;
+  gdouble staged_percentage;
+  UpDeviceState staged_state;
+  gint64 staged_time_remaining;
+  gboolean staged_on_line_power;
+  guint staged_device_count;
+  guint battery_flush_tag;
+
+  /* the clients' threshold watches, the name watch ids of the clients
+     that have any, and the values the watches were last checked against */
+  IndicatorPowerWatchList * watches;
+  GHashTable * watch_clients;
+  gdouble watch_values[INDICATOR_POWER_WATCH_N_PROPERTIES];
+  gboolean have_watch_values;
+  gboolean have_watch_time;
+
+  /* the notification server's capabilities, probed asynchronously
+     at startup and again whenever the server's name owner changes */
+  GDBusConnection * session_bus;
+  guint notify_name_watch_id;
+  guint notify_signal_tag;
+  GCancellable * caps_cancellable;
+  gboolean notifications_started;
+  gboolean caps_pending;
   gboolean actions_supported;
 
+  /* a notification that's waiting for the caps probe to finish */
+  gboolean show_when_caps_ready;
+
   GCancellable * cancellable;
   #ifdef LOMIRI_FEATURES_ENABLED
   DbusAccountsServiceSound * accounts_service_sound_proxy;
@@ -121,32 +173,6 @@ power_level_to_dbus_string (const PowerLevel power_level)
     }
 }
 
-static PowerLevel
-get_battery_power_level (IndicatorPowerDevice * battery)
-{
-  static const double percent_critical = 2.0;
-  static const double percent_very_low = 5.0;
-  static const double percent_low = 10.0;
-  gdouble p;
-  PowerLevel ret;
-
-  g_return_val_if_fail(battery != NULL, POWER_LEVEL_OK);
-  g_return_val_if_fail(indicator_power_device_get_kind(battery) == UP_DEVICE_KIND_BATTERY, POWER_LEVEL_OK);
-
-  p = indicator_power_device_get_percentage(battery);
-
-  if (p <= percent_critical)
-    ret = POWER_LEVEL_CRITICAL;
-  else if (p <= percent_very_low)
-    ret = POWER_LEVEL_VERY_LOW;
-  else if (p <= percent_low)
-    ret = POWER_LEVEL_LOW;
-  else
-    ret = POWER_LEVEL_OK;
-
-  return ret;
-}
-
 /***
 ****  Sounds
 ***/
@@ -200,83 +226,297 @@ silent_mode (IndicatorPowerNotifier * self)
 #endif
 
 /***
-****  Notifications
+****  org.ayatana.indicator.power.Battery
+****
+****  Changes are staged here and pushed to the skeleton from an idle, so
+****  everything that changes in one main loop iteration goes out in a
+****  single PropertiesChanged and a value that changes back in the
+****  meantime (e.g. IsWarning when a notification is replaced) isn't
+****  sent at all.
 ***/
 
+static gboolean
+on_battery_flush_idle (gpointer gself)
+{
+  priv_t * const p = get_priv (INDICATOR_POWER_NOTIFIER(gself));
+  const char * power_level;
+  gboolean changed = FALSE;
+
+  p->battery_flush_tag = 0;
+
+  power_level = power_level_to_dbus_string (p->staged_power_level);
+  if (g_strcmp0 (dbus_battery_get_power_level (p->dbus_battery), power_level))
+    {
+      dbus_battery_set_power_level (p->dbus_battery, power_level);
+      changed = TRUE;
+    }
+
+  if (!dbus_battery_get_is_warning (p->dbus_battery) != !p->staged_is_warning)
+    {
+      dbus_battery_set_is_warning (p->dbus_battery, p->staged_is_warning);
+      changed = TRUE;
+    }
+
+  if (dbus_battery_get_percentage (p->dbus_battery) != p->staged_percentage)
+    {
+      dbus_battery_set_percentage (p->dbus_battery, p->staged_percentage);
+      changed = TRUE;
+    }
+
+  if (dbus_battery_get_state (p->dbus_battery) != (guint)p->staged_state)
+    {
+      dbus_battery_set_state (p->dbus_battery, p->staged_state);
+      changed = TRUE;
+    }
+
+  if (dbus_battery_get_time_remaining (p->dbus_battery) != p->staged_time_remaining)
+    {
+      dbus_battery_set_time_remaining (p->dbus_battery, p->staged_time_remaining);
+      changed = TRUE;
+    }
+
+  if (!dbus_battery_get_on_line_power (p->dbus_battery) != !p->staged_on_line_power)
+    {
+      dbus_battery_set_on_line_power (p->dbus_battery, p->staged_on_line_power);
+      changed = TRUE;
+    }
+
+  if (dbus_battery_get_device_count (p->dbus_battery) != p->staged_device_count)
+    {
+      dbus_battery_set_device_count (p->dbus_battery, p->staged_device_count);
+      changed = TRUE;
+    }
+
+  if (changed)
+    g_dbus_interface_skeleton_flush (G_DBUS_INTERFACE_SKELETON(p->dbus_battery));
+
+  return G_SOURCE_REMOVE;
+}
+
 static void
-on_notify_notification_finalized (gpointer gself, GObject * dead)
+battery_schedule_flush (IndicatorPowerNotifier * self)
 {
-  IndicatorPowerNotifier * const self = INDICATOR_POWER_NOTIFIER(gself);
-  priv_t * const p = get_priv(self);
-  g_return_if_fail ((void*)(p->notify_notification) == (void*)dead);
-  p->notify_notification = NULL;
-  dbus_battery_set_is_warning (p->dbus_battery, FALSE);
+  priv_t * const p = get_priv (self);
+
+  if (p->battery_flush_tag == 0)
+    p->battery_flush_tag = g_idle_add (on_battery_flush_idle, self);
 }
 
 static void
-notification_clear (IndicatorPowerNotifier * self)
+battery_set_power_level (IndicatorPowerNotifier * self, PowerLevel power_level)
 {
-  priv_t * const p = get_priv(self);
-  NotifyNotification * nn;
+  priv_t * const p = get_priv (self);
 
-  if ((nn = p->notify_notification))
-    {
-      GError * error = NULL;
+  if (p->staged_power_level == power_level)
+    return;
 
-      g_object_weak_unref(G_OBJECT(nn), on_notify_notification_finalized, self);
+  p->staged_power_level = power_level;
+  battery_schedule_flush (self);
+}
 
-      if (!notify_notification_close(nn, &error))
-        {
-          g_warning("Unable to close notification: %s", error->message);
-          g_error_free(error);
-        }
+static void
+battery_set_is_warning (IndicatorPowerNotifier * self, gboolean is_warning)
+{
+  priv_t * const p = get_priv (self);
 
-      p->notify_notification = NULL;
-      dbus_battery_set_is_warning (p->dbus_battery, FALSE);
+  if (!p->staged_is_warning == !is_warning)
+    return;
+
+  p->staged_is_warning = is_warning;
+  battery_schedule_flush (self);
+}
+
+/* stage Percentage, State and TimeRemaining from our battery */
+static void
+battery_stage_device (IndicatorPowerNotifier * self)
+{
+  priv_t * const p = get_priv (self);
+  gdouble percentage = 0.0;
+  UpDeviceState state = UP_DEVICE_STATE_UNKNOWN;
+  gint64 time_remaining = 0;
+
+  if (p->battery != NULL)
+    {
+      percentage = indicator_power_device_get_percentage (p->battery);
+      state = indicator_power_device_get_state (p->battery);
+      time_remaining = indicator_power_device_get_time (p->battery);
     }
+
+  if ((p->staged_percentage == percentage) &&
+      (p->staged_state == state) &&
+      (p->staged_time_remaining == time_remaining))
+    return;
+
+  p->staged_percentage = percentage;
+  p->staged_state = state;
+  p->staged_time_remaining = time_remaining;
+  battery_schedule_flush (self);
+}
+
+/***
+****  Notifications
+***/
+
+/**
+ * A Notify call in flight.
+ *
+ * If the notification is cleared before the server replies, 'self' is
+ * set to NULL and the notification is closed as soon as we learn its ID.
+ */
+typedef struct _NotifyRequest
+{
+  IndicatorPowerNotifier * self;
 }
+NotifyRequest;
 
 static void
-on_battery_settings_clicked(NotifyNotification * nn        G_GNUC_UNUSED,
-                            char               * action    G_GNUC_UNUSED,
-                            gpointer             user_data G_GNUC_UNUSED)
+on_close_notification_response(GObject      * bus,
+                               GAsyncResult * res,
+                               gpointer       unused G_GNUC_UNUSED)
 {
-  utils_handle_settings_request();
+  GError * error = NULL;
+  GVariant * v;
+
+  v = g_dbus_connection_call_finish(G_DBUS_CONNECTION(bus), res, &error);
+  if (error != NULL)
+    {
+      if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        g_warning("Unable to close notification: %s", error->message);
+
+      g_error_free(error);
+    }
+
+  g_clear_pointer(&v, g_variant_unref);
 }
 
 static void
-on_dismiss_clicked(NotifyNotification * nn        G_GNUC_UNUSED,
-                   char               * action    G_GNUC_UNUSED,
-                   gpointer             user_data G_GNUC_UNUSED)
+close_notification(GDBusConnection * bus, guint32 id)
 {
-  /* no-op; libnotify warns if we have a NULL action callback */
+  /* no cancellable: this must get through even if we're shutting down */
+  g_dbus_connection_call(bus,
+                         NOTIFY_BUSNAME,
+                         NOTIFY_PATH,
+                         NOTIFY_IFACE,
+                         "CloseNotification",
+                         g_variant_new("(u)", id),
+                         NULL,
+                         G_DBUS_CALL_FLAGS_NONE,
+                         -1,
+                         NULL,
+                         on_close_notification_response,
+                         NULL);
 }
 
-static gboolean
-are_actions_supported(IndicatorPowerNotifier * self)
+static void
+notification_clear (IndicatorPowerNotifier * self)
 {
   priv_t * const p = get_priv(self);
+  gboolean had_notification = FALSE;
+
+  p->show_when_caps_ready = FALSE;
 
-  if (!p->caps_queried)
+  if (p->pending_request != NULL)
     {
-      gboolean actions_supported;
-      GList * caps;
-      GList * l;
+      /* on_notify_response() will close it */
+      p->pending_request->self = NULL;
+      p->pending_request = NULL;
+      had_notification = TRUE;
+    }
 
-      /* see if actions are supported */
-      actions_supported = FALSE;
-      caps = notify_get_server_caps();
-      for (l=caps; l!=NULL && !actions_supported; l=l->next)
-        if (!g_strcmp0(l->data, "actions"))
-          actions_supported = TRUE;
+  if (p->notification_id != 0)
+    {
+      close_notification(p->session_bus, p->notification_id);
+      p->notification_id = 0;
+      had_notification = TRUE;
+    }
 
-      p->actions_supported = actions_supported;
-      p->caps_queried = TRUE;
+  if (had_notification)
+    battery_set_is_warning (self, FALSE);
+}
+
+static void
+on_notify_response(GObject      * bus,
+                   GAsyncResult * res,
+                   gpointer       grequest)
+{
+  NotifyRequest * request = grequest;
+  GError * error = NULL;
+  GVariant * v;
+
+  v = g_dbus_connection_call_finish(G_DBUS_CONNECTION(bus), res, &error);
+  if (v != NULL)
+    {
+      guint32 id = 0;
+      g_variant_get(v, "(u)", &id);
+
+      if (request->self != NULL)
+        {
+          priv_t * const p = get_priv(request->self);
+          p->pending_request = NULL;
+          p->notification_id = id;
+        }
+      else /* it was cleared before the server answered */
+        {
+          close_notification(G_DBUS_CONNECTION(bus), id);
+        }
+
+      g_variant_unref(v);
+    }
+  else
+    {
+      if (request->self != NULL)
+        {
+          priv_t * const p = get_priv(request->self);
+          p->pending_request = NULL;
+          battery_set_is_warning (request->self, FALSE);
+          g_critical("Unable to show snap decision: %s", error->message);
+        }
+
+      g_error_free(error);
+    }
+
+  g_free(request);
+}
+
+static void
+on_notify_signal(GDBusConnection * bus          G_GNUC_UNUSED,
+                 const gchar     * sender_name  G_GNUC_UNUSED,
+                 const gchar     * object_path  G_GNUC_UNUSED,
+                 const gchar     * interface    G_GNUC_UNUSED,
+                 const gchar     * signal_name,
+                 GVariant        * parameters,
+                 gpointer          gself)
+{
+  priv_t * const p = get_priv(INDICATOR_POWER_NOTIFIER(gself));
+  guint32 id = 0;
+
+  if (!g_strcmp0(signal_name, "ActionInvoked") &&
+      g_variant_is_of_type(parameters, G_VARIANT_TYPE("(us)")))
+    {
+      const gchar * action = NULL;
+      g_variant_get(parameters, "(u&s)", &id, &action);
+
+      /* "dismiss" is a no-op; the server closes it for us */
+      if ((id != 0) && (id == p->notification_id) && !g_strcmp0(action, "settings"))
+        utils_handle_settings_request();
+    }
+  else if (!g_strcmp0(signal_name, "NotificationClosed") &&
+           g_variant_is_of_type(parameters, G_VARIANT_TYPE("(uu)")))
+    {
+      g_variant_get(parameters, "(uu)", &id, NULL);
 
-      g_list_free_full(caps, g_free);
+      if ((id != 0) && (id == p->notification_id))
+        {
+          p->notification_id = 0;
+          battery_set_is_warning (INDICATOR_POWER_NOTIFIER(gself), FALSE);
+        }
     }
+}
 
-  return p->actions_supported;
+static gboolean
+are_actions_supported(IndicatorPowerNotifier * self)
+{
+  return get_priv(self)->actions_supported;
 }
 
 static void
@@ -288,14 +528,27 @@ notification_show(IndicatorPowerNotifier * self)
   char * body;
   GStrv icon_names;
   const char * icon_name;
-  NotifyNotification * nn;
-  GError * error;
-  const PowerLevel power_level = get_battery_power_level(p->battery);
+  GVariantBuilder actions;
+  GVariantBuilder hints;
+  gint32 expire_timeout;
+  NotifyRequest * request;
+  const PowerLevel power_level = p->power_level;
 
   notification_clear(self);
 
   g_return_if_fail(power_level != POWER_LEVEL_OK);
 
+  /* don't block on the server's caps; show it when we have them */
+  if (p->caps_pending)
+    {
+      p->show_when_caps_ready = TRUE;
+      return;
+    }
+
+  /* no session bus, so nowhere to show it */
+  if (p->session_bus == NULL)
+    return;
+
   /* create the notification */
   title = power_level == POWER_LEVEL_LOW
         ? _("Battery Low")
@@ -306,10 +559,11 @@ notification_show(IndicatorPowerNotifier * self)
   if (icon_names && *icon_names)
     icon_name = icon_names[0];
   else
-    icon_name = NULL;
-  nn = notify_notification_new(title, body, icon_name);
-  g_strfreev (icon_names);
-  g_free (body);
+    icon_name = "";
+
+  g_variant_builder_init(&actions, G_VARIANT_TYPE_STRING_ARRAY);
+  g_variant_builder_init(&hints, G_VARIANT_TYPE_VARDICT);
+  expire_timeout = -1; /* the server's default */
 
   if (are_actions_supported(self))
     {
@@ -321,42 +575,396 @@ notification_show(IndicatorPowerNotifier * self)
           if (filename != NULL)
             {
               gchar * uri = g_filename_to_uri(filename, NULL, NULL);
-              notify_notification_set_hint(nn, "sound-file", g_variant_new_take_string(uri));
+              g_variant_builder_add(&hints, "{sv}", "sound-file", g_variant_new_take_string(uri));
               g_clear_pointer(&filename, g_free);
             }
           else
             {
               g_message("Unable to find '%s' in XDG data dirs, falling back to %s/notifications/", LOMIRI_SOUNDSDIR, LOW_BATTERY_SOUND);
-              notify_notification_set_hint(nn, "sound-file", g_variant_new_string("file://" LOMIRI_SOUNDSDIR "/notifications/" LOW_BATTERY_SOUND));
+              g_variant_builder_add(&hints, "{sv}", "sound-file", g_variant_new_string("file://" LOMIRI_SOUNDSDIR "/notifications/" LOW_BATTERY_SOUND));
             }
         }
 
-      notify_notification_set_hint(nn, "x-lomiri-snap-decisions", g_variant_new_string("true"));
-      notify_notification_set_hint(nn, "x-lomiri-non-shaped-icon", g_variant_new_string("true"));
-      notify_notification_set_hint(nn, "x-lomiri-private-affirmative-tint", g_variant_new_string("true"));
-      notify_notification_set_hint(nn, "x-lomiri-snap-decisions-timeout", g_variant_new_int32(INT32_MAX));
-      notify_notification_set_timeout(nn, NOTIFY_EXPIRES_NEVER);
-      notify_notification_add_action(nn, "dismiss", _("OK"), on_dismiss_clicked, NULL, NULL);
-      notify_notification_add_action(nn, "settings", _("Battery settings"), on_battery_settings_clicked, NULL, NULL);
+      g_variant_builder_add(&hints, "{sv}", "x-lomiri-snap-decisions", g_variant_new_string("true"));
+      g_variant_builder_add(&hints, "{sv}", "x-lomiri-non-shaped-icon", g_variant_new_string("true"));
+      g_variant_builder_add(&hints, "{sv}", "x-lomiri-private-affirmative-tint", g_variant_new_string("true"));
+      g_variant_builder_add(&hints, "{sv}", "x-lomiri-snap-decisions-timeout", g_variant_new_int32(INT32_MAX));
+      expire_timeout = 0; /* never */
+      g_variant_builder_add(&actions, "s", "dismiss");
+      g_variant_builder_add(&actions, "s", _("OK"));
+      g_variant_builder_add(&actions, "s", "settings");
+      g_variant_builder_add(&actions, "s", _("Battery settings"));
     }
 
-  /* if we can show it, keep it */
-  error = NULL;
-  if (notify_notification_show(nn, &error))
+  request = g_new0(NotifyRequest, 1);
+  request->self = self;
+  p->pending_request = request;
+
+  g_dbus_connection_call(p->session_bus,
+                         NOTIFY_BUSNAME,
+                         NOTIFY_PATH,
+                         NOTIFY_IFACE,
+                         "Notify",
+                         g_variant_new("(susssasa{sv}i)",
+                                       SERVICE_EXEC,
+                                       (guint32)0, /* replaces_id */
+                                       icon_name,
+                                       title,
+                                       body,
+                                       &actions,
+                                       &hints,
+                                       expire_timeout),
+                         G_VARIANT_TYPE("(u)"),
+                         G_DBUS_CALL_FLAGS_NONE,
+                         -1,
+                         NULL, /* see NotifyRequest */
+                         on_notify_response,
+                         request);
+
+  /* assume it'll be shown; on_notify_response() unsets this if it isn't */
+  battery_set_is_warning (self, TRUE);
+
+  g_strfreev (icon_names);
+  g_free (body);
+}
+
+/***
+****  Notification server capabilities
+***/
+
+static void
+on_caps_ready(IndicatorPowerNotifier * self)
+{
+  priv_t * const p = get_priv(self);
+
+  p->caps_pending = FALSE;
+
+  if (p->show_when_caps_ready)
+    {
+      p->show_when_caps_ready = FALSE;
+      notification_show(self);
+    }
+}
+
+static void
+on_get_capabilities_response(GObject      * bus,
+                             GAsyncResult * res,
+                             gpointer       gself)
+{
+  GError * error = NULL;
+  GVariant * v;
+
+  v = g_dbus_connection_call_finish(G_DBUS_CONNECTION(bus), res, &error);
+  if (error != NULL)
     {
-      p->notify_notification = nn;
-      g_signal_connect(nn, "closed", G_CALLBACK(g_object_unref), NULL);
-      g_object_weak_ref(G_OBJECT(nn), on_notify_notification_finalized, self);
-      dbus_battery_set_is_warning (p->dbus_battery, TRUE);
+      if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        {
+          g_debug("Unable to get notification server caps: %s", error->message);
+          get_priv(gself)->actions_supported = FALSE;
+          on_caps_ready(INDICATOR_POWER_NOTIFIER(gself));
+        }
+
+      g_error_free(error);
     }
   else
     {
-      g_critical("Unable to show snap decision for '%s': %s", body, error->message);
+      priv_t * const p = get_priv(gself);
+      const gchar ** caps = NULL;
+      gboolean actions_supported = FALSE;
+      guint i;
+
+      /* see if actions are supported */
+      g_variant_get(v, "(^a&s)", &caps);
+      for (i=0; caps!=NULL && caps[i]!=NULL && !actions_supported; ++i)
+        if (!g_strcmp0(caps[i], "actions"))
+          actions_supported = TRUE;
+      p->actions_supported = actions_supported;
+      g_free(caps);
+      g_variant_unref(v);
+
+      on_caps_ready(INDICATOR_POWER_NOTIFIER(gself));
+    }
+}
+
+static void
+on_notify_name_appeared(GDBusConnection * bus,
+                        const gchar     * name       G_GNUC_UNUSED,
+                        const gchar     * name_owner,
+                        gpointer          gself)
+{
+  priv_t * const p = get_priv(gself);
+
+  g_debug("notification server is now '%s'; querying its caps", name_owner);
+
+  /* a new server may have different caps, so ask again */
+  if (p->caps_cancellable != NULL)
+    {
+      g_cancellable_cancel(p->caps_cancellable);
+      g_object_unref(p->caps_cancellable);
+    }
+  p->caps_cancellable = g_cancellable_new();
+  p->caps_pending = TRUE;
+
+  g_dbus_connection_call(bus,
+                         name_owner,
+                         NOTIFY_PATH,
+                         NOTIFY_IFACE,
+                         "GetCapabilities",
+                         NULL,
+                         G_VARIANT_TYPE("(as)"),
+                         G_DBUS_CALL_FLAGS_NONE,
+                         -1,
+                         p->caps_cancellable,
+                         on_get_capabilities_response,
+                         gself);
+}
+
+static void
+on_notify_name_vanished(GDBusConnection * bus   G_GNUC_UNUSED,
+                        const gchar     * name  G_GNUC_UNUSED,
+                        gpointer          gself)
+{
+  priv_t * const p = get_priv(gself);
+
+  if (p->caps_cancellable != NULL)
+    {
+      g_cancellable_cancel(p->caps_cancellable);
+      g_clear_object(&p->caps_cancellable);
+    }
+
+  /* no server, so no actions; but don't hold notifications back */
+  p->actions_supported = FALSE;
+  on_caps_ready(INDICATOR_POWER_NOTIFIER(gself));
+}
+
+static void
+on_session_bus_ready(GObject      * source_object G_GNUC_UNUSED,
+                     GAsyncResult * res,
+                     gpointer       gself)
+{
+  GError * error = NULL;
+  GDBusConnection * bus;
+
+  bus = g_bus_get_finish(res, &error);
+  if (error != NULL)
+    {
+      if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        {
+          g_warning("Unable to get session bus: %s", error->message);
+          on_caps_ready(INDICATOR_POWER_NOTIFIER(gself));
+        }
+
       g_error_free(error);
-      g_object_unref(nn);
+    }
+  else
+    {
+      priv_t * const p = get_priv(gself);
+
+      p->session_bus = bus;
+      p->notify_signal_tag = g_dbus_connection_signal_subscribe(bus,
+                                                                NOTIFY_BUSNAME,
+                                                                NOTIFY_IFACE,
+                                                                NULL, /* ActionInvoked and NotificationClosed */
+                                                                NOTIFY_PATH,
+                                                                NULL,
+                                                                G_DBUS_SIGNAL_FLAGS_NONE,
+                                                                on_notify_signal,
+                                                                gself,
+                                                                NULL);
+      p->notify_name_watch_id = g_bus_watch_name_on_connection(bus,
+                                                               NOTIFY_BUSNAME,
+                                                               G_BUS_NAME_WATCHER_FLAGS_AUTO_START,
+                                                               on_notify_name_appeared,
+                                                               on_notify_name_vanished,
+                                                               gself,
+                                                               NULL);
     }
 }
 
+/***
+****  Threshold watches
+***/
+
+static void
+on_watch_client_vanished (GDBusConnection * connection G_GNUC_UNUSED,
+                          const gchar     * name,
+                          gpointer          gself)
+{
+  priv_t * const p = get_priv (INDICATOR_POWER_NOTIFIER(gself));
+
+  g_debug ("%s left the bus; dropping its watches", name);
+  indicator_power_watch_list_remove_owner (p->watches, name);
+  g_hash_table_remove (p->watch_clients, name); /* unwatches the name */
+}
+
+static void
+watch_client (IndicatorPowerNotifier * self,
+              GDBusConnection        * connection,
+              const gchar            * sender)
+{
+  priv_t * const p = get_priv (self);
+  guint tag;
+
+  if (g_hash_table_contains (p->watch_clients, sender))
+    return;
+
+  tag = g_bus_watch_name_on_connection (connection,
+                                        sender,
+                                        G_BUS_NAME_WATCHER_FLAGS_NONE,
+                                        NULL,
+                                        on_watch_client_vanished,
+                                        self,
+                                        NULL);
+  g_hash_table_insert (p->watch_clients, g_strdup (sender), GUINT_TO_POINTER (tag));
+}
+
+static void
+unwatch_client (gpointer gtag)
+{
+  g_bus_unwatch_name (GPOINTER_TO_UINT (gtag));
+}
+
+static gboolean
+on_handle_add_watch (DbusBattery           * skeleton,
+                     GDBusMethodInvocation * invocation,
+                     const gchar           * property_name,
+                     const gchar           * comparison_name,
+                     gdouble                 threshold,
+                     gpointer                gself)
+{
+  IndicatorPowerNotifier * const self = INDICATOR_POWER_NOTIFIER(gself);
+  priv_t * const p = get_priv (self);
+  const gchar * sender = g_dbus_method_invocation_get_sender (invocation);
+  IndicatorPowerWatchProperty property;
+  IndicatorPowerWatchComparison comparison;
+  guint32 id;
+
+  if (!indicator_power_watch_property_from_string (property_name, &property))
+    {
+      g_dbus_method_invocation_return_error (invocation, G_DBUS_ERROR, G_DBUS_ERROR_INVALID_ARGS,
+                                             "Unknown property '%s'", property_name);
+      return TRUE;
+    }
+
+  if (!indicator_power_watch_comparison_from_string (comparison_name, &comparison))
+    {
+      g_dbus_method_invocation_return_error (invocation, G_DBUS_ERROR, G_DBUS_ERROR_INVALID_ARGS,
+                                             "Unknown comparison '%s'", comparison_name);
+      return TRUE;
+    }
+
+  if (sender == NULL)
+    {
+      g_dbus_method_invocation_return_error (invocation, G_DBUS_ERROR, G_DBUS_ERROR_NOT_SUPPORTED,
+                                             "Watches need a message bus connection");
+      return TRUE;
+    }
+
+  if (indicator_power_watch_list_count_owner (p->watches, sender) >= MAX_WATCHES_PER_CLIENT)
+    {
+      g_dbus_method_invocation_return_error (invocation, G_DBUS_ERROR, G_DBUS_ERROR_LIMITS_EXCEEDED,
+                                             "No more than %d watches per client", MAX_WATCHES_PER_CLIENT);
+      return TRUE;
+    }
+
+  id = indicator_power_watch_list_add (p->watches, sender, property, comparison, threshold);
+  watch_client (self, g_dbus_method_invocation_get_connection (invocation), sender);
+  dbus_battery_complete_add_watch (skeleton, invocation, id);
+  return TRUE;
+}
+
+static gboolean
+on_handle_remove_watch (DbusBattery           * skeleton,
+                        GDBusMethodInvocation * invocation,
+                        guint32                 id,
+                        gpointer                gself)
+{
+  priv_t * const p = get_priv (INDICATOR_POWER_NOTIFIER(gself));
+  const gchar * sender = g_dbus_method_invocation_get_sender (invocation);
+
+  if (!indicator_power_watch_list_remove (p->watches, sender, id))
+    {
+      g_dbus_method_invocation_return_error (invocation, G_DBUS_ERROR, G_DBUS_ERROR_INVALID_ARGS,
+                                             "No such watch: %u", id);
+      return TRUE;
+    }
+
+  if (indicator_power_watch_list_count_owner (p->watches, sender) == 0)
+    g_hash_table_remove (p->watch_clients, sender);
+
+  dbus_battery_complete_remove_watch (skeleton, invocation);
+  return TRUE;
+}
+
+static void
+on_watch_fired (const gchar * owner,
+                guint32       id,
+                gdouble       value,
+                gpointer      gself)
+{
+  priv_t * const p = get_priv (INDICATOR_POWER_NOTIFIER(gself));
+  GError * error = NULL;
+
+  if (p->bus == NULL)
+    return;
+
+  /* only the client that asked for it gets the signal */
+  g_dbus_connection_emit_signal (p->bus,
+                                 owner,
+                                 BUS_PATH"/Battery",
+                                 BATTERY_IFACE,
+                                 "WatchFired",
+                                 g_variant_new ("(ud)", id, value),
+                                 &error);
+  if (error != NULL)
+    {
+      g_warning ("Unable to send WatchFired to %s: %s", owner, error->message);
+      g_error_free (error);
+    }
+}
+
+static void
+evaluate_watches (IndicatorPowerNotifier * self)
+{
+  priv_t * const p = get_priv (self);
+  gdouble values[INDICATOR_POWER_WATCH_N_PROPERTIES];
+  const UpDeviceState state = indicator_power_device_get_state (p->battery);
+  const time_t time = indicator_power_device_get_time (p->battery);
+
+  /* TimeRemaining watches follow the time until empty. UPower reports 0
+     when it has no estimate, e.g. just after a state change or a resume,
+     so hold the last real value until it has one again */
+  const gboolean have_time = (time > 0) && (state == UP_DEVICE_STATE_DISCHARGING);
+
+  values[INDICATOR_POWER_WATCH_PERCENTAGE] = indicator_power_device_get_percentage (p->battery);
+  values[INDICATOR_POWER_WATCH_TIME_REMAINING] = have_time ? time : p->watch_values[INDICATOR_POWER_WATCH_TIME_REMAINING];
+  values[INDICATOR_POWER_WATCH_STATE] = state;
+
+  if (p->have_watch_values)
+    {
+      gdouble old_values[INDICATOR_POWER_WATCH_N_PROPERTIES];
+
+      memcpy (old_values, p->watch_values, sizeof (old_values));
+
+      /* nothing crosses a threshold from an unknown time */
+      if (!p->have_watch_time)
+        old_values[INDICATOR_POWER_WATCH_TIME_REMAINING] = values[INDICATOR_POWER_WATCH_TIME_REMAINING];
+
+      indicator_power_watch_list_evaluate (p->watches, old_values, values, on_watch_fired, self);
+    }
+
+  memcpy (p->watch_values, values, sizeof (values));
+  p->have_watch_values = TRUE;
+  p->have_watch_time |= have_time;
+}
+
+static void
+on_battery_time_changed (IndicatorPowerNotifier * self)
+{
+  battery_stage_device (self);
+  evaluate_watches (self);
+}
+
 /***
 ****
 ***/
@@ -375,7 +983,9 @@ on_battery_property_changed (IndicatorPowerNotifier * self)
   g_return_if_fail(INDICATOR_IS_POWER_DEVICE(p->battery));
 
   old_power_level = p->power_level;
-  new_power_level = get_battery_power_level (p->battery);
+  indicator_power_level_engine_update (p->levels, indicator_power_device_get_percentage (p->battery));
+  new_power_level = (PowerLevel) indicator_power_level_engine_get_level (p->levels);
+  p->power_level = new_power_level;
 
   old_discharging = p->discharging;
   new_discharging = indicator_power_device_get_state(p->battery) == UP_DEVICE_STATE_DISCHARGING;
@@ -393,8 +1003,9 @@ on_battery_property_changed (IndicatorPowerNotifier * self)
       notification_clear (self);
     }
 
-  dbus_battery_set_power_level (p->dbus_battery, power_level_to_dbus_string (new_power_level));
-  p->power_level = new_power_level;
+  battery_set_power_level (self, new_power_level);
+  battery_stage_device (self);
+  evaluate_watches (self);
   p->discharging = new_discharging;
 }
 
@@ -453,9 +1064,39 @@ my_dispose (GObject * o)
       g_clear_object(&p->cancellable);
     }
 
-  indicator_power_notifier_set_bus (self, NULL);
+  if (p->caps_cancellable != NULL)
+    {
+      g_cancellable_cancel(p->caps_cancellable);
+      g_clear_object(&p->caps_cancellable);
+    }
+
+  /* close our notification while we still have the bus */
   notification_clear (self);
+
+  if (p->notify_name_watch_id != 0)
+    {
+      g_bus_unwatch_name(p->notify_name_watch_id);
+      p->notify_name_watch_id = 0;
+    }
+
+  if (p->notify_signal_tag != 0)
+    {
+      g_dbus_connection_signal_unsubscribe(p->session_bus, p->notify_signal_tag);
+      p->notify_signal_tag = 0;
+    }
+
+  g_clear_object(&p->session_bus);
+
+  indicator_power_notifier_set_bus (self, NULL);
   indicator_power_notifier_set_battery (self, NULL);
+  g_clear_pointer (&p->watch_clients, g_hash_table_destroy);
+
+  if (p->battery_flush_tag != 0)
+    {
+      g_source_remove (p->battery_flush_tag);
+      p->battery_flush_tag = 0;
+    }
+
   g_clear_object (&p->dbus_battery);
 
   #ifdef LOMIRI_FEATURES_ENABLED
@@ -466,34 +1107,39 @@ my_dispose (GObject * o)
 }
 
 static void
-my_finalize (GObject * o G_GNUC_UNUSED)
+my_finalize (GObject * o)
 {
-  /* FIXME: This is an awkward place to put this.
-     Ordinarily something like this would go in main(), but we need libnotify
-     to clean itself up before shutting down the bus in the unit tests as well. */
-  if (!--instance_count)
-    notify_uninit();
+  priv_t * const p = get_priv (INDICATOR_POWER_NOTIFIER(o));
+
+  indicator_power_level_engine_free (p->levels);
+  indicator_power_watch_list_free (p->watches);
+
+  G_OBJECT_CLASS (indicator_power_notifier_parent_class)->finalize (o);
 }
 
+
 /***
 ****  Instantiation
 ***/
 
+/* Get ready to show notifications. This waits for the first battery
+   because machines without one never need any of it. */
 static void
-indicator_power_notifier_init (IndicatorPowerNotifier * self)
+start_notifications (IndicatorPowerNotifier * self)
 {
   priv_t * const p = get_priv (self);
 
-  /* bind the read-only properties so they'll get pushed to the bus */
-
-  p->dbus_battery = dbus_battery_skeleton_new ();
+  if (p->notifications_started)
+    return;
 
-  p->power_level = POWER_LEVEL_OK;
+  p->notifications_started = TRUE;
 
-  p->cancellable = g_cancellable_new();
+  /* start probing the notification server's caps now,
+     so that we don't have to block on them later */
+  g_bus_get(G_BUS_TYPE_SESSION, p->cancellable, on_session_bus_ready, self);
 
-  if (!instance_count++ && !notify_init(SERVICE_EXEC))
-    g_critical("Unable to initialize libnotify! Notifications might not be shown.");
+  /* index the sound files now so showing a warning doesn't hit the disk */
+  datafile_index_init();
 
   #ifdef LOMIRI_FEATURES_ENABLED
   p->accounts_service_sound_proxy_pending = TRUE;
@@ -510,6 +1156,35 @@ indicator_power_notifier_init (IndicatorPowerNotifier * self)
   #endif
 }
 
+static void
+indicator_power_notifier_init (IndicatorPowerNotifier * self)
+{
+  priv_t * const p = get_priv (self);
+
+  /* bind the read-only properties so they'll get pushed to the bus */
+
+  p->dbus_battery = dbus_battery_skeleton_new ();
+  p->staged_power_level = POWER_LEVEL_OK;
+  dbus_battery_set_power_level (p->dbus_battery, power_level_to_dbus_string (POWER_LEVEL_OK));
+  p->staged_on_line_power = TRUE;
+  dbus_battery_set_on_line_power (p->dbus_battery, TRUE);
+
+  p->watches = indicator_power_watch_list_new ();
+  p->watch_clients = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, unwatch_client);
+  g_signal_connect (p->dbus_battery, "handle-add-watch",
+                    G_CALLBACK(on_handle_add_watch), self);
+  g_signal_connect (p->dbus_battery, "handle-remove-watch",
+                    G_CALLBACK(on_handle_remove_watch), self);
+
+  p->levels = indicator_power_level_engine_new (power_levels, G_N_ELEMENTS(power_levels));
+  p->power_level = POWER_LEVEL_OK;
+
+  p->cancellable = g_cancellable_new();
+
+  /* nothing's known about the server until start_notifications() asks */
+  p->caps_pending = TRUE;
+}
+
 static void
 indicator_power_notifier_class_init (IndicatorPowerNotifierClass * klass)
 {
@@ -560,17 +1235,23 @@ indicator_power_notifier_set_battery (IndicatorPowerNotifier * self,
     {
       g_signal_handlers_disconnect_by_data (p->battery, self);
       g_clear_object (&p->battery);
-      dbus_battery_set_power_level (p->dbus_battery, power_level_to_dbus_string (POWER_LEVEL_OK));
+      battery_set_power_level (self, POWER_LEVEL_OK);
+      indicator_power_level_engine_reset (p->levels);
       notification_clear (self);
+      battery_stage_device (self);
     }
 
   if (battery != NULL)
     {
+      start_notifications (self);
+
       p->battery = g_object_ref (battery);
       g_signal_connect_swapped (p->battery, "notify::"INDICATOR_POWER_DEVICE_PERCENTAGE,
                                 G_CALLBACK(on_battery_property_changed), self);
       g_signal_connect_swapped (p->battery, "notify::"INDICATOR_POWER_DEVICE_STATE,
                                 G_CALLBACK(on_battery_property_changed), self);
+      g_signal_connect_swapped (p->battery, "notify::"INDICATOR_POWER_DEVICE_TIME,
+                                G_CALLBACK(on_battery_time_changed), self);
       on_battery_property_changed (self);
     }
 }
@@ -594,9 +1275,18 @@ indicator_power_notifier_set_bus (IndicatorPowerNotifier * self,
 
   if (p->bus != NULL)
     {
+      GHashTableIter iter;
+      gpointer client;
+
       if (skel != NULL)
         g_dbus_interface_skeleton_unexport (skel);
 
+      /* the watches belong to clients on the old bus */
+      g_hash_table_iter_init (&iter, p->watch_clients);
+      while (g_hash_table_iter_next (&iter, &client, NULL))
+        indicator_power_watch_list_remove_owner (p->watches, client);
+      g_hash_table_remove_all (p->watch_clients);
+
       g_clear_object (&p->bus);
     }
 
@@ -618,8 +1308,51 @@ indicator_power_notifier_set_bus (IndicatorPowerNotifier * self,
     }
 }
 
+/**
+ * Publish the device summary from @snapshot on the bus.
+ *
+ * The battery's own Percentage, State and TimeRemaining come from the
+ * device given to indicator_power_notifier_set_battery().
+ */
+void
+indicator_power_notifier_set_snapshot (IndicatorPowerNotifier             * self,
+                                       const IndicatorPowerDeviceSnapshot * snapshot)
+{
+  priv_t * p;
+  guint device_count = 0;
+  gboolean on_line_power;
+  guint i;
+
+  g_return_if_fail(INDICATOR_IS_POWER_NOTIFIER(self));
+
+  p = get_priv (self);
+
+  on_line_power = (snapshot == NULL) || !snapshot->on_battery;
+
+  for (i=0; snapshot!=NULL && i<snapshot->n_records; i++)
+    {
+      const IndicatorPowerDeviceRecord * record = &snapshot->records[i];
+
+      if ((record->kind == UP_DEVICE_KIND_BATTERY) || (record->kind == UP_DEVICE_KIND_UPS))
+        ++device_count;
+    }
+
+  if ((p->staged_device_count == device_count) && (!p->staged_on_line_power == !on_line_power))
+    return;
+
+  p->staged_device_count = device_count;
+  p->staged_on_line_power = on_line_power;
+  battery_schedule_flush (self);
+}
+
+/**
+ * The battery's PowerLevel as published on the bus,
+ * i.e. with the hysteresis applied.
+ */
 const char *
-indicator_power_notifier_get_power_level (IndicatorPowerDevice * battery)
+indicator_power_notifier_get_power_level (IndicatorPowerNotifier * self)
 {
-  return power_level_to_dbus_string (get_battery_power_level (battery));
+  g_return_val_if_fail(INDICATOR_IS_POWER_NOTIFIER(self), POWER_LEVEL_STR_OK);
+
+  return power_level_to_dbus_string (get_priv(self)->staged_power_level);
 }
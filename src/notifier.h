@@ -23,6 +23,7 @@
 #include <gio/gio.h>
 
 #include "device.h"
+#include "device-snapshot.h"
 
 G_BEGIN_DECLS
 
@@ -63,11 +64,14 @@ void indicator_power_notifier_set_bus (IndicatorPowerNotifier  * self,
 void indicator_power_notifier_set_battery (IndicatorPowerNotifier  * self,
                                            IndicatorPowerDevice    * battery);
 
+void indicator_power_notifier_set_snapshot (IndicatorPowerNotifier             * self,
+                                            const IndicatorPowerDeviceSnapshot * snapshot);
+
 #define POWER_LEVEL_STR_OK "ok"
 #define POWER_LEVEL_STR_LOW "low"
 #define POWER_LEVEL_STR_VERY_LOW "very_low"
 #define POWER_LEVEL_STR_CRITICAL "critical"
-const char * indicator_power_notifier_get_power_level (IndicatorPowerDevice * battery);
+const char * indicator_power_notifier_get_power_level (IndicatorPowerNotifier * self);
 
 G_END_DECLS
 
@@ -0,0 +1,158 @@
+/*
+ * Copyright 2026 The Ayatana Indicators project
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "power-level.h"
+
+#include <string.h> /* memcpy() */
+
+/***
+****  Levels
+***/
+
+/**
+ * Get the level for @percentage without any hysteresis.
+ */
+guint
+indicator_power_level_classify (const IndicatorPowerLevelSpec * levels,
+                                guint                           n_levels,
+                                gdouble                         percentage)
+{
+  guint i;
+
+  g_return_val_if_fail ((levels != NULL) || (n_levels == 0), 0);
+
+  for (i=0; i<n_levels; ++i)
+    if (percentage <= levels[i].threshold)
+      return i;
+
+  return n_levels;
+}
+
+/***
+****  Engine
+***/
+
+struct _IndicatorPowerLevelEngine
+{
+  IndicatorPowerLevelSpec * levels;
+  guint n_levels;
+
+  /* the level we're in now */
+  guint level;
+};
+
+/**
+ * Create a new engine.
+ *
+ * @levels must be sorted from the worst level to the best one,
+ * i.e. by ascending threshold, and the hysteresis bands must not
+ * be negative. The engine starts out in the top level.
+ *
+ * Return value: (transfer full): a new engine.
+ *               Release with indicator_power_level_engine_free().
+ */
+IndicatorPowerLevelEngine *
+indicator_power_level_engine_new (const IndicatorPowerLevelSpec * levels,
+                                  guint                           n_levels)
+{
+  IndicatorPowerLevelEngine * engine;
+  guint i;
+
+  g_return_val_if_fail ((levels != NULL) || (n_levels == 0), NULL);
+
+  for (i=0; i<n_levels; ++i)
+    {
+      g_return_val_if_fail (levels[i].hysteresis >= 0.0, NULL);
+      g_return_val_if_fail ((i == 0) || (levels[i-1].threshold < levels[i].threshold), NULL);
+    }
+
+  engine = g_new0 (IndicatorPowerLevelEngine, 1);
+  engine->levels = g_new (IndicatorPowerLevelSpec, n_levels);
+  if (n_levels > 0)
+    memcpy (engine->levels, levels, n_levels * sizeof (IndicatorPowerLevelSpec));
+  engine->n_levels = n_levels;
+  engine->level = n_levels;
+
+  return engine;
+}
+
+void
+indicator_power_level_engine_free (IndicatorPowerLevelEngine * engine)
+{
+  g_return_if_fail (engine != NULL);
+
+  g_free (engine->levels);
+  g_free (engine);
+}
+
+/**
+ * Feed the engine a new percentage.
+ *
+ * Dropping into a worse level takes effect immediately so that warnings
+ * aren't delayed. Climbing out of a level needs the percentage to clear
+ * that level's hysteresis band.
+ *
+ * Return value: TRUE if the level changed.
+ */
+gboolean
+indicator_power_level_engine_update (IndicatorPowerLevelEngine * engine,
+                                     gdouble                     percentage)
+{
+  guint raw;
+  guint level;
+
+  g_return_val_if_fail (engine != NULL, FALSE);
+
+  raw = indicator_power_level_classify (engine->levels, engine->n_levels, percentage);
+  level = engine->level;
+
+  if (raw < level)
+    {
+      level = raw;
+    }
+  else
+    {
+      while ((level < raw) &&
+             (percentage > engine->levels[level].threshold + engine->levels[level].hysteresis))
+        ++level;
+    }
+
+  if (level == engine->level)
+    return FALSE;
+
+  engine->level = level;
+  return TRUE;
+}
+
+guint
+indicator_power_level_engine_get_level (const IndicatorPowerLevelEngine * engine)
+{
+  g_return_val_if_fail (engine != NULL, 0);
+
+  return engine->level;
+}
+
+/**
+ * Forget the current level and go back to the top one,
+ * e.g. when the battery being watched changes.
+ */
+void
+indicator_power_level_engine_reset (IndicatorPowerLevelEngine * engine)
+{
+  g_return_if_fail (engine != NULL);
+
+  engine->level = engine->n_levels;
+}
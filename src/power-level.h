@@ -0,0 +1,66 @@
+/*
+ * Copyright 2026 The Ayatana Indicators project
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __INDICATOR_POWER_LEVEL__H__
+#define __INDICATOR_POWER_LEVEL__H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * One warning level.
+ *
+ * The battery enters the level as soon as its percentage drops to
+ * @threshold, but only leaves it once the percentage has risen past
+ * @threshold + @hysteresis, so that a reading that wobbles around the
+ * threshold doesn't flip the level back and forth.
+ */
+typedef struct
+{
+  gdouble threshold;
+  gdouble hysteresis;
+}
+IndicatorPowerLevelSpec;
+
+guint indicator_power_level_classify (const IndicatorPowerLevelSpec * levels,
+                                      guint                           n_levels,
+                                      gdouble                         percentage);
+
+/**
+ * Tracks which level a battery is in.
+ *
+ * Levels are numbered from 0 (the worst) upwards in the order they
+ * were given to indicator_power_level_engine_new(), and the implicit
+ * level above the last threshold is numbered n_levels.
+ */
+typedef struct _IndicatorPowerLevelEngine IndicatorPowerLevelEngine;
+
+IndicatorPowerLevelEngine * indicator_power_level_engine_new      (const IndicatorPowerLevelSpec * levels,
+                                                                   guint                           n_levels);
+
+void                        indicator_power_level_engine_free     (IndicatorPowerLevelEngine * engine);
+
+gboolean                    indicator_power_level_engine_update   (IndicatorPowerLevelEngine * engine,
+                                                                   gdouble                     percentage);
+
+guint                       indicator_power_level_engine_get_level (const IndicatorPowerLevelEngine * engine);
+
+void                        indicator_power_level_engine_reset    (IndicatorPowerLevelEngine * engine);
+
+G_END_DECLS
+
+#endif /* __INDICATOR_POWER_LEVEL__H__ */
@@ -25,10 +25,12 @@
 #include <ayatana/common/utils.h>
 #include "brightness.h"
 #include "dbus-shared.h"
+#include "deadline-scheduler.h"
 #include "device.h"
 #include "device-provider.h"
 #include "notifier.h"
 #include "service.h"
+#include "shared-snapshot-writer.h"
 #include "flashlight.h"
 #include "utils.h"
 
@@ -38,6 +40,7 @@
 #define SETTINGS_SHOW_TIME_S "show-time"
 #define SETTINGS_ICON_POLICY_S "icon-policy"
 #define SETTINGS_SHOW_PERCENTAGE_S "show-percentage"
+#define SETTINGS_SHARED_SNAPSHOT_S "shared-snapshot"
 
 enum
 {
@@ -104,6 +107,7 @@ struct _IndicatorPowerServicePrivate
 
   GSettings * settings;
 
+  /* created on first use; see ensure_brightness() */
   IndicatorPowerBrightness * brightness;
 
   guint own_id;
@@ -117,10 +121,28 @@ struct _IndicatorPowerServicePrivate
   GSimpleAction * header_action;
   GSimpleAction * battery_level_action;
   GSimpleAction * device_state_action;
-  GSimpleAction * brightness_action;
+  GSimpleAction * brightness_action; /* NULL until ensure_brightness() */
+  GSimpleAction * auto_brightness_action;
+
+  /* The phone profile's settings section probes the backlight, the
+     flashlight and so on, so it's left empty until a client subscribes
+     to that menu. phone_menu_filter_id watches for that. */
+  gboolean phone_settings_wanted;
+  guint phone_menu_filter_id;
+
+  /* the provider's latest snapshot, plus a persistent GObject wrapper
+     for each of its records so that timers and listeners survive updates */
+  IndicatorPowerDeviceSnapshot * snapshot;
+  GPtrArray * devices; /* IndicatorPowerDevice, parallel to snapshot->records */
 
   IndicatorPowerDevice * primary_device;
-  GList * devices; /* IndicatorPowerDevice */
+  IndicatorPowerDevice * totalled_device;
+
+  /* rebuilds sections whose text changes with time, e.g. "estimating…" */
+  IndicatorPowerDeadlineScheduler * deadlines;
+
+  /* publishes the snapshot in $XDG_RUNTIME_DIR, if enabled */
+  IndicatorPowerSharedSnapshotWriter * shared_snapshot;
 
   IndicatorPowerDeviceProvider * device_provider;
   IndicatorPowerNotifier * notifier;
@@ -138,13 +160,13 @@ G_DEFINE_TYPE_WITH_PRIVATE(IndicatorPowerService, indicator_power_service, G_TYP
 
 /* the higher the weight, the more interesting the device */
 static int
-get_device_kind_weight (const IndicatorPowerDevice * device)
+get_device_kind_weight (const IndicatorPowerDeviceRecord * device)
 {
   UpDeviceKind kind;
   static gboolean initialized = FALSE;
   static int weights[UP_DEVICE_KIND_LAST];
 
-  kind = indicator_power_device_get_kind (device);
+  kind = device->kind;
   g_return_val_if_fail (0<=kind && kind<UP_DEVICE_KIND_LAST, 0);
 
   if (G_UNLIKELY(!initialized))
@@ -170,20 +192,19 @@ get_device_kind_weight (const IndicatorPowerDevice * device)
    5. discharging items with an unknown time remaining
    6. batteries, then non-line power, then line-power */
 static gint
-device_compare_func (gconstpointer ga, gconstpointer gb)
+device_compare_func (const IndicatorPowerDeviceRecord * a,
+                     const IndicatorPowerDeviceRecord * b)
 {
   int ret;
   int state;
-  const IndicatorPowerDevice * a = ga;
-  const IndicatorPowerDevice * b = gb;
-  const gboolean a_power_supply = indicator_power_device_get_power_supply (a);
-  const gboolean b_power_supply = indicator_power_device_get_power_supply (b);
-  const int a_state = indicator_power_device_get_state (a);
-  const int b_state = indicator_power_device_get_state (b);
-  const gdouble a_percentage = indicator_power_device_get_percentage (a);
-  const gdouble b_percentage = indicator_power_device_get_percentage (b);
-  const time_t a_time = indicator_power_device_get_time (a);
-  const time_t b_time = indicator_power_device_get_time (b);
+  const gboolean a_power_supply = a->power_supply;
+  const gboolean b_power_supply = b->power_supply;
+  const int a_state = a->state;
+  const int b_state = b->state;
+  const gdouble a_percentage = a->percentage;
+  const gdouble b_percentage = b->percentage;
+  const time_t a_time = a->time;
+  const time_t b_time = b->time;
 
   ret = 0;
 
@@ -300,6 +321,240 @@ device_compare_func (gconstpointer ga, gconstpointer gb)
   return ret;
 }
 
+/* If a device has multiple batteries and uses only one of them at a time,
+   they should be presented as separate items inside the battery menu,
+   but everywhere else they should be aggregated (bug 880881).
+   Their percentages should be averaged. If any are discharging,
+   the aggregated time remaining should be the maximum of the times
+   for all those that are discharging, plus the sum of the times
+   for all those that are idle. Otherwise, the aggregated time remaining
+   should be the the maximum of the times for all those that are charging. */
+static gboolean
+create_totalled_battery_record (const IndicatorPowerDeviceSnapshot * snapshot,
+                                IndicatorPowerDeviceRecord         * setme)
+{
+  guint i;
+  guint n_charged = 0;
+  guint n_charging = 0;
+  guint n_discharging = 0;
+  guint n_batteries = 0;
+  double sum_percent = 0;
+  time_t max_discharge_time = 0;
+  time_t max_charge_time = 0;
+  time_t sum_charged_time = 0;
+
+  for (i=0; i<snapshot->n_records; i++)
+    {
+      const IndicatorPowerDeviceRecord * walk = &snapshot->records[i];
+
+      if (walk->kind == UP_DEVICE_KIND_BATTERY)
+        {
+          const double percent = walk->percentage;
+          const time_t t = walk->time;
+          const UpDeviceState state = walk->state;
+
+
+          if (percent > 0.01)
+            {
+              sum_percent += percent;
+              ++n_batteries;
+            }
+
+          if (state == UP_DEVICE_STATE_CHARGING)
+            {
+              ++n_charging;
+              max_charge_time = MAX(max_charge_time, t);
+            }
+          else if (state == UP_DEVICE_STATE_DISCHARGING)
+            {
+              ++n_discharging;
+              max_discharge_time = MAX(max_discharge_time, t);
+            }
+          else if (state == UP_DEVICE_STATE_FULLY_CHARGED)
+            {
+              ++n_charged;
+              sum_charged_time += t;
+            }
+        }
+    }
+
+  if (n_batteries > 1)
+    {
+      const double percent = sum_percent / n_batteries;
+      UpDeviceState state;
+      time_t time_left;
+
+      if (n_discharging > 0)
+        {
+          state = UP_DEVICE_STATE_DISCHARGING;
+          time_left = max_discharge_time + sum_charged_time;
+        }
+      else if (n_charging > 0)
+        {
+          state = UP_DEVICE_STATE_CHARGING;
+          time_left = max_charge_time;
+        }
+      else if (n_charged > 0)
+        {
+          state = UP_DEVICE_STATE_FULLY_CHARGED;
+          time_left = 0;
+        }
+      else
+        {
+          state = UP_DEVICE_STATE_UNKNOWN;
+          time_left = 0;
+        }
+
+      indicator_power_device_record_set (setme,
+                                         NULL,
+                                         UP_DEVICE_KIND_BATTERY,
+                                         NULL,
+                                         percent,
+                                         state,
+                                         time_left,
+                                         TRUE);
+      return TRUE;
+    }
+
+  return FALSE;
+}
+
+/**
+ * Pick the most interesting record in the snapshot.
+ *
+ * If there are multiple UP_DEVICE_KIND_BATTERY records in the snapshot,
+ * they're merged into a 'totalled' record representing the sum of them,
+ * which is written into @totalled and competes in place of the batteries.
+ *
+ * Returns: (transfer none): the primary record, either @totalled or
+ *          one of the snapshot's records; or NULL if the snapshot is empty.
+ */
+static const IndicatorPowerDeviceRecord *
+choose_primary_record (const IndicatorPowerDeviceSnapshot * snapshot,
+                       IndicatorPowerDeviceRecord         * totalled)
+{
+  const IndicatorPowerDeviceRecord * primary = NULL;
+  gboolean merged;
+  guint i;
+
+  if (snapshot == NULL)
+    return NULL;
+
+  if ((merged = create_totalled_battery_record (snapshot, totalled)))
+    primary = totalled;
+
+  for (i=0; i<snapshot->n_records; i++)
+    {
+      const IndicatorPowerDeviceRecord * walk = &snapshot->records[i];
+
+      if (merged && (walk->kind == UP_DEVICE_KIND_BATTERY))
+        continue;
+
+      if ((primary == NULL) || (device_compare_func (walk, primary) < 0))
+        primary = walk;
+    }
+
+  return primary;
+}
+
+/* remove and return the first device of the given kind, or NULL */
+static IndicatorPowerDevice *
+take_device_of_kind (GPtrArray * devices, UpDeviceKind kind)
+{
+  guint i;
+
+  for (i=0; i<devices->len; i++)
+    if (indicator_power_device_get_kind (g_ptr_array_index (devices, i)) == kind)
+      return g_ptr_array_remove_index (devices, i);
+
+  return NULL;
+}
+
+/* keep one IndicatorPowerDevice per record, reusing the previous
+   wrappers when the object path matches so that their state persists.
+   Synthesized devices have no path, so those are matched by kind */
+static void
+update_device_wrappers (IndicatorPowerService * self)
+{
+  priv_t * p = self->priv;
+  GPtrArray * old_devices;
+  GHashTable * old_by_path;
+  GPtrArray * old_without_path;
+  guint i;
+
+  old_devices = p->devices;
+  old_by_path = g_hash_table_new (g_direct_hash, g_direct_equal);
+  old_without_path = g_ptr_array_new ();
+  for (i=0; i<old_devices->len; i++)
+    {
+      IndicatorPowerDevice * device = g_ptr_array_index (old_devices, i);
+      const gchar * path = indicator_power_device_get_object_path (device);
+
+      if (path != NULL)
+        g_hash_table_insert (old_by_path, (gpointer)g_intern_string (path), device);
+      else
+        g_ptr_array_add (old_without_path, device);
+    }
+
+  p->devices = g_ptr_array_new_with_free_func (g_object_unref);
+
+  for (i=0; p->snapshot!=NULL && i<p->snapshot->n_records; i++)
+    {
+      const IndicatorPowerDeviceRecord * record = &p->snapshot->records[i];
+      IndicatorPowerDevice * device = NULL;
+
+      if (record->object_path == NULL)
+        device = take_device_of_kind (old_without_path, record->kind);
+      else if ((device = g_hash_table_lookup (old_by_path, record->object_path)))
+        g_hash_table_remove (old_by_path, record->object_path);
+
+      if (device != NULL)
+        {
+          indicator_power_device_update_from_record (device, record);
+          g_ptr_array_add (p->devices, g_object_ref (device));
+        }
+      else
+        {
+          g_ptr_array_add (p->devices, indicator_power_device_new_from_record (record));
+        }
+    }
+
+  g_ptr_array_unref (old_without_path);
+  g_hash_table_destroy (old_by_path);
+  g_ptr_array_unref (old_devices);
+}
+
+static IndicatorPowerDevice *
+choose_primary_wrapper (IndicatorPowerService * self)
+{
+  priv_t * p = self->priv;
+  IndicatorPowerDeviceRecord totalled = { 0 };
+  const IndicatorPowerDeviceRecord * primary;
+
+  primary = choose_primary_record (p->snapshot, &totalled);
+
+  if (primary == NULL)
+    {
+      g_clear_object (&p->totalled_device);
+      return NULL;
+    }
+
+  if (primary != &totalled)
+    {
+      g_clear_object (&p->totalled_device);
+      indicator_power_device_record_clear (&totalled);
+      return g_object_ref (g_ptr_array_index (p->devices, primary - p->snapshot->records));
+    }
+
+  if (p->totalled_device != NULL)
+    indicator_power_device_update_from_record (p->totalled_device, &totalled);
+  else
+    p->totalled_device = indicator_power_device_new_from_record (&totalled);
+
+  indicator_power_device_record_clear (&totalled);
+  return g_object_ref (p->totalled_device);
+}
+
 static const char*
 device_state_to_string(UpDeviceState device_state)
 {
@@ -360,22 +615,21 @@ calculate_device_state_action_state (IndicatorPowerService * self)
 ***/
 
 static void
-count_batteries (GList * devices, int *total, int *inuse)
+count_batteries (const IndicatorPowerDeviceSnapshot * snapshot, int *total, int *inuse)
 {
-  GList * l;
+  guint i;
 
-  for (l=devices; l!=NULL; l=l->next)
+  for (i=0; snapshot!=NULL && i<snapshot->n_records; i++)
     {
-      const IndicatorPowerDevice * device = INDICATOR_POWER_DEVICE(l->data);
+      const IndicatorPowerDeviceRecord * device = &snapshot->records[i];
 
-      if (indicator_power_device_get_kind(device) == UP_DEVICE_KIND_BATTERY ||
-          indicator_power_device_get_kind(device) == UP_DEVICE_KIND_UPS)
+      if (device->kind == UP_DEVICE_KIND_BATTERY ||
+          device->kind == UP_DEVICE_KIND_UPS)
         {
           ++*total;
 
-          const UpDeviceState state = indicator_power_device_get_state (device);
-          if ((state == UP_DEVICE_STATE_CHARGING) ||
-              (state == UP_DEVICE_STATE_DISCHARGING))
+          if ((device->state == UP_DEVICE_STATE_CHARGING) ||
+              (device->state == UP_DEVICE_STATE_DISCHARGING))
             ++*inuse;
         }
     }
@@ -406,7 +660,7 @@ should_be_visible (IndicatorPowerService * self)
     {
       int batteries=0, inuse=0;
 
-      count_batteries (p->devices, &batteries, &inuse);
+      count_batteries (p->snapshot, &batteries, &inuse);
 
       if (policy == POWER_INDICATOR_ICON_POLICY_PRESENT)
         {
@@ -422,6 +676,24 @@ should_be_visible (IndicatorPowerService * self)
   return visible;
 }
 
+/* if @device's text is going to change by itself,
+   rebuild @sections when it does */
+static void
+schedule_transition (IndicatorPowerService * self,
+                     IndicatorPowerDevice  * device,
+                     guint                   sections)
+{
+  const priv_t * const p = self->priv;
+  guint seconds;
+
+  if (p->deadlines == NULL)
+    return;
+
+  seconds = indicator_power_device_get_next_transition (device);
+  if (seconds > 0)
+    indicator_power_deadline_scheduler_add (p->deadlines, seconds, sections);
+}
+
 static GVariant *
 create_header_state (IndicatorPowerService * self)
 {
@@ -439,7 +711,7 @@ create_header_state (IndicatorPowerService * self)
 
   if (p->primary_device != NULL)
     {
-      char * title;
+      const char * title;
       GIcon * icon;
       const gboolean want_time = g_settings_get_boolean (p->settings, SETTINGS_SHOW_TIME_S);
       const gboolean want_percent = g_settings_get_boolean (p->settings, SETTINGS_SHOW_PERCENTAGE_S);
@@ -447,24 +719,16 @@ create_header_state (IndicatorPowerService * self)
       title = indicator_power_device_get_readable_title (p->primary_device,
                                                          want_time,
                                                          want_percent);
-      if (title)
-        {
-          if (*title)
-            g_variant_builder_add (&b, "{sv}", "label", g_variant_new_take_string (title));
-          else
-            g_free (title);
-        }
+      if (title && *title)
+        g_variant_builder_add (&b, "{sv}", "label", g_variant_new_string (title));
 
       title = indicator_power_device_get_accessible_title (p->primary_device,
                                                            want_time,
                                                            want_percent);
-      if (title)
-        {
-          if (*title)
-            g_variant_builder_add (&b, "{sv}", "accessible-desc", g_variant_new_take_string (title));
-          else
-            g_free (title);
-        }
+      if (title && *title)
+        g_variant_builder_add (&b, "{sv}", "accessible-desc", g_variant_new_string (title));
+
+      schedule_transition (self, p->primary_device, SECTION_HEADER);
 
       if ((icon = indicator_power_device_get_gicon (p->primary_device, TRUE, TRUE)))
         {
@@ -504,16 +768,17 @@ static GMenuModel *
 create_devices_section (IndicatorPowerService * self, int profile)
 {
     GMenu * menu = g_menu_new ();
-    GList * l;
+    GPtrArray * devices = self->priv->devices;
+    guint i;
 
-    for (l=self->priv->devices; l!=NULL; l=l->next)
+    for (i=0; i<devices->len; i++)
     {
-        IndicatorPowerDevice *device = l->data;
+        IndicatorPowerDevice *device = g_ptr_array_index (devices, i);
         const UpDeviceKind kind = indicator_power_device_get_kind (device);
 
         if (kind != UP_DEVICE_KIND_LINE_POWER)
         {
-            gchar *sLabel = NULL;
+            const gchar *sLabel = NULL;
 
             if (kind == UP_DEVICE_KIND_BATTERY)
             {
@@ -523,7 +788,7 @@ create_devices_section (IndicatorPowerService * self, int profile)
                 }
                 else
                 {
-                    sLabel = g_strdup (_("Charge level"));
+                    sLabel = _("Charge level");
                 }
             }
             else
@@ -532,7 +797,7 @@ create_devices_section (IndicatorPowerService * self, int profile)
             }
 
             GMenuItem * item = g_menu_item_new (sLabel, NULL);
-            g_free (sLabel);
+            schedule_transition (self, device, SECTION_DEVICES);
             g_menu_item_set_attribute (item, "x-ayatana-type", "s", "org.ayatana.indicator.level");
             guint16 battery_level = (guint16)(indicator_power_device_get_percentage (device) + 0.5);
             g_menu_item_set_attribute (item, "x-ayatana-level", "q", battery_level);
@@ -593,11 +858,12 @@ create_brightness_menu_item(void)
   return item;
 }
 
+static void ensure_brightness (IndicatorPowerService * self);
+
 static GVariant *
 action_state_for_brightness (IndicatorPowerService * self)
 {
-  IndicatorPowerBrightness * b = self->priv->brightness;
-  return g_variant_new_double(indicator_power_brightness_get_percentage(b));
+  return g_variant_new_double(indicator_power_brightness_get_percentage(self->priv->brightness));
 }
 
 static void
@@ -639,6 +905,11 @@ create_phone_settings_section(IndicatorPowerService * self)
 
   section = g_menu_new();
 
+  if (!self->priv->phone_settings_wanted)
+    return G_MENU_MODEL(section);
+
+  ensure_brightness(self);
+
   item = create_brightness_menu_item();
   g_menu_append_item(section, item);
   update_brightness_action_state(self);
@@ -710,6 +981,10 @@ rebuild_now (IndicatorPowerService * self, guint sections)
   struct ProfileMenuInfo * desktop = &p->menus[PROFILE_DESKTOP];
   struct ProfileMenuInfo * greeter = &p->menus[PROFILE_DESKTOP_GREETER];
 
+  /* the sections being rebuilt will reschedule their own transitions */
+  if (p->deadlines != NULL)
+    indicator_power_deadline_scheduler_cancel (p->deadlines, sections);
+
   if (sections & SECTION_HEADER)
     {
       g_simple_action_set_state (p->header_action, create_header_state (self));
@@ -738,6 +1013,12 @@ rebuild_header_now (IndicatorPowerService * self)
   rebuild_now (self, SECTION_HEADER);
 }
 
+static void
+on_deadline (guint sections, gpointer gself)
+{
+  rebuild_now (INDICATOR_POWER_SERVICE(gself), sections);
+}
+
 static void
 create_menu (IndicatorPowerService * self, int profile)
 {
@@ -869,6 +1150,46 @@ convert_auto_state_to_prop(GBinding     * binding     G_GNUC_UNUSED,
   return TRUE;
 }
 
+static void on_auto_brightness_supported_changed (IndicatorPowerService * self);
+
+static void
+ensure_brightness (IndicatorPowerService * self)
+{
+  priv_t * p = self->priv;
+
+  if (p->brightness != NULL)
+    return;
+
+  p->brightness = indicator_power_brightness_new();
+
+  /* the brightness action only exists alongside the brightness object,
+     so that clients never see a made-up state before the real one */
+  p->brightness_action = g_simple_action_new_stateful ("brightness", NULL, action_state_for_brightness (self));
+  g_action_map_add_action (G_ACTION_MAP(p->actions), G_ACTION(p->brightness_action));
+  g_signal_connect (p->brightness_action, "change-state", G_CALLBACK(on_brightness_change_requested), self);
+
+  g_signal_connect_swapped(p->brightness, "notify::percentage",
+                           G_CALLBACK(update_brightness_action_state), self);
+  g_signal_connect_swapped(p->brightness, "notify::auto-brightness-supported",
+                           G_CALLBACK(on_auto_brightness_supported_changed), self);
+  g_object_bind_property_full(p->brightness, "auto-brightness",
+                              p->auto_brightness_action, "state",
+                              G_BINDING_SYNC_CREATE|G_BINDING_BIDIRECTIONAL,
+                              convert_auto_prop_to_state,
+                              convert_auto_state_to_prop,
+                              NULL, NULL);
+}
+
+static void
+on_auto_brightness_change_requested (GSimpleAction * action,
+                                     GVariant      * value,
+                                     gpointer        gself)
+{
+  /* once brightness exists, the binding passes this along to it */
+  ensure_brightness (INDICATOR_POWER_SERVICE(gself));
+  g_simple_action_set_state (action, value);
+}
+
 static void
 init_gactions (IndicatorPowerService * self)
 {
@@ -905,13 +1226,9 @@ init_gactions (IndicatorPowerService * self)
   GVariantType *pType = g_variant_type_new ("b");
   a = g_simple_action_new_stateful ("auto-brightness", pType, g_variant_new_boolean (FALSE));
   g_variant_type_free (pType);
-  g_object_bind_property_full(p->brightness, "auto-brightness",
-                              a,  "state",
-                              G_BINDING_SYNC_CREATE|G_BINDING_BIDIRECTIONAL,
-                              convert_auto_prop_to_state,
-                              convert_auto_state_to_prop,
-                              NULL, NULL);
   g_action_map_add_action(G_ACTION_MAP(p->actions), G_ACTION(a));
+  g_signal_connect(a, "change-state", G_CALLBACK(on_auto_brightness_change_requested), self);
+  p->auto_brightness_action = a;
 
   /* add the flashlight action */
   pType = g_variant_type_new ("b");
@@ -927,11 +1244,7 @@ init_gactions (IndicatorPowerService * self)
   g_action_map_add_action (G_ACTION_MAP(p->actions), G_ACTION(a));
   g_signal_connect(a, "change-state", G_CALLBACK(toggle_keep_screen_on_action), self);
 
-  /* add the brightness action */
-  a = g_simple_action_new_stateful ("brightness", NULL, action_state_for_brightness (self));
-  g_action_map_add_action (G_ACTION_MAP(p->actions), G_ACTION(a));
-  g_signal_connect (a, "change-state", G_CALLBACK(on_brightness_change_requested), self);
-  p->brightness_action = a;
+  /* the brightness action is added by ensure_brightness() */
 
   /* add the show-time action */
   show_time_action = g_settings_create_action (p->settings, "show-time");
@@ -951,6 +1264,99 @@ init_gactions (IndicatorPowerService * self)
 ****  GDBus Name Ownership & Menu / Action Exporting
 ***/
 
+/* what the phone menu's filter needs; freed by GDBus once it's done with it */
+typedef struct
+{
+  GWeakRef service;
+  GMainContext * context;
+  gchar * path;
+  gint seen;
+}
+PhoneMenuWatch;
+
+static void
+phone_menu_watch_free (gpointer gwatch)
+{
+  PhoneMenuWatch * watch = gwatch;
+
+  g_weak_ref_clear (&watch->service);
+  g_main_context_unref (watch->context);
+  g_free (watch->path);
+  g_free (watch);
+}
+
+static gboolean
+on_phone_menu_subscribed (gpointer gself)
+{
+  IndicatorPowerService * self = INDICATOR_POWER_SERVICE(gself);
+  priv_t * p = self->priv;
+
+  if (p->phone_menu_filter_id != 0)
+    {
+      g_dbus_connection_remove_filter (p->conn, p->phone_menu_filter_id);
+      p->phone_menu_filter_id = 0;
+    }
+
+  if (!p->phone_settings_wanted)
+    {
+      g_debug ("phone menu subscribed; building its settings");
+      p->phone_settings_wanted = TRUE;
+      rebuild_now (self, SECTION_SETTINGS);
+    }
+
+  return G_SOURCE_REMOVE;
+}
+
+/* Runs in GDBus' worker thread. When a client starts
+   subscribing to the phone menu, build it in the main thread */
+static GDBusMessage *
+phone_menu_filter (GDBusConnection * connection G_GNUC_UNUSED,
+                   GDBusMessage    * message,
+                   gboolean          incoming,
+                   gpointer          gwatch)
+{
+  PhoneMenuWatch * watch = gwatch;
+
+  if (incoming &&
+      (g_dbus_message_get_message_type (message) == G_DBUS_MESSAGE_TYPE_METHOD_CALL) &&
+      !g_strcmp0 (g_dbus_message_get_member (message), "Start") &&
+      !g_strcmp0 (g_dbus_message_get_interface (message), "org.gtk.Menus") &&
+      !g_strcmp0 (g_dbus_message_get_path (message), watch->path) &&
+      g_atomic_int_compare_and_exchange (&watch->seen, 0, 1))
+    {
+      GObject * service = g_weak_ref_get (&watch->service);
+
+      if (service != NULL)
+        g_main_context_invoke_full (watch->context,
+                                    G_PRIORITY_DEFAULT,
+                                    on_phone_menu_subscribed,
+                                    service,
+                                    g_object_unref);
+    }
+
+  return message;
+}
+
+static void
+watch_phone_menu (IndicatorPowerService * self, const char * path)
+{
+  priv_t * p = self->priv;
+  PhoneMenuWatch * watch;
+
+  if (p->phone_settings_wanted || (p->phone_menu_filter_id != 0))
+    return;
+
+  watch = g_new0 (PhoneMenuWatch, 1);
+  g_weak_ref_init (&watch->service, self);
+  watch->context = g_main_context_ref_thread_default ();
+  watch->path = g_strdup (path);
+
+  p->phone_menu_filter_id = g_dbus_connection_add_filter (p->conn,
+                                                          phone_menu_filter,
+                                                          watch,
+                                                          phone_menu_watch_free);
+}
+
 static void
 on_bus_acquired (GDBusConnection * connection,
                  const gchar     * name,
@@ -999,6 +1405,9 @@ on_bus_acquired (GDBusConnection * connection,
                                                      &err)))
         {
           menu->export_id = id;
+
+          if (i == PROFILE_PHONE)
+            watch_phone_menu (self, path->str);
         }
       else
         {
@@ -1028,6 +1437,12 @@ unexport (IndicatorPowerService * self)
         }
     }
 
+  if (p->phone_menu_filter_id != 0)
+    {
+      g_dbus_connection_remove_filter (p->conn, p->phone_menu_filter_id);
+      p->phone_menu_filter_id = 0;
+    }
+
   /* unexport the actions */
   if (p->actions_export_id)
     {
@@ -1060,18 +1475,23 @@ on_devices_changed (IndicatorPowerService * self)
   priv_t * p = self->priv;
 
   /* update the device list */
-  g_list_free_full (p->devices, (GDestroyNotify)g_object_unref);
-  p->devices = indicator_power_device_provider_get_devices (p->device_provider);
+  g_clear_pointer (&p->snapshot, indicator_power_device_snapshot_unref);
+  p->snapshot = indicator_power_device_provider_get_snapshot (p->device_provider);
+  update_device_wrappers (self);
+
+  if (p->shared_snapshot != NULL)
+    indicator_power_shared_snapshot_writer_publish (p->shared_snapshot, p->snapshot);
 
   /* update the primary device */
   g_clear_object (&p->primary_device);
-  p->primary_device = indicator_power_service_choose_primary_device (p->devices);
+  p->primary_device = choose_primary_wrapper (self);
 
   /* update the notifier's battery */
   if ((p->primary_device != NULL) && (indicator_power_device_get_kind(p->primary_device) == UP_DEVICE_KIND_BATTERY))
     indicator_power_notifier_set_battery (p->notifier, p->primary_device);
   else
     indicator_power_notifier_set_battery (p->notifier, NULL);
+  indicator_power_notifier_set_snapshot (p->notifier, p->snapshot);
 
   /* update the device-state action's state */
   g_simple_action_set_state (p->device_state_action, calculate_device_state_action_state(self));
@@ -1168,8 +1588,12 @@ my_dispose (GObject * o)
       g_clear_object (&p->settings);
     }
 
+  if (p->brightness != NULL)
+    g_signal_handlers_disconnect_by_data (p->brightness, self);
+
   g_clear_object (&p->notifier);
   g_clear_object (&p->brightness_action);
+  g_clear_object (&p->auto_brightness_action);
   g_clear_object (&p->brightness);
   g_clear_object (&p->battery_level_action);
   g_clear_object (&p->header_action);
@@ -1179,6 +1603,9 @@ my_dispose (GObject * o)
 
   indicator_power_service_set_device_provider (self, NULL);
   indicator_power_service_set_notifier (self, NULL);
+  g_clear_pointer (&p->devices, g_ptr_array_unref);
+  g_clear_pointer (&p->shared_snapshot, indicator_power_shared_snapshot_writer_free);
+  g_clear_pointer (&p->deadlines, indicator_power_deadline_scheduler_free);
 
   G_OBJECT_CLASS (indicator_power_service_parent_class)->dispose (o);
 }
@@ -1198,11 +1625,26 @@ indicator_power_service_init (IndicatorPowerService * self)
 
   p->cancellable = g_cancellable_new ();
 
+  p->devices = g_ptr_array_new_with_free_func (g_object_unref);
+
+  p->deadlines = indicator_power_deadline_scheduler_new (on_deadline, self);
+
   p->settings = g_settings_new ("org.ayatana.indicator.power");
 
-  p->brightness = indicator_power_brightness_new();
-  g_signal_connect_swapped(p->brightness, "notify::percentage",
-                           G_CALLBACK(update_brightness_action_state), self);
+  if (g_settings_get_boolean (p->settings, SETTINGS_SHARED_SNAPSHOT_S))
+    {
+      GError * error = NULL;
+      gchar * filename = indicator_power_shared_snapshot_get_default_filename ();
+
+      p->shared_snapshot = indicator_power_shared_snapshot_writer_new (filename, &error);
+      if (error != NULL)
+        {
+          g_warning ("Unable to publish the device snapshot: %s", error->message);
+          g_error_free (error);
+        }
+
+      g_free (filename);
+    }
 
   init_gactions (self);
 
@@ -1212,9 +1654,6 @@ indicator_power_service_init (IndicatorPowerService * self)
     create_menu(self, i);
   p->menus_built = TRUE;
 
-  g_signal_connect_swapped(p->brightness, "notify::auto-brightness-supported",
-                           G_CALLBACK(on_auto_brightness_supported_changed), self);
-
   p->own_id = g_bus_own_name(G_BUS_TYPE_SESSION,
                              BUS_NAME,
                              G_BUS_NAME_OWNER_FLAGS_ALLOW_REPLACEMENT,
@@ -1302,9 +1741,9 @@ indicator_power_service_set_device_provider (IndicatorPowerService * self,
       g_clear_object (&p->device_provider);
 
       g_clear_object (&p->primary_device);
-
-      g_list_free_full (p->devices, g_object_unref);
-      p->devices = NULL;
+      g_clear_object (&p->totalled_device);
+      g_clear_pointer (&p->snapshot, indicator_power_device_snapshot_unref);
+      g_ptr_array_set_size (p->devices, 0);
     }
 
   if (dp != NULL)
@@ -1337,137 +1776,11 @@ indicator_power_service_set_notifier (IndicatorPowerService  * self,
     {
       p->notifier = g_object_ref (notifier);
       indicator_power_notifier_set_bus (p->notifier, p->conn);
+      indicator_power_notifier_set_snapshot (p->notifier, p->snapshot);
     }
 }
 
 
-/* If a device has multiple batteries and uses only one of them at a time,
-   they should be presented as separate items inside the battery menu,
-   but everywhere else they should be aggregated (bug 880881).
-   Their percentages should be averaged. If any are discharging,
-   the aggregated time remaining should be the maximum of the times
-   for all those that are discharging, plus the sum of the times
-   for all those that are idle. Otherwise, the aggregated time remaining
-   should be the the maximum of the times for all those that are charging. */
-static IndicatorPowerDevice *
-create_totalled_battery_device (const GList * devices)
-{
-  const GList * l;
-  guint n_charged = 0;
-  guint n_charging = 0;
-  guint n_discharging = 0;
-  guint n_batteries = 0;
-  double sum_percent = 0;
-  time_t max_discharge_time = 0;
-  time_t max_charge_time = 0;
-  time_t sum_charged_time = 0;
-  IndicatorPowerDevice * device = NULL;
-
-  for (l=devices; l!=NULL; l=l->next)
-    {
-      const IndicatorPowerDevice * walk = INDICATOR_POWER_DEVICE(l->data);
-
-      if (indicator_power_device_get_kind(walk) == UP_DEVICE_KIND_BATTERY)
-        {
-          const double percent = indicator_power_device_get_percentage (walk);
-          const time_t t = indicator_power_device_get_time (walk);
-          const UpDeviceState state = indicator_power_device_get_state (walk);
-
-
-          if (percent > 0.01)
-            {
-              sum_percent += percent;
-              ++n_batteries;
-            }
-
-          if (state == UP_DEVICE_STATE_CHARGING)
-            {
-              ++n_charging;
-              max_charge_time = MAX(max_charge_time, t);
-            }
-          else if (state == UP_DEVICE_STATE_DISCHARGING)
-            {
-              ++n_discharging;
-              max_discharge_time = MAX(max_discharge_time, t);
-            }
-          else if (state == UP_DEVICE_STATE_FULLY_CHARGED)
-            {
-              ++n_charged;
-              sum_charged_time += t;
-            }
-        }
-    }
-
-  if (n_batteries > 1)
-    {
-      const double percent = sum_percent / n_batteries;
-      UpDeviceState state;
-      time_t time_left;
-
-      if (n_discharging > 0)
-        {
-          state = UP_DEVICE_STATE_DISCHARGING;
-          time_left = max_discharge_time + sum_charged_time;
-        }
-      else if (n_charging > 0)
-        {
-          state = UP_DEVICE_STATE_CHARGING;
-          time_left = max_charge_time;
-        }
-      else if (n_charged > 0)
-        {
-          state = UP_DEVICE_STATE_FULLY_CHARGED;
-          time_left = 0;
-        }
-      else
-        {
-          state = UP_DEVICE_STATE_UNKNOWN;
-          time_left = 0;
-        }
-
-      device = indicator_power_device_new (NULL,
-                                           UP_DEVICE_KIND_BATTERY,
-                                           NULL,
-                                           percent,
-                                           state,
-                                           time_left,
-                                           TRUE);
-    }
-
-  return device;
-}
-
-/**
- * If there are multiple UP_DEVICE_KIND_BATTERY devices in the list,
- * they're merged into a new 'totalled' device representing the sum of them.
- *
- * Returns: (element-type IndicatorPowerDevice)(transfer full): a list of devices
- */
-static GList*
-merge_batteries_together (GList * devices)
-{
-  GList * ret;
-  IndicatorPowerDevice * merged_device;
-
-  if ((merged_device = create_totalled_battery_device (devices)))
-    {
-      GList * l;
-
-      ret = g_list_append (NULL, merged_device);
-
-      for (l=devices; l!=NULL; l=l->next)
-        if (indicator_power_device_get_kind(INDICATOR_POWER_DEVICE(l->data)) != UP_DEVICE_KIND_BATTERY)
-          ret = g_list_append (ret, g_object_ref(l->data));
-    }
-  else /* not enough batteries to merge */
-    {
-      ret = g_list_copy (devices);
-      g_list_foreach (ret, (GFunc)g_object_ref, NULL);
-    }
-
-  return ret;
-}
-
 IndicatorPowerDevice *
 indicator_power_service_choose_primary_device (GList * devices)
 {
@@ -1475,10 +1788,20 @@ indicator_power_service_choose_primary_device (GList * devices)
 
   if (devices != NULL)
     {
-      GList * tmp = merge_batteries_together (devices);
-      tmp = g_list_sort (tmp, device_compare_func);
-      primary = g_object_ref (tmp->data);
-      g_list_free_full (tmp, (GDestroyNotify)g_object_unref);
+      IndicatorPowerDeviceSnapshot * snapshot;
+      IndicatorPowerDeviceRecord totalled = { 0 };
+      const IndicatorPowerDeviceRecord * record;
+
+      snapshot = indicator_power_device_snapshot_new_from_devices (devices);
+      record = choose_primary_record (snapshot, &totalled);
+
+      if (record == &totalled)
+        primary = indicator_power_device_new_from_record (record);
+      else
+        primary = g_object_ref (g_list_nth_data (devices, record - snapshot->records));
+
+      indicator_power_device_record_clear (&totalled);
+      indicator_power_device_snapshot_unref (snapshot);
     }
 
   return primary;
@@ -0,0 +1,180 @@
+/*
+ * Copyright 2026 The Ayatana Indicators project
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "shared-snapshot.h"
+#include "shared-snapshot-writer.h"
+
+#include <gio/gio.h> /* g_io_error_from_errno() */
+#include <glib/gstdio.h>
+
+#include <errno.h>
+
+G_STATIC_ASSERT (sizeof (IndicatorPowerShmRecord) == 224);
+G_STATIC_ASSERT (G_STRUCT_OFFSET (IndicatorPowerShm, records) == 64);
+
+struct _IndicatorPowerSharedSnapshotWriter
+{
+  gchar * filename;
+  IndicatorPowerShm * shm;
+};
+
+gchar *
+indicator_power_shared_snapshot_get_default_filename (void)
+{
+  return g_build_filename (g_get_user_runtime_dir (), INDICATOR_POWER_SHM_BASENAME, NULL);
+}
+
+/**
+ * Create a new snapshot file at @filename and map it.
+ *
+ * Any existing file is replaced rather than rewritten, so readers that
+ * still have it mapped aren't handed a half-initialized header.
+ *
+ * Return value: (transfer full): a new writer, or NULL with @error set.
+ *               Release with indicator_power_shared_snapshot_writer_free().
+ */
+IndicatorPowerSharedSnapshotWriter *
+indicator_power_shared_snapshot_writer_new (const gchar  * filename,
+                                            GError      ** error)
+{
+  IndicatorPowerSharedSnapshotWriter * writer;
+  void * map;
+  int fd;
+
+  g_return_val_if_fail (filename != NULL, NULL);
+
+  g_unlink (filename);
+
+  fd = g_open (filename, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+  if (fd < 0)
+    {
+      const int err = errno;
+      g_set_error (error, G_IO_ERROR, g_io_error_from_errno (err),
+                   "Unable to create \"%s\": %s", filename, g_strerror (err));
+      return NULL;
+    }
+
+  if (ftruncate (fd, sizeof (IndicatorPowerShm)) != 0)
+    {
+      const int err = errno;
+      g_set_error (error, G_IO_ERROR, g_io_error_from_errno (err),
+                   "Unable to resize \"%s\": %s", filename, g_strerror (err));
+      close (fd);
+      g_unlink (filename);
+      return NULL;
+    }
+
+  map = mmap (NULL, sizeof (IndicatorPowerShm), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close (fd);
+  if (map == MAP_FAILED)
+    {
+      const int err = errno;
+      g_set_error (error, G_IO_ERROR, g_io_error_from_errno (err),
+                   "Unable to map \"%s\": %s", filename, g_strerror (err));
+      g_unlink (filename);
+      return NULL;
+    }
+
+  writer = g_new0 (IndicatorPowerSharedSnapshotWriter, 1);
+  writer->filename = g_strdup (filename);
+  writer->shm = map;
+
+  /* the file is zero-filled, so sequence is already 0 (even).
+     magic goes last so readers can't see a header without a version */
+  writer->shm->version = INDICATOR_POWER_SHM_VERSION;
+  writer->shm->record_size = sizeof (IndicatorPowerShmRecord);
+  writer->shm->max_records = INDICATOR_POWER_SHM_MAX_RECORDS;
+  __atomic_store_n (&writer->shm->magic, INDICATOR_POWER_SHM_MAGIC, __ATOMIC_RELEASE);
+
+  return writer;
+}
+
+/**
+ * Stop publishing: readers that still have the file mapped get
+ * INDICATOR_POWER_SHM_STALE, and the file is removed.
+ */
+void
+indicator_power_shared_snapshot_writer_free (IndicatorPowerSharedSnapshotWriter * writer)
+{
+  IndicatorPowerShm * shm;
+  guint32 seq;
+
+  g_return_if_fail (writer != NULL);
+
+  shm = writer->shm;
+  seq = __atomic_load_n (&shm->sequence, __ATOMIC_RELAXED);
+  __atomic_store_n (&shm->sequence, seq + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence (__ATOMIC_RELEASE);
+  shm->magic = 0;
+  shm->n_records = 0;
+  __atomic_store_n (&shm->sequence, seq + 2, __ATOMIC_RELEASE);
+
+  munmap (shm, sizeof (IndicatorPowerShm));
+  g_unlink (writer->filename);
+
+  g_free (writer->filename);
+  g_free (writer);
+}
+
+static void
+copy_record (IndicatorPowerShmRecord          * dst,
+             const IndicatorPowerDeviceRecord * src)
+{
+  memset (dst, 0, sizeof (IndicatorPowerShmRecord));
+
+  dst->percentage = src->percentage;
+  dst->time = src->time;
+  dst->kind = src->kind;
+  dst->state = src->state;
+  dst->power_supply = src->power_supply ? 1 : 0;
+
+  if (src->object_path != NULL)
+    g_strlcpy (dst->object_path, src->object_path, sizeof (dst->object_path));
+  if (src->model != NULL)
+    g_strlcpy (dst->model, src->model, sizeof (dst->model));
+}
+
+/**
+ * Replace the published snapshot with @snapshot.
+ *
+ * Devices past INDICATOR_POWER_SHM_MAX_RECORDS are left out.
+ */
+void
+indicator_power_shared_snapshot_writer_publish (IndicatorPowerSharedSnapshotWriter * writer,
+                                                const IndicatorPowerDeviceSnapshot * snapshot)
+{
+  IndicatorPowerShm * shm;
+  guint32 seq;
+  guint n_records;
+  guint i;
+
+  g_return_if_fail (writer != NULL);
+
+  shm = writer->shm;
+  n_records = snapshot != NULL ? MIN (snapshot->n_records, INDICATOR_POWER_SHM_MAX_RECORDS) : 0;
+
+  /* make the sequence odd before touching anything... */
+  seq = __atomic_load_n (&shm->sequence, __ATOMIC_RELAXED);
+  __atomic_store_n (&shm->sequence, seq + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence (__ATOMIC_RELEASE);
+
+  for (i=0; i<n_records; i++)
+    copy_record (&shm->records[i], &snapshot->records[i]);
+  shm->n_records = n_records;
+
+  /* ...and even again once we're done */
+  __atomic_store_n (&shm->sequence, seq + 2, __ATOMIC_RELEASE);
+}
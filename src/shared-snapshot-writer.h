@@ -0,0 +1,45 @@
+/*
+ * Copyright 2026 The Ayatana Indicators project
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __INDICATOR_POWER_SHARED_SNAPSHOT_WRITER__H__
+#define __INDICATOR_POWER_SHARED_SNAPSHOT_WRITER__H__
+
+#include <glib.h>
+
+#include "device-snapshot.h"
+
+G_BEGIN_DECLS
+
+/**
+ * Publishes device snapshots in a file for shared-snapshot.h readers.
+ *
+ * Only one thread may publish through a writer at a time.
+ */
+typedef struct _IndicatorPowerSharedSnapshotWriter IndicatorPowerSharedSnapshotWriter;
+
+gchar                              * indicator_power_shared_snapshot_get_default_filename (void);
+
+IndicatorPowerSharedSnapshotWriter * indicator_power_shared_snapshot_writer_new     (const gchar  * filename,
+                                                                                     GError      ** error);
+
+void                                 indicator_power_shared_snapshot_writer_free    (IndicatorPowerSharedSnapshotWriter * writer);
+
+void                                 indicator_power_shared_snapshot_writer_publish (IndicatorPowerSharedSnapshotWriter * writer,
+                                                                                     const IndicatorPowerDeviceSnapshot * snapshot);
+
+G_END_DECLS
+
+#endif /* __INDICATOR_POWER_SHARED_SNAPSHOT_WRITER__H__ */
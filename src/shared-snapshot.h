@@ -0,0 +1,206 @@
+/*
+ * Copyright 2026 The Ayatana Indicators project
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __INDICATOR_POWER_SHARED_SNAPSHOT__H__
+#define __INDICATOR_POWER_SHARED_SNAPSHOT__H__
+
+/**
+ * The device snapshot that ayatana-indicator-power-service publishes in
+ * $XDG_RUNTIME_DIR when the "shared-snapshot" setting is enabled.
+ *
+ * This header is self-contained so that clients can copy it into their
+ * own tree: map the file once with indicator_power_shm_open(), then call
+ * indicator_power_shm_read() as often as needed. Reading takes no locks
+ * and makes no syscalls.
+ *
+ * The file holds one IndicatorPowerShm. Its 'sequence' field is a seqlock:
+ * the service makes it odd before changing anything and even again when
+ * it's done, so a reader that sees the same even value before and after
+ * copying the data knows that its copy is consistent.
+ */
+
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define INDICATOR_POWER_SHM_BASENAME "ayatana-indicator-power.snapshot"
+
+#define INDICATOR_POWER_SHM_MAGIC 0x50414949u /* "IIAP" */
+#define INDICATOR_POWER_SHM_VERSION 1u
+
+#define INDICATOR_POWER_SHM_MAX_RECORDS 32
+#define INDICATOR_POWER_SHM_PATH_MAX 128
+#define INDICATOR_POWER_SHM_MODEL_MAX 64
+
+/* how many times indicator_power_shm_read() retries before giving up */
+#define INDICATOR_POWER_SHM_READ_RETRIES 100000
+
+typedef enum
+{
+  INDICATOR_POWER_SHM_OK = 0,
+  INDICATOR_POWER_SHM_STALE = -1, /* not published, or a different version */
+  INDICATOR_POWER_SHM_BUSY = -2   /* the writer didn't finish in time */
+}
+IndicatorPowerShmResult;
+
+/* one device; the same fields as IndicatorPowerDeviceRecord */
+typedef struct
+{
+  double   percentage;
+  int64_t  time;          /* seconds until empty or full, or 0 */
+  uint32_t kind;          /* UpDeviceKind */
+  uint32_t state;         /* UpDeviceState */
+  uint32_t power_supply;
+  uint32_t reserved;
+  char     object_path[INDICATOR_POWER_SHM_PATH_MAX]; /* "" for synthesized devices */
+  char     model[INDICATOR_POWER_SHM_MODEL_MAX];
+}
+IndicatorPowerShmRecord;
+
+typedef struct
+{
+  uint32_t magic;
+  uint32_t version;
+  uint32_t sequence;      /* the seqlock; odd while the writer is busy */
+  uint32_t n_records;
+  uint32_t record_size;   /* sizeof(IndicatorPowerShmRecord) */
+  uint32_t max_records;   /* INDICATOR_POWER_SHM_MAX_RECORDS */
+  uint64_t reserved[5];
+  IndicatorPowerShmRecord records[INDICATOR_POWER_SHM_MAX_RECORDS];
+}
+IndicatorPowerShm;
+
+/**
+ * Map a published snapshot read-only.
+ *
+ * Returns NULL if @filename can't be opened or is too small.
+ * Release with indicator_power_shm_close().
+ */
+static inline const IndicatorPowerShm *
+indicator_power_shm_open (const char * filename)
+{
+  struct stat st;
+  void * map = MAP_FAILED;
+  int fd;
+
+  fd = open (filename, O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return NULL;
+
+  if ((fstat (fd, &st) == 0) && (st.st_size >= (off_t) sizeof (IndicatorPowerShm)))
+    map = mmap (NULL, sizeof (IndicatorPowerShm), PROT_READ, MAP_SHARED, fd, 0);
+
+  close (fd);
+
+  return map == MAP_FAILED ? NULL : (const IndicatorPowerShm *) map;
+}
+
+/**
+ * Map the snapshot at its usual place in $XDG_RUNTIME_DIR.
+ */
+static inline const IndicatorPowerShm *
+indicator_power_shm_open_default (void)
+{
+  char filename[4096];
+  const char * runtime_dir = getenv ("XDG_RUNTIME_DIR");
+
+  if ((runtime_dir == NULL) || (*runtime_dir == '\0'))
+    return NULL;
+
+  snprintf (filename, sizeof (filename), "%s/%s", runtime_dir, INDICATOR_POWER_SHM_BASENAME);
+  return indicator_power_shm_open (filename);
+}
+
+static inline void
+indicator_power_shm_close (const IndicatorPowerShm * shm)
+{
+  if (shm != NULL)
+    munmap ((void *) shm, sizeof (IndicatorPowerShm));
+}
+
+/**
+ * The current sequence number.
+ *
+ * It changes whenever the snapshot does, so a poller can compare it
+ * with copy->sequence from its last read and skip unchanged snapshots.
+ */
+static inline uint32_t
+indicator_power_shm_get_sequence (const IndicatorPowerShm * shm)
+{
+  return __atomic_load_n (&shm->sequence, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * Copy a consistent snapshot from @shm into @copy.
+ *
+ * Only the header and the first copy->n_records records are filled in.
+ * On success, copy->sequence identifies the snapshot that was read.
+ *
+ * If this returns INDICATOR_POWER_SHM_STALE, the service has stopped
+ * publishing this file; close it and try opening it again later.
+ */
+static inline IndicatorPowerShmResult
+indicator_power_shm_read (const IndicatorPowerShm * shm, IndicatorPowerShm * copy)
+{
+  int i;
+
+  for (i=0; i<INDICATOR_POWER_SHM_READ_RETRIES; ++i)
+    {
+      uint32_t begin;
+      uint32_t n_records;
+
+      begin = __atomic_load_n (&shm->sequence, __ATOMIC_ACQUIRE);
+      if (begin & 1u)
+        continue;
+
+      memcpy (copy, shm, offsetof (IndicatorPowerShm, records));
+      n_records = copy->n_records;
+      if (n_records > INDICATOR_POWER_SHM_MAX_RECORDS)
+        n_records = INDICATOR_POWER_SHM_MAX_RECORDS;
+      memcpy (copy->records, shm->records, n_records * sizeof (IndicatorPowerShmRecord));
+
+      __atomic_thread_fence (__ATOMIC_ACQUIRE);
+      if (__atomic_load_n (&shm->sequence, __ATOMIC_RELAXED) != begin)
+        continue;
+
+      if ((copy->magic != INDICATOR_POWER_SHM_MAGIC) ||
+          (copy->version != INDICATOR_POWER_SHM_VERSION) ||
+          (copy->record_size != sizeof (IndicatorPowerShmRecord)))
+        return INDICATOR_POWER_SHM_STALE;
+
+      copy->sequence = begin;
+      copy->n_records = n_records;
+      return INDICATOR_POWER_SHM_OK;
+    }
+
+  return INDICATOR_POWER_SHM_BUSY;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __INDICATOR_POWER_SHARED_SNAPSHOT__H__ */
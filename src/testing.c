@@ -27,6 +27,7 @@
 #include "testing.h"
 
 #include <glib-object.h>
+#include <gio/gio.h>
 
 /**
 ***  GObject Properties
@@ -52,7 +53,8 @@ typedef struct
   IndicatorPowerService * service;
   IndicatorPowerDevice * battery_mock;
   gpointer provider_mock;
-  gpointer provider_upower;
+  gpointer provider_real;
+  guint n_mock_devices_added;
 }
 IndicatorPowerTestingPrivate;
 
@@ -76,7 +78,7 @@ update_device_provider (IndicatorPowerTesting * self)
 
   device_provider = dbus_testing_get_mock_battery_enabled(p->skeleton)
                   ? p->provider_mock
-                  : p->provider_upower;
+                  : p->provider_real;
   indicator_power_service_set_device_provider(p->service, device_provider);
 }
 
@@ -181,6 +183,303 @@ on_mock_battery_minutes_left_changed(DbusTesting           * skeleton,
                NULL);
 }
 
+/***
+****  Mock devices
+***/
+
+/* the most devices AddMockDevices adds in one call */
+#define MAX_MOCK_DEVICES_PER_CALL 10000
+
+/* Look up each of @paths in the mock provider.
+   Returns FALSE and sets @error if any of them is unknown. */
+static gboolean
+get_mock_devices (IndicatorPowerTesting  * self,
+                  const gchar * const    * paths,
+                  GList                 ** setme,
+                  GError                ** error)
+{
+  IndicatorPowerDeviceProviderMock * mock = get_priv(self)->provider_mock;
+  GList * devices = NULL;
+
+  for ( ; paths && *paths; ++paths)
+    {
+      IndicatorPowerDevice * device = indicator_power_device_provider_mock_get_device (mock, *paths);
+
+      if (device == NULL)
+        {
+          g_set_error (error, G_DBUS_ERROR, G_DBUS_ERROR_INVALID_ARGS, "No mock device '%s'", *paths);
+          g_list_free (devices);
+          return FALSE;
+        }
+
+      devices = g_list_prepend (devices, device);
+    }
+
+  *setme = g_list_reverse (devices);
+  return TRUE;
+}
+
+static gboolean
+on_handle_add_mock_devices (DbusTesting           * skeleton,
+                            GDBusMethodInvocation * invocation,
+                            guint32                 kind,
+                            guint32                 count,
+                            gpointer                gself)
+{
+  priv_t * const p = get_priv (INDICATOR_POWER_TESTING(gself));
+  IndicatorPowerDeviceProviderMock * mock = p->provider_mock;
+  gchar ** paths;
+  guint i;
+
+  if (kind >= UP_DEVICE_KIND_LAST)
+    {
+      g_dbus_method_invocation_return_error (invocation, G_DBUS_ERROR, G_DBUS_ERROR_INVALID_ARGS,
+                                             "Unknown device kind %u", kind);
+      return TRUE;
+    }
+
+  if (count > MAX_MOCK_DEVICES_PER_CALL)
+    {
+      g_dbus_method_invocation_return_error (invocation, G_DBUS_ERROR, G_DBUS_ERROR_LIMITS_EXCEEDED,
+                                             "No more than %d mock devices per call", MAX_MOCK_DEVICES_PER_CALL);
+      return TRUE;
+    }
+
+  paths = g_new0 (gchar*, count+1);
+
+  indicator_power_device_provider_mock_freeze (mock);
+  for (i=0; i<count; i++)
+    {
+      const guint n = ++p->n_mock_devices_added;
+      gchar * model = g_strdup_printf ("Mock Device %u", n);
+      IndicatorPowerDevice * device;
+
+      paths[i] = g_strdup_printf (BUS_PATH"/Testing/mock_%u", n);
+      device = indicator_power_device_new (paths[i],
+                                           (UpDeviceKind) kind,
+                                           model,
+                                           50.0,
+                                           UP_DEVICE_STATE_DISCHARGING,
+                                           60*30,
+                                           TRUE);
+      indicator_power_device_provider_add_device (mock, device);
+      g_object_unref (device);
+      g_free (model);
+    }
+  indicator_power_device_provider_mock_thaw (mock);
+
+  dbus_testing_complete_add_mock_devices (skeleton, invocation, (const gchar * const *) paths);
+  g_strfreev (paths);
+  return TRUE;
+}
+
+static gboolean
+on_handle_remove_mock_devices (DbusTesting           * skeleton,
+                               GDBusMethodInvocation * invocation,
+                               const gchar * const   * paths,
+                               gpointer                gself)
+{
+  IndicatorPowerTesting * const self = INDICATOR_POWER_TESTING(gself);
+  IndicatorPowerDeviceProviderMock * mock = get_priv(self)->provider_mock;
+  GError * error = NULL;
+  GList * devices;
+  GList * l;
+
+  if (!get_mock_devices (self, paths, &devices, &error))
+    {
+      g_dbus_method_invocation_take_error (invocation, error);
+      return TRUE;
+    }
+
+  indicator_power_device_provider_mock_freeze (mock);
+  for (l=devices; l!=NULL; l=l->next)
+    indicator_power_device_provider_remove_device (mock, l->data);
+  indicator_power_device_provider_mock_thaw (mock);
+
+  g_list_free (devices);
+  dbus_testing_complete_remove_mock_devices (skeleton, invocation);
+  return TRUE;
+}
+
+typedef struct
+{
+  IndicatorPowerDevice * device;
+  const gchar * property_name;
+  GValue value;
+}
+MockChange;
+
+static void
+mock_change_clear (gpointer gchange)
+{
+  g_value_unset (&((MockChange*)gchange)->value);
+}
+
+/* Turn one {sv} into a value for the device property of the same name.
+   Returns FALSE and sets @error if there's no such property or the
+   value doesn't fit it. */
+static gboolean
+mock_change_init (MockChange   * change,
+                  const gchar  * key,
+                  GVariant     * variant,
+                  GError      ** error)
+{
+  GParamSpec * pspec = g_object_class_find_property (G_OBJECT_GET_CLASS(change->device), key);
+  GValue tmp = G_VALUE_INIT;
+  gboolean ok;
+
+  if ((pspec == NULL) || !g_strcmp0 (key, INDICATOR_POWER_DEVICE_OBJECT_PATH))
+    {
+      g_set_error (error, G_DBUS_ERROR, G_DBUS_ERROR_INVALID_ARGS, "Unknown device property '%s'", key);
+      return FALSE;
+    }
+
+  g_dbus_gvariant_to_gvalue (variant, &tmp);
+  g_value_init (&change->value, pspec->value_type);
+  ok = g_value_type_transformable (G_VALUE_TYPE(&tmp), pspec->value_type) &&
+       g_value_transform (&tmp, &change->value) &&
+       !g_param_value_validate (pspec, &change->value);
+  g_value_unset (&tmp);
+
+  if (!ok)
+    {
+      g_set_error (error, G_DBUS_ERROR, G_DBUS_ERROR_INVALID_ARGS,
+                   "Invalid value for '%s'", key);
+      g_value_unset (&change->value);
+      return FALSE;
+    }
+
+  change->property_name = pspec->name;
+  return TRUE;
+}
+
+static gboolean
+on_handle_apply_mock_changes (DbusTesting           * skeleton,
+                              GDBusMethodInvocation * invocation,
+                              GVariant              * changes,
+                              gpointer                gself)
+{
+  IndicatorPowerTesting * const self = INDICATOR_POWER_TESTING(gself);
+  IndicatorPowerDeviceProviderMock * mock = get_priv(self)->provider_mock;
+  GArray * parsed;
+  GVariantIter iter;
+  GVariantIter * properties;
+  const gchar * path;
+  GError * error = NULL;
+  guint i;
+
+  parsed = g_array_new (FALSE, TRUE, sizeof(MockChange));
+  g_array_set_clear_func (parsed, mock_change_clear);
+
+  /* check every change before making any of them */
+  g_variant_iter_init (&iter, changes);
+  while ((error == NULL) && g_variant_iter_next (&iter, "(&oa{sv})", &path, &properties))
+    {
+      IndicatorPowerDevice * device = indicator_power_device_provider_mock_get_device (mock, path);
+      const gchar * key;
+      GVariant * value;
+
+      if (device == NULL)
+        g_set_error (&error, G_DBUS_ERROR, G_DBUS_ERROR_INVALID_ARGS, "No mock device '%s'", path);
+
+      while ((error == NULL) && g_variant_iter_next (properties, "{&sv}", &key, &value))
+        {
+          MockChange change = { device, NULL, G_VALUE_INIT };
+
+          if (mock_change_init (&change, key, value, &error))
+            g_array_append_val (parsed, change);
+
+          g_variant_unref (value);
+        }
+
+      g_variant_iter_free (properties);
+    }
+
+  if (error != NULL)
+    {
+      g_dbus_method_invocation_take_error (invocation, error);
+      g_array_unref (parsed);
+      return TRUE;
+    }
+
+  indicator_power_device_provider_mock_freeze (mock);
+  for (i=0; i<parsed->len; i++)
+    {
+      MockChange * change = &g_array_index (parsed, MockChange, i);
+      g_object_set_property (G_OBJECT(change->device), change->property_name, &change->value);
+    }
+  indicator_power_device_provider_mock_thaw (mock);
+
+  g_array_unref (parsed);
+  dbus_testing_complete_apply_mock_changes (skeleton, invocation);
+  return TRUE;
+}
+
+static gboolean
+on_handle_load_mock_profile (DbusTesting           * skeleton,
+                             GDBusMethodInvocation * invocation,
+                             const gchar * const   * paths,
+                             GVariant              * keyframes,
+                             gdouble                 speed,
+                             gpointer                gself)
+{
+  IndicatorPowerTesting * const self = INDICATOR_POWER_TESTING(gself);
+  IndicatorPowerDeviceProviderMock * mock = get_priv(self)->provider_mock;
+  const gsize n_keyframes = g_variant_n_children (keyframes);
+  IndicatorPowerMockKeyframe * parsed;
+  GError * error = NULL;
+  GList * devices = NULL;
+  gsize i;
+
+  if (n_keyframes == 0)
+    g_set_error (&error, G_DBUS_ERROR, G_DBUS_ERROR_INVALID_ARGS, "A profile needs keyframes");
+  else if (!(speed > 0))
+    g_set_error (&error, G_DBUS_ERROR, G_DBUS_ERROR_INVALID_ARGS, "Speed must be more than 0");
+
+  parsed = g_new (IndicatorPowerMockKeyframe, MAX (n_keyframes, 1));
+  for (i=0; (error == NULL) && (i<n_keyframes); i++)
+    {
+      IndicatorPowerMockKeyframe * k = &parsed[i];
+      guint32 state;
+
+      g_variant_get_child (keyframes, i, "(tdut)", &k->offset, &k->percentage, &state, &k->time);
+      k->state = (UpDeviceState) state;
+
+      if ((i > 0) && (k->offset <= parsed[i-1].offset))
+        g_set_error (&error, G_DBUS_ERROR, G_DBUS_ERROR_INVALID_ARGS, "Keyframes must be sorted by time");
+      else if (!(0.0 <= k->percentage && k->percentage <= 100.0))
+        g_set_error (&error, G_DBUS_ERROR, G_DBUS_ERROR_INVALID_ARGS, "Invalid percentage %f", k->percentage);
+      else if (state >= UP_DEVICE_STATE_LAST)
+        g_set_error (&error, G_DBUS_ERROR, G_DBUS_ERROR_INVALID_ARGS, "Unknown device state %u", state);
+    }
+
+  if ((error == NULL) && get_mock_devices (self, paths, &devices, &error))
+    {
+      /* no paths means every mock device */
+      indicator_power_device_provider_mock_play_profile (mock, devices, parsed, n_keyframes, speed);
+      dbus_testing_complete_load_mock_profile (skeleton, invocation);
+    }
+  else
+    {
+      g_dbus_method_invocation_take_error (invocation, error);
+    }
+
+  g_list_free (devices);
+  g_free (parsed);
+  return TRUE;
+}
+
+static gboolean
+on_handle_stop_mock_profile (DbusTesting           * skeleton,
+                             GDBusMethodInvocation * invocation,
+                             gpointer                gself)
+{
+  indicator_power_device_provider_mock_stop_profile (get_priv(INDICATOR_POWER_TESTING(gself))->provider_mock);
+
+  dbus_testing_complete_stop_mock_profile (skeleton, invocation);
+  return TRUE;
+}
+
 static void
 on_bus_changed(IndicatorPowerService * service,
                GParamSpec            * spec     G_GNUC_UNUSED,
@@ -245,7 +544,7 @@ my_dispose(GObject * o)
 
   set_bus(self, NULL);
   g_clear_object(&p->skeleton);
-  g_clear_object(&p->provider_upower);
+  g_clear_object(&p->provider_real);
   g_clear_object(&p->provider_mock);
   g_clear_object(&p->battery_mock);
   g_clear_object(&p->service);
@@ -265,6 +564,13 @@ my_constructed (GObject * o)
   priv_t * const p = get_priv (self);
 
   g_assert(p->service != NULL); /* G_PARAM_CONSTRUCT_ONLY */
+
+  /* main() starts the real provider before the service so that it's
+     already on its way when the bus name is owned; adopt that one */
+  g_object_get(p->service, "device-provider", &p->provider_real, NULL);
+  if (p->provider_real == NULL)
+    p->provider_real = indicator_power_device_provider_upower_new();
+
   g_signal_connect(p->service, "notify::bus", G_CALLBACK(on_bus_changed), o);
   on_bus_changed(p->service, NULL, self);
   update_device_provider(self);
@@ -296,6 +602,16 @@ indicator_power_testing_init (IndicatorPowerTesting * self)
                    G_CALLBACK(on_mock_battery_state_changed), self);
   g_signal_connect(p->skeleton, "notify::mock-battery-minutes-left",
                    G_CALLBACK(on_mock_battery_minutes_left_changed), self);
+  g_signal_connect(p->skeleton, "handle-add-mock-devices",
+                   G_CALLBACK(on_handle_add_mock_devices), self);
+  g_signal_connect(p->skeleton, "handle-remove-mock-devices",
+                   G_CALLBACK(on_handle_remove_mock_devices), self);
+  g_signal_connect(p->skeleton, "handle-apply-mock-changes",
+                   G_CALLBACK(on_handle_apply_mock_changes), self);
+  g_signal_connect(p->skeleton, "handle-load-mock-profile",
+                   G_CALLBACK(on_handle_load_mock_profile), self);
+  g_signal_connect(p->skeleton, "handle-stop-mock-profile",
+                   G_CALLBACK(on_handle_stop_mock_profile), self);
 
   /* Mock Battery */
 
@@ -314,10 +630,6 @@ indicator_power_testing_init (IndicatorPowerTesting * self)
 
   indicator_power_device_provider_add_device(INDICATOR_POWER_DEVICE_PROVIDER_MOCK(p->provider_mock),
                                              p->battery_mock);
-
-  /* UPower Provider */
-
-  p->provider_upower = indicator_power_device_provider_upower_new();
 }
 
 static void
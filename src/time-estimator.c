@@ -0,0 +1,159 @@
+/*
+ * Copyright 2026 The Ayatana Indicators project
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "time-estimator.h"
+
+#include <string.h> /* memset() */
+
+/* weight given to the newest interval's rate */
+#define RATE_ALPHA 0.3
+
+/* don't trust the average until it's seen this many intervals... */
+#define MIN_RATES 2
+
+/* ...and the buffered samples span at least this long */
+#define MIN_SPAN_USEC (60 * G_USEC_PER_SEC)
+
+/* how far the average may stray from the buffer's overall rate */
+#define MAX_DISAGREEMENT 0.25
+
+void
+indicator_power_time_estimator_reset (IndicatorPowerTimeEstimator * estimator)
+{
+  g_return_if_fail (estimator != NULL);
+
+  memset (estimator, 0, sizeof (IndicatorPowerTimeEstimator));
+}
+
+/**
+ * Add a sample.
+ *
+ * Repeats of the newest sample's percentage are ignored so that an
+ * interval measures how long it took to go from one value to the next.
+ * Likewise, the interval that ends at the second sample is left out of
+ * the average because we don't know when the first value was reached.
+ */
+void
+indicator_power_time_estimator_add_sample (IndicatorPowerTimeEstimator * estimator,
+                                           gint64                        time,
+                                           gdouble                       percentage)
+{
+  guint prev;
+  gdouble rate;
+
+  g_return_if_fail (estimator != NULL);
+
+  if (estimator->n_samples > 0)
+    {
+      prev = estimator->head;
+
+      if (estimator->samples[prev].percentage == percentage)
+        return;
+
+      /* time going backwards means the caller's clock changed under us */
+      if (time <= estimator->samples[prev].time)
+        {
+          indicator_power_time_estimator_reset (estimator);
+        }
+      else
+        {
+          rate = (percentage - estimator->samples[prev].percentage)
+               / ((time - estimator->samples[prev].time) / (gdouble)G_USEC_PER_SEC);
+
+          /* if the direction changed, the old samples are no help */
+          if ((estimator->n_rates > 0) && ((rate > 0) != (estimator->rate > 0)))
+            {
+              indicator_power_time_estimator_reset (estimator);
+            }
+          else if (estimator->n_samples > 1)
+            {
+              if (estimator->n_rates == 0)
+                estimator->rate = rate;
+              else
+                estimator->rate = RATE_ALPHA * rate + (1.0 - RATE_ALPHA) * estimator->rate;
+              estimator->n_rates++;
+            }
+        }
+    }
+
+  if (estimator->n_samples > 0)
+    estimator->head = (estimator->head + 1) % INDICATOR_POWER_TIME_ESTIMATOR_N_SAMPLES;
+  estimator->samples[estimator->head].time = time;
+  estimator->samples[estimator->head].percentage = percentage;
+  if (estimator->n_samples < INDICATOR_POWER_TIME_ESTIMATOR_N_SAMPLES)
+    estimator->n_samples++;
+}
+
+/**
+ * Get the averaged rate of change in percent per second.
+ *
+ * Return value: TRUE if there's enough history to trust @rate.
+ */
+gboolean
+indicator_power_time_estimator_get_rate (const IndicatorPowerTimeEstimator * estimator,
+                                         gdouble                           * rate)
+{
+  guint tail;
+  gint64 span;
+  gdouble overall;
+
+  g_return_val_if_fail (estimator != NULL, FALSE);
+
+  if ((estimator->n_rates < MIN_RATES) || (estimator->rate == 0))
+    return FALSE;
+
+  tail = (estimator->head + INDICATOR_POWER_TIME_ESTIMATOR_N_SAMPLES + 1 - estimator->n_samples)
+       % INDICATOR_POWER_TIME_ESTIMATOR_N_SAMPLES;
+  span = estimator->samples[estimator->head].time - estimator->samples[tail].time;
+  if (span < MIN_SPAN_USEC)
+    return FALSE;
+
+  overall = (estimator->samples[estimator->head].percentage - estimator->samples[tail].percentage)
+          / (span / (gdouble)G_USEC_PER_SEC);
+  if (ABS (estimator->rate - overall) > MAX_DISAGREEMENT * ABS (overall))
+    return FALSE;
+
+  if (rate != NULL)
+    *rate = estimator->rate;
+  return TRUE;
+}
+
+/**
+ * Estimate the seconds until the device is full (if @charging)
+ * or empty, measured from the newest sample.
+ *
+ * Return value: the estimate, or 0 if there isn't a trustworthy one.
+ */
+time_t
+indicator_power_time_estimator_get_time (const IndicatorPowerTimeEstimator * estimator,
+                                         gboolean                            charging)
+{
+  gdouble rate;
+  gdouble remaining;
+
+  g_return_val_if_fail (estimator != NULL, 0);
+
+  if (!indicator_power_time_estimator_get_rate (estimator, &rate))
+    return 0;
+
+  if (charging != (rate > 0))
+    return 0;
+
+  remaining = charging ? 100.0 - estimator->samples[estimator->head].percentage
+                       : estimator->samples[estimator->head].percentage;
+
+  return (time_t) MAX (0.0, remaining / ABS (rate));
+}
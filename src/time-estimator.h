@@ -0,0 +1,68 @@
+/*
+ * Copyright 2026 The Ayatana Indicators project
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __INDICATOR_POWER_TIME_ESTIMATOR__H__
+#define __INDICATOR_POWER_TIME_ESTIMATOR__H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+#define INDICATOR_POWER_TIME_ESTIMATOR_N_SAMPLES 8
+
+/**
+ * Estimates a device's time remaining from how fast its percentage is
+ * changing, for use while UPower hasn't come up with an estimate yet.
+ *
+ * It keeps the last few (timestamp, percentage) samples in a ring buffer
+ * and an exponentially-weighted moving average of the rate between them.
+ * An estimate is only given once the samples span long enough and the
+ * average agrees with the overall rate across the buffer.
+ *
+ * The struct is fixed-size so that devices can embed it instead of
+ * allocating one; treat its fields as private.
+ */
+typedef struct
+{
+  struct
+  {
+    gint64 time;       /* microseconds, e.g. from g_get_monotonic_time() */
+    gdouble percentage;
+  }
+  samples[INDICATOR_POWER_TIME_ESTIMATOR_N_SAMPLES];
+
+  guint head;          /* index of the newest sample */
+  guint n_samples;
+  guint n_rates;       /* how many intervals have been folded into 'rate' */
+  gdouble rate;        /* percent per second */
+}
+IndicatorPowerTimeEstimator;
+
+void     indicator_power_time_estimator_reset      (IndicatorPowerTimeEstimator * estimator);
+
+void     indicator_power_time_estimator_add_sample (IndicatorPowerTimeEstimator * estimator,
+                                                    gint64                        time,
+                                                    gdouble                       percentage);
+
+gboolean indicator_power_time_estimator_get_rate   (const IndicatorPowerTimeEstimator * estimator,
+                                                    gdouble                           * rate);
+
+time_t   indicator_power_time_estimator_get_time   (const IndicatorPowerTimeEstimator * estimator,
+                                                    gboolean                            charging);
+
+G_END_DECLS
+
+#endif /* __INDICATOR_POWER_TIME_ESTIMATOR__H__ */
@@ -0,0 +1,385 @@
+/*
+ * Copyright 2026 The Ayatana Indicators project
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "glib-fixture.h"
+
+#include "backlight.h"
+
+#include <gtest/gtest.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include <fcntl.h> // open()
+#include <unistd.h> // geteuid(), symlink()
+
+/***
+****
+***/
+
+/**
+ * Builds a fake sysfs tree in a temporary directory.
+ */
+class BacklightFixture: public GlibFixture
+{
+private:
+
+  typedef GlibFixture super;
+
+protected:
+
+  gchar * sysfs_root {};
+  IndicatorPowerBacklight * backlight {};
+  int notify_count {};
+
+  void SetUp() override
+  {
+    super::SetUp();
+
+    GError * error {};
+    sysfs_root = g_dir_make_tmp("indicator-power-sysfs-XXXXXX", &error);
+    g_assert_no_error(error);
+  }
+
+  void TearDown() override
+  {
+    g_clear_object(&backlight);
+
+    remove_recursive(sysfs_root);
+    g_clear_pointer(&sysfs_root, g_free);
+
+    super::TearDown();
+  }
+
+  static void remove_recursive(const gchar * path)
+  {
+    auto dir = g_dir_open(path, 0, nullptr);
+    if (dir != nullptr)
+      {
+        const gchar * name;
+        while ((name = g_dir_read_name(dir)))
+          {
+            auto child = g_build_filename(path, name, nullptr);
+            remove_recursive(child);
+            g_free(child);
+          }
+        g_dir_close(dir);
+      }
+    g_remove(path);
+  }
+
+  std::string device_dir(const char * name) const
+  {
+    auto tmp = g_build_filename(sysfs_root, "class", "backlight", name, nullptr);
+    std::string ret {tmp};
+    g_free(tmp);
+    return ret;
+  }
+
+  // writes in place, like the kernel does, so open fds see the change
+  static void write_attribute(const std::string& dir, const char * attribute, const std::string& value)
+  {
+    const auto filename = dir + "/" + attribute;
+    auto fp = fopen(filename.c_str(), "w");
+    ASSERT_NE(nullptr, fp);
+    fputs(value.c_str(), fp);
+    fclose(fp);
+  }
+
+  static int read_attribute(const std::string& dir, const char * attribute)
+  {
+    gchar * contents {};
+    const auto filename = dir + "/" + attribute;
+    g_file_get_contents(filename.c_str(), &contents, nullptr, nullptr);
+    const int ret = contents ? atoi(contents) : -1;
+    g_free(contents);
+    return ret;
+  }
+
+  std::string add_device(const char * name, const char * type, int max_brightness, int brightness)
+  {
+    const auto dir = device_dir(name);
+    g_mkdir_with_parents(dir.c_str(), 0755);
+    write_attribute(dir, "type", std::string(type) + "\n");
+    write_attribute(dir, "max_brightness", std::to_string(max_brightness) + "\n");
+    write_attribute(dir, "brightness", std::to_string(brightness) + "\n");
+    write_attribute(dir, "actual_brightness", std::to_string(brightness) + "\n");
+    return dir;
+  }
+
+  void create_backlight()
+  {
+    backlight = indicator_power_backlight_new(sysfs_root);
+    g_signal_connect_swapped(backlight, "notify::" INDICATOR_POWER_BACKLIGHT_PROP_BRIGHTNESS,
+                             G_CALLBACK(on_brightness_notify), this);
+  }
+
+  static void on_brightness_notify(gpointer gself)
+  {
+    ++static_cast<BacklightFixture*>(gself)->notify_count;
+  }
+
+  struct SetResult
+  {
+    bool done {};
+    bool success {};
+    GError * error {};
+  };
+
+  void set_brightness(int brightness, SetResult& result)
+  {
+    indicator_power_backlight_set_brightness(backlight, brightness, nullptr,
+        [](GObject* o, GAsyncResult* res, gpointer gresult){
+          auto r = static_cast<SetResult*>(gresult);
+          r->success = indicator_power_backlight_set_brightness_finish(INDICATOR_POWER_BACKLIGHT(o), res, &r->error);
+          r->done = true;
+        }, &result);
+    EXPECT_TRUE(wait_for([&result](){return result.done;}));
+  }
+};
+
+/***
+****
+***/
+
+TEST_F(BacklightFixture, NoDevices)
+{
+  create_backlight();
+  EXPECT_FALSE(indicator_power_backlight_is_available(backlight));
+
+  SetResult result;
+  set_brightness(10, result);
+  EXPECT_FALSE(result.success);
+  EXPECT_TRUE(g_error_matches(result.error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND));
+  g_clear_error(&result.error);
+}
+
+TEST_F(BacklightFixture, PrefersFirmwareInterfaces)
+{
+  add_device("intel_backlight", "raw", 4882, 2000);
+  add_device("acpi_video0", "firmware", 15, 7);
+  add_device("nv_backlight", "platform", 100, 50);
+
+  create_backlight();
+  ASSERT_TRUE(indicator_power_backlight_is_available(backlight));
+  EXPECT_STREQ("acpi_video0", indicator_power_backlight_get_name(backlight));
+  EXPECT_EQ(15, indicator_power_backlight_get_max_brightness(backlight));
+  EXPECT_EQ(7, indicator_power_backlight_get_brightness(backlight));
+}
+
+TEST_F(BacklightFixture, WritesBrightness)
+{
+  const auto dir = add_device("intel_backlight", "raw", 4882, 2000);
+  create_backlight();
+  ASSERT_TRUE(indicator_power_backlight_is_available(backlight));
+
+  SetResult result;
+  set_brightness(1234, result);
+  EXPECT_TRUE(result.success);
+  EXPECT_EQ(1234, read_attribute(dir, "brightness"));
+  EXPECT_EQ(1234, indicator_power_backlight_get_brightness(backlight));
+
+  // out-of-range values are clamped
+  result = SetResult{};
+  set_brightness(99999, result);
+  EXPECT_TRUE(result.success);
+  EXPECT_EQ(4882, read_attribute(dir, "brightness"));
+
+  // our own changes don't count as external ones
+  wait_msec(100);
+  EXPECT_EQ(0, notify_count);
+}
+
+TEST_F(BacklightFixture, FollowsExternalChanges)
+{
+  const auto dir = add_device("intel_backlight", "raw", 4882, 2000);
+  create_backlight();
+  ASSERT_TRUE(indicator_power_backlight_is_available(backlight));
+
+  // e.g. a hotkey handled by the firmware
+  write_attribute(dir, "actual_brightness", "3000\n");
+  EXPECT_TRUE(wait_for([this](){return notify_count > 0;}, 3000));
+  EXPECT_EQ(3000, indicator_power_backlight_get_brightness(backlight));
+}
+
+/***
+****  Falling back to logind
+***/
+
+class BacklightLogindFixture: public BacklightFixture
+{
+private:
+
+  typedef BacklightFixture super;
+
+protected:
+
+  GTestDBus * test_dbus {};
+  GDBusConnection * logind_bus {};
+  GDBusNodeInfo * node_info {};
+  guint reg_id {};
+  guint own_id {};
+
+  int set_brightness_calls {};
+  std::string last_subsystem;
+  std::string last_name;
+  guint32 last_brightness {};
+
+  void SetUp() override
+  {
+    super::SetUp();
+
+    test_dbus = g_test_dbus_new(G_TEST_DBUS_NONE);
+    g_test_dbus_up(test_dbus);
+    g_setenv("DBUS_SYSTEM_BUS_ADDRESS", g_test_dbus_get_bus_address(test_dbus), true);
+
+    GError * error {};
+    logind_bus = g_dbus_connection_new_for_address_sync(
+        g_test_dbus_get_bus_address(test_dbus),
+        GDBusConnectionFlags(G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT |
+                             G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION),
+        nullptr,
+        nullptr,
+        &error);
+    g_assert_no_error(error);
+    g_dbus_connection_set_exit_on_close(logind_bus, FALSE);
+
+    node_info = g_dbus_node_info_new_for_xml(
+        "<node>"
+        "  <interface name='org.freedesktop.login1.Session'>"
+        "    <method name='SetBrightness'>"
+        "      <arg type='s' direction='in'/>"
+        "      <arg type='s' direction='in'/>"
+        "      <arg type='u' direction='in'/>"
+        "    </method>"
+        "  </interface>"
+        "</node>",
+        &error);
+    g_assert_no_error(error);
+
+    static const GDBusInterfaceVTable vtable = {
+      on_method_call, nullptr, nullptr, {}
+    };
+    reg_id = g_dbus_connection_register_object(logind_bus,
+                                               "/org/freedesktop/login1/session/auto",
+                                               node_info->interfaces[0],
+                                               &vtable,
+                                               this,
+                                               nullptr,
+                                               &error);
+    g_assert_no_error(error);
+
+    own_id = g_bus_own_name_on_connection(logind_bus, "org.freedesktop.login1",
+                                          G_BUS_NAME_OWNER_FLAGS_NONE,
+                                          nullptr, nullptr, nullptr, nullptr);
+    ASSERT_NAME_OWNED_EVENTUALLY(logind_bus, "org.freedesktop.login1");
+  }
+
+  void TearDown() override
+  {
+    g_clear_object(&backlight);
+
+    g_bus_unown_name(own_id);
+    g_dbus_connection_unregister_object(logind_bus, reg_id);
+    g_clear_pointer(&node_info, g_dbus_node_info_unref);
+    g_dbus_connection_close_sync(logind_bus, nullptr, nullptr);
+    g_clear_object(&logind_bus);
+
+    wait_msec(100);
+
+    g_test_dbus_down(test_dbus);
+    g_clear_object(&test_dbus);
+    g_unsetenv("DBUS_SYSTEM_BUS_ADDRESS");
+
+    super::TearDown();
+  }
+
+  static void
+  on_method_call(GDBusConnection       * /*connection*/,
+                 const gchar           * /*sender*/,
+                 const gchar           * /*object_path*/,
+                 const gchar           * /*interface_name*/,
+                 const gchar           * /*method_name*/,
+                 GVariant              * parameters,
+                 GDBusMethodInvocation * invocation,
+                 gpointer                gself)
+  {
+    auto self = static_cast<BacklightLogindFixture*>(gself);
+    const gchar * subsystem {};
+    const gchar * name {};
+
+    g_variant_get(parameters, "(&s&su)", &subsystem, &name, &self->last_brightness);
+    self->last_subsystem = subsystem;
+    self->last_name = name;
+    ++self->set_brightness_calls;
+
+    g_dbus_method_invocation_return_value(invocation, nullptr);
+  }
+};
+
+TEST_F(BacklightLogindFixture, UsesLogindWithoutWritePermission)
+{
+  const auto dir = add_device("intel_backlight", "raw", 4882, 2000);
+  const auto brightness_file = dir + "/brightness";
+  g_chmod(brightness_file.c_str(), 0444);
+
+  // root can open read-only files for writing, but not read-only sysfs attributes
+  if (geteuid() == 0)
+    {
+      static const char * const read_only_attributes[] = {
+        "/sys/kernel/fscaps",
+        "/sys/kernel/kexec_loaded",
+        "/sys/kernel/address_bits"
+      };
+      for (const auto attribute : read_only_attributes)
+        {
+          if (!g_file_test(attribute, G_FILE_TEST_EXISTS))
+            continue;
+          g_remove(brightness_file.c_str());
+          if (symlink(attribute, brightness_file.c_str()) == 0)
+            break;
+        }
+    }
+
+  const auto fd = open(brightness_file.c_str(), O_WRONLY|O_CLOEXEC);
+  if (fd != -1)
+    {
+      close(fd);
+      g_print("Can't make an unwritable brightness file here; skipping\n");
+      return;
+    }
+  const auto brightness_before = read_attribute(dir, "brightness");
+
+  create_backlight();
+  ASSERT_TRUE(indicator_power_backlight_is_available(backlight));
+
+  SetResult result;
+  set_brightness(1234, result);
+  EXPECT_TRUE(result.success);
+  EXPECT_EQ(1, set_brightness_calls);
+  EXPECT_EQ("backlight", last_subsystem);
+  EXPECT_EQ("intel_backlight", last_name);
+  EXPECT_EQ(1234u, last_brightness);
+  EXPECT_EQ(1234, indicator_power_backlight_get_brightness(backlight));
+
+  // the sysfs file wasn't touched
+  EXPECT_EQ(brightness_before, read_attribute(dir, "brightness"));
+}
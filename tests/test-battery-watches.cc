@@ -0,0 +1,115 @@
+/*
+ * Copyright 2026 The Ayatana Indicators project
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "battery-watches.h"
+
+#include <gtest/gtest.h>
+
+#include <glib.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+/***
+****
+***/
+
+namespace
+{
+  using Fired = std::vector<std::pair<std::string,guint32>>;
+
+  void on_fired (const gchar * owner, guint32 id, gdouble /*value*/, gpointer gfired)
+  {
+    static_cast<Fired*>(gfired)->emplace_back(owner, id);
+  }
+
+  Fired evaluate (IndicatorPowerWatchList * list, double old_percentage, double new_percentage)
+  {
+    const gdouble old_values[INDICATOR_POWER_WATCH_N_PROPERTIES] = { old_percentage, 0, 0 };
+    const gdouble new_values[INDICATOR_POWER_WATCH_N_PROPERTIES] = { new_percentage, 0, 0 };
+    Fired fired;
+    indicator_power_watch_list_evaluate (list, old_values, new_values, on_fired, &fired);
+    return fired;
+  }
+}
+
+TEST(BatteryWatchesTest, FromString)
+{
+  IndicatorPowerWatchProperty property;
+  EXPECT_TRUE(indicator_power_watch_property_from_string("TimeRemaining", &property));
+  EXPECT_EQ(INDICATOR_POWER_WATCH_TIME_REMAINING, property);
+  EXPECT_FALSE(indicator_power_watch_property_from_string("percentage", &property));
+  EXPECT_FALSE(indicator_power_watch_property_from_string(nullptr, &property));
+
+  IndicatorPowerWatchComparison comparison;
+  EXPECT_TRUE(indicator_power_watch_comparison_from_string("above", &comparison));
+  EXPECT_EQ(INDICATOR_POWER_WATCH_ABOVE, comparison);
+  EXPECT_FALSE(indicator_power_watch_comparison_from_string("less-than", &comparison));
+}
+
+TEST(BatteryWatchesTest, Crossings)
+{
+  auto list = indicator_power_watch_list_new();
+  const auto below_10 = indicator_power_watch_list_add(list, ":1.1", INDICATOR_POWER_WATCH_PERCENTAGE, INDICATOR_POWER_WATCH_BELOW, 10.0);
+  const auto below_20 = indicator_power_watch_list_add(list, ":1.2", INDICATOR_POWER_WATCH_PERCENTAGE, INDICATOR_POWER_WATCH_BELOW, 20.0);
+  const auto above_80 = indicator_power_watch_list_add(list, ":1.1", INDICATOR_POWER_WATCH_PERCENTAGE, INDICATOR_POWER_WATCH_ABOVE, 80.0);
+  const auto equals_50 = indicator_power_watch_list_add(list, ":1.2", INDICATOR_POWER_WATCH_PERCENTAGE, INDICATOR_POWER_WATCH_EQUALS, 50.0);
+  EXPECT_NE(0u, below_10);
+  EXPECT_NE(below_10, below_20);
+
+  // no crossings
+  EXPECT_TRUE(evaluate(list, 30.0, 21.0).empty());
+  EXPECT_TRUE(evaluate(list, 21.0, 21.0).empty());
+  EXPECT_TRUE(evaluate(list, 19.0, 30.0).empty());
+
+  // one crossing
+  EXPECT_EQ((Fired{{":1.2", below_20}}), evaluate(list, 20.0, 19.9));
+
+  // a big drop crosses several thresholds, in order
+  EXPECT_EQ((Fired{{":1.1", below_10}, {":1.2", below_20}}), evaluate(list, 25.0, 5.0));
+
+  // above and equals
+  EXPECT_EQ((Fired{{":1.1", above_80}}), evaluate(list, 79.0, 81.0));
+  EXPECT_EQ((Fired{{":1.2", equals_50}}), evaluate(list, 49.0, 50.0));
+  EXPECT_TRUE(evaluate(list, 50.0, 51.0).empty());
+
+  indicator_power_watch_list_free(list);
+}
+
+TEST(BatteryWatchesTest, Owners)
+{
+  auto list = indicator_power_watch_list_new();
+  const auto a = indicator_power_watch_list_add(list, ":1.1", INDICATOR_POWER_WATCH_PERCENTAGE, INDICATOR_POWER_WATCH_BELOW, 10.0);
+  indicator_power_watch_list_add(list, ":1.1", INDICATOR_POWER_WATCH_PERCENTAGE, INDICATOR_POWER_WATCH_BELOW, 10.0);
+  indicator_power_watch_list_add(list, ":1.1", INDICATOR_POWER_WATCH_STATE, INDICATOR_POWER_WATCH_EQUALS, 1.0);
+  const auto b = indicator_power_watch_list_add(list, ":1.2", INDICATOR_POWER_WATCH_PERCENTAGE, INDICATOR_POWER_WATCH_BELOW, 10.0);
+  EXPECT_EQ(3u, indicator_power_watch_list_count_owner(list, ":1.1"));
+  EXPECT_EQ(1u, indicator_power_watch_list_count_owner(list, ":1.2"));
+
+  // clients can only remove their own watches
+  EXPECT_FALSE(indicator_power_watch_list_remove(list, ":1.2", a));
+  EXPECT_TRUE(indicator_power_watch_list_remove(list, ":1.1", a));
+  EXPECT_FALSE(indicator_power_watch_list_remove(list, ":1.1", a));
+  EXPECT_EQ(2u, indicator_power_watch_list_count_owner(list, ":1.1"));
+
+  // a client leaving the bus takes all its watches with it
+  EXPECT_EQ(2u, indicator_power_watch_list_remove_owner(list, ":1.1"));
+  EXPECT_EQ(0u, indicator_power_watch_list_count_owner(list, ":1.1"));
+  EXPECT_EQ((Fired{{":1.2", b}}), evaluate(list, 11.0, 9.0));
+
+  indicator_power_watch_list_free(list);
+}
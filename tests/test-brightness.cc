@@ -0,0 +1,373 @@
+/*
+ * Copyright 2026 The Ayatana Indicators project
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "glib-fixture.h"
+
+#include "brightness.h"
+
+#include <gtest/gtest.h>
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include <algorithm>
+
+/***
+****
+***/
+
+/**
+ * Runs a private bus that poses as the system bus,
+ * with minimal stand-ins for repowerd and com.canonical.Unity.Screen.
+ */
+class BrightnessFixture: public GlibFixture
+{
+private:
+
+  typedef GlibFixture super;
+
+protected:
+
+  static constexpr char const * POWERD_BUSNAME  {"com.lomiri.Repowerd"};
+  static constexpr char const * POWERD_PATH     {"/com/lomiri/Repowerd"};
+  static constexpr char const * USCREEN_BUSNAME {"com.canonical.Unity.Screen"};
+  static constexpr char const * USCREEN_PATH    {"/com/canonical/Unity/Screen"};
+
+  static constexpr int POWERD_DIM     {5};
+  static constexpr int POWERD_MIN     {10};
+  static constexpr int POWERD_MAX     {255};
+  static constexpr int POWERD_DEFAULT {128};
+
+  GTestDBus * test_dbus {};
+  GDBusConnection * service_bus {};
+  GDBusNodeInfo * node_info {};
+  guint powerd_reg_id {};
+  guint uscreen_reg_id {};
+  guint powerd_own_id {};
+  guint uscreen_own_id {};
+
+  int params_calls {};
+  int set_user_brightness_calls {};
+  int last_user_brightness {-1};
+  int max_calls_in_flight {};
+  int calls_in_flight {};
+  guint reply_delay_msec {4};
+
+  void SetUp() override
+  {
+    super::SetUp();
+
+    // brightness keeps its value in com.lomiri.touch.system
+    g_setenv("GSETTINGS_SCHEMA_DIR", LOMIRI_SCHEMA_DIR, true);
+
+    test_dbus = g_test_dbus_new(G_TEST_DBUS_NONE);
+    g_test_dbus_up(test_dbus);
+    g_setenv("DBUS_SYSTEM_BUS_ADDRESS", g_test_dbus_get_bus_address(test_dbus), true);
+
+    GError * error {};
+    service_bus = g_dbus_connection_new_for_address_sync(
+        g_test_dbus_get_bus_address(test_dbus),
+        GDBusConnectionFlags(G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT |
+                             G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION),
+        nullptr,
+        nullptr,
+        &error);
+    g_assert_no_error(error);
+    g_dbus_connection_set_exit_on_close(service_bus, FALSE);
+
+    node_info = g_dbus_node_info_new_for_xml(
+        "<node>"
+        "  <interface name='com.lomiri.Repowerd'>"
+        "    <property name='brightness' type='i' access='readwrite'/>"
+        "    <method name='getBrightnessParams'>"
+        "      <arg type='(iiiib)' direction='out'/>"
+        "    </method>"
+        "  </interface>"
+        "  <interface name='com.canonical.Unity.Screen'>"
+        "    <method name='setUserBrightness'>"
+        "      <arg type='i' direction='in'/>"
+        "    </method>"
+        "  </interface>"
+        "</node>",
+        &error);
+    g_assert_no_error(error);
+
+    static const GDBusInterfaceVTable vtable = {
+      on_method_call, on_get_property, nullptr, {}
+    };
+    powerd_reg_id = g_dbus_connection_register_object(service_bus,
+                                                      POWERD_PATH,
+                                                      node_info->interfaces[0],
+                                                      &vtable,
+                                                      this,
+                                                      nullptr,
+                                                      &error);
+    g_assert_no_error(error);
+    uscreen_reg_id = g_dbus_connection_register_object(service_bus,
+                                                       USCREEN_PATH,
+                                                       node_info->interfaces[1],
+                                                       &vtable,
+                                                       this,
+                                                       nullptr,
+                                                       &error);
+    g_assert_no_error(error);
+
+    powerd_own_id = g_bus_own_name_on_connection(service_bus, POWERD_BUSNAME,
+                                                 G_BUS_NAME_OWNER_FLAGS_NONE,
+                                                 nullptr, nullptr, nullptr, nullptr);
+    uscreen_own_id = g_bus_own_name_on_connection(service_bus, USCREEN_BUSNAME,
+                                                  G_BUS_NAME_OWNER_FLAGS_NONE,
+                                                  nullptr, nullptr, nullptr, nullptr);
+    ASSERT_NAME_OWNED_EVENTUALLY(service_bus, POWERD_BUSNAME);
+    ASSERT_NAME_OWNED_EVENTUALLY(service_bus, USCREEN_BUSNAME);
+  }
+
+  void TearDown() override
+  {
+    g_bus_unown_name(uscreen_own_id);
+    g_bus_unown_name(powerd_own_id);
+    g_dbus_connection_unregister_object(service_bus, uscreen_reg_id);
+    g_dbus_connection_unregister_object(service_bus, powerd_reg_id);
+    g_clear_pointer(&node_info, g_dbus_node_info_unref);
+    g_dbus_connection_close_sync(service_bus, nullptr, nullptr);
+    g_clear_object(&service_bus);
+
+    wait_msec(100);
+
+    g_test_dbus_down(test_dbus);
+    g_clear_object(&test_dbus);
+    g_unsetenv("DBUS_SYSTEM_BUS_ADDRESS");
+
+    super::TearDown();
+  }
+
+  /***
+  ****  The service stand-ins
+  ***/
+
+  struct DelayedReply
+  {
+    BrightnessFixture * self;
+    GDBusMethodInvocation * invocation;
+  };
+
+  static gboolean
+  on_reply_timeout(gpointer gdata)
+  {
+    auto data = static_cast<DelayedReply*>(gdata);
+    --data->self->calls_in_flight;
+    g_dbus_method_invocation_return_value(data->invocation, nullptr);
+    delete data;
+    return G_SOURCE_REMOVE;
+  }
+
+  static void
+  on_method_call(GDBusConnection       * /*connection*/,
+                 const gchar           * /*sender*/,
+                 const gchar           * /*object_path*/,
+                 const gchar           * /*interface_name*/,
+                 const gchar           * method_name,
+                 GVariant              * parameters,
+                 GDBusMethodInvocation * invocation,
+                 gpointer                gself)
+  {
+    auto self = static_cast<BrightnessFixture*>(gself);
+
+    if (!g_strcmp0(method_name, "getBrightnessParams"))
+      {
+        ++self->params_calls;
+        g_dbus_method_invocation_return_value(invocation,
+            g_variant_new("((iiiib))", POWERD_DIM, POWERD_MIN, POWERD_MAX, POWERD_DEFAULT, FALSE));
+      }
+    else if (!g_strcmp0(method_name, "setUserBrightness"))
+      {
+        ++self->set_user_brightness_calls;
+        g_variant_get(parameters, "(i)", &self->last_user_brightness);
+        self->max_calls_in_flight = std::max(self->max_calls_in_flight, ++self->calls_in_flight);
+
+        // pretend the screen takes a few msec to apply it
+        g_timeout_add(self->reply_delay_msec, on_reply_timeout, new DelayedReply{self, invocation});
+      }
+    else
+      {
+        g_dbus_method_invocation_return_dbus_error(invocation,
+                                                   "org.freedesktop.DBus.Error.UnknownMethod",
+                                                   method_name);
+      }
+  }
+
+  static GVariant*
+  on_get_property(GDBusConnection * /*connection*/,
+                  const gchar     * /*sender*/,
+                  const gchar     * /*object_path*/,
+                  const gchar     * /*interface_name*/,
+                  const gchar     * /*property_name*/,
+                  GError         ** /*error*/,
+                  gpointer          /*gself*/)
+  {
+    return g_variant_new_int32(POWERD_DEFAULT);
+  }
+
+  /***
+  ****
+  ***/
+
+  IndicatorPowerBrightness* create_brightness()
+  {
+    auto brightness = indicator_power_brightness_new();
+
+    // wait for it to fetch repowerd's params
+    EXPECT_TRUE(wait_for([this](){return params_calls > 0;}));
+    wait_msec(100);
+
+    // forget restoring the previous session's brightness
+    set_user_brightness_calls = 0;
+    last_user_brightness = -1;
+    max_calls_in_flight = 0;
+
+    return brightness;
+  }
+
+  static int percentage_to_brightness(double percentage)
+  {
+    return int(POWERD_MIN + percentage*(POWERD_MAX-POWERD_MIN));
+  }
+};
+
+/***
+****
+***/
+
+TEST_F(BrightnessFixture, SingleSetIsSentImmediately)
+{
+  auto brightness = create_brightness();
+
+  indicator_power_brightness_set_percentage(brightness, 0.5);
+  EXPECT_DOUBLE_EQ(0.5, indicator_power_brightness_get_percentage(brightness));
+  EXPECT_TRUE(wait_for([this](){return set_user_brightness_calls == 1;}));
+  EXPECT_EQ(percentage_to_brightness(0.5), last_user_brightness);
+
+  // nothing else is pending, so nothing else gets sent
+  wait_msec(200);
+  EXPECT_EQ(1, set_user_brightness_calls);
+
+  g_object_unref(brightness);
+}
+
+/**
+ * Simulate dragging the slider from 0% to 100% over two seconds,
+ * with a new value every 2 msec. We want the screen to follow along,
+ * but with at most one setUserBrightness in flight and no more than
+ * one per display frame; and the last value must win.
+ */
+TEST_F(BrightnessFixture, DragIsCoalesced)
+{
+  static constexpr int DRAG_MSEC {2000};
+  static constexpr int STEP_MSEC {2};
+  static constexpr int FRAME_MSEC {16};
+
+  auto brightness = create_brightness();
+
+  // count what gets written to the settings backend...
+  auto settings = g_settings_new("com.lomiri.touch.system");
+  int n_applied {};
+  g_signal_connect(settings, "changed::brightness", G_CALLBACK(+[](GSettings*, gchar*, gpointer gcount){
+    ++*static_cast<int*>(gcount);
+  }), &n_applied);
+
+  // ...and how often the percentage changes
+  int n_percentage_notifies {};
+  g_signal_connect(brightness, "notify::percentage", G_CALLBACK(+[](GObject*, GParamSpec*, gpointer gcount){
+    ++*static_cast<int*>(gcount);
+  }), &n_percentage_notifies);
+
+  struct Drag
+  {
+    IndicatorPowerBrightness * brightness;
+    GTimer * timer;
+    int n_steps;
+    GMainLoop * loop;
+  };
+
+  Drag drag {brightness, g_timer_new(), 0, loop};
+  g_timeout_add(STEP_MSEC, [](gpointer gdrag){
+    auto d = static_cast<Drag*>(gdrag);
+    const auto elapsed_msec = g_timer_elapsed(d->timer, nullptr) * 1000.0;
+    const auto percentage = std::min(1.0, elapsed_msec / DRAG_MSEC);
+    indicator_power_brightness_set_percentage(d->brightness, percentage);
+    ++d->n_steps;
+    if (percentage < 1.0)
+      return G_SOURCE_CONTINUE;
+    g_main_loop_quit(d->loop);
+    return G_SOURCE_REMOVE;
+  }, &drag);
+  g_main_loop_run(loop);
+  const auto drag_msec = g_timer_elapsed(drag.timer, nullptr) * 1000.0;
+  g_timer_destroy(drag.timer);
+
+  // our view of the value tracks the slider immediately
+  EXPECT_DOUBLE_EQ(1.0, indicator_power_brightness_get_percentage(brightness));
+
+  // let the pipeline drain
+  EXPECT_TRUE(wait_for([this](){return last_user_brightness == percentage_to_brightness(1.0);}));
+  wait_msec(200);
+
+  g_message("%d slider steps in %.0f msec -> %d setUserBrightness calls",
+            drag.n_steps, drag_msec, set_user_brightness_calls);
+
+  EXPECT_EQ(1, max_calls_in_flight);
+  EXPECT_EQ(percentage_to_brightness(1.0), last_user_brightness);
+  EXPECT_LT(set_user_brightness_calls, drag.n_steps);
+  EXPECT_LE(set_user_brightness_calls, int(drag_msec / FRAME_MSEC) + 2);
+  EXPECT_GT(set_user_brightness_calls, 1);
+
+  // the whole drag is one write, once the slider settles...
+  const auto notifies_after_drag = n_percentage_notifies;
+  EXPECT_TRUE(wait_for([&n_applied](){return n_applied > 0;}, 2000));
+  wait_msec(700);
+  EXPECT_EQ(1, n_applied);
+  EXPECT_EQ(percentage_to_brightness(1.0), g_settings_get_int(settings, "brightness"));
+
+  // ...whose echo doesn't make us re-render
+  EXPECT_EQ(notifies_after_drag, n_percentage_notifies);
+  EXPECT_DOUBLE_EQ(1.0, indicator_power_brightness_get_percentage(brightness));
+
+  g_signal_handlers_disconnect_by_data(brightness, &n_percentage_notifies);
+  g_object_unref(settings);
+  g_object_unref(brightness);
+}
+
+/* Toggling auto-brightness is written right away,
+   but doesn't cut short a brightness change that's settling */
+TEST_F(BrightnessFixture, AutoDoesNotFlushSettlingBrightness)
+{
+  auto brightness = create_brightness();
+  auto settings = g_settings_new("com.lomiri.touch.system");
+  const auto old_value = g_settings_get_int(settings, "brightness");
+
+  indicator_power_brightness_set_percentage(brightness, 0.25);
+  ASSERT_NE(old_value, percentage_to_brightness(0.25));
+  g_object_set(brightness, "auto-brightness", TRUE, nullptr);
+
+  EXPECT_TRUE(wait_for([settings](){return g_settings_get_boolean(settings, "auto-brightness");}, 200));
+  EXPECT_EQ(old_value, g_settings_get_int(settings, "brightness"));
+
+  // ...it's written once the settle timer fires
+  EXPECT_TRUE(wait_for([settings](){return g_settings_get_int(settings, "brightness") == percentage_to_brightness(0.25);}, 2000));
+
+  g_object_unref(settings);
+  g_object_unref(brightness);
+}
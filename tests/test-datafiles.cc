@@ -0,0 +1,164 @@
+/*
+ * Copyright 2026 The Ayatana Indicators project
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "glib-fixture.h"
+
+#include "datafiles.h"
+
+#include <gtest/gtest.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include <string>
+
+/***
+****
+***/
+
+/**
+ * Points the XDG data dirs at a temporary tree.
+ *
+ * GLib caches the data dirs on first use and the datafile index is
+ * process-wide, so everything here has to run in a single test.
+ */
+class DatafilesFixture: public GlibFixture
+{
+private:
+
+  typedef GlibFixture super;
+
+protected:
+
+  gchar * tmp_root {};
+
+  void SetUp() override
+  {
+    GError * error {};
+    tmp_root = g_dir_make_tmp("indicator-power-datafiles-XXXXXX", &error);
+    g_assert_no_error(error);
+
+    g_setenv("XDG_DATA_HOME", path("home").c_str(), true);
+    const auto system_dirs = path("sys1") + G_SEARCHPATH_SEPARATOR_S + path("sys2");
+    g_setenv("XDG_DATA_DIRS", system_dirs.c_str(), true);
+
+    super::SetUp();
+  }
+
+  void TearDown() override
+  {
+    remove_recursive(tmp_root);
+    g_clear_pointer(&tmp_root, g_free);
+
+    super::TearDown();
+  }
+
+  static void remove_recursive(const gchar * path)
+  {
+    auto dir = g_dir_open(path, 0, nullptr);
+    if (dir != nullptr)
+      {
+        const gchar * name;
+        while ((name = g_dir_read_name(dir)))
+          {
+            auto child = g_build_filename(path, name, nullptr);
+            remove_recursive(child);
+            g_free(child);
+          }
+        g_dir_close(dir);
+      }
+    g_remove(path);
+  }
+
+  std::string path(const char * data_dir) const
+  {
+    auto tmp = g_build_filename(tmp_root, data_dir, nullptr);
+    std::string ret {tmp};
+    g_free(tmp);
+    return ret;
+  }
+
+  std::string sound_path(const char * data_dir, const char * basename) const
+  {
+    auto tmp = g_build_filename(tmp_root, data_dir, GETTEXT_PACKAGE, "sounds", basename, nullptr);
+    std::string ret {tmp};
+    g_free(tmp);
+    return ret;
+  }
+
+  void add_sound(const char * data_dir, const char * basename) const
+  {
+    const auto filename = sound_path(data_dir, basename);
+    auto dirname = g_path_get_dirname(filename.c_str());
+    ASSERT_EQ(0, g_mkdir_with_parents(dirname, 0700));
+    g_free(dirname);
+    ASSERT_TRUE(g_file_set_contents(filename.c_str(), "", 0, nullptr));
+  }
+
+  static std::string find_sound(const char * basename)
+  {
+    auto tmp = datafile_find(DATAFILE_TYPE_SOUND, basename);
+    std::string ret {tmp ? tmp : ""};
+    g_free(tmp);
+    return ret;
+  }
+};
+
+/***
+****
+***/
+
+TEST_F(DatafilesFixture, IndexFollowsTheDataDirs)
+{
+  // sys2 doesn't exist
+  add_sound("home", "a.ogg");
+  add_sound("sys1", "a.ogg");
+  add_sound("sys1", "b.ogg");
+
+  // before the index exists, lookups search the dirs directly
+  EXPECT_EQ(sound_path("home", "a.ogg"), find_sound("a.ogg"));
+  EXPECT_EQ(sound_path("sys1", "b.ogg"), find_sound("b.ogg"));
+  EXPECT_EQ("", find_sound("missing.ogg"));
+
+  // once built, the index gives the same answers
+  // and only the dirs that exist are monitored
+  datafile_index_init();
+  EXPECT_TRUE(wait_for([](){return datafile_index_is_ready();}, 5000));
+  EXPECT_EQ(2u, datafile_index_get_n_monitored_dirs());
+  EXPECT_EQ(sound_path("home", "a.ogg"), find_sound("a.ogg"));
+  EXPECT_EQ(sound_path("sys1", "b.ogg"), find_sound("b.ogg"));
+
+  // a miss rescans, which finds dirs created since the last scan
+  add_sound("sys2", "d.ogg");
+  EXPECT_EQ("", find_sound("d.ogg"));
+  EXPECT_TRUE(wait_for([this](){
+    return datafile_index_is_ready() && (find_sound("d.ogg") == sound_path("sys2", "d.ogg"));
+  }, 5000));
+  EXPECT_EQ(3u, datafile_index_get_n_monitored_dirs());
+
+  // misses won't rescan again for a while, so this relies on the monitors
+  add_sound("sys1", "c.ogg");
+  EXPECT_TRUE(wait_for([this](){
+    return datafile_index_is_ready() && (find_sound("c.ogg") == sound_path("sys1", "c.ogg"));
+  }, 5000));
+
+  // removing a file falls back to the next dir
+  EXPECT_EQ(0, g_remove(sound_path("home", "a.ogg").c_str()));
+  EXPECT_TRUE(wait_for([this](){
+    return datafile_index_is_ready() && (find_sound("a.ogg") == sound_path("sys1", "a.ogg"));
+  }, 5000));
+}
@@ -0,0 +1,105 @@
+/*
+ * Copyright 2026 The Ayatana Indicators project
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "glib-fixture.h"
+
+#include "deadline-scheduler.h"
+
+#include <gtest/gtest.h>
+
+#include <glib.h>
+
+#include <vector>
+
+/***
+****
+***/
+
+class DeadlineSchedulerTest: public GlibFixture
+{
+  private:
+
+    typedef GlibFixture super;
+
+  protected:
+
+    IndicatorPowerDeadlineScheduler * scheduler {};
+    std::vector<guint> fired;
+
+    static void on_deadline (guint tags, gpointer gself)
+    {
+      static_cast<DeadlineSchedulerTest*>(gself)->fired.push_back(tags);
+    }
+
+    void SetUp() override
+    {
+      super::SetUp();
+
+      scheduler = indicator_power_deadline_scheduler_new (on_deadline, this);
+    }
+
+    void TearDown() override
+    {
+      indicator_power_deadline_scheduler_free (scheduler);
+
+      super::TearDown();
+    }
+};
+
+namespace
+{
+  constexpr guint A {1<<0};
+  constexpr guint B {1<<1};
+}
+
+TEST_F(DeadlineSchedulerTest, SameSecondIsCoalesced)
+{
+  indicator_power_deadline_scheduler_add (scheduler, 1, A);
+  indicator_power_deadline_scheduler_add (scheduler, 1, B);
+  indicator_power_deadline_scheduler_add (scheduler, 1, A);
+  EXPECT_EQ(1u, indicator_power_deadline_scheduler_get_n_pending (scheduler));
+
+  EXPECT_TRUE(wait_for([this](){return !fired.empty();}, 3000));
+  wait_msec(200);
+  EXPECT_EQ(std::vector<guint>({A|B}), fired);
+  EXPECT_EQ(0u, indicator_power_deadline_scheduler_get_n_pending (scheduler));
+}
+
+TEST_F(DeadlineSchedulerTest, EarliestFiresFirst)
+{
+  indicator_power_deadline_scheduler_add (scheduler, 2, B);
+  indicator_power_deadline_scheduler_add (scheduler, 1, A);
+  EXPECT_EQ(2u, indicator_power_deadline_scheduler_get_n_pending (scheduler));
+
+  EXPECT_TRUE(wait_for([this](){return fired.size() >= 2;}, 4000));
+  EXPECT_EQ(std::vector<guint>({A, B}), fired);
+}
+
+TEST_F(DeadlineSchedulerTest, Cancel)
+{
+  indicator_power_deadline_scheduler_add (scheduler, 1, A|B);
+  indicator_power_deadline_scheduler_cancel (scheduler, A);
+  EXPECT_TRUE(wait_for([this](){return !fired.empty();}, 3000));
+  EXPECT_EQ(std::vector<guint>({B}), fired);
+
+  // cancelling everything leaves nothing to wake up for
+  fired.clear();
+  indicator_power_deadline_scheduler_add (scheduler, 1, A);
+  indicator_power_deadline_scheduler_cancel (scheduler, A|B);
+  EXPECT_EQ(0u, indicator_power_deadline_scheduler_get_n_pending (scheduler));
+  wait_msec(2000);
+  EXPECT_TRUE(fired.empty());
+}
@@ -0,0 +1,645 @@
+/*
+ * Copyright 2026 The Ayatana Indicators project
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "glib-fixture.h"
+
+#include "device.h"
+#include "device-provider.h"
+#include "device-provider-hub.h"
+#include "device-provider-upower.h"
+#include "device-snapshot.h"
+
+#include <gtest/gtest.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+
+#include <sys/stat.h> /* umask() */
+#include <unistd.h> /* sysconf() */
+
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+/***
+****
+***/
+
+/**
+ * Runs a private bus that poses as the system bus, a minimal stand-in
+ * for UPower on that bus, and a scratch directory for the hub's socket.
+ *
+ * Each "session" is an in-process hub provider, just as each session's
+ * service would create one; they only meet through the hub's socket.
+ */
+class HubFixture: public GlibFixture
+{
+private:
+
+  typedef GlibFixture super;
+
+protected:
+
+  static constexpr char const * UPOWER_BUSNAME      {"org.freedesktop.UPower"};
+  static constexpr char const * UPOWER_PATH         {"/org/freedesktop/UPower"};
+  static constexpr char const * UPOWER_DEVICE_IFACE {"org.freedesktop.UPower.Device"};
+  static constexpr char const * PROPERTIES_IFACE    {"org.freedesktop.DBus.Properties"};
+
+  struct MockDevice
+  {
+    gdouble percentage {50.0};
+    guint reg_id {};
+  };
+
+  GTestDBus * test_dbus {};
+  GDBusConnection * upower_bus {};
+  guint upower_own_id {};
+  guint manager_reg_id {};
+  GDBusNodeInfo * node_info {};
+  std::map<std::string,MockDevice> mock_devices;
+  int enumerate_calls {};
+  int get_all_calls {};
+
+  gchar * tmpdir {};
+  gchar * address {};
+
+  void SetUp() override
+  {
+    super::SetUp();
+
+    test_dbus = g_test_dbus_new(G_TEST_DBUS_NONE);
+    g_test_dbus_up(test_dbus);
+    g_setenv("DBUS_SYSTEM_BUS_ADDRESS", g_test_dbus_get_bus_address(test_dbus), true);
+
+    tmpdir = g_dir_make_tmp("indicator-power-hub-XXXXXX", &error);
+    g_assert_no_error(error);
+    gchar * socket_path = g_build_filename(tmpdir, "hub", nullptr);
+    gchar * escaped = g_dbus_address_escape_value(socket_path);
+    address = g_strdup_printf("unix:path=%s", escaped);
+    g_free(escaped);
+    g_free(socket_path);
+
+    upower_bus = g_dbus_connection_new_for_address_sync(
+        g_test_dbus_get_bus_address(test_dbus),
+        GDBusConnectionFlags(G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT |
+                             G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION),
+        nullptr,
+        nullptr,
+        &error);
+    g_assert_no_error(error);
+    g_dbus_connection_set_exit_on_close(upower_bus, FALSE);
+
+    node_info = g_dbus_node_info_new_for_xml(
+        "<node>"
+        "  <interface name='org.freedesktop.UPower'>"
+        "    <method name='EnumerateDevices'>"
+        "      <arg type='ao' direction='out'/>"
+        "    </method>"
+        "    <property name='OnBattery' type='b' access='read'/>"
+        "    <signal name='DeviceAdded'><arg type='o'/></signal>"
+        "    <signal name='DeviceRemoved'><arg type='o'/></signal>"
+        "  </interface>"
+        "  <interface name='org.freedesktop.UPower.Device'>"
+        "    <property name='Type' type='u' access='read'/>"
+        "    <property name='Model' type='s' access='read'/>"
+        "    <property name='State' type='u' access='read'/>"
+        "    <property name='Percentage' type='d' access='read'/>"
+        "    <property name='TimeToEmpty' type='x' access='read'/>"
+        "    <property name='TimeToFull' type='x' access='read'/>"
+        "    <property name='PowerSupply' type='b' access='read'/>"
+        "  </interface>"
+        "</node>",
+        &error);
+    g_assert_no_error(error);
+
+    static const GDBusInterfaceVTable manager_vtable = {
+      on_manager_method_call, on_manager_get_property, nullptr, {}
+    };
+    manager_reg_id = g_dbus_connection_register_object(upower_bus,
+                                                       UPOWER_PATH,
+                                                       node_info->interfaces[0],
+                                                       &manager_vtable,
+                                                       this,
+                                                       nullptr,
+                                                       &error);
+    g_assert_no_error(error);
+  }
+
+  void TearDown() override
+  {
+    if (upower_own_id != 0)
+      g_bus_unown_name(upower_own_id);
+    for (const auto& it : mock_devices)
+      g_dbus_connection_unregister_object(upower_bus, it.second.reg_id);
+    g_dbus_connection_unregister_object(upower_bus, manager_reg_id);
+    g_clear_pointer(&node_info, g_dbus_node_info_unref);
+    g_dbus_connection_close_sync(upower_bus, nullptr, nullptr);
+    g_clear_object(&upower_bus);
+
+    // let the providers' pending calls and signals drain
+    wait_msec(100);
+
+    g_test_dbus_down(test_dbus);
+    g_clear_object(&test_dbus);
+    g_unsetenv("DBUS_SYSTEM_BUS_ADDRESS");
+
+    gchar * lock_path = g_build_filename(tmpdir, "hub.lock", nullptr);
+    g_unlink(lock_path);
+    g_free(lock_path);
+    g_rmdir(tmpdir);
+    g_clear_pointer(&tmpdir, g_free);
+    g_clear_pointer(&address, g_free);
+
+    super::TearDown();
+  }
+
+  /***
+  ****  The UPower stand-in
+  ***/
+
+  static void
+  on_manager_method_call(GDBusConnection       * /*connection*/,
+                         const gchar           * /*sender*/,
+                         const gchar           * /*object_path*/,
+                         const gchar           * /*interface_name*/,
+                         const gchar           * method_name,
+                         GVariant              * /*parameters*/,
+                         GDBusMethodInvocation * invocation,
+                         gpointer                gself)
+  {
+    auto self = static_cast<HubFixture*>(gself);
+
+    if (!g_strcmp0(method_name, "EnumerateDevices"))
+      {
+        ++self->enumerate_calls;
+
+        GVariantBuilder b;
+        g_variant_builder_init(&b, G_VARIANT_TYPE("ao"));
+        for (const auto& it : self->mock_devices)
+          g_variant_builder_add(&b, "o", it.first.c_str());
+        g_dbus_method_invocation_return_value(invocation, g_variant_new("(ao)", &b));
+      }
+    else
+      {
+        g_dbus_method_invocation_return_dbus_error(invocation,
+                                                   "org.freedesktop.DBus.Error.UnknownMethod",
+                                                   method_name);
+      }
+  }
+
+  static GVariant*
+  on_manager_get_property(GDBusConnection * /*connection*/,
+                          const gchar     * /*sender*/,
+                          const gchar     * /*object_path*/,
+                          const gchar     * /*interface_name*/,
+                          const gchar     * /*property_name*/,
+                          GError         ** /*error*/,
+                          gpointer          /*gself*/)
+  {
+    return g_variant_new_boolean(TRUE);
+  }
+
+  static GVariant*
+  on_device_get_property(GDBusConnection * /*connection*/,
+                         const gchar     * /*sender*/,
+                         const gchar     * object_path,
+                         const gchar     * /*interface_name*/,
+                         const gchar     * property_name,
+                         GError         ** error,
+                         gpointer          gself)
+  {
+    auto self = static_cast<HubFixture*>(gself);
+    const auto it = self->mock_devices.find(object_path);
+    GVariant * ret {};
+
+    if (it == self->mock_devices.end())
+      {
+        g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_UNKNOWN_OBJECT, "%s", object_path);
+        return nullptr;
+      }
+
+    const std::string name {property_name};
+    if (name == "Type")
+      {
+        ++self->get_all_calls; // GetAll() asks for each property once
+        ret = g_variant_new_uint32(UP_DEVICE_KIND_BATTERY);
+      }
+    else if (name == "Model")
+      ret = g_variant_new_string("");
+    else if (name == "State")
+      ret = g_variant_new_uint32(UP_DEVICE_STATE_DISCHARGING);
+    else if (name == "Percentage")
+      ret = g_variant_new_double(it->second.percentage);
+    else if (name == "TimeToEmpty")
+      ret = g_variant_new_int64(3600);
+    else if (name == "TimeToFull")
+      ret = g_variant_new_int64(0);
+    else if (name == "PowerSupply")
+      ret = g_variant_new_boolean(TRUE);
+    else
+      g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_UNKNOWN_PROPERTY, "%s", property_name);
+
+    return ret;
+  }
+
+  static std::string
+  device_path(int i)
+  {
+    gchar * tmp = g_strdup_printf("/org/freedesktop/UPower/devices/battery_BAT%d", i);
+    std::string ret {tmp};
+    g_free(tmp);
+    return ret;
+  }
+
+  void start_upower(int n_devices)
+  {
+    static const GDBusInterfaceVTable device_vtable = {
+      nullptr, on_device_get_property, nullptr, {}
+    };
+
+    for (int i=0; i<n_devices; ++i)
+      {
+        auto& mock = mock_devices[device_path(i)];
+        mock.reg_id = g_dbus_connection_register_object(upower_bus,
+                                                        device_path(i).c_str(),
+                                                        node_info->interfaces[1],
+                                                        &device_vtable,
+                                                        this,
+                                                        nullptr,
+                                                        &error);
+        g_assert_no_error(error);
+      }
+
+    upower_own_id = g_bus_own_name_on_connection(upower_bus,
+                                                 UPOWER_BUSNAME,
+                                                 G_BUS_NAME_OWNER_FLAGS_NONE,
+                                                 nullptr,
+                                                 nullptr,
+                                                 nullptr,
+                                                 nullptr);
+  }
+
+  void set_percentage(const std::string& path, gdouble percentage)
+  {
+    mock_devices[path].percentage = percentage;
+
+    GVariantBuilder b;
+    g_variant_builder_init(&b, G_VARIANT_TYPE_VARDICT);
+    g_variant_builder_add(&b, "{sv}", "Percentage", g_variant_new_double(percentage));
+    g_dbus_connection_emit_signal(upower_bus, nullptr, path.c_str(), PROPERTIES_IFACE,
+                                  "PropertiesChanged",
+                                  g_variant_new("(sa{sv}@as)", UPOWER_DEVICE_IFACE, &b,
+                                                g_variant_new_strv(nullptr, 0)),
+                                  nullptr);
+    g_dbus_connection_flush_sync(upower_bus, nullptr, nullptr);
+  }
+
+  /***
+  ****  Sessions
+  ***/
+
+  IndicatorPowerDeviceProvider* new_session(IndicatorPowerDeviceHubAccess access=INDICATOR_POWER_DEVICE_HUB_GROUP,
+                                            const char * where=nullptr)
+  {
+    return indicator_power_device_provider_hub_new(where ? where : address,
+                                                   access,
+                                                   indicator_power_device_provider_upower_new);
+  }
+
+  static guint file_mode(const char * filename)
+  {
+    GStatBuf st;
+    return g_stat(filename, &st) == 0 ? guint(st.st_mode & 0777) : 0u;
+  }
+
+  static bool is_serving(IndicatorPowerDeviceProvider * provider)
+  {
+    return indicator_power_device_provider_hub_is_serving(INDICATOR_POWER_DEVICE_PROVIDER_HUB(provider));
+  }
+
+  static bool has_devices(IndicatorPowerDeviceProvider * provider, guint n_devices, gdouble percentage=50.0)
+  {
+    auto snapshot = indicator_power_device_provider_get_snapshot(provider);
+    bool ok = snapshot->n_records == n_devices;
+    for (guint i=0; ok && i<snapshot->n_records; ++i)
+      ok = (snapshot->records[i].kind == UP_DEVICE_KIND_BATTERY) &&
+           (!g_strcmp0(snapshot->records[i].object_path, device_path(0).c_str())
+              ? snapshot->records[i].percentage == percentage
+              : snapshot->records[i].percentage == 50.0);
+    indicator_power_device_snapshot_unref(snapshot);
+    return ok;
+  }
+
+  static bool all_have_devices(const std::vector<IndicatorPowerDeviceProvider*>& sessions,
+                               guint n_devices,
+                               gdouble percentage=50.0)
+  {
+    for (const auto& session : sessions)
+      if (!has_devices(session, n_devices, percentage))
+        return false;
+    return true;
+  }
+
+  static gboolean
+  wake_up(gpointer /*unused*/)
+  {
+    return G_SOURCE_CONTINUE;
+  }
+
+  /* Like wait_for(), but checks after every main loop iteration
+     so that the benchmarks' timings aren't rounded up to its polling */
+  bool wait_until(std::function<bool()> test_function, guint timeout_msec)
+  {
+    const auto deadline = g_get_monotonic_time() + gint64(timeout_msec) * 1000;
+    const auto tag = g_timeout_add(10, wake_up, nullptr);
+    auto ok = test_function();
+
+    while (!ok && (g_get_monotonic_time() < deadline))
+      {
+        g_main_context_iteration(nullptr, TRUE);
+        ok = test_function();
+      }
+
+    g_source_remove(tag);
+    return ok;
+  }
+
+  static void
+  clear_sessions(std::vector<IndicatorPowerDeviceProvider*>& sessions)
+  {
+    // the clients first, so that none of them tries to take over
+    for (auto it=sessions.rbegin(); it!=sessions.rend(); ++it)
+      g_object_unref(*it);
+    sessions.clear();
+  }
+
+  static long get_rss_kib()
+  {
+    long pages_total {}, pages_resident {};
+    auto fp = fopen("/proc/self/statm", "r");
+    if (fp != nullptr)
+      {
+        if (fscanf(fp, "%ld %ld", &pages_total, &pages_resident) != 2)
+          pages_resident = 0;
+        fclose(fp);
+      }
+    return pages_resident * (sysconf(_SC_PAGESIZE) / 1024);
+  }
+};
+
+/***
+****
+***/
+
+TEST_F(HubFixture, GetAddress)
+{
+  IndicatorPowerDeviceHubAccess access;
+
+  EXPECT_EQ(nullptr, indicator_power_device_provider_hub_get_address(nullptr, &access));
+  EXPECT_EQ(nullptr, indicator_power_device_provider_hub_get_address("", &access));
+
+  auto tmp = indicator_power_device_provider_hub_get_address("unix:path=/run/hub", &access);
+  EXPECT_STREQ("unix:path=/run/hub", tmp);
+  EXPECT_EQ(INDICATOR_POWER_DEVICE_HUB_GROUP, access);
+  g_free(tmp);
+
+  // only this user's sessions
+  tmp = indicator_power_device_provider_hub_get_address(INDICATOR_POWER_DEVICE_HUB_SESSION, &access);
+  EXPECT_EQ(INDICATOR_POWER_DEVICE_HUB_SAME_USER, access);
+  EXPECT_TRUE(g_str_has_prefix(tmp, "unix:path="));
+  EXPECT_TRUE(g_str_has_suffix(tmp, "ayatana-indicator-power.hub"));
+  g_free(tmp);
+}
+
+TEST_F(HubFixture, SnapshotRoundTrip)
+{
+  const auto path = device_path(0);
+  auto snapshot = indicator_power_device_snapshot_new(2);
+  indicator_power_device_record_set(&snapshot->records[0], path.c_str(), UP_DEVICE_KIND_BATTERY,
+                                    "Fancy Battery", 42.5, UP_DEVICE_STATE_CHARGING, 600, TRUE);
+  indicator_power_device_record_set(&snapshot->records[1], nullptr, UP_DEVICE_KIND_MOUSE,
+                                    nullptr, 80.0, UP_DEVICE_STATE_DISCHARGING, 0, FALSE);
+  snapshot->on_battery = TRUE;
+
+  auto variant = g_variant_ref_sink(indicator_power_device_snapshot_serialize(snapshot));
+  EXPECT_STREQ(INDICATOR_POWER_DEVICE_SNAPSHOT_VARIANT_TYPE, g_variant_get_type_string(variant));
+  auto copy = indicator_power_device_snapshot_deserialize(variant);
+  ASSERT_NE(nullptr, copy);
+  EXPECT_TRUE(copy->on_battery);
+  ASSERT_EQ(2u, copy->n_records);
+  EXPECT_EQ(UP_DEVICE_KIND_BATTERY, copy->records[0].kind);
+  EXPECT_EQ(UP_DEVICE_STATE_CHARGING, copy->records[0].state);
+  EXPECT_EQ(g_intern_string(path.c_str()), copy->records[0].object_path);
+  EXPECT_STREQ("Fancy Battery", copy->records[0].model);
+  EXPECT_EQ(42.5, copy->records[0].percentage);
+  EXPECT_EQ(600, copy->records[0].time);
+  EXPECT_TRUE(copy->records[0].power_supply);
+  EXPECT_EQ(UP_DEVICE_KIND_MOUSE, copy->records[1].kind);
+  EXPECT_EQ(80.0, copy->records[1].percentage);
+  EXPECT_EQ(nullptr, copy->records[1].object_path);
+  EXPECT_EQ(nullptr, copy->records[1].model);
+
+  // wrong type
+  auto bad = g_variant_ref_sink(g_variant_new_string("nope"));
+  EXPECT_EQ(nullptr, indicator_power_device_snapshot_deserialize(bad));
+
+  g_variant_unref(bad);
+  indicator_power_device_snapshot_unref(copy);
+  g_variant_unref(variant);
+  indicator_power_device_snapshot_unref(snapshot);
+}
+
+TEST_F(HubFixture, FirstSessionServesTheRest)
+{
+  constexpr guint n_devices {3};
+  start_upower(n_devices);
+
+  std::vector<IndicatorPowerDeviceProvider*> sessions;
+  sessions.push_back(new_session());
+  sessions.push_back(new_session());
+  EXPECT_TRUE(is_serving(sessions[0]));
+  EXPECT_FALSE(is_serving(sessions[1]));
+
+  EXPECT_TRUE(wait_for([&sessions](){return all_have_devices(sessions, n_devices);}, 2000));
+  EXPECT_EQ(1u, indicator_power_device_provider_hub_get_n_clients(INDICATOR_POWER_DEVICE_PROVIDER_HUB(sessions[0])));
+
+  // only the hub talks to UPower
+  EXPECT_EQ(1, enumerate_calls);
+  EXPECT_EQ(int(n_devices), get_all_calls);
+
+  // changes reach the client too
+  set_percentage(device_path(0), 25.0);
+  EXPECT_TRUE(wait_for([&sessions](){return all_have_devices(sessions, n_devices, 25.0);}, 2000));
+
+  clear_sessions(sessions);
+}
+
+TEST_F(HubFixture, ClientTakesOverWhenHubExits)
+{
+  constexpr guint n_devices {2};
+  start_upower(n_devices);
+
+  auto hub = new_session();
+  auto client = new_session();
+  ASSERT_TRUE(wait_for([client](){return has_devices(client, n_devices);}, 2000));
+
+  g_object_unref(hub);
+
+  // the client takes over, and never stops showing the devices
+  EXPECT_TRUE(wait_for([client](){
+    EXPECT_TRUE(has_devices(client, n_devices));
+    return is_serving(client);
+  }, 2000));
+  EXPECT_EQ(2, enumerate_calls);
+
+  // ...and serves the next session
+  auto late = new_session();
+  EXPECT_FALSE(is_serving(late));
+  EXPECT_TRUE(wait_for([late](){return has_devices(late, n_devices);}, 2000));
+
+  set_percentage(device_path(0), 75.0);
+  EXPECT_TRUE(wait_for([client,late](){
+    return has_devices(client, n_devices, 75.0) && has_devices(late, n_devices, 75.0);
+  }, 2000));
+
+  g_object_unref(late);
+  g_object_unref(client);
+}
+
+/* Other users can only connect, or take over, if the files aren't
+   left to the first user's umask */
+TEST_F(HubFixture, SocketPermissions)
+{
+  start_upower(1);
+  gchar * socket_path = g_build_filename(tmpdir, "hub", nullptr);
+  gchar * lock_path = g_build_filename(tmpdir, "hub.lock", nullptr);
+  const auto old_umask = umask(077);
+
+  auto hub = new_session(INDICATOR_POWER_DEVICE_HUB_GROUP);
+  ASSERT_TRUE(is_serving(hub));
+  EXPECT_EQ(0660u, file_mode(socket_path));
+  EXPECT_EQ(0660u, file_mode(lock_path));
+  g_object_unref(hub);
+  g_unlink(lock_path);
+
+  hub = new_session(INDICATOR_POWER_DEVICE_HUB_SAME_USER);
+  ASSERT_TRUE(is_serving(hub));
+  EXPECT_EQ(0600u, file_mode(socket_path));
+  EXPECT_EQ(0600u, file_mode(lock_path));
+
+  // this user is always welcome
+  auto client = new_session(INDICATOR_POWER_DEVICE_HUB_SAME_USER);
+  EXPECT_TRUE(wait_for([client](){return has_devices(client, 1);}, 2000));
+  EXPECT_EQ(1u, indicator_power_device_provider_hub_get_n_clients(INDICATOR_POWER_DEVICE_PROVIDER_HUB(hub)));
+
+  g_object_unref(client);
+  g_object_unref(hub);
+  umask(old_umask);
+  g_free(lock_path);
+  g_free(socket_path);
+}
+
+/* If the lock can't even be created, e.g. because the directory
+   is missing, don't wait forever for a hub that isn't there */
+TEST_F(HubFixture, RunsStandaloneIfNoLock)
+{
+  constexpr guint n_devices {2};
+  start_upower(n_devices);
+
+  gchar * where = g_strdup_printf("unix:path=%s/missing/hub", tmpdir);
+  expectLogMessage(G_LOG_DOMAIN, G_LOG_LEVEL_WARNING, "*Unable to open*");
+  auto session = new_session(INDICATOR_POWER_DEVICE_HUB_GROUP, where);
+
+  EXPECT_FALSE(is_serving(session));
+  EXPECT_TRUE(wait_for([session](){return has_devices(session, n_devices);}, 2000));
+  EXPECT_EQ(1, enumerate_calls);
+
+  g_object_unref(session);
+  g_free(where);
+}
+
+/***
+****  Benchmark
+***/
+
+/* 50 sessions on one machine, e.g. a terminal server or a greeter plus
+   many logins. Standalone, each one enumerates UPower and fetches every
+   device itself; through the hub, UPower sees one subscriber. */
+TEST_F(HubFixture, FiftySessions)
+{
+  constexpr int n_sessions {50};
+  constexpr guint n_devices {4};
+  start_upower(n_devices);
+  std::vector<IndicatorPowerDeviceProvider*> sessions;
+
+  // standalone
+  auto rss_before = get_rss_kib();
+  auto begin = g_get_monotonic_time();
+  for (int i=0; i<n_sessions; ++i)
+    sessions.push_back(indicator_power_device_provider_upower_new());
+  ASSERT_TRUE(wait_until([&sessions](){return all_have_devices(sessions, n_devices);}, 10000));
+  const auto standalone_ready = g_get_monotonic_time() - begin;
+  const auto standalone_rss = get_rss_kib() - rss_before;
+  const auto standalone_enumerates = enumerate_calls;
+  const auto standalone_get_alls = get_all_calls;
+
+  begin = g_get_monotonic_time();
+  set_percentage(device_path(0), 40.0);
+  ASSERT_TRUE(wait_until([&sessions](){return all_have_devices(sessions, n_devices, 40.0);}, 10000));
+  const auto standalone_fanout = g_get_monotonic_time() - begin;
+
+  clear_sessions(sessions);
+  wait_msec(100);
+  mock_devices[device_path(0)].percentage = 50.0;
+  enumerate_calls = get_all_calls = 0;
+
+  // shared: one hub and 50 clients
+  rss_before = get_rss_kib();
+  begin = g_get_monotonic_time();
+  sessions.push_back(new_session());
+  for (int i=0; i<n_sessions; ++i)
+    sessions.push_back(new_session());
+  ASSERT_TRUE(wait_until([&sessions](){return all_have_devices(sessions, n_devices);}, 10000));
+  const auto shared_ready = g_get_monotonic_time() - begin;
+  const auto shared_rss = get_rss_kib() - rss_before;
+  EXPECT_EQ(guint(n_sessions), indicator_power_device_provider_hub_get_n_clients(INDICATOR_POWER_DEVICE_PROVIDER_HUB(sessions[0])));
+
+  begin = g_get_monotonic_time();
+  set_percentage(device_path(0), 40.0);
+  ASSERT_TRUE(wait_until([&sessions](){return all_have_devices(sessions, n_devices, 40.0);}, 10000));
+  const auto shared_fanout = g_get_monotonic_time() - begin;
+
+  EXPECT_EQ(n_sessions, standalone_enumerates);
+  EXPECT_EQ(int(n_sessions * n_devices), standalone_get_alls);
+  EXPECT_EQ(1, enumerate_calls);
+  EXPECT_EQ(int(n_devices), get_all_calls);
+
+  g_print("%d standalone sessions: %d EnumerateDevices, %d GetAll, ready in %.1f ms, change seen by all in %.1f ms, RSS grew %ld KiB\n",
+          n_sessions, standalone_enumerates, standalone_get_alls,
+          standalone_ready/1000.0, standalone_fanout/1000.0, standalone_rss);
+  g_print("hub + %d clients: %d EnumerateDevices, %d GetAll, ready in %.1f ms, change seen by all in %.1f ms, RSS grew %ld KiB\n",
+          n_sessions, enumerate_calls, get_all_calls,
+          shared_ready/1000.0, shared_fanout/1000.0, shared_rss);
+  RecordProperty("standalone_get_all_calls", standalone_get_alls);
+  RecordProperty("hub_get_all_calls", get_all_calls);
+  RecordProperty("hub_ready_usec", int(shared_ready));
+  RecordProperty("hub_fanout_usec", int(shared_fanout));
+
+  clear_sessions(sessions);
+}
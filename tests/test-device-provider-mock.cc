@@ -0,0 +1,212 @@
+/*
+ * Copyright 2026 The Ayatana Indicators project
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "glib-fixture.h"
+
+#include "device.h"
+#include "device-provider.h"
+#include "device-provider-mock.h"
+
+#include <gtest/gtest.h>
+
+#include <glib.h>
+
+/***
+****
+***/
+
+class MockProviderFixture: public GlibFixture
+{
+private:
+
+  typedef GlibFixture super;
+
+protected:
+
+  IndicatorPowerDeviceProvider * provider {};
+  IndicatorPowerDeviceProviderMock * mock {};
+  int devices_changed_count {};
+
+  void SetUp() override
+  {
+    super::SetUp();
+
+    provider = indicator_power_device_provider_mock_new();
+    mock = INDICATOR_POWER_DEVICE_PROVIDER_MOCK(provider);
+    g_signal_connect_swapped(provider, "devices-changed", G_CALLBACK(on_devices_changed), this);
+  }
+
+  void TearDown() override
+  {
+    g_signal_handlers_disconnect_by_data(provider, this);
+    g_clear_object(&provider);
+
+    super::TearDown();
+  }
+
+  static void
+  on_devices_changed(gpointer gself)
+  {
+    ++static_cast<MockProviderFixture*>(gself)->devices_changed_count;
+  }
+
+  IndicatorPowerDevice* add_battery(const char * path)
+  {
+    auto device = indicator_power_device_new(path,
+                                             UP_DEVICE_KIND_BATTERY,
+                                             "Some Model",
+                                             50.0,
+                                             UP_DEVICE_STATE_DISCHARGING,
+                                             60*30,
+                                             TRUE);
+    indicator_power_device_provider_add_device(mock, device);
+    g_object_unref(device);
+    return device;
+  }
+
+  guint n_devices()
+  {
+    auto snapshot = indicator_power_device_provider_get_snapshot(provider);
+    const auto n = snapshot->n_records;
+    indicator_power_device_snapshot_unref(snapshot);
+    return n;
+  }
+};
+
+/***
+****
+***/
+
+TEST_F(MockProviderFixture, AddAndRemove)
+{
+  auto a = add_battery("/a");
+  auto b = add_battery("/b");
+  EXPECT_EQ(2, devices_changed_count);
+  EXPECT_EQ(2u, n_devices());
+  EXPECT_EQ(a, indicator_power_device_provider_mock_get_device(mock, "/a"));
+  EXPECT_EQ(b, indicator_power_device_provider_mock_get_device(mock, "/b"));
+  EXPECT_EQ(nullptr, indicator_power_device_provider_mock_get_device(mock, "/c"));
+
+  indicator_power_device_provider_remove_device(mock, a);
+  EXPECT_EQ(3, devices_changed_count);
+  EXPECT_EQ(1u, n_devices());
+  EXPECT_EQ(nullptr, indicator_power_device_provider_mock_get_device(mock, "/a"));
+
+  // a device's changes are announced
+  g_object_set(b, INDICATOR_POWER_DEVICE_PERCENTAGE, 20.0, nullptr);
+  EXPECT_EQ(4, devices_changed_count);
+}
+
+TEST_F(MockProviderFixture, BatchesAreAtomic)
+{
+  constexpr int n {500};
+
+  indicator_power_device_provider_mock_freeze(mock);
+  for (int i=0; i<n; ++i)
+    {
+      gchar * path = g_strdup_printf("/battery%d", i);
+      auto device = add_battery(path);
+      g_object_set(device, INDICATOR_POWER_DEVICE_PERCENTAGE, 10.0, nullptr);
+      g_free(path);
+    }
+
+  // nested
+  indicator_power_device_provider_mock_freeze(mock);
+  indicator_power_device_provider_mock_thaw(mock);
+  EXPECT_EQ(0, devices_changed_count);
+
+  indicator_power_device_provider_mock_thaw(mock);
+  EXPECT_EQ(1, devices_changed_count);
+  EXPECT_EQ(guint(n), n_devices());
+
+  // nothing changed, so nothing to announce
+  indicator_power_device_provider_mock_freeze(mock);
+  indicator_power_device_provider_mock_thaw(mock);
+  EXPECT_EQ(1, devices_changed_count);
+}
+
+/* An hour's discharge from 100% to 0%, played in half a second */
+TEST_F(MockProviderFixture, PlaysProfileAtSpeed)
+{
+  constexpr int n {3};
+  for (int i=0; i<n; ++i)
+    {
+      gchar * path = g_strdup_printf("/battery%d", i);
+      add_battery(path);
+      g_free(path);
+    }
+  devices_changed_count = 0;
+
+  const IndicatorPowerMockKeyframe keyframes[] = {
+    { 0,    100.0, UP_DEVICE_STATE_DISCHARGING, 3600 },
+    { 3600,   0.0, UP_DEVICE_STATE_EMPTY,          0 }
+  };
+  indicator_power_device_provider_mock_play_profile(mock, nullptr, keyframes, G_N_ELEMENTS(keyframes), 7200.0);
+  EXPECT_TRUE(indicator_power_device_provider_mock_is_playing(mock));
+
+  // the first keyframe is applied right away, as one change
+  EXPECT_EQ(1, devices_changed_count);
+  auto device = indicator_power_device_provider_mock_get_device(mock, "/battery0");
+  EXPECT_EQ(100.0, indicator_power_device_get_percentage(device));
+  EXPECT_EQ(UP_DEVICE_STATE_DISCHARGING, indicator_power_device_get_state(device));
+
+  // partway through, the percentage is between the keyframes
+  wait_msec(250);
+  const auto percentage = indicator_power_device_get_percentage(device);
+  EXPECT_LT(0.0, percentage);
+  EXPECT_GT(100.0, percentage);
+  EXPECT_EQ(UP_DEVICE_STATE_DISCHARGING, indicator_power_device_get_state(device));
+
+  // it ends on the last keyframe, and every tick was one change
+  EXPECT_TRUE(wait_for([this](){return !indicator_power_device_provider_mock_is_playing(mock);}, 2000));
+  for (int i=0; i<n; ++i)
+    {
+      gchar * path = g_strdup_printf("/battery%d", i);
+      device = indicator_power_device_provider_mock_get_device(mock, path);
+      EXPECT_EQ(0.0, indicator_power_device_get_percentage(device));
+      EXPECT_EQ(UP_DEVICE_STATE_EMPTY, indicator_power_device_get_state(device));
+      EXPECT_EQ(0, indicator_power_device_get_time(device));
+      g_free(path);
+    }
+  EXPECT_GE(15, devices_changed_count);
+}
+
+TEST_F(MockProviderFixture, StopAndRemoveDuringProfile)
+{
+  auto a = add_battery("/a");
+  auto b = add_battery("/b");
+
+  const IndicatorPowerMockKeyframe keyframes[] = {
+    { 0,  20.0, UP_DEVICE_STATE_CHARGING, 3600 },
+    { 60, 80.0, UP_DEVICE_STATE_CHARGING,    0 }
+  };
+  GList * devices = g_list_append(nullptr, a);
+  indicator_power_device_provider_mock_play_profile(mock, devices, keyframes, G_N_ELEMENTS(keyframes), 1.0);
+  g_list_free(devices);
+
+  // only the listed devices play it
+  EXPECT_EQ(20.0, indicator_power_device_get_percentage(a));
+  EXPECT_EQ(50.0, indicator_power_device_get_percentage(b));
+
+  // removing a playing device is safe
+  indicator_power_device_provider_remove_device(mock, a);
+  wait_msec(150);
+  EXPECT_TRUE(indicator_power_device_provider_mock_is_playing(mock));
+
+  indicator_power_device_provider_mock_stop_profile(mock);
+  EXPECT_FALSE(indicator_power_device_provider_mock_is_playing(mock));
+}
@@ -0,0 +1,826 @@
+/*
+ * Copyright 2026 The Ayatana Indicators project
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "glib-fixture.h"
+
+#include "device.h"
+#include "device-provider.h"
+#include "device-provider-upower.h"
+#include "device-snapshot.h"
+
+#include <gtest/gtest.h>
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include <atomic>
+#include <map>
+#include <string>
+
+/***
+****
+***/
+
+/**
+ * Runs a private bus that poses as the system bus,
+ * and a minimal stand-in for UPower on that bus.
+ */
+class UPowerFixture: public GlibFixture
+{
+private:
+
+  typedef GlibFixture super;
+
+protected:
+
+  static constexpr char const * UPOWER_BUSNAME      {"org.freedesktop.UPower"};
+  static constexpr char const * UPOWER_PATH         {"/org/freedesktop/UPower"};
+  static constexpr char const * UPOWER_IFACE        {"org.freedesktop.UPower"};
+  static constexpr char const * UPOWER_DEVICE_IFACE {"org.freedesktop.UPower.Device"};
+  static constexpr char const * PROPERTIES_IFACE    {"org.freedesktop.DBus.Properties"};
+  static constexpr char const * DISPLAY_DEVICE_PATH {"/org/freedesktop/UPower/devices/DisplayDevice"};
+  static constexpr char const * BATT_THERM_PATH     {"/org/freedesktop/UPower/devices/battery_batt_therm"};
+
+  struct MockDevice
+  {
+    guint32 kind {UP_DEVICE_KIND_BATTERY};
+    std::string model;
+    guint32 state {UP_DEVICE_STATE_DISCHARGING};
+    gdouble percentage {50.0};
+    gint64 time_to_empty {3600};
+    gboolean power_supply {TRUE};
+    guint reg_id {};
+  };
+
+  GTestDBus * test_dbus {};
+  GDBusConnection * logind_bus {};
+  GDBusConnection * upower_bus {};
+  guint upower_own_id {};
+  guint manager_reg_id {};
+  GDBusNodeInfo * node_info {};
+  std::map<std::string,MockDevice> mock_devices;
+  gboolean on_battery {};
+  int get_all_calls {};
+
+  IndicatorPowerDeviceProvider * provider {};
+  int devices_changed_count {};
+  bool devices_changed_off_main_thread {};
+
+  void SetUp() override
+  {
+    super::SetUp();
+
+    test_dbus = g_test_dbus_new(G_TEST_DBUS_NONE);
+    g_test_dbus_up(test_dbus);
+
+    // point the provider's system bus at our private bus
+    const auto address = g_test_dbus_get_bus_address(test_dbus);
+    g_setenv("DBUS_SYSTEM_BUS_ADDRESS", address, true);
+
+    upower_bus = new_private_connection();
+
+    node_info = g_dbus_node_info_new_for_xml(
+        "<node>"
+        "  <interface name='org.freedesktop.UPower'>"
+        "    <method name='EnumerateDevices'>"
+        "      <arg type='ao' direction='out'/>"
+        "    </method>"
+        "    <property name='OnBattery' type='b' access='read'/>"
+        "    <signal name='DeviceAdded'><arg type='o'/></signal>"
+        "    <signal name='DeviceRemoved'><arg type='o'/></signal>"
+        "  </interface>"
+        "  <interface name='org.freedesktop.UPower.Device'>"
+        "    <property name='Type' type='u' access='read'/>"
+        "    <property name='Model' type='s' access='read'/>"
+        "    <property name='State' type='u' access='read'/>"
+        "    <property name='Percentage' type='d' access='read'/>"
+        "    <property name='TimeToEmpty' type='x' access='read'/>"
+        "    <property name='TimeToFull' type='x' access='read'/>"
+        "    <property name='PowerSupply' type='b' access='read'/>"
+        "  </interface>"
+        "</node>",
+        &error);
+    g_assert_no_error(error);
+
+    static const GDBusInterfaceVTable manager_vtable = {
+      on_manager_method_call, on_manager_get_property, nullptr, {}
+    };
+    manager_reg_id = g_dbus_connection_register_object(upower_bus,
+                                                       UPOWER_PATH,
+                                                       node_info->interfaces[0],
+                                                       &manager_vtable,
+                                                       this,
+                                                       nullptr,
+                                                       &error);
+    g_assert_no_error(error);
+  }
+
+  GDBusConnection* new_private_connection()
+  {
+    GError * error {};
+    auto connection = g_dbus_connection_new_for_address_sync(
+        g_test_dbus_get_bus_address(test_dbus),
+        GDBusConnectionFlags(G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT |
+                             G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION),
+        nullptr,
+        nullptr,
+        &error);
+    g_assert_no_error(error);
+    g_dbus_connection_set_exit_on_close(connection, FALSE);
+    return connection;
+  }
+
+  void TearDown() override
+  {
+    if (provider != nullptr)
+      {
+        g_signal_handlers_disconnect_by_data(provider, this);
+        g_clear_object(&provider);
+      }
+
+    if (upower_own_id != 0)
+      g_bus_unown_name(upower_own_id);
+    for (const auto& it : mock_devices)
+      g_dbus_connection_unregister_object(upower_bus, it.second.reg_id);
+    g_dbus_connection_unregister_object(upower_bus, manager_reg_id);
+    g_clear_pointer(&node_info, g_dbus_node_info_unref);
+    g_dbus_connection_close_sync(upower_bus, nullptr, nullptr);
+    g_clear_object(&upower_bus);
+    if (logind_bus != nullptr)
+      {
+        g_dbus_connection_close_sync(logind_bus, nullptr, nullptr);
+        g_clear_object(&logind_bus);
+      }
+
+    // let the provider's pending calls and signals drain
+    wait_msec(100);
+
+    g_test_dbus_down(test_dbus);
+    g_clear_object(&test_dbus);
+    g_unsetenv("DBUS_SYSTEM_BUS_ADDRESS");
+
+    super::TearDown();
+  }
+
+  /***
+  ****  The UPower stand-in
+  ***/
+
+  static void
+  on_manager_method_call(GDBusConnection       * /*connection*/,
+                         const gchar           * /*sender*/,
+                         const gchar           * /*object_path*/,
+                         const gchar           * /*interface_name*/,
+                         const gchar           * method_name,
+                         GVariant              * /*parameters*/,
+                         GDBusMethodInvocation * invocation,
+                         gpointer                gself)
+  {
+    auto self = static_cast<UPowerFixture*>(gself);
+
+    if (!g_strcmp0(method_name, "EnumerateDevices"))
+      {
+        GVariantBuilder b;
+        g_variant_builder_init(&b, G_VARIANT_TYPE("ao"));
+        for (const auto& it : self->mock_devices)
+          g_variant_builder_add(&b, "o", it.first.c_str());
+        g_dbus_method_invocation_return_value(invocation, g_variant_new("(ao)", &b));
+      }
+    else
+      {
+        g_dbus_method_invocation_return_dbus_error(invocation,
+                                                   "org.freedesktop.DBus.Error.UnknownMethod",
+                                                   method_name);
+      }
+  }
+
+  static GVariant*
+  on_manager_get_property(GDBusConnection * /*connection*/,
+                          const gchar     * /*sender*/,
+                          const gchar     * /*object_path*/,
+                          const gchar     * /*interface_name*/,
+                          const gchar     * /*property_name*/,
+                          GError         ** /*error*/,
+                          gpointer          gself)
+  {
+    return g_variant_new_boolean(static_cast<UPowerFixture*>(gself)->on_battery);
+  }
+
+  static GVariant*
+  on_device_get_property(GDBusConnection * /*connection*/,
+                         const gchar     * /*sender*/,
+                         const gchar     * object_path,
+                         const gchar     * /*interface_name*/,
+                         const gchar     * property_name,
+                         GError         ** error,
+                         gpointer          gself)
+  {
+    auto self = static_cast<UPowerFixture*>(gself);
+    const auto it = self->mock_devices.find(object_path);
+    GVariant * ret {};
+
+    if (it == self->mock_devices.end())
+      {
+        g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_UNKNOWN_OBJECT, "%s", object_path);
+        return nullptr;
+      }
+
+    const auto& device = it->second;
+    const std::string name {property_name};
+    if (name == "Type")
+      {
+        ++self->get_all_calls; // GetAll() asks for each property once
+        ret = g_variant_new_uint32(device.kind);
+      }
+    else if (name == "Model")
+      ret = g_variant_new_string(device.model.c_str());
+    else if (name == "State")
+      ret = g_variant_new_uint32(device.state);
+    else if (name == "Percentage")
+      ret = g_variant_new_double(device.percentage);
+    else if (name == "TimeToEmpty")
+      ret = g_variant_new_int64(device.time_to_empty);
+    else if (name == "TimeToFull")
+      ret = g_variant_new_int64(0);
+    else if (name == "PowerSupply")
+      ret = g_variant_new_boolean(device.power_supply);
+    else
+      g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_UNKNOWN_PROPERTY, "%s", property_name);
+
+    return ret;
+  }
+
+  void register_device(const std::string& path, const MockDevice& device)
+  {
+    static const GDBusInterfaceVTable device_vtable = {
+      nullptr, on_device_get_property, nullptr, {}
+    };
+
+    GError * error {};
+    auto& mock = mock_devices[path];
+    mock = device;
+    mock.reg_id = g_dbus_connection_register_object(upower_bus,
+                                                    path.c_str(),
+                                                    node_info->interfaces[1],
+                                                    &device_vtable,
+                                                    this,
+                                                    nullptr,
+                                                    &error);
+    g_assert_no_error(error);
+  }
+
+  void unregister_device(const std::string& path)
+  {
+    const auto it = mock_devices.find(path);
+    if (it != mock_devices.end())
+      {
+        g_dbus_connection_unregister_object(upower_bus, it->second.reg_id);
+        mock_devices.erase(it);
+      }
+  }
+
+  static std::string
+  device_path(int i)
+  {
+    gchar * tmp = g_strdup_printf("/org/freedesktop/UPower/devices/battery_BAT%d", i);
+    std::string ret {tmp};
+    g_free(tmp);
+    return ret;
+  }
+
+  void start_upower()
+  {
+    upower_own_id = g_bus_own_name_on_connection(upower_bus,
+                                                 UPOWER_BUSNAME,
+                                                 G_BUS_NAME_OWNER_FLAGS_NONE,
+                                                 nullptr,
+                                                 nullptr,
+                                                 nullptr,
+                                                 nullptr);
+  }
+
+  void add_device(const std::string& path, const MockDevice& device)
+  {
+    register_device(path, device);
+
+    g_dbus_connection_emit_signal(upower_bus, nullptr, UPOWER_PATH, UPOWER_IFACE,
+                                  "DeviceAdded",
+                                  g_variant_new("(o)", path.c_str()),
+                                  nullptr);
+  }
+
+  void remove_device(const std::string& path)
+  {
+    unregister_device(path);
+
+    g_dbus_connection_emit_signal(upower_bus, nullptr, UPOWER_PATH, UPOWER_IFACE,
+                                  "DeviceRemoved",
+                                  g_variant_new("(o)", path.c_str()),
+                                  nullptr);
+  }
+
+  void set_percentage(const std::string& path, gdouble percentage)
+  {
+    mock_devices[path].percentage = percentage;
+
+    GVariantBuilder b;
+    g_variant_builder_init(&b, G_VARIANT_TYPE_VARDICT);
+    g_variant_builder_add(&b, "{sv}", "Percentage", g_variant_new_double(percentage));
+    g_dbus_connection_emit_signal(upower_bus, nullptr, path.c_str(), PROPERTIES_IFACE,
+                                  "PropertiesChanged",
+                                  g_variant_new("(sa{sv}@as)", UPOWER_DEVICE_IFACE, &b,
+                                                g_variant_new_strv(nullptr, 0)),
+                                  nullptr);
+  }
+
+  void set_on_battery(gboolean value)
+  {
+    on_battery = value;
+
+    GVariantBuilder b;
+    g_variant_builder_init(&b, G_VARIANT_TYPE_VARDICT);
+    g_variant_builder_add(&b, "{sv}", "OnBattery", g_variant_new_boolean(value));
+    g_dbus_connection_emit_signal(upower_bus, nullptr, UPOWER_PATH, PROPERTIES_IFACE,
+                                  "PropertiesChanged",
+                                  g_variant_new("(sa{sv}@as)", UPOWER_IFACE, &b,
+                                                g_variant_new_strv(nullptr, 0)),
+                                  nullptr);
+  }
+
+  /***
+  ****  The logind stand-in
+  ***/
+
+  void start_logind()
+  {
+    logind_bus = new_private_connection();
+
+    GError * error {};
+    auto ret = g_dbus_connection_call_sync(logind_bus,
+                                           "org.freedesktop.DBus",
+                                           "/org/freedesktop/DBus",
+                                           "org.freedesktop.DBus",
+                                           "RequestName",
+                                           g_variant_new("(su)", "org.freedesktop.login1", 0u),
+                                           G_VARIANT_TYPE("(u)"),
+                                           G_DBUS_CALL_FLAGS_NONE,
+                                           -1,
+                                           nullptr,
+                                           &error);
+    g_assert_no_error(error);
+    g_variant_unref(ret);
+  }
+
+  void emit_prepare_for_sleep(bool going_to_sleep)
+  {
+    g_dbus_connection_emit_signal(logind_bus,
+                                  nullptr,
+                                  "/org/freedesktop/login1",
+                                  "org.freedesktop.login1.Manager",
+                                  "PrepareForSleep",
+                                  g_variant_new("(b)", going_to_sleep),
+                                  nullptr);
+    g_dbus_connection_flush_sync(logind_bus, nullptr, nullptr);
+  }
+
+  /***
+  ****  The provider under test
+  ***/
+
+  static void
+  on_devices_changed(IndicatorPowerDeviceProvider * /*provider*/, gpointer gself)
+  {
+    auto self = static_cast<UPowerFixture*>(gself);
+
+    ++self->devices_changed_count;
+
+    if (!g_main_context_is_owner(g_main_context_default()))
+      self->devices_changed_off_main_thread = true;
+  }
+
+  void create_provider(bool threaded=false)
+  {
+    provider = threaded ? indicator_power_device_provider_upower_new_threaded()
+                        : indicator_power_device_provider_upower_new();
+    g_signal_connect(provider, "devices-changed", G_CALLBACK(on_devices_changed), this);
+  }
+
+  guint n_provider_devices()
+  {
+    auto snapshot = indicator_power_device_provider_get_snapshot(provider);
+    const auto n = snapshot->n_records;
+    indicator_power_device_snapshot_unref(snapshot);
+    return n;
+  }
+
+  bool provider_on_battery()
+  {
+    auto snapshot = indicator_power_device_provider_get_snapshot(provider);
+    const bool ret = snapshot->on_battery;
+    indicator_power_device_snapshot_unref(snapshot);
+    return ret;
+  }
+
+  bool provider_has_percentage(const std::string& path, gdouble percentage)
+  {
+    bool found = false;
+    auto snapshot = indicator_power_device_provider_get_snapshot(provider);
+    for (guint i=0; i<snapshot->n_records; ++i)
+      if (!g_strcmp0(snapshot->records[i].object_path, path.c_str()))
+        found = snapshot->records[i].percentage == percentage;
+    indicator_power_device_snapshot_unref(snapshot);
+    return found;
+  }
+};
+
+/***
+****
+***/
+
+TEST_F(UPowerFixture, EnumeratesDevices)
+{
+  register_device(device_path(0), MockDevice{});
+  register_device(device_path(1), MockDevice{});
+  start_upower();
+  create_provider();
+
+  EXPECT_TRUE(wait_for([this](){return n_provider_devices() == 2;}, 2000));
+  EXPECT_EQ(2, get_all_calls);
+}
+
+TEST_F(UPowerFixture, AddAndRemoveDevices)
+{
+  start_upower();
+  create_provider();
+  wait_msec(100);
+  EXPECT_EQ(0u, n_provider_devices());
+
+  add_device(device_path(0), MockDevice{});
+  EXPECT_TRUE(wait_for([this](){return n_provider_devices() == 1;}, 2000));
+
+  remove_device(device_path(0));
+  EXPECT_TRUE(wait_for([this](){return n_provider_devices() == 0;}, 2000));
+
+  // a device that comes back gets the same identity as before
+  add_device(device_path(0), MockDevice{});
+  EXPECT_TRUE(wait_for([this](){return n_provider_devices() == 1;}, 2000));
+  auto snapshot = indicator_power_device_provider_get_snapshot(provider);
+  EXPECT_EQ(g_intern_string(device_path(0).c_str()), snapshot->records[0].object_path);
+  indicator_power_device_snapshot_unref(snapshot);
+}
+
+TEST_F(UPowerFixture, FollowsOnBattery)
+{
+  register_device(device_path(0), MockDevice{});
+  on_battery = TRUE;
+  start_upower();
+  create_provider();
+
+  // the first update has the devices and OnBattery together
+  EXPECT_TRUE(wait_for([this](){return devices_changed_count > 0;}, 2000));
+  EXPECT_EQ(1u, n_provider_devices());
+  EXPECT_TRUE(provider_on_battery());
+
+  set_on_battery(FALSE);
+  EXPECT_TRUE(wait_for([this](){return !provider_on_battery();}, 2000));
+
+  set_on_battery(TRUE);
+  EXPECT_TRUE(wait_for([this](){return provider_on_battery();}, 2000));
+}
+
+/* Benchmark: how long does it take the provider to digest
+   a burst of PropertiesChanged signals across 200 devices? */
+TEST_F(UPowerFixture, PropertiesChangedBurst)
+{
+  constexpr int n_devices {200};
+  constexpr int n_rounds {10};
+
+  for (int i=0; i<n_devices; ++i)
+    register_device(device_path(i), MockDevice{});
+  start_upower();
+  create_provider();
+  ASSERT_TRUE(wait_for([this](){return n_provider_devices() == n_devices;}, 5000));
+  const auto get_all_calls_before = get_all_calls;
+
+  const auto begin = g_get_monotonic_time();
+  for (int round=1; round<=n_rounds; ++round)
+    for (int i=0; i<n_devices; ++i)
+      set_percentage(device_path(i), round);
+  g_dbus_connection_flush_sync(upower_bus, nullptr, nullptr);
+
+  const auto last = device_path(n_devices-1);
+  ASSERT_TRUE(wait_for([this,&last](){return provider_has_percentage(last, n_rounds);}, 10000));
+  const auto elapsed = g_get_monotonic_time() - begin;
+
+  // every signal was applied in place; no device needed a refetch
+  for (int i=0; i<n_devices; ++i)
+    EXPECT_TRUE(provider_has_percentage(device_path(i), n_rounds));
+  EXPECT_EQ(get_all_calls_before, get_all_calls);
+
+  const auto n_signals = n_devices * n_rounds;
+  g_print("%d PropertiesChanged signals across %d devices: %.1f ms (%.2f usec/signal)\n",
+          n_signals, n_devices, elapsed/1000.0, double(elapsed)/n_signals);
+  RecordProperty("usec_per_signal", int(elapsed/n_signals));
+}
+
+/***
+****  Wakeups
+***/
+
+namespace
+{
+  struct SignalCounts
+  {
+    std::atomic<int> ignored {0};
+    std::atomic<int> wanted {0};
+  };
+
+  /* runs in GDBus' worker thread for every message that reaches the connection */
+  GDBusMessage*
+  count_properties_changed(GDBusConnection * /*connection*/,
+                           GDBusMessage    * message,
+                           gboolean          incoming,
+                           gpointer          gcounts)
+  {
+    auto counts = static_cast<SignalCounts*>(gcounts);
+
+    if (incoming &&
+        (g_dbus_message_get_message_type(message) == G_DBUS_MESSAGE_TYPE_SIGNAL) &&
+        !g_strcmp0(g_dbus_message_get_member(message), "PropertiesChanged"))
+      {
+        const auto path = g_dbus_message_get_path(message);
+
+        if (g_str_has_suffix(path, "batt_therm") || g_str_has_suffix(path, "DisplayDevice"))
+          ++counts->ignored;
+        else
+          ++counts->wanted;
+      }
+
+    return message;
+  }
+}
+
+/* UPower on Android phones emits a steady stream of batt_therm changes,
+   and DisplayDevice changes along with every real battery change.
+   Neither should reach our connection at all. */
+TEST_F(UPowerFixture, IgnoredDevicesDoNotWakeUs)
+{
+  constexpr int n_noise {500};
+  constexpr int n_real {5};
+  const auto battery = device_path(0);
+
+  register_device(battery, MockDevice{});
+  register_device(BATT_THERM_PATH, MockDevice{});
+  register_device(DISPLAY_DEVICE_PATH, MockDevice{});
+  start_upower();
+
+  // count what reaches the provider's connection. Filters run in the
+  // order they're added, so adding ours before the provider adds its
+  // own means we see what the bus delivers, not what the filter keeps
+  auto system_bus = g_bus_get_sync(G_BUS_TYPE_SYSTEM, nullptr, nullptr);
+  SignalCounts received;
+  const auto filter_id = g_dbus_connection_add_filter(system_bus,
+                                                      count_properties_changed,
+                                                      &received,
+                                                      nullptr);
+
+  create_provider();
+  ASSERT_TRUE(wait_for([this](){return n_provider_devices() == 1;}, 2000));
+  received.ignored = 0;
+  received.wanted = 0;
+
+  // ...and what a namespace-wide match on the device interface would get
+  auto baseline_bus = g_dbus_connection_new_for_address_sync(
+      g_test_dbus_get_bus_address(test_dbus),
+      GDBusConnectionFlags(G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT |
+                           G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION),
+      nullptr,
+      nullptr,
+      nullptr);
+  ASSERT_NE(nullptr, baseline_bus);
+  SignalCounts baseline;
+  const auto baseline_filter_id = g_dbus_connection_add_filter(baseline_bus,
+                                                               count_properties_changed,
+                                                               &baseline,
+                                                               nullptr);
+  const auto baseline_sub = g_dbus_connection_signal_subscribe(baseline_bus,
+                                                               nullptr,
+                                                               PROPERTIES_IFACE,
+                                                               "PropertiesChanged",
+                                                               nullptr,
+                                                               UPOWER_DEVICE_IFACE,
+                                                               G_DBUS_SIGNAL_FLAGS_MATCH_ARG0_NAMESPACE,
+                                                               [](GDBusConnection*, const gchar*, const gchar*,
+                                                                  const gchar*, const gchar*, GVariant*, gpointer){},
+                                                               nullptr,
+                                                               nullptr);
+  wait_msec(100);
+
+  for (int i=0; i<n_noise; ++i)
+    {
+      set_percentage(BATT_THERM_PATH, i % 100);
+      set_percentage(DISPLAY_DEVICE_PATH, i % 100);
+    }
+  for (int i=1; i<=n_real; ++i)
+    set_percentage(battery, i);
+  g_dbus_connection_flush_sync(upower_bus, nullptr, nullptr);
+
+  EXPECT_TRUE(wait_for([this,&battery](){return provider_has_percentage(battery, n_real);}, 5000));
+  EXPECT_TRUE(wait_for([&baseline](){return baseline.ignored + baseline.wanted == 2*n_noise + n_real;}, 5000));
+
+  EXPECT_EQ(0, received.ignored);
+  EXPECT_EQ(n_real, received.wanted);
+
+  // the match rules kept them off the connection, so the filter had nothing to drop
+  auto upower = INDICATOR_POWER_DEVICE_PROVIDER_UPOWER(provider);
+  EXPECT_EQ(0u, indicator_power_device_provider_upower_get_filter_drops(upower, INDICATOR_POWER_UPOWER_FILTER_BATT_THERM));
+  EXPECT_EQ(0u, indicator_power_device_provider_upower_get_filter_drops(upower, INDICATOR_POWER_UPOWER_FILTER_DISPLAY_DEVICE));
+
+  g_print("namespace-wide match: %d wakeups; per-device matches: %d wakeups (%d saved)\n",
+          baseline.ignored + baseline.wanted,
+          received.ignored + received.wanted,
+          baseline.ignored + baseline.wanted - received.ignored - received.wanted);
+  RecordProperty("wakeups_saved", baseline.ignored + baseline.wanted - received.ignored - received.wanted);
+
+  g_dbus_connection_signal_unsubscribe(baseline_bus, baseline_sub);
+  g_dbus_connection_remove_filter(baseline_bus, baseline_filter_id);
+  g_dbus_connection_close_sync(baseline_bus, nullptr, nullptr);
+  g_clear_object(&baseline_bus);
+  g_dbus_connection_remove_filter(system_bus, filter_id);
+  g_clear_object(&system_bus);
+}
+
+/***
+****  Message filter
+***/
+
+/* Even if something else in the process adds a broad match rule,
+   the filter drops ignored devices' signals in GDBus' worker thread.
+   Unchanged-value signals still reach that other subscriber, and the
+   provider skips them itself. Both are counted by rule. */
+TEST_F(UPowerFixture, FilterDropsIgnoredAndDuplicateSignals)
+{
+  constexpr int n_noise {100};
+  const auto battery = device_path(0);
+
+  register_device(battery, MockDevice{});
+  register_device(BATT_THERM_PATH, MockDevice{});
+  register_device(DISPLAY_DEVICE_PATH, MockDevice{});
+  start_upower();
+  create_provider();
+  ASSERT_TRUE(wait_for([this](){return n_provider_devices() == 1;}, 2000));
+
+  // a broad match rule on the provider's connection
+  auto system_bus = g_bus_get_sync(G_BUS_TYPE_SYSTEM, nullptr, nullptr);
+  int broad_count {};
+  const auto broad_sub = g_dbus_connection_signal_subscribe(system_bus,
+                                                            nullptr,
+                                                            PROPERTIES_IFACE,
+                                                            "PropertiesChanged",
+                                                            nullptr,
+                                                            UPOWER_DEVICE_IFACE,
+                                                            G_DBUS_SIGNAL_FLAGS_MATCH_ARG0_NAMESPACE,
+                                                            [](GDBusConnection*, const gchar*, const gchar*,
+                                                               const gchar*, const gchar*, GVariant*, gpointer gcount){
+                                                              ++*static_cast<int*>(gcount);
+                                                            },
+                                                            &broad_count,
+                                                            nullptr);
+  wait_msec(100);
+
+  auto upower = INDICATOR_POWER_DEVICE_PROVIDER_UPOWER(provider);
+  for (int i=0; i<n_noise; ++i)
+    {
+      set_percentage(BATT_THERM_PATH, i);
+      set_percentage(DISPLAY_DEVICE_PATH, i);
+    }
+  set_percentage(battery, 10);
+  for (int i=0; i<n_noise; ++i)
+    set_percentage(battery, 10); // unchanged
+  set_percentage(battery, 20);
+  g_dbus_connection_flush_sync(upower_bus, nullptr, nullptr);
+
+  EXPECT_TRUE(wait_for([this,&battery](){return provider_has_percentage(battery, 20);}, 5000));
+  EXPECT_TRUE(wait_for([&broad_count](){return broad_count == 2 + n_noise;}, 5000));
+  EXPECT_EQ(guint(n_noise), indicator_power_device_provider_upower_get_filter_drops(upower, INDICATOR_POWER_UPOWER_FILTER_BATT_THERM));
+  EXPECT_EQ(guint(n_noise), indicator_power_device_provider_upower_get_filter_drops(upower, INDICATOR_POWER_UPOWER_FILTER_DISPLAY_DEVICE));
+  EXPECT_EQ(guint(n_noise), indicator_power_device_provider_upower_get_filter_drops(upower, INDICATOR_POWER_UPOWER_FILTER_DUPLICATE));
+
+  for (int rule=0; rule<INDICATOR_POWER_UPOWER_FILTER_N_RULES; ++rule)
+    g_print("filter rule %d dropped %u signals\n", rule,
+            indicator_power_device_provider_upower_get_filter_drops(upower, IndicatorPowerUPowerFilterRule(rule)));
+
+  g_dbus_connection_signal_unsubscribe(system_bus, broad_sub);
+  g_clear_object(&system_bus);
+}
+
+/***
+****  Ingestion thread
+***/
+
+TEST_F(UPowerFixture, ThreadedEnumeratesDevices)
+{
+  register_device(device_path(0), MockDevice{});
+  register_device(device_path(1), MockDevice{});
+  start_upower();
+  create_provider(true);
+
+  EXPECT_TRUE(wait_for([this](){return n_provider_devices() == 2;}, 2000));
+  EXPECT_FALSE(devices_changed_off_main_thread);
+
+  remove_device(device_path(0));
+  EXPECT_TRUE(wait_for([this](){return n_provider_devices() == 1;}, 2000));
+  EXPECT_FALSE(devices_changed_off_main_thread);
+}
+
+/* The ingestion thread folds a burst into a handful of snapshots,
+   so the main loop sees far fewer devices-changed than signals. */
+TEST_F(UPowerFixture, ThreadedPropertiesChangedBurst)
+{
+  constexpr int n_devices {200};
+  constexpr int n_rounds {10};
+
+  for (int i=0; i<n_devices; ++i)
+    register_device(device_path(i), MockDevice{});
+  start_upower();
+  create_provider(true);
+  ASSERT_TRUE(wait_for([this](){return n_provider_devices() == n_devices;}, 5000));
+  devices_changed_count = 0;
+
+  const auto begin = g_get_monotonic_time();
+  for (int round=1; round<=n_rounds; ++round)
+    for (int i=0; i<n_devices; ++i)
+      set_percentage(device_path(i), round);
+  g_dbus_connection_flush_sync(upower_bus, nullptr, nullptr);
+
+  ASSERT_TRUE(wait_for([this](){
+    for (int i=0; i<n_devices; ++i)
+      if (!provider_has_percentage(device_path(i), n_rounds))
+        return false;
+    return true;
+  }, 10000));
+  const auto elapsed = g_get_monotonic_time() - begin;
+
+  const auto n_signals = n_devices * n_rounds;
+  EXPECT_FALSE(devices_changed_off_main_thread);
+  EXPECT_LT(devices_changed_count, n_signals);
+
+  g_print("%d PropertiesChanged signals across %d devices: %.1f ms, %d snapshots published to the main loop\n",
+          n_signals, n_devices, elapsed/1000.0, devices_changed_count);
+  RecordProperty("snapshots", devices_changed_count);
+}
+
+/***
+****  Resume
+***/
+
+/* Modern UPower doesn't say when we've resumed, and its per-property
+   signals trickle in late, so the provider listens to logind instead
+   and refreshes everything without waiting for the usual coalescing. */
+TEST_F(UPowerFixture, RefreshesAllDevicesOnResume)
+{
+  constexpr int n_devices {3};
+
+  for (int i=0; i<n_devices; ++i)
+    register_device(device_path(i), MockDevice{});
+  start_logind();
+  start_upower();
+  create_provider();
+  ASSERT_TRUE(wait_for([this](){return n_provider_devices() == n_devices;}, 2000));
+  const auto get_all_calls_before = get_all_calls;
+
+  // the batteries drain while we sleep, and UPower doesn't tell us
+  emit_prepare_for_sleep(true);
+  for (int i=0; i<n_devices; ++i)
+    mock_devices[device_path(i)].percentage = 20.0;
+  wait_msec(100);
+  EXPECT_EQ(get_all_calls_before, get_all_calls);
+
+  // on wake, one batch refresh happens well inside the 500 msec coalescing window...
+  devices_changed_count = 0;
+  emit_prepare_for_sleep(false);
+  EXPECT_TRUE(wait_for([this](){
+    for (int i=0; i<n_devices; ++i)
+      if (!provider_has_percentage(device_path(i), 20.0))
+        return false;
+    return true;
+  }, 400));
+  EXPECT_EQ(get_all_calls_before + n_devices, get_all_calls);
+
+  // ...and consumers see it as a single update
+  wait_msec(100);
+  EXPECT_EQ(1, devices_changed_count);
+}
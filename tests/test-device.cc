@@ -83,9 +83,8 @@ class DeviceTest : public ::testing::Test
     void check_label (const IndicatorPowerDevice * device,
                       const char * expected_label)
     {
-      char * label = indicator_power_device_get_readable_text (device, FALSE);
+      const char * label = indicator_power_device_get_readable_text (device, FALSE);
       EXPECT_STREQ (expected_label, label);
-      g_free (label);
     }
 
     void check_header (const IndicatorPowerDevice * device,
@@ -94,40 +93,35 @@ class DeviceTest : public ::testing::Test
                        const char * expected_percent,
                        const char * expected_a11y)
     {
-      char * a11y = NULL;
-      char * title = NULL;
+      const char * a11y = NULL;
+      const char * title = NULL;
 
       title = indicator_power_device_get_readable_title (device, true, true);
       if (expected_time_and_percent)
         EXPECT_STREQ (expected_time_and_percent, title);
       else
         EXPECT_EQ(NULL, title);
-      g_free (title);
 
       title = indicator_power_device_get_readable_title (device, true, false);
       if (expected_time)
         EXPECT_STREQ (expected_time, title);
       else
         EXPECT_EQ(NULL, title);
-      g_free (title);
 
       title = indicator_power_device_get_readable_title (device, false, true);
       if (expected_percent)
         EXPECT_STREQ (expected_percent, title);
       else
         EXPECT_EQ(NULL, title);
-      g_free (title);
 
       title = indicator_power_device_get_readable_title (device, false, false);
       EXPECT_EQ(NULL, title);
-      g_free (title);
 
       a11y = indicator_power_device_get_accessible_title (device, false, false);
       if (expected_a11y)
         EXPECT_STREQ (expected_a11y, a11y);
       else
         EXPECT_EQ(NULL, a11y);
-      g_free (a11y);
     }
 };
 
@@ -699,6 +693,76 @@ TEST_F(DeviceTest, Labels)
 }
 
 
+TEST_F(DeviceTest, CachedTexts)
+{
+  auto real_lang = g_strdup(g_getenv ("LANG"));
+  g_setenv ("LANG", "en_US.UTF-8", TRUE);
+
+  auto device = indicator_power_device_new ("/org/freedesktop/UPower/devices/battery_BAT0",
+                                            UP_DEVICE_KIND_BATTERY,
+                                            "Some Model",
+                                            50.0,
+                                            UP_DEVICE_STATE_DISCHARGING,
+                                            60*61,
+                                            TRUE);
+  auto o = G_OBJECT(device);
+
+  // asking again gives back the same string
+  auto label = indicator_power_device_get_readable_text (device, FALSE);
+  EXPECT_STREQ ("Battery (1:01 left)", label);
+  EXPECT_EQ (label, indicator_power_device_get_readable_text (device, FALSE));
+  auto title = indicator_power_device_get_readable_title (device, false, true);
+  EXPECT_STREQ ("(50%)", title);
+  EXPECT_EQ (title, indicator_power_device_get_readable_title (device, false, true));
+
+  // changes that don't show aren't re-rendered...
+  g_object_set (o, INDICATOR_POWER_DEVICE_TIME, guint64(60*61 + 30), nullptr);
+  EXPECT_EQ (label, indicator_power_device_get_readable_text (device, FALSE));
+  EXPECT_STREQ ("Some Model (1:01 left)", indicator_power_device_get_readable_text (device, TRUE));
+  g_object_set (o, INDICATOR_POWER_DEVICE_MODEL, "Another Model", nullptr);
+  EXPECT_EQ (label, indicator_power_device_get_readable_text (device, FALSE));
+  EXPECT_STREQ ("Another Model (1:01 left)", indicator_power_device_get_readable_text (device, TRUE));
+
+  // ...and changes that do show are
+  g_object_set (o, INDICATOR_POWER_DEVICE_TIME, guint64(60*62), nullptr);
+  EXPECT_STREQ ("Battery (1:02 left)", indicator_power_device_get_readable_text (device, FALSE));
+  EXPECT_STREQ ("(50%)", indicator_power_device_get_readable_title (device, false, true));
+  g_object_set (o, INDICATOR_POWER_DEVICE_PERCENTAGE, 49.0, nullptr);
+  EXPECT_STREQ ("(49%)", indicator_power_device_get_readable_title (device, false, true));
+  EXPECT_STREQ ("(1:02, 49%)", indicator_power_device_get_readable_title (device, true, true));
+  g_object_set (o, INDICATOR_POWER_DEVICE_STATE, UP_DEVICE_STATE_CHARGING, nullptr);
+  EXPECT_STREQ ("Battery (1:02 to charge)", indicator_power_device_get_readable_text (device, FALSE));
+  EXPECT_STREQ ("Battery (1 hour 2 minutes to charge)", indicator_power_device_get_accessible_text (device));
+
+  // cleanup
+  g_object_unref (o);
+  g_setenv ("LANG", real_lang, TRUE);
+  g_free (real_lang);
+}
+
+TEST_F(DeviceTest, NextTransition)
+{
+  auto device = INDICATOR_POWER_DEVICE (g_object_new (INDICATOR_POWER_DEVICE_TYPE, nullptr));
+  auto o = G_OBJECT(device);
+
+  // "estimating…" turns into "unknown" in 30 seconds
+  g_object_set (o, INDICATOR_POWER_DEVICE_KIND, UP_DEVICE_KIND_BATTERY,
+                   INDICATOR_POWER_DEVICE_STATE, UP_DEVICE_STATE_DISCHARGING,
+                   INDICATOR_POWER_DEVICE_PERCENTAGE, 50.0,
+                   INDICATOR_POWER_DEVICE_TIME, guint64(0),
+                   nullptr);
+  const auto seconds = indicator_power_device_get_next_transition (device);
+  EXPECT_GE(seconds, 30u);
+  EXPECT_LE(seconds, 31u);
+
+  // a real time estimate doesn't change by itself
+  g_object_set (o, INDICATOR_POWER_DEVICE_TIME, guint64(60*60), nullptr);
+  EXPECT_EQ(0u, indicator_power_device_get_next_transition (device));
+
+  // cleanup
+  g_object_unref(o);
+}
+
 TEST_F(DeviceTest, Inestimable___this_takes_80_seconds)
 {
   // set our language so that i18n won't break these tests
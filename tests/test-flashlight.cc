@@ -0,0 +1,188 @@
+/*
+ * Copyright 2026 The Ayatana Indicators project
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "glib-fixture.h"
+
+#include "flashlight.h"
+
+#include <gtest/gtest.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+
+#include <string>
+
+/***
+****
+***/
+
+/**
+ * Builds a fake sysfs tree in a temporary directory.
+ */
+class FlashlightFixture: public GlibFixture
+{
+private:
+
+  typedef GlibFixture super;
+
+protected:
+
+  gchar * sysfs_root {};
+  GSimpleAction * action {};
+
+  void SetUp() override
+  {
+    super::SetUp();
+
+    GError * error {};
+    sysfs_root = g_dir_make_tmp("indicator-power-leds-XXXXXX", &error);
+    g_assert_no_error(error);
+    flashlight_set_sysfs_root(sysfs_root);
+
+    action = g_simple_action_new_stateful("flashlight", nullptr, g_variant_new_boolean(FALSE));
+  }
+
+  void TearDown() override
+  {
+    g_clear_object(&action);
+
+    // let flashlight.c close its fds
+    flashlight_set_sysfs_root(nullptr);
+    remove_recursive(sysfs_root);
+    g_clear_pointer(&sysfs_root, g_free);
+
+    super::TearDown();
+  }
+
+  static void remove_recursive(const gchar * path)
+  {
+    auto dir = g_dir_open(path, 0, nullptr);
+    if (dir != nullptr)
+      {
+        const gchar * name;
+        while ((name = g_dir_read_name(dir)))
+          {
+            auto child = g_build_filename(path, name, nullptr);
+            remove_recursive(child);
+            g_free(child);
+          }
+        g_dir_close(dir);
+      }
+    g_remove(path);
+  }
+
+  std::string add_led(const char * relative_path)
+  {
+    auto path = g_build_filename(sysfs_root, relative_path, nullptr);
+    auto dir = g_path_get_dirname(path);
+    g_mkdir_with_parents(dir, 0755);
+    g_file_set_contents(path, "0", -1, nullptr);
+    std::string ret {path};
+    g_free(dir);
+    g_free(path);
+    return ret;
+  }
+
+  static std::string read_led(const std::string& path)
+  {
+    gchar * contents {};
+    g_file_get_contents(path.c_str(), &contents, nullptr, nullptr);
+    std::string ret {contents ? contents : ""};
+    g_free(contents);
+    return ret;
+  }
+
+  void toggle()
+  {
+    toggle_flashlight_action(G_ACTION(action), nullptr, nullptr);
+  }
+
+  bool action_state()
+  {
+    auto state = g_action_get_state(G_ACTION(action));
+    const bool ret = g_variant_get_boolean(state);
+    g_variant_unref(state);
+    return ret;
+  }
+};
+
+/***
+****
+***/
+
+TEST_F(FlashlightFixture, DiscoveryIsCachedUntilLedsChange)
+{
+  EXPECT_FALSE(flashlight_supported());
+
+  // a new LED alone doesn't trigger a new probe...
+  add_led("class/leds/white:flash/brightness");
+  EXPECT_FALSE(flashlight_supported());
+
+  // ...nor does an unrelated uevent...
+  flashlight_handle_uevent("add", "power_supply");
+  EXPECT_FALSE(flashlight_supported());
+
+  // ...but a leds uevent does
+  flashlight_handle_uevent("add", "leds");
+  EXPECT_TRUE(flashlight_supported());
+}
+
+TEST_F(FlashlightFixture, ToggleSimple)
+{
+  const auto led = add_led("class/leds/white:flash/brightness");
+  ASSERT_TRUE(flashlight_supported());
+
+  toggle();
+  EXPECT_TRUE(action_state());
+  EXPECT_EQ("1", read_led(led));
+
+  toggle();
+  EXPECT_FALSE(action_state());
+  EXPECT_EQ("0", read_led(led));
+}
+
+TEST_F(FlashlightFixture, ToggleQcomWithSwitch)
+{
+  const auto led = add_led("class/leds/torch-light/brightness");
+  const auto led_switch = add_led("class/leds/led:switch/brightness");
+  ASSERT_TRUE(flashlight_supported());
+
+  toggle();
+  EXPECT_TRUE(action_state());
+  EXPECT_EQ("255", read_led(led));
+  EXPECT_EQ("1", read_led(led_switch));
+
+  // turning it off only needs the switch
+  toggle();
+  EXPECT_FALSE(action_state());
+  EXPECT_EQ("255", read_led(led));
+  EXPECT_EQ("0", read_led(led_switch));
+}
+
+TEST_F(FlashlightFixture, RemovedLed)
+{
+  const auto led = add_led("class/leds/white:flash/brightness");
+  ASSERT_TRUE(flashlight_supported());
+
+  g_remove(led.c_str());
+  flashlight_handle_uevent("remove", "leds");
+  EXPECT_FALSE(flashlight_supported());
+
+  // nothing to toggle, so the state doesn't change
+  toggle();
+  EXPECT_FALSE(action_state());
+}
@@ -27,17 +27,19 @@
 
 #include "dbus-shared.h"
 #include "device.h"
+#include "device-snapshot.h"
 #include "notifier.h"
 
 #include <gtest/gtest.h>
 
 #include <libdbustest/dbus-test.h>
 
-#include <libnotify/notify.h>
-
 #include <glib.h>
 #include <gio/gio.h>
 
+#include <utility>
+#include <vector>
+
 /***
 ****
 ***/
@@ -135,14 +137,10 @@ protected:
     bus = g_bus_get_sync(G_BUS_TYPE_SESSION, nullptr, nullptr);
     g_dbus_connection_set_exit_on_close(bus, FALSE);
     g_object_add_weak_pointer(G_OBJECT(bus), reinterpret_cast<gpointer*>(&bus));
-
-    notify_init(SERVICE_EXEC);
   }
 
   virtual void TearDown()
   {
-    notify_uninit();
-
     g_clear_object(&mock);
     g_clear_object(&service);
     g_object_unref(bus);
@@ -241,12 +239,15 @@ TEST_F(NotifyFixture, PercentageToLevel)
                                              UP_DEVICE_STATE_DISCHARGING,
                                              30,
                                              TRUE);
+  auto notifier = indicator_power_notifier_new ();
+  indicator_power_notifier_set_battery (notifier, battery);
+  indicator_power_notifier_set_bus (notifier, bus);
 
   // confirm that the power levels trigger at the right percentages
   for (int i=100; i>=0; --i)
     {
       set_battery_percentage (battery, i);
-      const auto level = indicator_power_notifier_get_power_level(battery);
+      const auto level = indicator_power_notifier_get_power_level(notifier);
 
        if (i <= percent_critical)
          EXPECT_STREQ (POWER_LEVEL_STR_CRITICAL, level);
@@ -258,6 +259,13 @@ TEST_F(NotifyFixture, PercentageToLevel)
          EXPECT_STREQ (POWER_LEVEL_STR_OK, level);
      }
 
+  // ...and that climbing back out of them honors the hysteresis
+  set_battery_percentage (battery, percent_low + 0.5);
+  EXPECT_STREQ (POWER_LEVEL_STR_LOW, indicator_power_notifier_get_power_level(notifier));
+  set_battery_percentage (battery, percent_low + 1.5);
+  EXPECT_STREQ (POWER_LEVEL_STR_OK, indicator_power_notifier_get_power_level(notifier));
+
+  g_object_unref (notifier);
   g_object_unref (battery);
 }
 
@@ -279,6 +287,8 @@ namespace
     std::string power_level = POWER_LEVEL_STR_OK;
     bool is_warning = false;
     uint32_t fields = 0;
+    int n_signals = 0;
+    int n_level_signals = 0; // the ones carrying PowerLevel or IsWarning
   };
 
   void on_battery_property_changed (GDBusConnection *connection G_GNUC_UNUSED,
@@ -293,12 +303,15 @@ namespace
     auto dict = g_variant_get_child_value (parameters, 1);
     g_return_if_fail (g_variant_is_of_type (dict, G_VARIANT_TYPE_DICTIONARY));
     auto changed_params = static_cast<ChangedParams*>(gchanged_params);
+    ++changed_params->n_signals;
+    bool level_changed = false;
 
     const char * power_level;
     if (g_variant_lookup (dict, "PowerLevel", "&s", &power_level, nullptr))
     {
       changed_params->power_level = power_level;
       changed_params->fields |= FIELD_POWER_LEVEL;
+      level_changed = true;
     }
 
     gboolean is_warning;
@@ -306,8 +319,12 @@ namespace
     {
       changed_params->is_warning = is_warning;
       changed_params->fields |= FIELD_IS_WARNING;
+      level_changed = true;
     }
 
+    if (level_changed)
+      ++changed_params->n_level_signals;
+
     g_variant_unref (dict);
   }
 }
@@ -348,9 +365,9 @@ TEST_F(NotifyFixture, LevelsDuringBatteryDrain)
       changed_params = ChangedParams();
       EXPECT_TRUE (changed_params.fields == 0);
 
-      const auto old_level = indicator_power_notifier_get_power_level(battery);
+      const auto old_level = indicator_power_notifier_get_power_level(notifier);
       set_battery_percentage (battery, i);
-      const auto new_level = indicator_power_notifier_get_power_level(battery);
+      const auto new_level = indicator_power_notifier_get_power_level(notifier);
       wait_msec();
 
       if (old_level == new_level)
@@ -430,7 +447,7 @@ TEST_F(NotifyFixture, EventsThatChangeNotifications)
   set_battery_percentage (battery, percent_low);
   wait_msec();
   EXPECT_EQ (FIELD_POWER_LEVEL|FIELD_IS_WARNING, changed_params.fields);
-  EXPECT_EQ (indicator_power_notifier_get_power_level(battery), changed_params.power_level);
+  EXPECT_EQ (indicator_power_notifier_get_power_level(notifier), changed_params.power_level);
   EXPECT_TRUE (changed_params.is_warning);
   EXPECT_EQ (1, get_notify_call_count());
   EXPECT_EQ (low_power_uri, get_notify_call_sound_file(0));
@@ -464,11 +481,189 @@ TEST_F(NotifyFixture, EventsThatChangeNotifications)
   EXPECT_EQ (low_power_uri, get_notify_call_sound_file(0));
   clear_method_calls();
 
-  // ...and that it's taken down if the power level is OK
+  // ...and that it's taken down if the power level is OK,
+  // i.e. past the 'low' threshold's 1% hysteresis band
+  changed_params = ChangedParams();
+  set_battery_percentage (battery, percent_low+2);
+  wait_msec();
+  EXPECT_EQ (FIELD_POWER_LEVEL|FIELD_IS_WARNING, changed_params.fields);
+  EXPECT_STREQ (POWER_LEVEL_STR_OK, changed_params.power_level.c_str());
+  EXPECT_FALSE (changed_params.is_warning);
+  EXPECT_EQ (0, get_notify_call_count());
+
+  // cleanup
+  g_dbus_connection_signal_unsubscribe (bus, sub_tag);
+  g_object_unref (notifier);
+  g_object_unref (battery);
+}
+
+/***
+****
+***/
+
+TEST_F(NotifyFixture, PropertyChangesAreBatched)
+{
+  GError * error = nullptr;
+  dbus_test_dbus_mock_object_add_method (mock,
+                                         obj,
+                                         METHOD_GET_CAPS,
+                                         nullptr,
+                                         G_VARIANT_TYPE_STRING_ARRAY,
+                                         "ret = ['actions', 'body']",
+                                         &error);
+  g_assert_no_error (error);
+
+  auto battery = indicator_power_device_new ("/object/path",
+                                             UP_DEVICE_KIND_BATTERY,
+                                             "Some Model",
+                                             percent_low + 1.0,
+                                             UP_DEVICE_STATE_DISCHARGING,
+                                             30,
+                                             TRUE);
+
+  auto notifier = indicator_power_notifier_new ();
+  indicator_power_notifier_set_battery (notifier, battery);
+  indicator_power_notifier_set_bus (notifier, bus);
+  ChangedParams changed_params;
+  auto sub_tag = g_dbus_connection_signal_subscribe (bus,
+                                                     nullptr,
+                                                     "org.freedesktop.DBus.Properties",
+                                                     "PropertiesChanged",
+                                                     BUS_PATH"/Battery",
+                                                     nullptr,
+                                                     G_DBUS_SIGNAL_FLAGS_NONE,
+                                                     on_battery_property_changed,
+                                                     &changed_params,
+                                                     nullptr);
+  wait_msec();
+
+  // PowerLevel and IsWarning change together, so they share a signal
   changed_params = ChangedParams();
-  set_battery_percentage (battery, percent_low+1);
+  set_battery_percentage (battery, percent_low);
   wait_msec();
   EXPECT_EQ (FIELD_POWER_LEVEL|FIELD_IS_WARNING, changed_params.fields);
+  EXPECT_EQ (1, changed_params.n_signals);
+
+  // several changes in one main loop iteration are sent once,
+  // and IsWarning going false and back to true isn't sent at all
+  changed_params = ChangedParams();
+  set_battery_percentage (battery, percent_very_low);
+  set_battery_percentage (battery, percent_critical);
+  wait_msec();
+  EXPECT_EQ (FIELD_POWER_LEVEL, changed_params.fields);
+  EXPECT_STREQ (POWER_LEVEL_STR_CRITICAL, changed_params.power_level.c_str());
+  EXPECT_EQ (1, changed_params.n_signals);
+
+  // a change that's undone before the flush costs nothing
+  changed_params = ChangedParams();
+  g_object_set (battery, INDICATOR_POWER_DEVICE_STATE, UP_DEVICE_STATE_CHARGING, nullptr);
+  g_object_set (battery, INDICATOR_POWER_DEVICE_STATE, UP_DEVICE_STATE_DISCHARGING, nullptr);
+  wait_msec();
+  EXPECT_EQ (0, changed_params.n_signals);
+
+  // cleanup
+  g_dbus_connection_signal_unsubscribe (bus, sub_tag);
+  g_object_unref (notifier);
+  g_object_unref (battery);
+}
+
+/***
+****
+***/
+
+TEST_F(NotifyFixture, NoisyPercentageDoesNotFlap)
+{
+  GError * error = nullptr;
+  dbus_test_dbus_mock_object_add_method (mock,
+                                         obj,
+                                         METHOD_GET_CAPS,
+                                         nullptr,
+                                         G_VARIANT_TYPE_STRING_ARRAY,
+                                         "ret = ['actions', 'body']",
+                                         &error);
+  g_assert_no_error (error);
+
+  auto battery = indicator_power_device_new ("/object/path",
+                                             UP_DEVICE_KIND_BATTERY,
+                                             "Some Model",
+                                             percent_low + 2.0,
+                                             UP_DEVICE_STATE_DISCHARGING,
+                                             30,
+                                             TRUE);
+
+  auto notifier = indicator_power_notifier_new ();
+  indicator_power_notifier_set_battery (notifier, battery);
+  indicator_power_notifier_set_bus (notifier, bus);
+  ChangedParams changed_params;
+  auto sub_tag = g_dbus_connection_signal_subscribe (bus,
+                                                     nullptr,
+                                                     "org.freedesktop.DBus.Properties",
+                                                     "PropertiesChanged",
+                                                     BUS_PATH"/Battery",
+                                                     nullptr,
+                                                     G_DBUS_SIGNAL_FLAGS_NONE,
+                                                     on_battery_property_changed,
+                                                     &changed_params,
+                                                     nullptr);
+  wait_msec();
+
+  // drop into 'low'
+  changed_params = ChangedParams();
+  set_battery_percentage (battery, percent_low - 0.1);
+  wait_msec();
+  EXPECT_STREQ (POWER_LEVEL_STR_LOW, changed_params.power_level.c_str());
+  EXPECT_TRUE (changed_params.is_warning);
+  EXPECT_EQ (1, get_notify_call_count());
+  clear_method_calls();
+
+  // wobble around the threshold...
+  static constexpr double noise[] = { +0.1, -0.2, +0.3, -0.1, +0.2, -0.3, +0.4, 0.0 };
+  changed_params = ChangedParams();
+  for (int i=0; i<200; ++i)
+    {
+      set_battery_percentage (battery, percent_low + noise[i % G_N_ELEMENTS(noise)]);
+      if (!(i % 20))
+        wait_msec(10);
+    }
+  wait_msec();
+
+  // ...and confirm it only moved Percentage, not PowerLevel or IsWarning
+  EXPECT_EQ (0, changed_params.n_level_signals);
+  EXPECT_EQ (0, get_notify_call_count());
+  guint len {0u};
+  dbus_test_dbus_mock_object_get_method_calls (mock, obj, METHOD_CLOSE, &len, &error);
+  g_assert_no_error (error);
+  EXPECT_EQ (0u, len);
+
+  // same for devices that only report whole percentages
+  changed_params = ChangedParams();
+  for (int i=0; i<200; ++i)
+    {
+      set_battery_percentage (battery, percent_low + (i % 2));
+      if (!(i % 20))
+        wait_msec(10);
+    }
+  wait_msec();
+  EXPECT_EQ (0, changed_params.n_level_signals);
+  EXPECT_EQ (0, get_notify_call_count());
+  dbus_test_dbus_mock_object_get_method_calls (mock, obj, METHOD_CLOSE, &len, &error);
+  g_assert_no_error (error);
+  EXPECT_EQ (0u, len);
+
+  // dropping a level still takes effect right away, even when noisy...
+  changed_params = ChangedParams();
+  for (int i=0; i<200; ++i)
+    set_battery_percentage (battery, percent_very_low + noise[i % G_N_ELEMENTS(noise)]);
+  wait_msec();
+  EXPECT_STREQ (POWER_LEVEL_STR_VERY_LOW, changed_params.power_level.c_str());
+  EXPECT_LE (changed_params.n_level_signals, 1);
+  EXPECT_EQ (1, get_notify_call_count());
+  clear_method_calls();
+
+  // ...and a real recovery is reported once
+  changed_params = ChangedParams();
+  set_battery_percentage (battery, percent_low + 2.0);
+  wait_msec();
   EXPECT_STREQ (POWER_LEVEL_STR_OK, changed_params.power_level.c_str());
   EXPECT_FALSE (changed_params.is_warning);
   EXPECT_EQ (0, get_notify_call_count());
@@ -478,3 +673,348 @@ TEST_F(NotifyFixture, EventsThatChangeNotifications)
   g_object_unref (notifier);
   g_object_unref (battery);
 }
+
+/***
+****
+***/
+
+TEST_F(NotifyFixture, ServerClosingNotificationClearsWarning)
+{
+  GError * error = nullptr;
+  dbus_test_dbus_mock_object_add_method (mock,
+                                         obj,
+                                         METHOD_GET_CAPS,
+                                         nullptr,
+                                         G_VARIANT_TYPE_STRING_ARRAY,
+                                         "ret = ['actions', 'body']",
+                                         &error);
+  g_assert_no_error (error);
+
+  auto battery = indicator_power_device_new ("/object/path",
+                                             UP_DEVICE_KIND_BATTERY,
+                                             "Some Model",
+                                             percent_low + 1.0,
+                                             UP_DEVICE_STATE_DISCHARGING,
+                                             30,
+                                             TRUE);
+
+  auto notifier = indicator_power_notifier_new ();
+  indicator_power_notifier_set_battery (notifier, battery);
+  indicator_power_notifier_set_bus (notifier, bus);
+  ChangedParams changed_params;
+  auto sub_tag = g_dbus_connection_signal_subscribe (bus,
+                                                     nullptr,
+                                                     "org.freedesktop.DBus.Properties",
+                                                     "PropertiesChanged",
+                                                     BUS_PATH"/Battery",
+                                                     nullptr,
+                                                     G_DBUS_SIGNAL_FLAGS_NONE,
+                                                     on_battery_property_changed,
+                                                     &changed_params,
+                                                     nullptr);
+  wait_msec();
+
+  // show a notification...
+  changed_params = ChangedParams();
+  set_battery_percentage (battery, percent_low);
+  wait_msec();
+  EXPECT_TRUE (changed_params.is_warning);
+  EXPECT_EQ (1, get_notify_call_count());
+
+  // ...and have the server close it, e.g. when the user dismisses it
+  changed_params = ChangedParams();
+  dbus_test_dbus_mock_object_emit_signal (mock,
+                                          obj,
+                                          SIGNAL_CLOSED,
+                                          G_VARIANT_TYPE("(uu)"),
+                                          g_variant_new("(uu)", guint32(FIRST_NOTIFY_ID), guint32(NOTIFICATION_CLOSED_DISMISSED)),
+                                          &error);
+  g_assert_no_error (error);
+  wait_msec();
+  EXPECT_EQ (FIELD_IS_WARNING, changed_params.fields);
+  EXPECT_FALSE (changed_params.is_warning);
+
+  // cleanup
+  g_dbus_connection_signal_unsubscribe (bus, sub_tag);
+  g_object_unref (notifier);
+  g_object_unref (battery);
+}
+
+/***
+****
+***/
+
+namespace
+{
+  GVariant* get_battery_properties (GDBusConnection * bus)
+  {
+    struct Data { GMainLoop * loop; GVariant * props; } data { g_main_loop_new (nullptr, false), nullptr };
+
+    // async, since the skeleton answers from this thread's main loop
+    g_dbus_connection_call (bus,
+                            g_dbus_connection_get_unique_name (bus),
+                            BUS_PATH"/Battery",
+                            "org.freedesktop.DBus.Properties",
+                            "GetAll",
+                            g_variant_new ("(s)", "org.ayatana.indicator.power.Battery"),
+                            G_VARIANT_TYPE ("(a{sv})"),
+                            G_DBUS_CALL_FLAGS_NONE,
+                            -1,
+                            nullptr,
+                            [](GObject * o, GAsyncResult * res, gpointer gdata) {
+                              auto d = static_cast<Data*>(gdata);
+                              auto v = g_dbus_connection_call_finish (G_DBUS_CONNECTION(o), res, nullptr);
+                              if (v != nullptr)
+                                {
+                                  d->props = g_variant_get_child_value (v, 0);
+                                  g_variant_unref (v);
+                                }
+                              g_main_loop_quit (d->loop);
+                            },
+                            &data);
+    g_main_loop_run (data.loop);
+    g_main_loop_unref (data.loop);
+
+    return data.props;
+  }
+}
+
+TEST_F(NotifyFixture, PublishesDeviceSummary)
+{
+  auto snapshot = indicator_power_device_snapshot_new (3);
+  indicator_power_device_record_set (&snapshot->records[0], "/battery", UP_DEVICE_KIND_BATTERY,
+                                     "Some Model", 40.0, UP_DEVICE_STATE_DISCHARGING, 3600, TRUE);
+  indicator_power_device_record_set (&snapshot->records[1], "/mouse", UP_DEVICE_KIND_MOUSE,
+                                     "Some Mouse", 80.0, UP_DEVICE_STATE_DISCHARGING, 0, FALSE);
+  indicator_power_device_record_set (&snapshot->records[2], "/ups", UP_DEVICE_KIND_UPS,
+                                     "Some UPS", 100.0, UP_DEVICE_STATE_FULLY_CHARGED, 0, TRUE);
+  snapshot->on_battery = TRUE;
+  auto battery = indicator_power_device_new_from_record (&snapshot->records[0]);
+
+  auto notifier = indicator_power_notifier_new ();
+  indicator_power_notifier_set_battery (notifier, battery);
+  indicator_power_notifier_set_snapshot (notifier, snapshot);
+  indicator_power_notifier_set_bus (notifier, bus);
+  ChangedParams changed_params;
+  auto sub_tag = g_dbus_connection_signal_subscribe (bus,
+                                                     nullptr,
+                                                     "org.freedesktop.DBus.Properties",
+                                                     "PropertiesChanged",
+                                                     BUS_PATH"/Battery",
+                                                     nullptr,
+                                                     G_DBUS_SIGNAL_FLAGS_NONE,
+                                                     on_battery_property_changed,
+                                                     &changed_params,
+                                                     nullptr);
+  wait_msec();
+
+  auto props = get_battery_properties (bus);
+  ASSERT_NE (nullptr, props);
+  gdouble percentage {};
+  guint32 state {};
+  gint64 time_remaining {};
+  gboolean on_line_power {};
+  guint32 device_count {};
+  EXPECT_TRUE (g_variant_lookup (props, "Percentage", "d", &percentage));
+  EXPECT_TRUE (g_variant_lookup (props, "State", "u", &state));
+  EXPECT_TRUE (g_variant_lookup (props, "TimeRemaining", "x", &time_remaining));
+  EXPECT_TRUE (g_variant_lookup (props, "OnLinePower", "b", &on_line_power));
+  EXPECT_TRUE (g_variant_lookup (props, "DeviceCount", "u", &device_count));
+  EXPECT_DOUBLE_EQ (40.0, percentage);
+  EXPECT_EQ (guint32(UP_DEVICE_STATE_DISCHARGING), state);
+  EXPECT_EQ (3600, time_remaining);
+  EXPECT_FALSE (on_line_power);
+  EXPECT_EQ (2u, device_count); // the battery and the UPS
+  g_variant_unref (props);
+
+  // plugging in changes several properties, but they're sent together
+  changed_params = ChangedParams();
+  indicator_power_device_record_set (&snapshot->records[0], "/battery", UP_DEVICE_KIND_BATTERY,
+                                     "Some Model", 41.0, UP_DEVICE_STATE_CHARGING, 1800, TRUE);
+  snapshot->on_battery = FALSE;
+  indicator_power_device_update_from_record (battery, &snapshot->records[0]);
+  indicator_power_notifier_set_snapshot (notifier, snapshot);
+  wait_msec();
+  EXPECT_EQ (1, changed_params.n_signals);
+
+  props = get_battery_properties (bus);
+  ASSERT_NE (nullptr, props);
+  EXPECT_TRUE (g_variant_lookup (props, "Percentage", "d", &percentage));
+  EXPECT_TRUE (g_variant_lookup (props, "State", "u", &state));
+  EXPECT_TRUE (g_variant_lookup (props, "TimeRemaining", "x", &time_remaining));
+  EXPECT_TRUE (g_variant_lookup (props, "OnLinePower", "b", &on_line_power));
+  EXPECT_DOUBLE_EQ (41.0, percentage);
+  EXPECT_EQ (guint32(UP_DEVICE_STATE_CHARGING), state);
+  EXPECT_EQ (1800, time_remaining);
+  EXPECT_TRUE (on_line_power);
+  g_variant_unref (props);
+
+  // nothing changed, so nothing's sent
+  changed_params = ChangedParams();
+  indicator_power_notifier_set_snapshot (notifier, snapshot);
+  wait_msec();
+  EXPECT_EQ (0, changed_params.n_signals);
+
+  // cleanup
+  g_dbus_connection_signal_unsubscribe (bus, sub_tag);
+  g_object_unref (notifier);
+  g_object_unref (battery);
+  indicator_power_device_snapshot_unref (snapshot);
+}
+
+/***
+****
+***/
+
+namespace
+{
+  struct WatchCall
+  {
+    bool done {};
+    guint32 id {};
+    GError * error {};
+  };
+
+  void add_watch (GDBusConnection * bus, const char * property, const char * comparison, double threshold, WatchCall& call)
+  {
+    g_dbus_connection_call (bus,
+                            g_dbus_connection_get_unique_name (bus),
+                            BUS_PATH"/Battery",
+                            "org.ayatana.indicator.power.Battery",
+                            "AddWatch",
+                            g_variant_new ("(ssd)", property, comparison, threshold),
+                            G_VARIANT_TYPE ("(u)"),
+                            G_DBUS_CALL_FLAGS_NONE,
+                            -1,
+                            nullptr,
+                            [](GObject * o, GAsyncResult * res, gpointer gcall) {
+                              auto c = static_cast<WatchCall*>(gcall);
+                              auto v = g_dbus_connection_call_finish (G_DBUS_CONNECTION(o), res, &c->error);
+                              if (v != nullptr)
+                                {
+                                  g_variant_get (v, "(u)", &c->id);
+                                  g_variant_unref (v);
+                                }
+                              c->done = true;
+                            },
+                            &call);
+  }
+
+  void on_watch_fired (GDBusConnection * /*connection*/,
+                       const gchar     * /*sender_name*/,
+                       const gchar     * /*object_path*/,
+                       const gchar     * /*interface_name*/,
+                       const gchar     * /*signal_name*/,
+                       GVariant        * parameters,
+                       gpointer          gfired)
+  {
+    guint32 id {};
+    double value {};
+    g_variant_get (parameters, "(ud)", &id, &value);
+    static_cast<std::vector<std::pair<guint32,double>>*>(gfired)->emplace_back(id, value);
+  }
+}
+
+TEST_F(NotifyFixture, ThresholdWatches)
+{
+  auto battery = indicator_power_device_new ("/object/path",
+                                             UP_DEVICE_KIND_BATTERY,
+                                             "Some Model",
+                                             50.0,
+                                             UP_DEVICE_STATE_DISCHARGING,
+                                             3600,
+                                             TRUE);
+
+  auto notifier = indicator_power_notifier_new ();
+  indicator_power_notifier_set_battery (notifier, battery);
+  indicator_power_notifier_set_bus (notifier, bus);
+
+  std::vector<std::pair<guint32,double>> fired;
+  auto sub_tag = g_dbus_connection_signal_subscribe (bus,
+                                                     nullptr,
+                                                     "org.ayatana.indicator.power.Battery",
+                                                     "WatchFired",
+                                                     BUS_PATH"/Battery",
+                                                     nullptr,
+                                                     G_DBUS_SIGNAL_FLAGS_NONE,
+                                                     on_watch_fired,
+                                                     &fired,
+                                                     nullptr);
+  wait_msec();
+
+  WatchCall below_15, under_ten_minutes, charging, bogus;
+  add_watch (bus, "Percentage", "below", 15.0, below_15);
+  add_watch (bus, "TimeRemaining", "below", 600.0, under_ten_minutes);
+  add_watch (bus, "State", "equals", UP_DEVICE_STATE_CHARGING, charging);
+  add_watch (bus, "Voltage", "below", 11.0, bogus);
+  ASSERT_TRUE (wait_for ([&](){return below_15.done && under_ten_minutes.done && charging.done && bogus.done;}));
+  EXPECT_EQ (nullptr, below_15.error);
+  EXPECT_EQ (nullptr, under_ten_minutes.error);
+  EXPECT_EQ (nullptr, charging.error);
+  EXPECT_TRUE (g_error_matches (bogus.error, G_DBUS_ERROR, G_DBUS_ERROR_INVALID_ARGS));
+  g_clear_error (&bogus.error);
+
+  // changes that don't cross a threshold don't send anything
+  set_battery_percentage (battery, 40.0);
+  set_battery_percentage (battery, 20.0);
+  wait_msec();
+  EXPECT_TRUE (fired.empty());
+
+  // crossing one does
+  set_battery_percentage (battery, 14.0);
+  wait_msec();
+  ASSERT_EQ (1u, fired.size());
+  EXPECT_EQ (below_15.id, fired[0].first);
+  EXPECT_DOUBLE_EQ (14.0, fired[0].second);
+  fired.clear();
+
+  // but staying under it doesn't
+  set_battery_percentage (battery, 13.0);
+  wait_msec();
+  EXPECT_TRUE (fired.empty());
+
+  // upower reports 0 when it has no estimate; that's not "below 600"
+  g_object_set (battery, INDICATOR_POWER_DEVICE_TIME, time_t(0), nullptr);
+  wait_msec();
+  EXPECT_TRUE (fired.empty());
+
+  g_object_set (battery, INDICATOR_POWER_DEVICE_TIME, time_t(300), nullptr);
+  wait_msec();
+  ASSERT_EQ (1u, fired.size());
+  EXPECT_EQ (under_ten_minutes.id, fired[0].first);
+  EXPECT_DOUBLE_EQ (300.0, fired[0].second);
+  fired.clear();
+
+  g_object_set (battery, INDICATOR_POWER_DEVICE_STATE, UP_DEVICE_STATE_CHARGING, nullptr);
+  wait_msec();
+  ASSERT_EQ (1u, fired.size());
+  EXPECT_EQ (charging.id, fired[0].first);
+  fired.clear();
+
+  // time to full isn't time remaining
+  g_object_set (battery, INDICATOR_POWER_DEVICE_TIME, time_t(3600), nullptr);
+  g_object_set (battery, INDICATOR_POWER_DEVICE_TIME, time_t(120), nullptr);
+  wait_msec();
+  EXPECT_TRUE (fired.empty());
+
+  // unplugged again, with no estimate yet and then a long one
+  g_object_set (battery,
+                INDICATOR_POWER_DEVICE_STATE, UP_DEVICE_STATE_DISCHARGING,
+                INDICATOR_POWER_DEVICE_TIME, time_t(0),
+                nullptr);
+  g_object_set (battery, INDICATOR_POWER_DEVICE_TIME, time_t(7200), nullptr);
+  wait_msec();
+  EXPECT_TRUE (fired.empty());
+
+  // so the next real drop below 600 fires again
+  g_object_set (battery, INDICATOR_POWER_DEVICE_TIME, time_t(500), nullptr);
+  wait_msec();
+  ASSERT_EQ (1u, fired.size());
+  EXPECT_EQ (under_ten_minutes.id, fired[0].first);
+  fired.clear();
+
+  // cleanup
+  g_dbus_connection_signal_unsubscribe (bus, sub_tag);
+  g_object_unref (notifier);
+  g_object_unref (battery);
+}
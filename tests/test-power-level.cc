@@ -0,0 +1,105 @@
+/*
+ * Copyright 2026 The Ayatana Indicators project
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "power-level.h"
+
+#include <gtest/gtest.h>
+
+#include <glib.h>
+
+/***
+****
+***/
+
+namespace
+{
+  constexpr IndicatorPowerLevelSpec levels[] = {
+    { 20.0, 2.0 },
+    { 50.0, 5.0 }
+  };
+
+  constexpr guint BOTTOM {0};
+  constexpr guint MIDDLE {1};
+  constexpr guint TOP    {2};
+}
+
+TEST(PowerLevelTest, Classify)
+{
+  const guint n_levels = G_N_ELEMENTS(levels);
+
+  EXPECT_EQ(BOTTOM, indicator_power_level_classify(levels, n_levels, 0.0));
+  EXPECT_EQ(BOTTOM, indicator_power_level_classify(levels, n_levels, 20.0));
+  EXPECT_EQ(MIDDLE, indicator_power_level_classify(levels, n_levels, 20.1));
+  EXPECT_EQ(MIDDLE, indicator_power_level_classify(levels, n_levels, 50.0));
+  EXPECT_EQ(TOP,    indicator_power_level_classify(levels, n_levels, 50.1));
+  EXPECT_EQ(TOP,    indicator_power_level_classify(levels, n_levels, 100.0));
+
+  // no levels means everything's fine
+  EXPECT_EQ(0u, indicator_power_level_classify(nullptr, 0, 0.0));
+}
+
+TEST(PowerLevelTest, Hysteresis)
+{
+  auto engine = indicator_power_level_engine_new(levels, G_N_ELEMENTS(levels));
+  EXPECT_EQ(TOP, indicator_power_level_engine_get_level(engine));
+
+  // dropping below a threshold takes effect right away...
+  EXPECT_TRUE(indicator_power_level_engine_update(engine, 50.0));
+  EXPECT_EQ(MIDDLE, indicator_power_level_engine_get_level(engine));
+
+  // ...but climbing back out needs to clear the band
+  EXPECT_FALSE(indicator_power_level_engine_update(engine, 52.0));
+  EXPECT_FALSE(indicator_power_level_engine_update(engine, 55.0));
+  EXPECT_EQ(MIDDLE, indicator_power_level_engine_get_level(engine));
+  EXPECT_TRUE(indicator_power_level_engine_update(engine, 55.1));
+  EXPECT_EQ(TOP, indicator_power_level_engine_get_level(engine));
+
+  // a big jump can skip levels in either direction
+  EXPECT_TRUE(indicator_power_level_engine_update(engine, 5.0));
+  EXPECT_EQ(BOTTOM, indicator_power_level_engine_get_level(engine));
+  EXPECT_TRUE(indicator_power_level_engine_update(engine, 90.0));
+  EXPECT_EQ(TOP, indicator_power_level_engine_get_level(engine));
+
+  // clearing one band but not the next stops in between
+  indicator_power_level_engine_update(engine, 10.0);
+  EXPECT_TRUE(indicator_power_level_engine_update(engine, 53.0));
+  EXPECT_EQ(MIDDLE, indicator_power_level_engine_get_level(engine));
+
+  indicator_power_level_engine_reset(engine);
+  EXPECT_EQ(TOP, indicator_power_level_engine_get_level(engine));
+
+  indicator_power_level_engine_free(engine);
+}
+
+TEST(PowerLevelTest, NoisySeries)
+{
+  auto engine = indicator_power_level_engine_new(levels, G_N_ELEMENTS(levels));
+
+  indicator_power_level_engine_update(engine, 21.0);
+  ASSERT_EQ(MIDDLE, indicator_power_level_engine_get_level(engine));
+
+  // a reading that wobbles around a threshold changes the level once
+  auto rand = g_rand_new_with_seed(1234);
+  int n_changes {0};
+  for (int i=0; i<1000; ++i)
+    if (indicator_power_level_engine_update(engine, g_rand_double_range(rand, 19.0, 21.9)))
+      ++n_changes;
+  EXPECT_EQ(1, n_changes);
+  EXPECT_EQ(BOTTOM, indicator_power_level_engine_get_level(engine));
+
+  g_rand_free(rand);
+  indicator_power_level_engine_free(engine);
+}
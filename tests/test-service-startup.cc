@@ -0,0 +1,167 @@
+/*
+ * Copyright 2026 The Ayatana Indicators project
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "glib-fixture.h"
+
+#include "dbus-shared.h"
+#include "service.h"
+
+#include <gtest/gtest.h>
+
+#include <gio/gio.h>
+
+#include <unistd.h> // sysconf()
+
+#include <cstdio>
+#include <cstring>
+
+/***
+****
+***/
+
+class ServiceStartupFixture: public GlibFixture
+{
+  private:
+
+    typedef GlibFixture super;
+
+  protected:
+
+    GTestDBus * test_dbus {};
+    GDBusConnection * bus {};
+
+    void SetUp() override
+    {
+      super::SetUp();
+
+      test_dbus = g_test_dbus_new(G_TEST_DBUS_NONE);
+      g_test_dbus_up(test_dbus);
+      g_setenv("DBUS_SYSTEM_BUS_ADDRESS", g_test_dbus_get_bus_address(test_dbus), true);
+
+      GError * error {};
+      bus = g_bus_get_sync(G_BUS_TYPE_SESSION, nullptr, &error);
+      g_assert_no_error(error);
+      g_dbus_connection_set_exit_on_close(bus, FALSE);
+    }
+
+    void TearDown() override
+    {
+      g_dbus_connection_close_sync(bus, nullptr, nullptr);
+      g_clear_object(&bus);
+
+      wait_msec(100);
+
+      g_test_dbus_down(test_dbus);
+      g_clear_object(&test_dbus);
+      g_unsetenv("DBUS_SYSTEM_BUS_ADDRESS");
+
+      super::TearDown();
+    }
+
+    static long get_rss_kib()
+    {
+      long pages_total {}, pages_resident {};
+      auto fp = fopen("/proc/self/statm", "r");
+      if (fp != nullptr)
+        {
+          if (fscanf(fp, "%ld %ld", &pages_total, &pages_resident) != 2)
+            pages_resident = 0;
+          fclose(fp);
+        }
+      return pages_resident * (sysconf(_SC_PAGESIZE) / 1024);
+    }
+
+    // call a method on the service and wait for its reply
+    GVariant* call(const char* path, const char* iface, const char* method, GVariant* args)
+    {
+      struct Data { bool done {}; GVariant* reply {}; } data;
+
+      g_dbus_connection_call(bus, BUS_NAME, path, iface, method, args,
+                             nullptr, G_DBUS_CALL_FLAGS_NONE, -1, nullptr,
+                             [](GObject* o, GAsyncResult* res, gpointer gdata){
+                               auto d = static_cast<Data*>(gdata);
+                               d->reply = g_dbus_connection_call_finish(G_DBUS_CONNECTION(o), res, nullptr);
+                               d->done = true;
+                             },
+                             &data);
+      EXPECT_TRUE(wait_for([&data](){return data.done;}, 5000));
+      return data.reply;
+    }
+
+    GVariant* start_menu(const char* profile)
+    {
+      auto path = g_strdup_printf("%s/%s", BUS_PATH, profile);
+      GVariantBuilder b;
+      g_variant_builder_init(&b, G_VARIANT_TYPE("au"));
+      for (guint32 group=0; group<4; ++group)
+        g_variant_builder_add(&b, "u", group);
+      auto reply = call(path, "org.gtk.Menus", "Start", g_variant_new("(au)", &b));
+      g_free(path);
+      return reply;
+    }
+
+    void run_benchmark(const char* name, const char* profile, bool want_phone_settings)
+    {
+      const auto rss_before = get_rss_kib();
+      const auto begin = g_get_monotonic_time();
+
+      // time to first header
+      auto service = indicator_power_service_new(nullptr, nullptr);
+      ASSERT_NAME_OWNED_EVENTUALLY(bus, BUS_NAME, 5000);
+      auto reply = call(BUS_PATH, "org.gtk.Actions", "Describe", g_variant_new("(s)", "_header"));
+      ASSERT_NE(nullptr, reply);
+      g_variant_unref(reply);
+      const auto first_header_usec = g_get_monotonic_time() - begin;
+
+      // subscribe to the profile's menu, as its indicator would
+      reply = start_menu(profile);
+      ASSERT_NE(nullptr, reply);
+      g_variant_unref(reply);
+
+      // RSS after settle
+      wait_msec(500);
+      const auto rss_delta_kib = get_rss_kib() - rss_before;
+
+      // the phone's settings get built once its menu is subscribed to
+      reply = start_menu(profile);
+      ASSERT_NE(nullptr, reply);
+      auto str = g_variant_print(reply, true);
+      EXPECT_EQ(want_phone_settings, strstr(str, "indicator.activate-phone-settings") != nullptr) << str;
+      g_free(str);
+      g_variant_unref(reply);
+
+      g_print("%s session: first header after %.1f msec; RSS grew %ld KiB\n",
+              name, first_header_usec / 1000.0, rss_delta_kib);
+      RecordProperty("first_header_usec", int(first_header_usec));
+      RecordProperty("rss_delta_kib", int(rss_delta_kib));
+
+      g_object_unref(service);
+      wait_msec(100);
+    }
+};
+
+TEST_F(ServiceStartupFixture, DesktopSession)
+{
+  run_benchmark("desktop", "desktop", false);
+}
+
+TEST_F(ServiceStartupFixture, PhoneSession)
+{
+  // there's no repowerd on the test bus; brightness may complain about that
+  g_log_set_fatal_mask(G_LOG_DOMAIN, G_LOG_LEVEL_CRITICAL);
+
+  run_benchmark("phone", "phone", true);
+}
@@ -0,0 +1,399 @@
+/*
+ * Copyright 2026 The Ayatana Indicators project
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "glib-fixture.h"
+
+#include "dbus-battery.h"
+#include "device-snapshot.h"
+#include "shared-snapshot.h"
+#include "shared-snapshot-writer.h"
+
+#include <gtest/gtest.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+/***
+****
+***/
+
+class SharedSnapshotFixture: public GlibFixture
+{
+private:
+
+  typedef GlibFixture super;
+
+protected:
+
+  gchar * tmp_dir {};
+  gchar * filename {};
+
+  void SetUp() override
+  {
+    super::SetUp();
+
+    GError * error {};
+    tmp_dir = g_dir_make_tmp("indicator-power-shm-XXXXXX", &error);
+    g_assert_no_error(error);
+    filename = g_build_filename(tmp_dir, INDICATOR_POWER_SHM_BASENAME, nullptr);
+  }
+
+  void TearDown() override
+  {
+    g_remove(filename);
+    g_remove(tmp_dir);
+    g_clear_pointer(&filename, g_free);
+    g_clear_pointer(&tmp_dir, g_free);
+
+    super::TearDown();
+  }
+
+  IndicatorPowerSharedSnapshotWriter * create_writer()
+  {
+    GError * error {};
+    auto writer = indicator_power_shared_snapshot_writer_new(filename, &error);
+    g_assert_no_error(error);
+    return writer;
+  }
+
+  // snapshot #i has 1 + (i % MAX) records, all describing i,
+  // so a torn read shows up as records that disagree
+  static IndicatorPowerDeviceSnapshot* create_snapshot(guint i)
+  {
+    const guint n_records = 1 + (i % INDICATOR_POWER_SHM_MAX_RECORDS);
+    auto snapshot = indicator_power_device_snapshot_new(n_records);
+
+    auto path = g_strdup_printf("/org/freedesktop/UPower/devices/battery_%u", i % 16);
+    for (guint j=0; j<n_records; ++j)
+      indicator_power_device_record_set(&snapshot->records[j],
+                                        path,
+                                        UP_DEVICE_KIND_BATTERY,
+                                        "Some Model",
+                                        double(i),
+                                        UP_DEVICE_STATE_DISCHARGING,
+                                        time_t(i) * 60,
+                                        TRUE);
+    g_free(path);
+
+    return snapshot;
+  }
+
+  // returns an empty string if the copy is consistent
+  static std::string check_copy(const IndicatorPowerShm& copy)
+  {
+    if (copy.n_records == 0)
+      return "";
+
+    const auto i = guint(copy.records[0].percentage);
+    if (copy.n_records != 1 + (i % INDICATOR_POWER_SHM_MAX_RECORDS))
+      return "wrong number of records for snapshot " + std::to_string(i);
+
+    auto path = g_strdup_printf("/org/freedesktop/UPower/devices/battery_%u", i % 16);
+    std::string ret;
+    for (guint j=0; ret.empty() && j<copy.n_records; ++j)
+      {
+        const auto& record = copy.records[j];
+        if ((guint(record.percentage) != i) ||
+            (record.time != gint64(i) * 60) ||
+            (record.kind != UP_DEVICE_KIND_BATTERY) ||
+            g_strcmp0(record.object_path, path) ||
+            g_strcmp0(record.model, "Some Model"))
+          ret = "record " + std::to_string(j) + " doesn't match snapshot " + std::to_string(i);
+      }
+    g_free(path);
+
+    return ret;
+  }
+};
+
+/***
+****
+***/
+
+TEST_F(SharedSnapshotFixture, PublishAndRead)
+{
+  auto writer = create_writer();
+  auto shm = indicator_power_shm_open(filename);
+  ASSERT_NE(nullptr, shm);
+
+  // nothing published yet
+  IndicatorPowerShm copy;
+  ASSERT_EQ(INDICATOR_POWER_SHM_OK, indicator_power_shm_read(shm, &copy));
+  EXPECT_EQ(0u, copy.n_records);
+  const auto first_sequence = copy.sequence;
+
+  auto snapshot = indicator_power_device_snapshot_new(2);
+  indicator_power_device_record_set(&snapshot->records[0], "/battery", UP_DEVICE_KIND_BATTERY,
+                                    "Some Model", 42.0, UP_DEVICE_STATE_CHARGING, 600, TRUE);
+  indicator_power_device_record_set(&snapshot->records[1], nullptr, UP_DEVICE_KIND_MOUSE,
+                                    nullptr, 80.0, UP_DEVICE_STATE_DISCHARGING, 0, FALSE);
+  indicator_power_shared_snapshot_writer_publish(writer, snapshot);
+  indicator_power_device_snapshot_unref(snapshot);
+
+  EXPECT_NE(first_sequence, indicator_power_shm_get_sequence(shm));
+  ASSERT_EQ(INDICATOR_POWER_SHM_OK, indicator_power_shm_read(shm, &copy));
+  ASSERT_EQ(2u, copy.n_records);
+  EXPECT_EQ(0u, copy.sequence & 1u);
+  EXPECT_DOUBLE_EQ(42.0, copy.records[0].percentage);
+  EXPECT_EQ(600, copy.records[0].time);
+  EXPECT_EQ(guint(UP_DEVICE_KIND_BATTERY), copy.records[0].kind);
+  EXPECT_EQ(guint(UP_DEVICE_STATE_CHARGING), copy.records[0].state);
+  EXPECT_EQ(1u, copy.records[0].power_supply);
+  EXPECT_STREQ("/battery", copy.records[0].object_path);
+  EXPECT_STREQ("Some Model", copy.records[0].model);
+  EXPECT_EQ(guint(UP_DEVICE_KIND_MOUSE), copy.records[1].kind);
+  EXPECT_STREQ("", copy.records[1].object_path);
+  EXPECT_STREQ("", copy.records[1].model);
+
+  // once the writer's gone, readers are told so
+  indicator_power_shared_snapshot_writer_free(writer);
+  EXPECT_EQ(INDICATOR_POWER_SHM_STALE, indicator_power_shm_read(shm, &copy));
+  EXPECT_FALSE(g_file_test(filename, G_FILE_TEST_EXISTS));
+
+  indicator_power_shm_close(shm);
+}
+
+TEST_F(SharedSnapshotFixture, TooManyDevices)
+{
+  auto writer = create_writer();
+  auto shm = indicator_power_shm_open(filename);
+  ASSERT_NE(nullptr, shm);
+
+  auto snapshot = indicator_power_device_snapshot_new(INDICATOR_POWER_SHM_MAX_RECORDS + 10);
+  indicator_power_shared_snapshot_writer_publish(writer, snapshot);
+  indicator_power_device_snapshot_unref(snapshot);
+
+  IndicatorPowerShm copy;
+  ASSERT_EQ(INDICATOR_POWER_SHM_OK, indicator_power_shm_read(shm, &copy));
+  EXPECT_EQ(guint(INDICATOR_POWER_SHM_MAX_RECORDS), copy.n_records);
+
+  indicator_power_shm_close(shm);
+  indicator_power_shared_snapshot_writer_free(writer);
+}
+
+/* A writer thread publishes as fast as it can
+   while reader threads confirm that every copy is consistent */
+TEST_F(SharedSnapshotFixture, Torture)
+{
+  constexpr guint n_snapshots {200000};
+  constexpr int n_readers {4};
+
+  auto writer = create_writer();
+  auto shm = indicator_power_shm_open(filename);
+  ASSERT_NE(nullptr, shm);
+
+  std::atomic<bool> done {false};
+  std::atomic<int> n_reads {0};
+  std::atomic<int> n_busy {0};
+  std::vector<std::string> errors(n_readers);
+
+  std::vector<std::thread> readers;
+  for (int r=0; r<n_readers; ++r)
+    {
+      readers.emplace_back([&, r](){
+        IndicatorPowerShm copy;
+        guint32 last_sequence {0};
+        while (!done && errors[r].empty())
+          {
+            const auto result = indicator_power_shm_read(shm, &copy);
+            if (result == INDICATOR_POWER_SHM_BUSY)
+              {
+                ++n_busy;
+                continue;
+              }
+            if (result != INDICATOR_POWER_SHM_OK)
+              errors[r] = "read failed: " + std::to_string(int(result));
+            else if (copy.sequence < last_sequence)
+              errors[r] = "sequence went backwards";
+            else
+              errors[r] = check_copy(copy);
+            last_sequence = copy.sequence;
+            ++n_reads;
+          }
+      });
+    }
+
+  std::thread writer_thread([&](){
+    for (guint i=1; i<=n_snapshots; ++i)
+      {
+        auto snapshot = create_snapshot(i);
+        indicator_power_shared_snapshot_writer_publish(writer, snapshot);
+        indicator_power_device_snapshot_unref(snapshot);
+      }
+    done = true;
+  });
+
+  writer_thread.join();
+  for (auto& reader : readers)
+    reader.join();
+
+  for (const auto& error : errors)
+    EXPECT_EQ("", error);
+  EXPECT_GT(n_reads, 0);
+
+  // the last snapshot is what's left
+  IndicatorPowerShm copy;
+  ASSERT_EQ(INDICATOR_POWER_SHM_OK, indicator_power_shm_read(shm, &copy));
+  EXPECT_EQ("", check_copy(copy));
+  EXPECT_EQ(guint(n_snapshots), guint(copy.records[0].percentage));
+
+  g_print("%u snapshots published during %d consistent reads (%d reads gave up)\n",
+          n_snapshots, int(n_reads), int(n_busy));
+
+  indicator_power_shm_close(shm);
+  indicator_power_shared_snapshot_writer_free(writer);
+}
+
+/***
+****  Benchmark: reading the percentage from the shared snapshot
+****  versus getting it from the Battery interface over D-Bus
+***/
+
+class SharedSnapshotBenchmarkFixture: public SharedSnapshotFixture
+{
+private:
+
+  typedef SharedSnapshotFixture super;
+
+protected:
+
+  GTestDBus * test_dbus {};
+  GDBusConnection * service_bus {};
+  DbusBattery * skeleton {};
+
+  void SetUp() override
+  {
+    super::SetUp();
+
+    test_dbus = g_test_dbus_new(G_TEST_DBUS_NONE);
+    g_test_dbus_up(test_dbus);
+
+    GError * error {};
+    service_bus = g_dbus_connection_new_for_address_sync(
+        g_test_dbus_get_bus_address(test_dbus),
+        GDBusConnectionFlags(G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT |
+                             G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION),
+        nullptr,
+        nullptr,
+        &error);
+    g_assert_no_error(error);
+    g_dbus_connection_set_exit_on_close(service_bus, FALSE);
+
+    skeleton = dbus_battery_skeleton_new();
+    dbus_battery_set_percentage(skeleton, 42.0);
+    g_dbus_interface_skeleton_export(G_DBUS_INTERFACE_SKELETON(skeleton),
+                                     service_bus,
+                                     "/org/ayatana/indicator/power/Battery",
+                                     &error);
+    g_assert_no_error(error);
+  }
+
+  void TearDown() override
+  {
+    g_dbus_interface_skeleton_unexport(G_DBUS_INTERFACE_SKELETON(skeleton));
+    g_clear_object(&skeleton);
+    g_dbus_connection_close_sync(service_bus, nullptr, nullptr);
+    g_clear_object(&service_bus);
+
+    g_test_dbus_down(test_dbus);
+    g_clear_object(&test_dbus);
+
+    super::TearDown();
+  }
+};
+
+TEST_F(SharedSnapshotBenchmarkFixture, ReadPercentage)
+{
+  constexpr int n_dbus_reads {2000};
+  constexpr int n_shm_reads {1000000};
+
+  // D-Bus: a client thread with its own connection,
+  // while this thread's main loop serves the skeleton
+  std::atomic<bool> dbus_done {false};
+  gint64 dbus_elapsed {};
+  int dbus_ok {};
+  std::thread client([&](){
+    auto client_bus = g_dbus_connection_new_for_address_sync(
+        g_test_dbus_get_bus_address(test_dbus),
+        GDBusConnectionFlags(G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT |
+                             G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION),
+        nullptr,
+        nullptr,
+        nullptr);
+    const auto begin = g_get_monotonic_time();
+    for (int i=0; client_bus!=nullptr && i<n_dbus_reads; ++i)
+      {
+        auto v = g_dbus_connection_call_sync(client_bus,
+                                             g_dbus_connection_get_unique_name(service_bus),
+                                             "/org/ayatana/indicator/power/Battery",
+                                             "org.freedesktop.DBus.Properties",
+                                             "Get",
+                                             g_variant_new("(ss)", "org.ayatana.indicator.power.Battery", "Percentage"),
+                                             G_VARIANT_TYPE("(v)"),
+                                             G_DBUS_CALL_FLAGS_NONE,
+                                             -1,
+                                             nullptr,
+                                             nullptr);
+        if (v != nullptr)
+          {
+            ++dbus_ok;
+            g_variant_unref(v);
+          }
+      }
+    dbus_elapsed = g_get_monotonic_time() - begin;
+    if (client_bus != nullptr)
+      {
+        g_dbus_connection_close_sync(client_bus, nullptr, nullptr);
+        g_object_unref(client_bus);
+      }
+    dbus_done = true;
+  });
+  EXPECT_TRUE(wait_for([&dbus_done](){return bool(dbus_done);}, 60000));
+  client.join();
+  EXPECT_EQ(n_dbus_reads, dbus_ok);
+
+  // shared memory
+  auto writer = create_writer();
+  auto snapshot = create_snapshot(42);
+  indicator_power_shared_snapshot_writer_publish(writer, snapshot);
+  indicator_power_device_snapshot_unref(snapshot);
+  auto shm = indicator_power_shm_open(filename);
+  ASSERT_NE(nullptr, shm);
+
+  IndicatorPowerShm copy;
+  double sum {};
+  const auto begin = g_get_monotonic_time();
+  for (int i=0; i<n_shm_reads; ++i)
+    if (indicator_power_shm_read(shm, &copy) == INDICATOR_POWER_SHM_OK)
+      sum += copy.records[0].percentage;
+  const auto shm_elapsed = g_get_monotonic_time() - begin;
+  EXPECT_DOUBLE_EQ(42.0 * n_shm_reads, sum);
+
+  const double dbus_usec = double(dbus_elapsed) / n_dbus_reads;
+  const double shm_usec = double(shm_elapsed) / n_shm_reads;
+  g_print("D-Bus Get: %.2f usec/read; shared snapshot: %.4f usec/read\n", dbus_usec, shm_usec);
+  RecordProperty("dbus_nsec_per_read", int(dbus_usec * 1000));
+  RecordProperty("shm_nsec_per_read", int(shm_usec * 1000));
+
+  indicator_power_shm_close(shm);
+  indicator_power_shared_snapshot_writer_free(writer);
+}
@@ -0,0 +1,469 @@
+/*
+ * Copyright 2026 The Ayatana Indicators project
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "glib-fixture.h"
+
+#include "dbus-shared.h"
+#include "device.h"
+#include "device-provider-upower.h"
+#include "notifier.h"
+#include "service.h"
+
+#include <gtest/gtest.h>
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+/***
+****
+***/
+
+/**
+ * Starts the service the way main() does, against stand-ins for UPower
+ * and repowerd that only answer after an injected delay, and times how
+ * long it takes for the header to show the right battery.
+ */
+class StartupBudgetFixture: public GlibFixture
+{
+private:
+
+  typedef GlibFixture super;
+
+protected:
+
+  static constexpr char const * UPOWER_BUSNAME   {"org.freedesktop.UPower"};
+  static constexpr char const * UPOWER_PATH      {"/org/freedesktop/UPower"};
+  static constexpr char const * POWERD_BUSNAME   {"com.lomiri.Repowerd"};
+  static constexpr char const * POWERD_PATH      {"/com/lomiri/Repowerd"};
+  static constexpr char const * PROPERTIES_IFACE {"org.freedesktop.DBus.Properties"};
+
+  // the injected delays
+  static constexpr guint UPOWER_APPEARS_MSEC {50};
+  static constexpr guint ENUMERATE_MSEC      {100};
+  static constexpr guint SLOWEST_GET_ALL_MSEC {150};
+  static constexpr guint REPOWERD_MSEC       {1500};
+
+  // what the service may add on top of UPower's own delays
+  static constexpr guint OVERHEAD_MSEC {250};
+
+  static constexpr guint BUDGET_MSEC {UPOWER_APPEARS_MSEC + ENUMERATE_MSEC + SLOWEST_GET_ALL_MSEC + OVERHEAD_MSEC};
+  static_assert(BUDGET_MSEC < REPOWERD_MSEC, "the header mustn't be able to wait on repowerd");
+
+  struct MockDevice
+  {
+    const char * path;
+    gdouble percentage;
+    guint get_all_msec;
+  };
+
+  // the header shows these two batteries averaged, so a header
+  // built from only one of them is easy to tell from a correct one
+  const std::vector<MockDevice> mock_devices {
+    { "/org/freedesktop/UPower/devices/battery_BAT0", 80.0, SLOWEST_GET_ALL_MSEC / 3 },
+    { "/org/freedesktop/UPower/devices/battery_BAT1", 20.0, SLOWEST_GET_ALL_MSEC }
+  };
+  static constexpr char const * EXPECTED_PERCENT {"50%"};
+
+  GTestDBus * test_dbus {};
+  GDBusConnection * bus {};
+  GDBusConnection * stand_in_bus {};
+  GDBusNodeInfo * node_info {};
+  std::vector<guint> reg_ids;
+  std::vector<guint> pending_replies;
+  guint upower_own_id {};
+  guint powerd_own_id {};
+  guint actions_changed_tag {};
+  int brightness_params_calls {};
+
+  gint64 begin {};
+  gint64 first_correct_usec {};
+  std::vector<std::string> wrong_labels;
+
+  void SetUp() override
+  {
+    super::SetUp();
+
+    test_dbus = g_test_dbus_new(G_TEST_DBUS_NONE);
+    g_test_dbus_up(test_dbus);
+    g_setenv("DBUS_SYSTEM_BUS_ADDRESS", g_test_dbus_get_bus_address(test_dbus), true);
+
+    GError * error {};
+    bus = g_bus_get_sync(G_BUS_TYPE_SESSION, nullptr, &error);
+    g_assert_no_error(error);
+    g_dbus_connection_set_exit_on_close(bus, FALSE);
+
+    stand_in_bus = g_dbus_connection_new_for_address_sync(
+        g_test_dbus_get_bus_address(test_dbus),
+        GDBusConnectionFlags(G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT |
+                             G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION),
+        nullptr,
+        nullptr,
+        &error);
+    g_assert_no_error(error);
+    g_dbus_connection_set_exit_on_close(stand_in_bus, FALSE);
+
+    node_info = g_dbus_node_info_new_for_xml(
+        "<node>"
+        "  <interface name='org.freedesktop.UPower'>"
+        "    <method name='EnumerateDevices'>"
+        "      <arg type='ao' direction='out'/>"
+        "    </method>"
+        "    <property name='OnBattery' type='b' access='read'/>"
+        "  </interface>"
+        "  <interface name='org.freedesktop.UPower.Device'>"
+        "    <property name='Type' type='u' access='read'/>"
+        "    <property name='State' type='u' access='read'/>"
+        "    <property name='Percentage' type='d' access='read'/>"
+        "    <property name='TimeToEmpty' type='x' access='read'/>"
+        "    <property name='PowerSupply' type='b' access='read'/>"
+        "  </interface>"
+        "  <interface name='com.lomiri.Repowerd'>"
+        "    <property name='brightness' type='i' access='readwrite'/>"
+        "    <method name='getBrightnessParams'>"
+        "      <arg type='(iiiib)' direction='out'/>"
+        "    </method>"
+        "  </interface>"
+        "</node>",
+        &error);
+    g_assert_no_error(error);
+
+    // with no get_property(), GetAll() comes to on_method_call()
+    // so that it can be answered late
+    static const GDBusInterfaceVTable vtable = {
+      on_method_call, nullptr, nullptr, {}
+    };
+    static const GDBusInterfaceVTable powerd_vtable = {
+      on_method_call, on_powerd_get_property, nullptr, {}
+    };
+
+    register_object(UPOWER_PATH, node_info->interfaces[0], &vtable);
+    for (const auto& device : mock_devices)
+      register_object(device.path, node_info->interfaces[1], &vtable);
+    register_object(POWERD_PATH, node_info->interfaces[2], &powerd_vtable);
+
+    powerd_own_id = g_bus_own_name_on_connection(stand_in_bus, POWERD_BUSNAME,
+                                                 G_BUS_NAME_OWNER_FLAGS_NONE,
+                                                 nullptr, nullptr, nullptr, nullptr);
+    ASSERT_NAME_OWNED_EVENTUALLY(stand_in_bus, POWERD_BUSNAME);
+
+    // watch the header as a client would
+    actions_changed_tag = g_dbus_connection_signal_subscribe(bus,
+                                                             nullptr,
+                                                             "org.gtk.Actions",
+                                                             "Changed",
+                                                             BUS_PATH,
+                                                             nullptr,
+                                                             G_DBUS_SIGNAL_FLAGS_NONE,
+                                                             on_actions_changed,
+                                                             this,
+                                                             nullptr);
+
+    auto settings = g_settings_new("org.ayatana.indicator.power");
+    g_settings_set_boolean(settings, "show-percentage", TRUE);
+    g_object_unref(settings);
+  }
+
+  void TearDown() override
+  {
+    for (const auto id : pending_replies)
+      {
+        auto source = g_main_context_find_source_by_id(nullptr, id);
+        if (source != nullptr)
+          g_source_destroy(source);
+      }
+
+    g_dbus_connection_signal_unsubscribe(bus, actions_changed_tag);
+    if (upower_own_id != 0)
+      g_bus_unown_name(upower_own_id);
+    g_bus_unown_name(powerd_own_id);
+    for (const auto id : reg_ids)
+      g_dbus_connection_unregister_object(stand_in_bus, id);
+    g_clear_pointer(&node_info, g_dbus_node_info_unref);
+    g_dbus_connection_close_sync(stand_in_bus, nullptr, nullptr);
+    g_clear_object(&stand_in_bus);
+    g_dbus_connection_close_sync(bus, nullptr, nullptr);
+    g_clear_object(&bus);
+
+    wait_msec(100);
+
+    g_test_dbus_down(test_dbus);
+    g_clear_object(&test_dbus);
+    g_unsetenv("DBUS_SYSTEM_BUS_ADDRESS");
+
+    super::TearDown();
+  }
+
+  void register_object(const char* path, GDBusInterfaceInfo* info, const GDBusInterfaceVTable* vtable)
+  {
+    GError * error {};
+    reg_ids.push_back(g_dbus_connection_register_object(stand_in_bus, path, info, vtable, this, nullptr, &error));
+    g_assert_no_error(error);
+  }
+
+  /***
+  ****  The stand-ins
+  ***/
+
+  struct DelayedReply
+  {
+    GDBusMethodInvocation * invocation;
+    GVariant * value;
+  };
+
+  static gboolean
+  on_reply_timeout(gpointer gdata)
+  {
+    auto data = static_cast<DelayedReply*>(gdata);
+    g_dbus_method_invocation_return_value(data->invocation, data->value);
+    data->invocation = nullptr;
+    return G_SOURCE_REMOVE;
+  }
+
+  static void
+  delayed_reply_free(gpointer gdata)
+  {
+    auto data = static_cast<DelayedReply*>(gdata);
+
+    // torn down before it was due
+    if (data->invocation != nullptr)
+      {
+        g_variant_unref(g_variant_ref_sink(data->value));
+        g_dbus_method_invocation_return_dbus_error(data->invocation,
+                                                   "org.freedesktop.DBus.Error.NoReply",
+                                                   "shutting down");
+      }
+
+    delete data;
+  }
+
+  void reply_later(GDBusMethodInvocation* invocation, GVariant* value, guint msec)
+  {
+    pending_replies.push_back(g_timeout_add_full(G_PRIORITY_DEFAULT,
+                                                 msec,
+                                                 on_reply_timeout,
+                                                 new DelayedReply{invocation, value},
+                                                 delayed_reply_free));
+  }
+
+  static void
+  on_method_call(GDBusConnection       * /*connection*/,
+                 const gchar           * /*sender*/,
+                 const gchar           * object_path,
+                 const gchar           * interface_name,
+                 const gchar           * method_name,
+                 GVariant              * /*parameters*/,
+                 GDBusMethodInvocation * invocation,
+                 gpointer                gself)
+  {
+    auto self = static_cast<StartupBudgetFixture*>(gself);
+
+    if (!g_strcmp0(method_name, "EnumerateDevices"))
+      {
+        GVariantBuilder b;
+        g_variant_builder_init(&b, G_VARIANT_TYPE("ao"));
+        for (const auto& device : self->mock_devices)
+          g_variant_builder_add(&b, "o", device.path);
+        self->reply_later(invocation, g_variant_new("(ao)", &b), ENUMERATE_MSEC);
+      }
+    else if (!g_strcmp0(interface_name, PROPERTIES_IFACE) && !g_strcmp0(method_name, "Get"))
+      {
+        // the manager's OnBattery
+        g_dbus_method_invocation_return_value(invocation,
+                                              g_variant_new("(v)", g_variant_new_boolean(TRUE)));
+      }
+    else if (!g_strcmp0(interface_name, PROPERTIES_IFACE) && !g_strcmp0(method_name, "GetAll"))
+      {
+        for (const auto& device : self->mock_devices)
+          {
+            if (g_strcmp0(device.path, object_path))
+              continue;
+
+            GVariantBuilder b;
+            g_variant_builder_init(&b, G_VARIANT_TYPE_VARDICT);
+            g_variant_builder_add(&b, "{sv}", "Type", g_variant_new_uint32(UP_DEVICE_KIND_BATTERY));
+            g_variant_builder_add(&b, "{sv}", "State", g_variant_new_uint32(UP_DEVICE_STATE_DISCHARGING));
+            g_variant_builder_add(&b, "{sv}", "Percentage", g_variant_new_double(device.percentage));
+            g_variant_builder_add(&b, "{sv}", "TimeToEmpty", g_variant_new_int64(3600));
+            g_variant_builder_add(&b, "{sv}", "PowerSupply", g_variant_new_boolean(TRUE));
+            self->reply_later(invocation, g_variant_new("(a{sv})", &b), device.get_all_msec);
+            return;
+          }
+
+        g_dbus_method_invocation_return_dbus_error(invocation,
+                                                   "org.freedesktop.DBus.Error.UnknownObject",
+                                                   object_path);
+      }
+    else if (!g_strcmp0(method_name, "getBrightnessParams"))
+      {
+        ++self->brightness_params_calls;
+        self->reply_later(invocation, g_variant_new("((iiiib))", 5, 10, 255, 128, FALSE), REPOWERD_MSEC);
+      }
+    else
+      {
+        g_dbus_method_invocation_return_dbus_error(invocation,
+                                                   "org.freedesktop.DBus.Error.UnknownMethod",
+                                                   method_name);
+      }
+  }
+
+  static GVariant*
+  on_powerd_get_property(GDBusConnection * /*connection*/,
+                         const gchar     * /*sender*/,
+                         const gchar     * /*object_path*/,
+                         const gchar     * /*interface_name*/,
+                         const gchar     * /*property_name*/,
+                         GError         ** /*error*/,
+                         gpointer          /*gself*/)
+  {
+    return g_variant_new_int32(128);
+  }
+
+  static gboolean
+  on_upower_appears(gpointer gself)
+  {
+    auto self = static_cast<StartupBudgetFixture*>(gself);
+
+    self->upower_own_id = g_bus_own_name_on_connection(self->stand_in_bus, UPOWER_BUSNAME,
+                                                       G_BUS_NAME_OWNER_FLAGS_NONE,
+                                                       nullptr, nullptr, nullptr, nullptr);
+    return G_SOURCE_REMOVE;
+  }
+
+  /***
+  ****  Watching the header
+  ***/
+
+  void on_header_state(GVariant* state)
+  {
+    const gchar * label {};
+    gboolean visible {};
+
+    if (!g_variant_lookup(state, "label", "&s", &label))
+      return;
+
+    g_variant_lookup(state, "visible", "b", &visible);
+    if (!visible || (strstr(label, EXPECTED_PERCENT) == nullptr))
+      wrong_labels.push_back(label);
+    else if (first_correct_usec == 0)
+      first_correct_usec = g_get_monotonic_time() - begin;
+  }
+
+  static void
+  on_actions_changed(GDBusConnection * /*connection*/,
+                     const gchar     * /*sender_name*/,
+                     const gchar     * /*object_path*/,
+                     const gchar     * /*interface_name*/,
+                     const gchar     * /*signal_name*/,
+                     GVariant        * parameters,
+                     gpointer          gself)
+  {
+    // (asa{sb}a{sv}a{s(bgav)}): the third child holds the new states
+    auto states = g_variant_get_child_value(parameters, 2);
+    auto state = g_variant_lookup_value(states, "_header", G_VARIANT_TYPE_VARDICT);
+    if (state != nullptr)
+      {
+        static_cast<StartupBudgetFixture*>(gself)->on_header_state(state);
+        g_variant_unref(state);
+      }
+    g_variant_unref(states);
+  }
+
+  // the header as it was when we first got to look at it
+  void describe_header()
+  {
+    GError * error {};
+    auto reply = g_dbus_connection_call_sync(bus, BUS_NAME, BUS_PATH,
+                                             "org.gtk.Actions", "Describe",
+                                             g_variant_new("(s)", "_header"),
+                                             G_VARIANT_TYPE("((bgav))"),
+                                             G_DBUS_CALL_FLAGS_NONE, -1, nullptr, &error);
+    g_assert_no_error(error);
+
+    GVariant * states {};
+    g_variant_get(reply, "((bg@av))", nullptr, nullptr, &states);
+    if (g_variant_n_children(states) > 0)
+      {
+        auto boxed = g_variant_get_child_value(states, 0);
+        auto state = g_variant_get_variant(boxed);
+        on_header_state(state);
+        g_variant_unref(state);
+        g_variant_unref(boxed);
+      }
+    g_variant_unref(states);
+    g_variant_unref(reply);
+  }
+
+  void run_budget(const char* name, bool threaded)
+  {
+    begin = g_get_monotonic_time();
+
+    // the same order as main()
+    auto upower = threaded ? indicator_power_device_provider_upower_new_threaded()
+                           : indicator_power_device_provider_upower_new();
+    auto notifier = indicator_power_notifier_new();
+    auto service = indicator_power_service_new(upower, notifier);
+
+    // UPower shows up a little after we do
+    g_timeout_add(UPOWER_APPEARS_MSEC, on_upower_appears, this);
+
+    ASSERT_NAME_OWNED_EVENTUALLY(bus, BUS_NAME, 5000);
+
+    // a phone indicator subscribes right away, which wakes up brightness;
+    // repowerd is slow to answer, but the header mustn't wait for it
+    GVariantBuilder b;
+    g_variant_builder_init(&b, G_VARIANT_TYPE("au"));
+    g_variant_builder_add(&b, "u", 0u);
+    g_dbus_connection_call(bus, BUS_NAME, BUS_PATH "/phone", "org.gtk.Menus", "Start",
+                           g_variant_new("(au)", &b), nullptr, G_DBUS_CALL_FLAGS_NONE,
+                           -1, nullptr, nullptr, nullptr);
+
+    describe_header();
+    EXPECT_TRUE(wait_for([this](){return first_correct_usec != 0;}, 5000));
+    EXPECT_TRUE(wait_for([this](){return brightness_params_calls > 0;}, 2000));
+
+    // no partial header got out before the complete one
+    for (const auto& label : wrong_labels)
+      ADD_FAILURE() << "header showed '" << label << "' before '" << EXPECTED_PERCENT << "'";
+
+    EXPECT_LT(first_correct_usec, gint64(BUDGET_MSEC) * 1000);
+    g_print("%s: first correct header after %.1f msec (budget %u msec)\n",
+            name, first_correct_usec / 1000.0, BUDGET_MSEC);
+    RecordProperty("first_correct_header_usec", int(first_correct_usec));
+
+    g_object_unref(service);
+    g_object_unref(notifier);
+    g_object_unref(upower);
+    wait_msec(100);
+  }
+};
+
+/***
+****
+***/
+
+TEST_F(StartupBudgetFixture, FirstHeaderWithinBudget)
+{
+  run_budget("main thread", false);
+}
+
+TEST_F(StartupBudgetFixture, ThreadedFirstHeaderWithinBudget)
+{
+  run_budget("ingestion thread", true);
+}
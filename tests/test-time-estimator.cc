@@ -0,0 +1,141 @@
+/*
+ * Copyright 2026 The Ayatana Indicators project
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "time-estimator.h"
+
+#include <gtest/gtest.h>
+
+#include <glib.h>
+
+#include <cmath>
+
+/***
+****
+***/
+
+namespace
+{
+  constexpr gint64 SECOND {G_USEC_PER_SEC};
+  constexpr gint64 MINUTE {60 * SECOND};
+
+  // Feed the estimator a curve sampled the way upower reports it:
+  // whole percentages, each reported when it's first reached.
+  // Returns the first time an estimate was available, or -1.
+  template<typename Curve>
+  gint64 feed (IndicatorPowerTimeEstimator& estimator, Curve curve, gint64 duration, bool charging)
+  {
+    gint64 first_estimate = -1;
+
+    for (gint64 t=0; t<=duration; t+=SECOND)
+      {
+        indicator_power_time_estimator_add_sample (&estimator, t, std::round(curve(t)));
+
+        if ((first_estimate < 0) && indicator_power_time_estimator_get_time (&estimator, charging))
+          first_estimate = t;
+      }
+
+    return first_estimate;
+  }
+}
+
+TEST(TimeEstimatorTest, MemoryBudget)
+{
+  // devices embed the estimator, so it must stay small and fixed-size
+  static_assert(sizeof(IndicatorPowerTimeEstimator) <= 192, "estimator grew past its budget");
+}
+
+TEST(TimeEstimatorTest, NothingToGoOn)
+{
+  IndicatorPowerTimeEstimator estimator;
+  indicator_power_time_estimator_reset (&estimator);
+  EXPECT_EQ(0, indicator_power_time_estimator_get_time (&estimator, FALSE));
+
+  // an unchanging percentage gives no rate
+  for (int i=0; i<100; ++i)
+    indicator_power_time_estimator_add_sample (&estimator, i*MINUTE, 50.0);
+  EXPECT_FALSE(indicator_power_time_estimator_get_rate (&estimator, nullptr));
+  EXPECT_EQ(0, indicator_power_time_estimator_get_time (&estimator, FALSE));
+
+  // a fast change that hasn't gone on for long enough isn't trusted
+  indicator_power_time_estimator_reset (&estimator);
+  for (int i=0; i<10; ++i)
+    indicator_power_time_estimator_add_sample (&estimator, i*SECOND, 50.0 - i);
+  EXPECT_EQ(0, indicator_power_time_estimator_get_time (&estimator, FALSE));
+}
+
+TEST(TimeEstimatorTest, LinearDischarge)
+{
+  // 1% every 36 seconds: a full battery lasts one hour
+  IndicatorPowerTimeEstimator estimator;
+  indicator_power_time_estimator_reset (&estimator);
+  auto curve = [](gint64 t){ return 80.0 - t / (36.0 * SECOND); };
+  const auto first = feed (estimator, curve, 10*MINUTE, false);
+
+  // we get an estimate within a few minutes...
+  ASSERT_GE(first, 0);
+  EXPECT_LE(first, 3*MINUTE);
+
+  // ...and it's close to the truth
+  const auto expected = curve(10*MINUTE) * 36.0;
+  const auto actual = indicator_power_time_estimator_get_time (&estimator, FALSE);
+  EXPECT_NEAR(expected, actual, expected * 0.05);
+
+  // but it's not a charging estimate
+  EXPECT_EQ(0, indicator_power_time_estimator_get_time (&estimator, TRUE));
+}
+
+TEST(TimeEstimatorTest, LinearCharge)
+{
+  // 1% a minute
+  IndicatorPowerTimeEstimator estimator;
+  indicator_power_time_estimator_reset (&estimator);
+  auto curve = [](gint64 t){ return 20.0 + t / double(MINUTE); };
+  ASSERT_GE(feed (estimator, curve, 15*MINUTE, true), 0);
+
+  const auto expected = (100.0 - curve(15*MINUTE)) * 60.0;
+  const auto actual = indicator_power_time_estimator_get_time (&estimator, TRUE);
+  EXPECT_NEAR(expected, actual, expected * 0.05);
+}
+
+TEST(TimeEstimatorTest, FollowsChangingLoad)
+{
+  // 1% a minute, then a heavy load drains 1% every 15 seconds
+  IndicatorPowerTimeEstimator estimator;
+  indicator_power_time_estimator_reset (&estimator);
+  auto curve = [](gint64 t){
+    return t < 10*MINUTE ? 90.0 - t / double(MINUTE)
+                         : 80.0 - (t - 10*MINUTE) / (15.0 * SECOND);
+  };
+  ASSERT_GE(feed (estimator, curve, 15*MINUTE, false), 0);
+
+  gdouble rate {};
+  ASSERT_TRUE(indicator_power_time_estimator_get_rate (&estimator, &rate));
+  EXPECT_NEAR(-1.0/15.0, rate, 0.01);
+}
+
+TEST(TimeEstimatorTest, DirectionChangeStartsOver)
+{
+  IndicatorPowerTimeEstimator estimator;
+  indicator_power_time_estimator_reset (&estimator);
+  auto curve = [](gint64 t){ return 80.0 - t / double(MINUTE); };
+  ASSERT_GE(feed (estimator, curve, 10*MINUTE, false), 0);
+
+  // plugged in: the old discharge rate mustn't leak into a charge estimate
+  indicator_power_time_estimator_add_sample (&estimator, 10*MINUTE + 30*SECOND, 71.0);
+  EXPECT_FALSE(indicator_power_time_estimator_get_rate (&estimator, nullptr));
+  EXPECT_EQ(0, indicator_power_time_estimator_get_time (&estimator, FALSE));
+  EXPECT_EQ(0, indicator_power_time_estimator_get_time (&estimator, TRUE));
+}